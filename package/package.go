@@ -40,8 +40,15 @@ func GetPackage() *denv.Package {
 	maintest.AddDependencies(unittestpkg.GetMainLib()...)
 	maintest.AddDependency(testlib)
 
+	// benchmark application (source/bench)
+	mainbench := denv.SetupCppAppProject(mainpkg, name+"_bench")
+	mainbench.AddDependencies(basepkg.GetMainLib()...)
+	mainbench.AddDependencies(corepkg.GetMainLib()...)
+	mainbench.AddDependency(mainlib)
+
 	mainpkg.AddMainLib(mainlib)
 	mainpkg.AddTestLib(testlib)
 	mainpkg.AddUnittest(maintest)
+	mainpkg.AddMainApp(mainbench)
 	return mainpkg
 }
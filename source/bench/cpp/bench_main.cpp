@@ -0,0 +1,343 @@
+#include "cbase/c_base.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_context.h"
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_arena.h"
+#include "c3dff/c_synthetic.h"
+#include "c3dff/c_pointcloud.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Decode benchmark on synthetic ply files, the results are written as JSON.
+//
+//   c3dff_bench [--vertices N] [--faces N] [--arity N] [--attributes N] [--position float|double]
+//               [--format ascii|ble|bbe|all] [--repeat N] [--seed N] [--out file.json]
+//
+// Every phase runs 'repeat' times and the fastest run is reported, the generated data only depends
+// on the arguments so that runs on different machines or builds can be compared.
+
+using namespace ncore;
+
+static f64 now_seconds()
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+class size_writer_t : public nsynthetic::writer_t
+{
+public:
+    size_writer_t()
+        : m_size(0)
+    {
+    }
+    virtual bool write(const u8* data, u64 size)
+    {
+        m_size += size;
+        return true;
+    }
+    u64 m_size;
+};
+
+class memory_writer_t : public nsynthetic::writer_t
+{
+public:
+    memory_writer_t(u8* buffer, u64 size)
+        : m_buffer(buffer)
+        , m_size(size)
+        , m_used(0)
+    {
+    }
+    virtual bool write(const u8* data, u64 size)
+    {
+        if (m_used + size > m_size)
+            return false;
+        memcpy(m_buffer + m_used, data, (size_t)size);
+        m_used += size;
+        return true;
+    }
+    u8* m_buffer;
+    u64 m_size;
+    u64 m_used;
+};
+
+// Accepts every element and ignores the data, measures parsing and conversion only
+class null_handler_t : public nply::handler_t
+{
+public:
+    null_handler_t()
+        : m_count(0)
+    {
+    }
+    virtual bool setup(s32 element_index, u64 num_items, nply::etype* property_type_array, s32* property_index_array, s32 property_count) { return true; }
+    virtual void read(s32 element_index, nply::etype* property_type_array, s32 property_count, void* property_data) { m_count++; }
+    u64 m_count;
+};
+
+struct result_t
+{
+    const char* m_format;
+    const char* m_phase;
+    u64         m_bytes;
+    u64         m_elements;
+    f64         m_seconds;
+};
+
+static const s32 c_max_results = 64;
+
+struct bench_t
+{
+    nsynthetic::config_t m_config;
+    s32                  m_repeat;
+    nply::arena_t        m_arena;
+    const u8*            m_data;
+    u64                  m_size;
+    u64                  m_body_offset;
+    result_t             m_results[c_max_results];
+    s32                  m_result_count;
+};
+
+static void add_result(bench_t& bench, const char* format, const char* phase, u64 bytes, u64 elements, f64 seconds)
+{
+    if (bench.m_result_count == c_max_results)
+        return;
+    result_t& r  = bench.m_results[bench.m_result_count++];
+    r.m_format   = format;
+    r.m_phase    = phase;
+    r.m_bytes    = bytes;
+    r.m_elements = elements;
+    r.m_seconds  = seconds;
+}
+
+enum ephase
+{
+    PHASE_HEADER = 0,
+    PHASE_DECODE,
+    PHASE_VERTICES,
+    PHASE_TRIANGLES,
+    PHASE_VOXEL_GRID,
+};
+
+// Run one phase on the generated file, returns the time of the decode (or header) part
+static f64 run_phase(bench_t& bench, ephase phase, u64& elements)
+{
+    nply::arena_t& arena = bench.m_arena;
+    arena.reset();
+
+    nply::memory_reader_t reader(bench.m_data, bench.m_size);
+    nply::ply_t*          ply = nply::create(&arena);
+    if (ply == nullptr)
+        return -1.0;
+
+    f64 const header_start = now_seconds();
+    if (!nply::read_header(ply, &reader))
+        return -1.0;
+    f64 const header_end = now_seconds();
+    bench.m_body_offset  = reader.offset();
+
+    u64 const vertex_count = nply::get_element_count(ply, "vertex");
+    u64 const face_count   = nply::get_element_count(ply, "face");
+    elements               = 0;
+
+    f64  start = 0.0, end = 0.0;
+    bool ok    = true;
+    switch (phase)
+    {
+        case PHASE_HEADER:
+            return header_end - header_start;
+        case PHASE_DECODE:
+        {
+            null_handler_t handler;
+            start    = now_seconds();
+            ok       = nply::read_data(ply, &reader, &handler, nullptr);
+            end      = now_seconds();
+            elements = handler.m_count;
+            break;
+        }
+        case PHASE_VERTICES:
+        {
+            const char* xyz[3] = {"x", "y", "z"};
+            nply::select_properties(ply, "vertex", xyz, 3);
+            nply::vertex_t* vertices = (nply::vertex_t*)arena.alloc(sizeof(nply::vertex_t) * (vertex_count + 1));
+            if (vertices == nullptr)
+                return -1.0;
+            nply::vertices_handler_t handler(vertices, vertex_count);
+            start    = now_seconds();
+            ok       = nply::read_data(ply, &reader, &handler, nullptr);
+            end      = now_seconds();
+            elements = handler.m_vertex_count;
+            break;
+        }
+        case PHASE_TRIANGLES:
+        {
+            // faces with more than 3 corners are fan triangulated by the handler
+            s32 const         arity          = bench.m_config.m_face_arity;
+            u64 const         triangle_count = face_count * (u64)(arity > 3 ? arity - 2 : 1);
+            nply::triangle_t* triangles      = (nply::triangle_t*)arena.alloc(sizeof(nply::triangle_t) * (triangle_count + 1));
+            if (triangles == nullptr)
+                return -1.0;
+            nply::triangles_handler_t handler(triangles, triangle_count);
+            start    = now_seconds();
+            ok       = nply::read_data(ply, &reader, &handler, nullptr);
+            end      = now_seconds();
+            elements = handler.m_triangle_count;
+            break;
+        }
+        case PHASE_VOXEL_GRID:
+        {
+            const char* xyz[3] = {"x", "y", "z"};
+            nply::select_properties(ply, "vertex", xyz, 3);
+            npointcloud::voxel_grid_handler_t handler(&arena, 1.0f);
+            start    = now_seconds();
+            ok       = nply::read_data(ply, &reader, &handler, nullptr);
+            end      = now_seconds();
+            elements = handler.get_input_count();
+            break;
+        }
+    }
+    return ok ? (end - start) : -1.0;
+}
+
+static void run_format(bench_t& bench, nply::eformat format)
+{
+    static const char* s_format_names[] = {"ascii", "ble", "bbe"};
+    const char*        format_name      = s_format_names[format];
+
+    bench.m_config.m_format = format;
+
+    size_writer_t sizer;
+    nsynthetic::generate(bench.m_config, &sizer);
+    u8*             data = (u8*)malloc((size_t)sizer.m_size);
+    memory_writer_t writer(data, sizer.m_size);
+    if (data == nullptr || !nsynthetic::generate(bench.m_config, &writer))
+    {
+        fprintf(stderr, "failed to generate %s data (%llu bytes)\n", format_name, (unsigned long long)sizer.m_size);
+        free(data);
+        return;
+    }
+    bench.m_data = data;
+    bench.m_size = sizer.m_size;
+
+    struct phase_t
+    {
+        ephase      m_phase;
+        const char* m_name;
+    };
+    static const phase_t s_phases[] = {
+      {PHASE_HEADER, "header"},
+      {PHASE_DECODE, "decode"},
+      {PHASE_VERTICES, "handler_vertices_xyz"},
+      {PHASE_TRIANGLES, "handler_triangles"},
+      {PHASE_VOXEL_GRID, "handler_voxel_grid"},
+    };
+
+    for (s32 p = 0; p < (s32)(sizeof(s_phases) / sizeof(s_phases[0])); ++p)
+    {
+        ephase const phase = s_phases[p].m_phase;
+        if (phase == PHASE_TRIANGLES && bench.m_config.m_face_count == 0)
+            continue;
+
+        f64 best     = -1.0;
+        u64 elements = 0;
+        for (s32 r = 0; r < bench.m_repeat; ++r)
+        {
+            f64 const t = run_phase(bench, phase, elements);
+            if (t >= 0.0 && (best < 0.0 || t < best))
+                best = t;
+        }
+        if (best < 0.0)
+        {
+            fprintf(stderr, "%s: phase %s failed\n", format_name, s_phases[p].m_name);
+            continue;
+        }
+        u64 const bytes = phase == PHASE_HEADER ? bench.m_body_offset : bench.m_size - bench.m_body_offset;
+        add_result(bench, format_name, s_phases[p].m_name, bytes, elements, best);
+    }
+
+    free(data);
+    bench.m_data = nullptr;
+}
+
+static void write_json(bench_t const& bench, FILE* out)
+{
+    nsynthetic::config_t const& c = bench.m_config;
+    fprintf(out, "{\n");
+    fprintf(out, "  \"benchmark\": \"c3dff.decode\",\n");
+    fprintf(out, "  \"config\": {\"vertices\": %llu, \"faces\": %llu, \"arity\": %d, \"attributes\": %d, \"position\": \"%s\", \"seed\": %u, \"repeat\": %d},\n", (unsigned long long)c.m_vertex_count,
+            (unsigned long long)c.m_face_count, c.m_face_arity, c.m_attribute_count, c.m_position_type == nply::TYPE_FLOAT64 ? "double" : "float", c.m_seed, bench.m_repeat);
+    fprintf(out, "  \"results\": [\n");
+    for (s32 i = 0; i < bench.m_result_count; ++i)
+    {
+        result_t const& r       = bench.m_results[i];
+        f64 const       seconds = r.m_seconds > 0.0 ? r.m_seconds : 1e-9;
+        fprintf(out, "    {\"format\": \"%s\", \"phase\": \"%s\", \"bytes\": %llu, \"elements\": %llu, \"seconds\": %.6f, \"mb_per_s\": %.3f, \"elements_per_s\": %.1f}%s\n", r.m_format, r.m_phase,
+                (unsigned long long)r.m_bytes, (unsigned long long)r.m_elements, r.m_seconds, ((f64)r.m_bytes / (1024.0 * 1024.0)) / seconds, (f64)r.m_elements / seconds, (i + 1) < bench.m_result_count ? "," : "");
+    }
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char** argv)
+{
+    cbase::init();
+
+    static bench_t bench;
+    bench.m_config.m_vertex_count = 1000000;
+    bench.m_config.m_face_count   = 2000000;
+    bench.m_repeat                = 3;
+    bench.m_result_count          = 0;
+
+    const char* format   = "all";
+    const char* out_path = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const char* key   = argv[i];
+        const char* value = argv[i + 1];
+        if (strcmp(key, "--vertices") == 0)
+            bench.m_config.m_vertex_count = strtoull(value, nullptr, 10);
+        else if (strcmp(key, "--faces") == 0)
+            bench.m_config.m_face_count = strtoull(value, nullptr, 10);
+        else if (strcmp(key, "--arity") == 0)
+            bench.m_config.m_face_arity = atoi(value);
+        else if (strcmp(key, "--attributes") == 0)
+            bench.m_config.m_attribute_count = atoi(value);
+        else if (strcmp(key, "--position") == 0)
+            bench.m_config.m_position_type = strcmp(value, "double") == 0 ? nply::TYPE_FLOAT64 : nply::TYPE_FLOAT32;
+        else if (strcmp(key, "--format") == 0)
+            format = value;
+        else if (strcmp(key, "--repeat") == 0)
+            bench.m_repeat = atoi(value) > 0 ? atoi(value) : 1;
+        else if (strcmp(key, "--seed") == 0)
+            bench.m_config.m_seed = (u32)strtoul(value, nullptr, 10);
+        else if (strcmp(key, "--out") == 0)
+            out_path = value;
+        else
+            fprintf(stderr, "unknown argument %s\n", key);
+    }
+
+    bench.m_arena.init(context_t::system_alloc(), 64 * 1024 * 1024);
+
+    if (strcmp(format, "all") == 0 || strcmp(format, "ascii") == 0)
+        run_format(bench, nply::FORMAT_ASCII);
+    if (strcmp(format, "all") == 0 || strcmp(format, "ble") == 0)
+        run_format(bench, nply::FORMAT_BLE);
+    if (strcmp(format, "all") == 0 || strcmp(format, "bbe") == 0)
+        run_format(bench, nply::FORMAT_BBE);
+
+    FILE* out = out_path != nullptr ? fopen(out_path, "w") : stdout;
+    if (out != nullptr)
+    {
+        write_json(bench, out);
+        if (out != stdout)
+            fclose(out);
+    }
+
+    bench.m_arena.exit();
+    cbase::exit();
+    return bench.m_result_count > 0 ? 0 : 1;
+}
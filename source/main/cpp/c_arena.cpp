@@ -0,0 +1,278 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_arena.h"
+
+namespace ncore
+{
+    namespace nply
+    {
+        struct arena_t::chunk_t
+        {
+            chunk_t* m_next;
+            u64      m_size; // size of the data that follows the chunk header
+            u64      m_used;
+            u64      m_pad;
+        };
+
+        static inline u8* chunk_data(arena_t::chunk_t* chunk) { return (u8*)(chunk + 1); }
+
+        static inline u8* align_ptr(u8* ptr, u32 alignment) { return (u8*)(((uint_t)ptr + (alignment - 1)) & ~(uint_t)(alignment - 1)); }
+
+        arena_t::arena_t()
+            : m_backing(nullptr)
+            , m_chunk_size(0)
+            , m_first(nullptr)
+            , m_current(nullptr)
+        {
+        }
+
+        void arena_t::init(alloc_t* backing, u64 chunk_size)
+        {
+            m_backing    = backing;
+            m_chunk_size = chunk_size;
+            m_first      = nullptr;
+            m_current    = nullptr;
+        }
+
+        void arena_t::exit()
+        {
+            chunk_t* chunk = m_first;
+            while (chunk != nullptr)
+            {
+                chunk_t* next = chunk->m_next;
+                m_backing->deallocate(chunk);
+                chunk = next;
+            }
+            m_first   = nullptr;
+            m_current = nullptr;
+        }
+
+        arena_t::chunk_t* arena_t::new_chunk(u64 size)
+        {
+            // The backing allocator takes a 32-bit size
+            u64 const total = sizeof(chunk_t) + size;
+            if (total > 0xFFFFFFFF)
+                return nullptr;
+            chunk_t* chunk = (chunk_t*)m_backing->allocate((u32)total, 16);
+            if (chunk == nullptr)
+                return nullptr;
+            chunk->m_next = nullptr;
+            chunk->m_size = size;
+            chunk->m_used = 0;
+            return chunk;
+        }
+
+        void* arena_t::v_alloc(u64 size, u32 alignment)
+        {
+            ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+            u64 const needed = size + alignment;
+
+            if (m_current == nullptr)
+            {
+                m_first = new_chunk(needed > m_chunk_size ? needed : m_chunk_size);
+                if (m_first == nullptr)
+                    return nullptr;
+                m_current = m_first;
+            }
+
+            while (true)
+            {
+                u8* const data = chunk_data(m_current);
+                u8* const ptr  = align_ptr(data + m_current->m_used, alignment);
+                if ((u64)(ptr - data) + size <= m_current->m_size)
+                {
+                    m_current->m_used = (u64)(ptr - data) + size;
+                    return ptr;
+                }
+
+                // Continue with the next (free) chunk or insert a new one
+                chunk_t* next = m_current->m_next;
+                if (next == nullptr || next->m_size < needed)
+                {
+                    chunk_t* chunk = new_chunk(needed > m_chunk_size ? needed : m_chunk_size);
+                    if (chunk == nullptr)
+                        return nullptr;
+                    chunk->m_next       = next;
+                    m_current->m_next   = chunk;
+                    next                = chunk;
+                }
+                m_current         = next;
+                m_current->m_used = 0;
+            }
+        }
+
+        void arena_t::reset()
+        {
+            m_current = m_first;
+            if (m_current != nullptr)
+                m_current->m_used = 0;
+        }
+
+        arena_t::marker_t arena_t::mark() const
+        {
+            marker_t marker;
+            marker.m_chunk = m_current;
+            marker.m_used  = m_current != nullptr ? m_current->m_used : 0;
+            return marker;
+        }
+
+        void arena_t::rewind(marker_t const& marker)
+        {
+            if (marker.m_chunk == nullptr)
+            {
+                reset();
+                return;
+            }
+            m_current         = marker.m_chunk;
+            m_current->m_used = marker.m_used;
+        }
+
+        void arena_t::trim()
+        {
+            if (m_current == nullptr)
+                return;
+            chunk_t* chunk = m_current->m_next;
+            while (chunk != nullptr)
+            {
+                chunk_t* next = chunk->m_next;
+                m_backing->deallocate(chunk);
+                chunk = next;
+            }
+            m_current->m_next = nullptr;
+        }
+
+        u64 arena_t::get_used() const
+        {
+            u64      used  = 0;
+            chunk_t* chunk = m_first;
+            while (chunk != nullptr)
+            {
+                used += chunk->m_used;
+                if (chunk == m_current)
+                    break;
+                chunk = chunk->m_next;
+            }
+            return used;
+        }
+
+        u64 arena_t::get_reserved() const
+        {
+            u64      reserved = 0;
+            chunk_t* chunk    = m_first;
+            while (chunk != nullptr)
+            {
+                reserved += sizeof(chunk_t) + chunk->m_size;
+                chunk = chunk->m_next;
+            }
+            return reserved;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // pool_t
+        // ----------------------------------------------------------------------------------------
+
+        pool_t::pool_t()
+            : m_allocator(nullptr)
+            , m_item_size(0)
+            , m_item_alignment(16)
+            , m_items_per_block(0)
+            , m_count(0)
+            , m_free_list(nullptr)
+            , m_block_cursor(nullptr)
+            , m_block_end(nullptr)
+        {
+        }
+
+        void pool_t::init(allocator_t* allocator, u32 item_size, u32 item_alignment, u32 items_per_block)
+        {
+            ASSERT(item_alignment > 0 && (item_alignment & (item_alignment - 1)) == 0);
+            if (item_size < sizeof(void*))
+                item_size = sizeof(void*);
+            m_allocator       = allocator;
+            m_item_size       = (item_size + (item_alignment - 1)) & ~(item_alignment - 1);
+            m_item_alignment  = item_alignment;
+            m_items_per_block = items_per_block > 0 ? items_per_block : 1;
+            reset();
+        }
+
+        void pool_t::reset()
+        {
+            m_count        = 0;
+            m_free_list    = nullptr;
+            m_block_cursor = nullptr;
+            m_block_end    = nullptr;
+        }
+
+        void* pool_t::v_alloc(u64 size, u32 alignment)
+        {
+            ASSERT(size <= m_item_size && alignment <= m_item_alignment);
+            void* ptr = nullptr;
+            if (m_free_list != nullptr)
+            {
+                ptr         = m_free_list;
+                m_free_list = *(void**)m_free_list;
+            }
+            else
+            {
+                if (m_block_cursor == m_block_end)
+                {
+                    u64 const block_size = (u64)m_item_size * m_items_per_block;
+                    m_block_cursor       = (u8*)m_allocator->alloc(block_size, m_item_alignment);
+                    if (m_block_cursor == nullptr)
+                        return nullptr;
+                    m_block_end = m_block_cursor + block_size;
+                }
+                ptr = m_block_cursor;
+                m_block_cursor += m_item_size;
+            }
+            m_count++;
+            return ptr;
+        }
+
+        void pool_t::v_dealloc(void* ptr)
+        {
+            if (ptr == nullptr)
+                return;
+            *(void**)ptr = m_free_list;
+            m_free_list  = ptr;
+            m_count--;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // scratch_t
+        // ----------------------------------------------------------------------------------------
+
+        scratch_t::scratch_t()
+            : m_count(0)
+        {
+        }
+
+        void scratch_t::init(alloc_t* backing, s32 count, u64 chunk_size)
+        {
+            m_count = count < 1 ? 1 : (count > MAX_ARENAS ? (s32)MAX_ARENAS : count);
+            for (s32 i = 0; i < m_count; ++i)
+                m_arenas[i].init(backing, chunk_size);
+        }
+
+        void scratch_t::exit()
+        {
+            for (s32 i = 0; i < m_count; ++i)
+                m_arenas[i].exit();
+            m_count = 0;
+        }
+
+        arena_t* scratch_t::get(s32 index)
+        {
+            ASSERT(index >= 0 && index < m_count);
+            return &m_arenas[index];
+        }
+
+        void scratch_t::reset()
+        {
+            for (s32 i = 0; i < m_count; ++i)
+                m_arenas[i].reset();
+        }
+
+    } // namespace nply
+} // namespace ncore
@@ -0,0 +1,543 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_batch.h"
+
+namespace ncore
+{
+    namespace nbatch
+    {
+        const u64 c_window_size = 1024 * 1024; // read-ahead of the binary readers
+
+        // A file is decoded as one job, or as parts of its vertices plus one job for the rest (the faces)
+        enum ejob
+        {
+            JOB_WHOLE = 0,
+            JOB_VERTICES,
+            JOB_REST,
+        };
+
+        struct job_t
+        {
+            u64 m_file;
+            u64 m_first; // JOB_VERTICES, the records to decode
+            u64 m_count;
+            s32 m_kind;
+        };
+
+        struct file_t
+        {
+            const char*       m_path;
+            nply::info_t      m_info;
+            bool              m_probed;
+            u64               m_size;
+            u64               m_vertex_count;
+            u64               m_face_count;
+            u64               m_vertex_offset; // of the vertex records in the file, split files only
+            u64               m_vertex_stride;
+            u64               m_parts; // 0 = decoded as a whole
+            u64               m_memory;
+            nply::vertex_t*   m_vertices;
+            nply::triangle_t* m_triangles;
+            u64 volatile      m_pending; // jobs still running
+            u64 volatile      m_failed;
+            nply::error_t     m_error;
+        };
+
+        // Each task has a share of the jobs, kept apart to avoid false sharing
+        struct slot_t
+        {
+            u64 volatile m_next;
+            u64          m_end;
+            u8           m_pad[48];
+        };
+
+        static inline s32 str_compare(const char* a, const char* b)
+        {
+            while (*a != 0 && *a == *b)
+            {
+                a++;
+                b++;
+            }
+            return (s32)(u8)*a - (s32)(u8)*b;
+        }
+
+        // Reads binary data of a file in windows, skipping over data does not read it
+        class source_reader_t : public nply::reader_t
+        {
+        public:
+            source_reader_t(source_t* source, const char* path, u64 offset, u64 end, nply::arena_t* arena)
+                : m_source(source)
+                , m_path(path)
+                , m_offset(offset)
+                , m_end(end)
+                , m_arena(arena)
+                , m_window((u8*)arena->alloc(c_window_size))
+                , m_capacity(c_window_size)
+                , m_begin(0)
+                , m_used(0)
+            {
+            }
+
+            virtual bool read_line(const char*& str, const char*& end) { return false; }
+
+            virtual bool read_data(u64 size, const u8*& begin, const u8*& end)
+            {
+                if (m_used - m_begin < size && !fill(size))
+                    return false;
+                begin = m_window + m_begin;
+                end   = begin + size;
+                m_begin += size;
+                return true;
+            }
+
+            virtual bool skip_data(u64 size)
+            {
+                u64 const buffered = m_used - m_begin;
+                if (size <= buffered)
+                {
+                    m_begin += size;
+                    return true;
+                }
+                size -= buffered;
+                m_begin = m_used = 0;
+                if (size > m_end - m_offset)
+                    return false;
+                m_offset += size;
+                return true;
+            }
+
+            // Make 'size' bytes available at m_begin
+            bool fill(u64 size)
+            {
+                u64 const buffered = m_used - m_begin;
+                if (size > m_capacity)
+                {
+                    u8* window = (u8*)m_arena->alloc(size);
+                    if (window == nullptr)
+                        return false;
+                    for (u64 i = 0; i < buffered; ++i)
+                        window[i] = m_window[m_begin + i];
+                    m_window   = window;
+                    m_capacity = size;
+                }
+                else
+                {
+                    for (u64 i = 0; i < buffered; ++i)
+                        m_window[i] = m_window[m_begin + i];
+                }
+                m_begin = 0;
+                m_used  = buffered;
+
+                u64 n = m_capacity - m_used;
+                if (n > m_end - m_offset)
+                    n = m_end - m_offset;
+                u64 const read = n > 0 ? m_source->read_at(m_path, m_offset, m_window + m_used, n) : 0;
+                m_offset += read;
+                m_used += read;
+                return m_used >= size;
+            }
+
+            source_t*      m_source;
+            const char*    m_path;
+            u64            m_offset; // of the end of the window in the file
+            u64            m_end;
+            nply::arena_t* m_arena;
+            u8*            m_window;
+            u64            m_capacity;
+            u64            m_begin;
+            u64            m_used;
+        };
+
+        // The fixed record size of an element, 0 when it has lists
+        static u64 get_stride(nply::info_t const& info, s32 element)
+        {
+            u64 stride = 0;
+            for (s32 p = 0; p < nply::get_num_properties(info, element); ++p)
+            {
+                nply::etype const type = nply::get_property_type(info, element, p);
+                if (nply::type_is_list(type))
+                    return 0;
+                stride += nply::type_sizeof(type);
+            }
+            return stride;
+        }
+
+        static s32 find_element(nply::info_t const& info, const char* name)
+        {
+            for (s32 e = 0; e < nply::get_num_elements(info); ++e)
+            {
+                if (str_compare(nply::get_element_name(info, e), name) == 0)
+                    return e;
+            }
+            return -1;
+        }
+
+        // Decide how to decode a file and how much memory that takes
+        static void plan(file_t& file, config_t const& config)
+        {
+            nply::info_t const& info   = file.m_info;
+            s32 const           vertex = find_element(info, "vertex");
+            s32 const           face   = find_element(info, "face");
+            file.m_vertex_count        = vertex >= 0 ? nply::get_element_items(info, vertex) : 0;
+            file.m_face_count          = face >= 0 ? nply::get_element_items(info, face) : 0;
+            file.m_parts               = 0;
+            file.m_vertex_stride       = vertex >= 0 ? get_stride(info, vertex) : 0;
+
+            // the vertices can be split when their offset in the file is known
+            if (nply::get_format(info) != nply::FORMAT_ASCII && file.m_vertex_stride > 0)
+            {
+                u64  offset = nply::get_body_offset(info);
+                bool known  = true;
+                for (s32 e = 0; e < vertex && known; ++e)
+                {
+                    u64 const stride = get_stride(info, e);
+                    known            = stride > 0 || nply::get_num_properties(info, e) == 0;
+                    offset += stride * nply::get_element_items(info, e);
+                }
+                u64 const bytes = file.m_vertex_count * file.m_vertex_stride;
+                if (known && bytes > config.m_split_size)
+                {
+                    file.m_vertex_offset = offset;
+                    file.m_parts         = (bytes + config.m_split_size - 1) / config.m_split_size;
+                }
+            }
+
+            file.m_memory = file.m_vertex_count * sizeof(nply::vertex_t) + file.m_face_count * sizeof(nply::triangle_t);
+            if (file.m_parts == 0)
+                file.m_memory += file.m_size;
+        }
+
+        static const char* s_xyz[3] = {"x", "y", "z"};
+
+        // A ply_t for one job, the header is read again from the file
+        static nply::ply_t* open(source_t* source, file_t const& file, nply::arena_t* arena, u32 validate, nply::error_t& error)
+        {
+            u64 const body   = nply::get_body_offset(file.m_info);
+            u8*       header = (u8*)arena->alloc(body);
+            if (header == nullptr || source->read_at(file.m_path, 0, header, body) != body)
+                return nullptr;
+            nply::ply_t* ply = nply::create(arena);
+            if (ply == nullptr)
+            {
+                error.m_kind = nply::ERROR_MEMORY;
+                return nullptr;
+            }
+            nply::memory_reader_t reader(header, body);
+            if (!nply::read_header(ply, &reader))
+            {
+                error = nply::get_error(ply);
+                return nullptr;
+            }
+            for (s32 e = 0; e < nply::get_num_elements(file.m_info); ++e)
+            {
+                const char* name  = nply::get_element_name(file.m_info, e);
+                s32         index = nply::INDEX_NONE;
+                if (str_compare(name, "vertex") == 0)
+                    index = nply::INDEX_VERTEX;
+                else if (str_compare(name, "face") == 0)
+                    index = nply::INDEX_FACE;
+                nply::set_element_index(ply, name, index);
+            }
+            if (file.m_vertex_count > 0 && !nply::select_properties(ply, "vertex", s_xyz, 3))
+            {
+                error.m_kind = nply::ERROR_HEADER; // no x, y and z
+                return nullptr;
+            }
+            nply::set_validation(ply, validate);
+            return ply;
+        }
+
+        class load_task_t : public nparallel::task_t
+        {
+        public:
+            source_t*        m_source;
+            nply::scratch_t* m_scratch;
+            callback_t*      m_callback;
+            u32              m_validate;
+            file_t*          m_files;
+            job_t*           m_jobs;
+            slot_t*          m_slots;
+            s32              m_workers;
+            u64 volatile     m_loaded;
+
+            // From the own share first, then from the others
+            bool take(s32 worker, u64& job)
+            {
+                for (s32 k = 0; k < m_workers; ++k)
+                {
+                    slot_t& slot = m_slots[(worker + k) % m_workers];
+                    if (slot.m_next >= slot.m_end)
+                        continue;
+                    job = nparallel::atomic_add(&slot.m_next, 1);
+                    if (job < slot.m_end)
+                        return true;
+                }
+                return false;
+            }
+
+            bool run_whole(file_t& file, nply::arena_t* arena, nply::error_t& error)
+            {
+                u8* data = (u8*)arena->alloc(file.m_size);
+                if (data == nullptr || m_source->read_at(file.m_path, 0, data, file.m_size) != file.m_size)
+                    return false;
+                nply::ply_t* ply = open(m_source, file, arena, m_validate, error);
+                if (ply == nullptr)
+                    return false;
+                nply::memory_reader_t reader(data, file.m_size);
+                reader.m_cursor += nply::get_body_offset(file.m_info);
+                nply::vertices_handler_t  vertices(file.m_vertices, file.m_vertex_count);
+                nply::triangles_handler_t triangles(file.m_triangles, file.m_face_count);
+                if (nply::read_data(ply, &reader, &vertices, &triangles))
+                    return true;
+                error = nply::get_error(ply);
+                return false;
+            }
+
+            bool run_vertices(file_t& file, job_t const& job, nply::arena_t* arena, nply::error_t& error)
+            {
+                nply::ply_t* ply = open(m_source, file, arena, m_validate, error);
+                if (ply == nullptr)
+                    return false;
+                u64 const                begin = file.m_vertex_offset + job.m_first * file.m_vertex_stride;
+                source_reader_t          reader(m_source, file.m_path, begin, begin + job.m_count * file.m_vertex_stride, arena);
+                nply::vertices_handler_t vertices(file.m_vertices + job.m_first, job.m_count);
+                if (nply::read_records(ply, "vertex", job.m_first, job.m_count, &reader, &vertices))
+                    return true;
+                error = nply::get_error(ply);
+                return false;
+            }
+
+            bool run_rest(file_t& file, nply::arena_t* arena, nply::error_t& error)
+            {
+                nply::ply_t* ply = open(m_source, file, arena, m_validate, error);
+                if (ply == nullptr)
+                    return false;
+                nply::set_element_index(ply, "vertex", nply::INDEX_NONE); // decoded by the other jobs
+                source_reader_t           reader(m_source, file.m_path, nply::get_body_offset(file.m_info), file.m_size, arena);
+                nply::triangles_handler_t triangles(file.m_triangles, file.m_face_count);
+                if (nply::read_data(ply, &reader, &triangles, nullptr))
+                    return true;
+                error = nply::get_error(ply);
+                return false;
+            }
+
+            void finish(file_t& file, u64 index)
+            {
+                result_t result;
+                result.m_index          = index;
+                result.m_path           = file.m_path;
+                result.m_ok             = file.m_failed == 0;
+                result.m_error          = file.m_error;
+                result.m_vertices       = file.m_vertices;
+                result.m_vertex_count   = file.m_vertex_count;
+                result.m_triangles      = file.m_triangles;
+                result.m_triangle_count = file.m_face_count;
+                if (result.m_ok)
+                    nparallel::atomic_add(&m_loaded, 1);
+                m_callback->loaded(result);
+            }
+
+            virtual void execute(s32 index)
+            {
+                nply::arena_t* arena = m_scratch->get(index);
+                u64            j;
+                while (take(index, j))
+                {
+                    job_t const&                  job    = m_jobs[j];
+                    file_t&                       file   = m_files[job.m_file];
+                    nply::arena_t::marker_t const marker = arena->mark();
+                    nply::error_t                 error;
+                    error.m_kind    = nply::ERROR_TRUNCATED; // the file could not be read
+                    error.m_element = -1;
+                    error.m_record  = 0;
+                    error.m_offset  = 0;
+
+                    bool ok;
+                    if (job.m_kind == JOB_WHOLE)
+                        ok = run_whole(file, arena, error);
+                    else if (job.m_kind == JOB_VERTICES)
+                        ok = run_vertices(file, job, arena, error);
+                    else
+                        ok = run_rest(file, arena, error);
+                    arena->rewind(marker);
+
+                    if (!ok && nparallel::atomic_add(&file.m_failed, 1) == 0)
+                        file.m_error = error;
+                    if (nparallel::atomic_add(&file.m_pending, (u64)-1) == 1)
+                        finish(file, job.m_file);
+                }
+            }
+        };
+
+        static void not_loaded(callback_t* callback, file_t const& file, u64 index, nply::eerror kind)
+        {
+            result_t result;
+            result.m_index           = index;
+            result.m_path            = file.m_path;
+            result.m_ok              = false;
+            result.m_error.m_kind    = kind;
+            result.m_error.m_element = -1;
+            result.m_error.m_record  = 0;
+            result.m_error.m_offset  = 0;
+            result.m_vertices        = nullptr;
+            result.m_vertex_count    = 0;
+            result.m_triangles       = nullptr;
+            result.m_triangle_count  = 0;
+            callback->loaded(result);
+        }
+
+        u64 load(nply::arena_t* arena, nparallel::scheduler_t* scheduler, nply::scratch_t* scratch, source_t* source, const char** paths, u64 path_count, config_t const& config, callback_t* callback)
+        {
+            scheduler = nparallel::get_scheduler(scheduler);
+            if (path_count == 0 || scratch->get_count() < 2)
+                return 0;
+
+            // Probe all headers, the catalog is only needed until the files have their info
+            nply::arena_t::marker_t const start = arena->mark();
+            ncatalog::catalog_t           catalog;
+            file_t*                       files = (file_t*)arena->alloc(sizeof(file_t) * path_count);
+            if (files == nullptr || !ncatalog::build(arena, scheduler, scratch, source, paths, path_count, nullptr, catalog))
+            {
+                arena->rewind(start);
+                return 0;
+            }
+            for (u64 i = 0; i < path_count; ++i)
+            {
+                file_t& file  = files[i];
+                file.m_path   = paths[i];
+                s64 const c   = ncatalog::find(catalog, paths[i]);
+                file.m_probed = c >= 0 && ncatalog::get_info(catalog, (u64)c, file.m_info);
+                file.m_size   = file.m_probed ? source->size(paths[i]) : 0;
+                if (file.m_probed)
+                    plan(file, config);
+            }
+
+            s32 workers = scheduler->concurrency();
+            if (workers > scratch->get_count())
+                workers = scratch->get_count();
+            if (workers < 1)
+                workers = 1;
+
+            // the read buffers of the tasks are always in flight
+            u64 const buffers = (u64)workers * (config.m_split_size + c_window_size);
+            u64 const budget  = config.m_memory_budget > buffers ? config.m_memory_budget - buffers : 0;
+
+            nply::arena_t::marker_t const wave   = arena->mark();
+            u64                           loaded = 0;
+            u64                           next   = 0;
+            while (next < path_count)
+            {
+                arena->rewind(wave);
+
+                // Admit files while they fit, at least one
+                u64 first  = next;
+                u64 memory = 0;
+                u64 jobs   = 0;
+                for (; next < path_count; ++next)
+                {
+                    file_t& file = files[next];
+                    if (!file.m_probed || file.m_size == 0)
+                        continue;
+                    if (memory > 0 && memory + file.m_memory > budget)
+                        break;
+                    memory += file.m_memory;
+                    jobs += file.m_parts + 1;
+                }
+
+                job_t*  job_array = (job_t*)arena->alloc(sizeof(job_t) * (jobs + 1));
+                slot_t* slots     = (slot_t*)arena->alloc(sizeof(slot_t) * workers, 64);
+                if (job_array == nullptr || slots == nullptr)
+                {
+                    // Nothing of this wave can be scheduled, the next wave starts from a rewound arena
+                    for (u64 i = first; i < next; ++i)
+                    {
+                        file_t const& file = files[i];
+                        if (!file.m_probed || file.m_size == 0)
+                            not_loaded(callback, file, i, file.m_probed ? nply::ERROR_TRUNCATED : nply::ERROR_NOT_PLY);
+                        else
+                            not_loaded(callback, file, i, nply::ERROR_MEMORY);
+                    }
+                    continue;
+                }
+                u64 count = 0;
+                for (u64 i = first; i < next; ++i)
+                {
+                    file_t& file = files[i];
+                    if (!file.m_probed || file.m_size == 0)
+                    {
+                        not_loaded(callback, file, i, file.m_probed ? nply::ERROR_TRUNCATED : nply::ERROR_NOT_PLY);
+                        continue;
+                    }
+                    file.m_vertices  = (nply::vertex_t*)arena->alloc(sizeof(nply::vertex_t) * (file.m_vertex_count + 1));
+                    file.m_triangles = (nply::triangle_t*)arena->alloc(sizeof(nply::triangle_t) * (file.m_face_count + 1));
+                    file.m_failed    = 0;
+                    file.m_error.m_kind    = nply::ERROR_NONE;
+                    file.m_error.m_element = -1;
+                    file.m_error.m_record  = 0;
+                    file.m_error.m_offset  = 0;
+                    if (file.m_vertices == nullptr || file.m_triangles == nullptr)
+                    {
+                        not_loaded(callback, file, i, nply::ERROR_MEMORY);
+                        continue;
+                    }
+                    if (file.m_parts == 0)
+                    {
+                        job_t& job = job_array[count++];
+                        job.m_file = i;
+                        job.m_kind = JOB_WHOLE;
+                    }
+                    else
+                    {
+                        for (u64 p = 0; p < file.m_parts; ++p)
+                        {
+                            u64 begin, end;
+                            nparallel::get_range(file.m_vertex_count, (s32)file.m_parts, (s32)p, begin, end);
+                            job_t& job  = job_array[count++];
+                            job.m_file  = i;
+                            job.m_kind  = JOB_VERTICES;
+                            job.m_first = begin;
+                            job.m_count = end - begin;
+                        }
+                        if (file.m_face_count > 0)
+                        {
+                            job_t& job = job_array[count++];
+                            job.m_file = i;
+                            job.m_kind = JOB_REST;
+                        }
+                    }
+                    file.m_pending = file.m_parts == 0 ? 1 : file.m_parts + (file.m_face_count > 0 ? 1 : 0);
+                }
+                if (count == 0)
+                    continue;
+
+                s32 const tasks = (u64)workers < count ? workers : (s32)count;
+                for (s32 w = 0; w < tasks; ++w)
+                {
+                    u64 begin, end;
+                    nparallel::get_range(count, tasks, w, begin, end);
+                    slots[w].m_next = begin;
+                    slots[w].m_end  = end;
+                }
+
+                load_task_t task;
+                task.m_source   = source;
+                task.m_scratch  = scratch;
+                task.m_callback = callback;
+                task.m_validate = config.m_validate;
+                task.m_files    = files;
+                task.m_jobs     = job_array;
+                task.m_slots    = slots;
+                task.m_workers  = tasks;
+                task.m_loaded   = 0;
+                scheduler->run(&task, tasks);
+                loaded += task.m_loaded;
+            }
+
+            for (s32 w = 0; w < workers; ++w)
+                scratch->get(w)->reset();
+            arena->rewind(start);
+            return loaded;
+        }
+
+    } // namespace nbatch
+} // namespace ncore
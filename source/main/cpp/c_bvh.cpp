@@ -0,0 +1,946 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_bvh.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#    include <emmintrin.h>
+#    define BVH_USE_SSE
+#endif
+
+namespace ncore
+{
+    namespace nbvh
+    {
+        // 4-wide node, the bounds of the 4 children are stored as SoA.
+        // A child slot is either:
+        //   - an internal node : m_count == 0, m_child = node index
+        //   - a leaf           : m_count  > 0, m_child = index of the first triangle
+        //   - empty            : m_count == 0, m_child = 0 and inverted bounds (the root is never a child)
+        struct node4_t
+        {
+            f32 m_min_x[4];
+            f32 m_min_y[4];
+            f32 m_min_z[4];
+            f32 m_max_x[4];
+            f32 m_max_y[4];
+            f32 m_max_z[4];
+            u32 m_child[4];
+            u32 m_count[4];
+        };
+
+        // Triangle in leaf order, pre-computed for ray intersection
+        struct tri_t
+        {
+            f32 m_v0[3];
+            f32 m_e1[3];
+            f32 m_e2[3];
+            u32 m_index;
+        };
+
+        struct bvh_t
+        {
+            n3d::box_t m_bounds;
+            node4_t*   m_nodes;
+            u32        m_node_count;
+            tri_t*     m_tris;
+            u32        m_tri_count;
+        };
+
+        // ----------------------------------------------------------------------------------------
+        // Build
+        // ----------------------------------------------------------------------------------------
+
+        // Binary node, a subtree over triangles [begin, end) rooted at node N occupies the
+        // nodes [N, N + 2 * (end - begin) - 1), this allows subtrees to be built in parallel
+        // without any synchronization.
+        struct bnode_t
+        {
+            n3d::box_t m_box;
+            u32        m_first;
+            u32        m_count; // > 0 means leaf
+            u32        m_left;
+            u32        m_right;
+        };
+
+        struct subtree_t
+        {
+            u32 m_node;
+            u32 m_begin;
+            u32 m_end;
+            u32 m_depth;
+        };
+
+        // Nodes deeper than this become leaves whatever their size, which bounds the recursion of the
+        // build and the traversal stacks of the queries (see c_stack_size)
+        const u32 c_max_depth = 64;
+
+        struct builder_t
+        {
+            config_t        m_config;
+            n3d::box_t*     m_tri_boxes;
+            nply::vertex_t* m_centroids;
+            u32*            m_indices;
+            bnode_t*        m_nodes;
+            u32             m_defer_threshold; // subtrees with less triangles are deferred to the scheduler
+            subtree_t*      m_deferred;
+            u32             m_deferred_count;
+            u32             m_deferred_max;
+        };
+
+        static inline f32 get_axis(nply::vertex_t const& v, s32 axis) { return (&v.x)[axis]; }
+
+        // Clamped, a NaN or Inf centroid must not be converted to an integer as is
+        static inline u32 get_bin(f32 position, u32 bin_count)
+        {
+            if (!(position > 0.0f))
+                return 0;
+            return position < (f32)(bin_count - 1) ? (u32)position : bin_count - 1;
+        }
+
+        static void make_leaf(builder_t& b, u32 node, u32 begin, u32 end)
+        {
+            bnode_t& n = b.m_nodes[node];
+            n.m_first  = begin;
+            n.m_count  = end - begin;
+            n.m_left   = 0;
+            n.m_right  = 0;
+        }
+
+        // Binned SAH split, returns the index of the first triangle of the right child
+        static u32 split(builder_t& b, u32 begin, u32 end, n3d::box_t const& centroid_box)
+        {
+            u32 const bin_count = b.m_config.m_bin_count < 2 ? 2 : (b.m_config.m_bin_count > 32 ? 32 : b.m_config.m_bin_count);
+
+            f32 best_cost  = n3d::c_f32_max;
+            s32 best_axis  = -1;
+            u32 best_split = 0;
+            f32 best_scale = 0.0f;
+
+            for (s32 axis = 0; axis < 3; ++axis)
+            {
+                f32 const extent = centroid_box.m_max[axis] - centroid_box.m_min[axis];
+                if (extent <= 0.0f)
+                    continue;
+
+                n3d::box_t bin_boxes[32];
+                u32        bin_counts[32];
+                for (u32 i = 0; i < bin_count; ++i)
+                {
+                    n3d::box_empty(bin_boxes[i]);
+                    bin_counts[i] = 0;
+                }
+
+                f32 const scale = ((f32)bin_count * 0.9999f) / extent;
+                for (u32 i = begin; i < end; ++i)
+                {
+                    u32 const t   = b.m_indices[i];
+                    u32 const bin = get_bin((get_axis(b.m_centroids[t], axis) - centroid_box.m_min[axis]) * scale, bin_count);
+                    n3d::box_extend(bin_boxes[bin], b.m_tri_boxes[t]);
+                    bin_counts[bin]++;
+                }
+
+                // Sweep from the right to get the cost of the right side of every split
+                f32        right_cost[32];
+                n3d::box_t box;
+                n3d::box_empty(box);
+                u32 count = 0;
+                for (u32 i = bin_count - 1; i > 0; --i)
+                {
+                    n3d::box_extend(box, bin_boxes[i]);
+                    count += bin_counts[i];
+                    right_cost[i - 1] = n3d::box_area(box) * (f32)count;
+                }
+
+                n3d::box_empty(box);
+                count = 0;
+                for (u32 i = 0; i < (bin_count - 1); ++i)
+                {
+                    n3d::box_extend(box, bin_boxes[i]);
+                    count += bin_counts[i];
+                    f32 const cost = n3d::box_area(box) * (f32)count + right_cost[i];
+                    if (cost < best_cost)
+                    {
+                        best_cost  = cost;
+                        best_axis  = axis;
+                        best_split = i;
+                        best_scale = scale;
+                    }
+                }
+            }
+
+            u32 mid = begin;
+            if (best_axis >= 0)
+            {
+                u32 i = begin;
+                u32 j = end;
+                while (i < j)
+                {
+                    u32 const t   = b.m_indices[i];
+                    u32 const bin = get_bin((get_axis(b.m_centroids[t], best_axis) - centroid_box.m_min[best_axis]) * best_scale, bin_count);
+                    if (bin <= best_split)
+                    {
+                        i++;
+                    }
+                    else
+                    {
+                        --j;
+                        b.m_indices[i] = b.m_indices[j];
+                        b.m_indices[j] = t;
+                    }
+                }
+                mid = i;
+            }
+
+            // All centroids are at the same position, split in the middle
+            if (mid == begin || mid == end)
+                mid = begin + (end - begin) / 2;
+            return mid;
+        }
+
+        static void build_node(builder_t& b, u32 node, u32 begin, u32 end, u32 depth, bool defer)
+        {
+            if (defer && (end - begin) <= b.m_defer_threshold && b.m_deferred_count < b.m_deferred_max)
+            {
+                subtree_t& s = b.m_deferred[b.m_deferred_count++];
+                s.m_node     = node;
+                s.m_begin    = begin;
+                s.m_end      = end;
+                s.m_depth    = depth;
+                return;
+            }
+
+            bnode_t&   n = b.m_nodes[node];
+            n3d::box_t centroid_box;
+            n3d::box_empty(n.m_box);
+            n3d::box_empty(centroid_box);
+            for (u32 i = begin; i < end; ++i)
+            {
+                u32 const t = b.m_indices[i];
+                n3d::box_extend(n.m_box, b.m_tri_boxes[t]);
+                n3d::box_extend(centroid_box, b.m_centroids[t]);
+            }
+
+            if ((end - begin) <= b.m_config.m_max_leaf_size || depth >= c_max_depth)
+            {
+                make_leaf(b, node, begin, end);
+                return;
+            }
+
+            u32 const mid = split(b, begin, end, centroid_box);
+            n.m_first     = begin;
+            n.m_count     = 0;
+            n.m_left      = node + 1;
+            n.m_right     = node + 2 * (mid - begin);
+            build_node(b, n.m_left, begin, mid, depth + 1, defer);
+            build_node(b, n.m_right, mid, end, depth + 1, defer);
+        }
+
+        // Deferred subtrees only write their own node range, parent boxes are fixed up afterwards
+        static void update_boxes(builder_t& b, u32 node)
+        {
+            bnode_t& n = b.m_nodes[node];
+            if (n.m_count > 0)
+                return;
+            update_boxes(b, n.m_left);
+            update_boxes(b, n.m_right);
+            n.m_box = b.m_nodes[n.m_left].m_box;
+            n3d::box_extend(n.m_box, b.m_nodes[n.m_right].m_box);
+        }
+
+        class tri_bounds_task_t : public nparallel::task_t
+        {
+        public:
+            builder_t*              m_builder;
+            nply::vertex_t const*   m_vertices;
+            u32                     m_vertex_count;
+            nply::triangle_t const* m_triangles;
+            u32                     m_triangle_count;
+            s32                     m_parts;
+
+            virtual void execute(s32 index)
+            {
+                u64 begin, end;
+                nparallel::get_range(m_triangle_count, m_parts, index, begin, end);
+                for (u64 i = begin; i < end; ++i)
+                {
+                    nply::triangle_t const& t = m_triangles[i];
+                    ASSERT(t.v1 < m_vertex_count && t.v2 < m_vertex_count && t.v3 < m_vertex_count);
+                    n3d::box_t& box = m_builder->m_tri_boxes[i];
+                    n3d::box_empty(box);
+                    n3d::box_extend(box, m_vertices[t.v1]);
+                    n3d::box_extend(box, m_vertices[t.v2]);
+                    n3d::box_extend(box, m_vertices[t.v3]);
+                    nply::vertex_t& c = m_builder->m_centroids[i];
+                    c.x               = (box.m_min[0] + box.m_max[0]) * 0.5f;
+                    c.y               = (box.m_min[1] + box.m_max[1]) * 0.5f;
+                    c.z               = (box.m_min[2] + box.m_max[2]) * 0.5f;
+                    m_builder->m_indices[i] = (u32)i;
+                }
+            }
+        };
+
+        class subtree_task_t : public nparallel::task_t
+        {
+        public:
+            builder_t* m_builder;
+
+            virtual void execute(s32 index)
+            {
+                subtree_t const& s = m_builder->m_deferred[index];
+                build_node(*m_builder, s.m_node, s.m_begin, s.m_end, s.m_depth, false);
+            }
+        };
+
+        class tri_copy_task_t : public nparallel::task_t
+        {
+        public:
+            bvh_t*                  m_bvh;
+            u32 const*              m_indices;
+            nply::vertex_t const*   m_vertices;
+            nply::triangle_t const* m_triangles;
+            s32                     m_parts;
+
+            virtual void execute(s32 index)
+            {
+                u64 begin, end;
+                nparallel::get_range(m_bvh->m_tri_count, m_parts, index, begin, end);
+                for (u64 i = begin; i < end; ++i)
+                {
+                    u32 const               ti = m_indices[i];
+                    nply::triangle_t const& t  = m_triangles[ti];
+                    nply::vertex_t const&   v1 = m_vertices[t.v1];
+                    nply::vertex_t const&   v2 = m_vertices[t.v2];
+                    nply::vertex_t const&   v3 = m_vertices[t.v3];
+                    tri_t&                  d  = m_bvh->m_tris[i];
+                    d.m_v0[0]                  = v1.x;
+                    d.m_v0[1]                  = v1.y;
+                    d.m_v0[2]                  = v1.z;
+                    d.m_e1[0]                  = v2.x - v1.x;
+                    d.m_e1[1]                  = v2.y - v1.y;
+                    d.m_e1[2]                  = v2.z - v1.z;
+                    d.m_e2[0]                  = v3.x - v1.x;
+                    d.m_e2[1]                  = v3.y - v1.y;
+                    d.m_e2[2]                  = v3.z - v1.z;
+                    d.m_index                  = ti;
+                }
+            }
+        };
+
+        static void set_empty_slot(node4_t& n, s32 slot)
+        {
+            n.m_min_x[slot] = n.m_min_y[slot] = n.m_min_z[slot] = n3d::c_f32_max;
+            n.m_max_x[slot] = n.m_max_y[slot] = n.m_max_z[slot] = -n3d::c_f32_max;
+            n.m_child[slot]                                      = 0;
+            n.m_count[slot]                                      = 0;
+        }
+
+        static void set_slot(node4_t& n, s32 slot, n3d::box_t const& box, u32 child, u32 count)
+        {
+            n.m_min_x[slot] = box.m_min[0];
+            n.m_min_y[slot] = box.m_min[1];
+            n.m_min_z[slot] = box.m_min[2];
+            n.m_max_x[slot] = box.m_max[0];
+            n.m_max_y[slot] = box.m_max[1];
+            n.m_max_z[slot] = box.m_max[2];
+            n.m_child[slot] = child;
+            n.m_count[slot] = count;
+        }
+
+        // Collapse the binary tree into 4-wide nodes by repeatedly opening the child with the
+        // largest surface area. When 'nodes' is nullptr only the number of nodes is counted.
+        static u32 collapse(bnode_t const* bnodes, u32 bnode, node4_t* nodes, u32& node_count)
+        {
+            u32 const index = node_count++;
+
+            u32 children[4];
+            s32 num_children = 2;
+            children[0]      = bnodes[bnode].m_left;
+            children[1]      = bnodes[bnode].m_right;
+            while (num_children < 4)
+            {
+                s32 best      = -1;
+                f32 best_area = -1.0f;
+                for (s32 i = 0; i < num_children; ++i)
+                {
+                    bnode_t const& c = bnodes[children[i]];
+                    if (c.m_count == 0)
+                    {
+                        f32 const area = n3d::box_area(c.m_box);
+                        if (area > best_area)
+                        {
+                            best_area = area;
+                            best      = i;
+                        }
+                    }
+                }
+                if (best < 0)
+                    break;
+                u32 const open           = children[best];
+                children[best]           = bnodes[open].m_left;
+                children[num_children++] = bnodes[open].m_right;
+            }
+
+            for (s32 i = 0; i < 4; ++i)
+            {
+                if (i >= num_children)
+                {
+                    if (nodes != nullptr)
+                        set_empty_slot(nodes[index], i);
+                    continue;
+                }
+                bnode_t const& c = bnodes[children[i]];
+                if (c.m_count > 0)
+                {
+                    if (nodes != nullptr)
+                        set_slot(nodes[index], i, c.m_box, c.m_first, c.m_count);
+                }
+                else
+                {
+                    u32 const child = collapse(bnodes, children[i], nodes, node_count);
+                    if (nodes != nullptr)
+                        set_slot(nodes[index], i, c.m_box, child, 0);
+                }
+            }
+            return index;
+        }
+
+        // The arrays of the builder are only needed during the build
+        static void release_scratch(nply::allocator_t* allocator, builder_t& b)
+        {
+            allocator->dealloc(b.m_tri_boxes);
+            allocator->dealloc(b.m_centroids);
+            allocator->dealloc(b.m_indices);
+            allocator->dealloc(b.m_nodes);
+            allocator->dealloc(b.m_deferred);
+        }
+
+        bvh_t* build(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, nply::vertex_t const* vertices, u32 vertex_count, nply::triangle_t const* triangles, u32 triangle_count, config_t const& config)
+        {
+            scheduler = nparallel::get_scheduler(scheduler);
+
+            bvh_t* bvh = (bvh_t*)allocator->alloc(sizeof(bvh_t));
+            if (bvh == nullptr)
+                return nullptr;
+            bvh->m_nodes      = nullptr;
+            bvh->m_node_count = 0;
+            bvh->m_tris       = nullptr;
+            bvh->m_tri_count  = triangle_count;
+            n3d::box_empty(bvh->m_bounds);
+            if (triangle_count == 0)
+                return bvh;
+
+            builder_t b;
+            b.m_config = config;
+            if (b.m_config.m_max_leaf_size == 0)
+                b.m_config.m_max_leaf_size = 1;
+            b.m_tri_boxes       = (n3d::box_t*)allocator->alloc(sizeof(n3d::box_t) * triangle_count);
+            b.m_centroids       = (nply::vertex_t*)allocator->alloc(sizeof(nply::vertex_t) * triangle_count);
+            b.m_indices         = (u32*)allocator->alloc(sizeof(u32) * triangle_count);
+            b.m_nodes           = (bnode_t*)allocator->alloc(sizeof(bnode_t) * 2 * triangle_count);
+            b.m_deferred_count  = 0;
+            b.m_defer_threshold = 0;
+            b.m_deferred_max    = 0;
+            b.m_deferred        = nullptr;
+
+            s32 const concurrency = scheduler->concurrency();
+            if (concurrency > 1)
+            {
+                b.m_defer_threshold = triangle_count / (u32)(concurrency * 8);
+                b.m_deferred_max    = (u32)concurrency * 64;
+                b.m_deferred        = (subtree_t*)allocator->alloc(sizeof(subtree_t) * b.m_deferred_max);
+            }
+            if (b.m_tri_boxes == nullptr || b.m_centroids == nullptr || b.m_indices == nullptr || b.m_nodes == nullptr || (b.m_deferred_max > 0 && b.m_deferred == nullptr))
+            {
+                release_scratch(allocator, b);
+                release(allocator, bvh);
+                return nullptr;
+            }
+
+            // Triangle bounds and centroids
+            {
+                tri_bounds_task_t task;
+                task.m_builder        = &b;
+                task.m_vertices       = vertices;
+                task.m_vertex_count   = vertex_count;
+                task.m_triangles      = triangles;
+                task.m_triangle_count = triangle_count;
+                task.m_parts          = nparallel::get_parts(scheduler, triangle_count, 4096);
+                scheduler->run(&task, task.m_parts);
+            }
+
+            // The top of the tree is built here, the subtrees below the threshold in parallel
+            build_node(b, 0, 0, triangle_count, 0, b.m_defer_threshold > 0);
+            if (b.m_deferred_count > 0)
+            {
+                subtree_task_t task;
+                task.m_builder = &b;
+                scheduler->run(&task, (s32)b.m_deferred_count);
+                update_boxes(b, 0);
+            }
+            bvh->m_bounds = b.m_nodes[0].m_box;
+
+            // Flatten into 4-wide nodes, a root that is a leaf is wrapped in a node with a single child
+            if (b.m_nodes[0].m_count > 0)
+            {
+                bvh->m_node_count = 1;
+                bvh->m_nodes      = (node4_t*)allocator->alloc(sizeof(node4_t));
+                if (bvh->m_nodes == nullptr)
+                {
+                    release_scratch(allocator, b);
+                    release(allocator, bvh);
+                    return nullptr;
+                }
+                set_slot(bvh->m_nodes[0], 0, b.m_nodes[0].m_box, 0, b.m_nodes[0].m_count);
+                for (s32 i = 1; i < 4; ++i)
+                    set_empty_slot(bvh->m_nodes[0], i);
+            }
+            else
+            {
+                u32 node_count = 0;
+                collapse(b.m_nodes, 0, nullptr, node_count);
+                bvh->m_nodes = (node4_t*)allocator->alloc(sizeof(node4_t) * node_count);
+                if (bvh->m_nodes == nullptr)
+                {
+                    release_scratch(allocator, b);
+                    release(allocator, bvh);
+                    return nullptr;
+                }
+                node_count = 0;
+                collapse(b.m_nodes, 0, bvh->m_nodes, node_count);
+                bvh->m_node_count = node_count;
+            }
+
+            // Triangles in leaf order
+            {
+                bvh->m_tris = (tri_t*)allocator->alloc(sizeof(tri_t) * triangle_count);
+                if (bvh->m_tris == nullptr)
+                {
+                    release_scratch(allocator, b);
+                    release(allocator, bvh);
+                    return nullptr;
+                }
+                tri_copy_task_t task;
+                task.m_bvh       = bvh;
+                task.m_indices   = b.m_indices;
+                task.m_vertices  = vertices;
+                task.m_triangles = triangles;
+                task.m_parts     = nparallel::get_parts(scheduler, triangle_count, 4096);
+                scheduler->run(&task, task.m_parts);
+            }
+
+            release_scratch(allocator, b);
+            return bvh;
+        }
+
+        void release(nply::allocator_t* allocator, bvh_t* bvh)
+        {
+            if (bvh == nullptr)
+                return;
+            allocator->dealloc(bvh->m_nodes);
+            allocator->dealloc(bvh->m_tris);
+            allocator->dealloc(bvh);
+        }
+
+        n3d::box_t get_bounds(bvh_t const* bvh) { return bvh->m_bounds; }
+        u32        get_node_count(bvh_t const* bvh) { return bvh->m_node_count; }
+
+        // ----------------------------------------------------------------------------------------
+        // Queries
+        // ----------------------------------------------------------------------------------------
+
+        // A 4-wide node is never deeper than the binary node it was collapsed from. Every level leaves
+        // at most 3 of its 4 children on the stack, so c_max_depth bounds the stack.
+        const s32 c_stack_size = 3 * c_max_depth + 1;
+
+        static inline bool is_empty_slot(node4_t const& n, s32 slot) { return n.m_count[slot] == 0 && n.m_child[slot] == 0; }
+
+        // Slab test of a ray against the 4 children, returns a bit mask of the hit children
+        static inline u32 intersect_node(node4_t const& n, f32 const org[3], f32 const inv[3], f32 tmin, f32 tmax, f32 tnear[4])
+        {
+#ifdef BVH_USE_SSE
+            __m128 const ox  = _mm_set1_ps(org[0]);
+            __m128 const oy  = _mm_set1_ps(org[1]);
+            __m128 const oz  = _mm_set1_ps(org[2]);
+            __m128 const ix  = _mm_set1_ps(inv[0]);
+            __m128 const iy  = _mm_set1_ps(inv[1]);
+            __m128 const iz  = _mm_set1_ps(inv[2]);
+            __m128 const t0x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.m_min_x), ox), ix);
+            __m128 const t1x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.m_max_x), ox), ix);
+            __m128 const t0y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.m_min_y), oy), iy);
+            __m128 const t1y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.m_max_y), oy), iy);
+            __m128 const t0z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.m_min_z), oz), iz);
+            __m128 const t1z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.m_max_z), oz), iz);
+            __m128 const tn  = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_set1_ps(tmin)));
+            __m128 const tf  = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_set1_ps(tmax)));
+            _mm_storeu_ps(tnear, tn);
+            return (u32)_mm_movemask_ps(_mm_cmple_ps(tn, tf));
+#else
+            u32 mask = 0;
+            for (s32 i = 0; i < 4; ++i)
+            {
+                f32 const t0x = (n.m_min_x[i] - org[0]) * inv[0];
+                f32 const t1x = (n.m_max_x[i] - org[0]) * inv[0];
+                f32 const t0y = (n.m_min_y[i] - org[1]) * inv[1];
+                f32 const t1y = (n.m_max_y[i] - org[1]) * inv[1];
+                f32 const t0z = (n.m_min_z[i] - org[2]) * inv[2];
+                f32 const t1z = (n.m_max_z[i] - org[2]) * inv[2];
+                f32       tn  = tmin;
+                f32       tf  = tmax;
+                tn            = (t0x < t1x ? t0x : t1x) > tn ? (t0x < t1x ? t0x : t1x) : tn;
+                tn            = (t0y < t1y ? t0y : t1y) > tn ? (t0y < t1y ? t0y : t1y) : tn;
+                tn            = (t0z < t1z ? t0z : t1z) > tn ? (t0z < t1z ? t0z : t1z) : tn;
+                tf            = (t0x > t1x ? t0x : t1x) < tf ? (t0x > t1x ? t0x : t1x) : tf;
+                tf            = (t0y > t1y ? t0y : t1y) < tf ? (t0y > t1y ? t0y : t1y) : tf;
+                tf            = (t0z > t1z ? t0z : t1z) < tf ? (t0z > t1z ? t0z : t1z) : tf;
+                tnear[i]      = tn;
+                if (tn <= tf)
+                    mask |= 1 << i;
+            }
+            return mask;
+#endif
+        }
+
+        // Squared distance of a point to the 4 children
+        static inline void distance_node(node4_t const& n, f32 const p[3], f32 dist_sq[4])
+        {
+#ifdef BVH_USE_SSE
+            __m128 const zero = _mm_setzero_ps();
+            __m128 const px   = _mm_set1_ps(p[0]);
+            __m128 const py   = _mm_set1_ps(p[1]);
+            __m128 const pz   = _mm_set1_ps(p[2]);
+            __m128 const dx   = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(n.m_min_x), px), _mm_sub_ps(px, _mm_loadu_ps(n.m_max_x))), zero);
+            __m128 const dy   = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(n.m_min_y), py), _mm_sub_ps(py, _mm_loadu_ps(n.m_max_y))), zero);
+            __m128 const dz   = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(n.m_min_z), pz), _mm_sub_ps(pz, _mm_loadu_ps(n.m_max_z))), zero);
+            _mm_storeu_ps(dist_sq, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+#else
+            for (s32 i = 0; i < 4; ++i)
+            {
+                f32 dx = n.m_min_x[i] - p[0] > p[0] - n.m_max_x[i] ? n.m_min_x[i] - p[0] : p[0] - n.m_max_x[i];
+                f32 dy = n.m_min_y[i] - p[1] > p[1] - n.m_max_y[i] ? n.m_min_y[i] - p[1] : p[1] - n.m_max_y[i];
+                f32 dz = n.m_min_z[i] - p[2] > p[2] - n.m_max_z[i] ? n.m_min_z[i] - p[2] : p[2] - n.m_max_z[i];
+                dx         = dx > 0.0f ? dx : 0.0f;
+                dy         = dy > 0.0f ? dy : 0.0f;
+                dz         = dz > 0.0f ? dz : 0.0f;
+                dist_sq[i] = dx * dx + dy * dy + dz * dz;
+            }
+#endif
+        }
+
+        static inline u32 overlap_node(node4_t const& n, n3d::box_t const& box)
+        {
+            u32 mask = 0;
+            for (s32 i = 0; i < 4; ++i)
+            {
+                if (n.m_min_x[i] <= box.m_max[0] && n.m_max_x[i] >= box.m_min[0] && n.m_min_y[i] <= box.m_max[1] && n.m_max_y[i] >= box.m_min[1] && n.m_min_z[i] <= box.m_max[2] && n.m_max_z[i] >= box.m_min[2])
+                    mask |= 1 << i;
+            }
+            return mask;
+        }
+
+        // Sort the selected children on their key (nearest first)
+        static inline s32 sort_children(u32 mask, f32 const key[4], s32 order[4])
+        {
+            s32 count = 0;
+            for (s32 i = 0; i < 4; ++i)
+            {
+                if ((mask & (1 << i)) == 0)
+                    continue;
+                s32 j = count++;
+                while (j > 0 && key[order[j - 1]] > key[i])
+                {
+                    order[j] = order[j - 1];
+                    --j;
+                }
+                order[j] = i;
+            }
+            return count;
+        }
+
+        // Moller-Trumbore
+        static inline bool intersect_tri(tri_t const& t, f32 const org[3], f32 const dir[3], f32 tmin, f32 tmax, f32& out_t, f32& out_u, f32& out_v)
+        {
+            f32 const p[3] = {dir[1] * t.m_e2[2] - dir[2] * t.m_e2[1], dir[2] * t.m_e2[0] - dir[0] * t.m_e2[2], dir[0] * t.m_e2[1] - dir[1] * t.m_e2[0]};
+            f32 const det  = t.m_e1[0] * p[0] + t.m_e1[1] * p[1] + t.m_e1[2] * p[2];
+
+            // the tests are written so that a NaN (a triangle with non-finite vertices) is a miss
+            if (!(det <= -1e-12f || det >= 1e-12f))
+                return false;
+            f32 const inv_det = 1.0f / det;
+            f32 const s[3]    = {org[0] - t.m_v0[0], org[1] - t.m_v0[1], org[2] - t.m_v0[2]};
+            f32 const u       = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+            if (!(u >= 0.0f && u <= 1.0f))
+                return false;
+            f32 const q[3] = {s[1] * t.m_e1[2] - s[2] * t.m_e1[1], s[2] * t.m_e1[0] - s[0] * t.m_e1[2], s[0] * t.m_e1[1] - s[1] * t.m_e1[0]};
+            f32 const v    = (dir[0] * q[0] + dir[1] * q[1] + dir[2] * q[2]) * inv_det;
+            if (!(v >= 0.0f && (u + v) <= 1.0f))
+                return false;
+            f32 const d = (t.m_e2[0] * q[0] + t.m_e2[1] * q[1] + t.m_e2[2] * q[2]) * inv_det;
+            if (!(d >= tmin && d <= tmax))
+                return false;
+            out_t = d;
+            out_u = u;
+            out_v = v;
+            return true;
+        }
+
+        bool raycast(bvh_t const* bvh, ray_t const& ray, hit_t& hit)
+        {
+            if (bvh->m_node_count == 0)
+                return false;
+
+            f32 const org[3] = {ray.m_origin.x, ray.m_origin.y, ray.m_origin.z};
+            f32 const dir[3] = {ray.m_direction.x, ray.m_direction.y, ray.m_direction.z};
+            f32       inv[3];
+            for (s32 i = 0; i < 3; ++i)
+            {
+                // avoid 0 * inf = NaN in the slab test
+                f32 const d = (dir[i] > -1e-20f && dir[i] < 1e-20f) ? (dir[i] < 0.0f ? -1e-20f : 1e-20f) : dir[i];
+                inv[i]      = 1.0f / d;
+            }
+
+            bool found = false;
+            f32  tmax  = ray.m_tmax;
+
+            u32 stack[c_stack_size];
+            f32 stack_t[c_stack_size];
+            s32 sp      = 0;
+            stack[sp]   = 0;
+            stack_t[sp] = ray.m_tmin;
+            sp++;
+            while (sp > 0)
+            {
+                --sp;
+                if (stack_t[sp] > tmax)
+                    continue;
+
+                node4_t const& n = bvh->m_nodes[stack[sp]];
+                f32            tnear[4];
+                u32 const      mask = intersect_node(n, org, inv, ray.m_tmin, tmax, tnear);
+                s32            order[4];
+                s32 const      count = sort_children(mask, tnear, order);
+
+                // push far to near so the nearest child is popped first
+                for (s32 i = count - 1; i >= 0; --i)
+                {
+                    s32 const c = order[i];
+                    if (n.m_count[c] > 0 || is_empty_slot(n, c))
+                        continue;
+                    ASSERT(sp < c_stack_size);
+                    stack[sp]   = n.m_child[c];
+                    stack_t[sp] = tnear[c];
+                    sp++;
+                }
+                for (s32 i = 0; i < count; ++i)
+                {
+                    s32 const c = order[i];
+                    if (n.m_count[c] == 0)
+                        continue;
+                    for (u32 j = 0; j < n.m_count[c]; ++j)
+                    {
+                        tri_t const& t = bvh->m_tris[n.m_child[c] + j];
+                        f32          d, u, v;
+                        if (intersect_tri(t, org, dir, ray.m_tmin, tmax, d, u, v))
+                        {
+                            tmax           = d;
+                            hit.m_t        = d;
+                            hit.m_u        = u;
+                            hit.m_v        = v;
+                            hit.m_triangle = t.m_index;
+                            found          = true;
+                        }
+                    }
+                }
+            }
+            return found;
+        }
+
+        static inline f32 dot(f32 const a[3], f32 const b[3]) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+        // Closest point on a triangle (Ericson, Real-Time Collision Detection 5.1.5)
+        static void closest_point_tri(tri_t const& t, f32 const p[3], f32 out[3])
+        {
+            f32 const* a  = t.m_v0;
+            f32 const* ab = t.m_e1;
+            f32 const* ac = t.m_e2;
+            f32 const  ap[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+
+            f32 const d1 = dot(ab, ap);
+            f32 const d2 = dot(ac, ap);
+            if (d1 <= 0.0f && d2 <= 0.0f)
+            {
+                out[0] = a[0], out[1] = a[1], out[2] = a[2];
+                return;
+            }
+
+            f32 const bp[3] = {ap[0] - ab[0], ap[1] - ab[1], ap[2] - ab[2]};
+            f32 const d3    = dot(ab, bp);
+            f32 const d4    = dot(ac, bp);
+            if (d3 >= 0.0f && d4 <= d3)
+            {
+                out[0] = a[0] + ab[0], out[1] = a[1] + ab[1], out[2] = a[2] + ab[2];
+                return;
+            }
+
+            f32 const vc = d1 * d4 - d3 * d2;
+            if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            {
+                f32 const v = d1 / (d1 - d3);
+                out[0] = a[0] + v * ab[0], out[1] = a[1] + v * ab[1], out[2] = a[2] + v * ab[2];
+                return;
+            }
+
+            f32 const cp[3] = {ap[0] - ac[0], ap[1] - ac[1], ap[2] - ac[2]};
+            f32 const d5    = dot(ab, cp);
+            f32 const d6    = dot(ac, cp);
+            if (d6 >= 0.0f && d5 <= d6)
+            {
+                out[0] = a[0] + ac[0], out[1] = a[1] + ac[1], out[2] = a[2] + ac[2];
+                return;
+            }
+
+            f32 const vb = d5 * d2 - d1 * d6;
+            if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            {
+                f32 const w = d2 / (d2 - d6);
+                out[0] = a[0] + w * ac[0], out[1] = a[1] + w * ac[1], out[2] = a[2] + w * ac[2];
+                return;
+            }
+
+            f32 const va = d3 * d6 - d5 * d4;
+            if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+            {
+                f32 const w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+                out[0] = a[0] + ab[0] + w * (ac[0] - ab[0]);
+                out[1] = a[1] + ab[1] + w * (ac[1] - ab[1]);
+                out[2] = a[2] + ab[2] + w * (ac[2] - ab[2]);
+                return;
+            }
+
+            f32 const denom = 1.0f / (va + vb + vc);
+            f32 const v     = vb * denom;
+            f32 const w     = vc * denom;
+            out[0]          = a[0] + ab[0] * v + ac[0] * w;
+            out[1]          = a[1] + ab[1] * v + ac[1] * w;
+            out[2]          = a[2] + ab[2] * v + ac[2] * w;
+        }
+
+        bool closest_point(bvh_t const* bvh, nply::vertex_t const& point, f32 max_distance, closest_t& closest)
+        {
+            if (bvh->m_node_count == 0)
+                return false;
+
+            f32 const p[3]    = {point.x, point.y, point.z};
+            f32       best_sq = max_distance * max_distance;
+            bool      found   = false;
+
+            u32 stack[c_stack_size];
+            f32 stack_d[c_stack_size];
+            s32 sp      = 0;
+            stack[sp]   = 0;
+            stack_d[sp] = 0.0f;
+            sp++;
+            while (sp > 0)
+            {
+                --sp;
+                if (stack_d[sp] > best_sq)
+                    continue;
+
+                node4_t const& n = bvh->m_nodes[stack[sp]];
+                f32            dist_sq[4];
+                distance_node(n, p, dist_sq);
+                u32 mask = 0;
+                for (s32 i = 0; i < 4; ++i)
+                {
+                    if (dist_sq[i] <= best_sq && !is_empty_slot(n, i))
+                        mask |= 1 << i;
+                }
+                s32       order[4];
+                s32 const count = sort_children(mask, dist_sq, order);
+
+                // leaves first, nearest first, to shrink the search radius early
+                for (s32 i = 0; i < count; ++i)
+                {
+                    s32 const c = order[i];
+                    if (n.m_count[c] == 0 || dist_sq[c] > best_sq)
+                        continue;
+                    for (u32 j = 0; j < n.m_count[c]; ++j)
+                    {
+                        tri_t const& t = bvh->m_tris[n.m_child[c] + j];
+                        f32          q[3];
+                        closest_point_tri(t, p, q);
+                        f32 const d[3] = {q[0] - p[0], q[1] - p[1], q[2] - p[2]};
+                        f32 const d_sq = dot(d, d);
+                        if (d_sq <= best_sq)
+                        {
+                            best_sq                = d_sq;
+                            closest.m_point.x      = q[0];
+                            closest.m_point.y      = q[1];
+                            closest.m_point.z      = q[2];
+                            closest.m_distance_sq  = d_sq;
+                            closest.m_triangle     = t.m_index;
+                            found                  = true;
+                        }
+                    }
+                }
+                for (s32 i = count - 1; i >= 0; --i)
+                {
+                    s32 const c = order[i];
+                    if (n.m_count[c] > 0 || dist_sq[c] > best_sq)
+                        continue;
+                    ASSERT(sp < c_stack_size);
+                    stack[sp]   = n.m_child[c];
+                    stack_d[sp] = dist_sq[c];
+                    sp++;
+                }
+            }
+            return found;
+        }
+
+        u32 overlap(bvh_t const* bvh, n3d::box_t const& box, u32* triangles, u32 max_triangles)
+        {
+            if (bvh->m_node_count == 0)
+                return 0;
+
+            u32 found = 0;
+            u32 stack[c_stack_size];
+            s32 sp      = 0;
+            stack[sp++] = 0;
+            while (sp > 0)
+            {
+                node4_t const& n    = bvh->m_nodes[stack[--sp]];
+                u32 const      mask = overlap_node(n, box);
+                for (s32 c = 0; c < 4; ++c)
+                {
+                    if ((mask & (1 << c)) == 0 || is_empty_slot(n, c))
+                        continue;
+                    if (n.m_count[c] == 0)
+                    {
+                        ASSERT(sp < c_stack_size);
+                        stack[sp++] = n.m_child[c];
+                        continue;
+                    }
+                    for (u32 j = 0; j < n.m_count[c]; ++j)
+                    {
+                        tri_t const& t = bvh->m_tris[n.m_child[c] + j];
+                        n3d::box_t   tb;
+                        for (s32 a = 0; a < 3; ++a)
+                        {
+                            f32 const v0 = t.m_v0[a];
+                            f32 const v1 = v0 + t.m_e1[a];
+                            f32 const v2 = v0 + t.m_e2[a];
+                            tb.m_min[a]  = v0 < v1 ? (v0 < v2 ? v0 : v2) : (v1 < v2 ? v1 : v2);
+                            tb.m_max[a]  = v0 > v1 ? (v0 > v2 ? v0 : v2) : (v1 > v2 ? v1 : v2);
+                        }
+                        if (!n3d::box_overlaps(tb, box))
+                            continue;
+                        if (found < max_triangles)
+                            triangles[found] = t.m_index;
+                        found++;
+                    }
+                }
+            }
+            return found;
+        }
+
+    } // namespace nbvh
+} // namespace ncore
@@ -0,0 +1,350 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_cache.h"
+
+namespace ncore
+{
+    namespace ncache
+    {
+        enum estate
+        {
+            STATE_LOADING = 0,
+            STATE_READY   = 1,
+            STATE_FAILED  = 2,
+        };
+
+        // Every allocation of a loader is linked into a list, so that evicting a mesh releases all of
+        // its memory and the size of a mesh is known without asking the loader
+        struct block_t
+        {
+            block_t* m_prev;
+            block_t* m_next;
+            void*    m_raw;
+            u64      m_size;
+        };
+
+        class tracking_allocator_t : public nply::allocator_t
+        {
+        public:
+            tracking_allocator_t(nply::allocator_t* backing)
+                : m_backing(backing)
+                , m_head(nullptr)
+                , m_size(0)
+            {
+            }
+
+            nply::allocator_t* m_backing;
+            block_t*           m_head;
+            u64                m_size;
+
+        protected:
+            virtual void* v_alloc(u64 size, u32 alignment)
+            {
+                alignment        = alignment < 16 ? 16 : alignment;
+                u64 const offset = (sizeof(block_t) + alignment - 1) & ~((u64)alignment - 1);
+                u8*       raw    = (u8*)m_backing->alloc(offset + size, alignment);
+                if (raw == nullptr)
+                    return nullptr;
+                u8*      ptr   = raw + offset;
+                block_t* block = (block_t*)(ptr - sizeof(block_t));
+                block->m_prev  = nullptr;
+                block->m_next  = m_head;
+                block->m_raw   = raw;
+                block->m_size  = offset + size;
+                if (m_head != nullptr)
+                    m_head->m_prev = block;
+                m_head  = block;
+                m_size += block->m_size;
+                return ptr;
+            }
+
+            virtual void v_dealloc(void* ptr)
+            {
+                if (ptr == nullptr)
+                    return;
+                block_t* block = (block_t*)((u8*)ptr - sizeof(block_t));
+                if (block->m_prev != nullptr)
+                    block->m_prev->m_next = block->m_next;
+                else
+                    m_head = block->m_next;
+                if (block->m_next != nullptr)
+                    block->m_next->m_prev = block->m_prev;
+                m_size -= block->m_size;
+                m_backing->dealloc(block->m_raw);
+            }
+        };
+
+        // The handle handed out is the address of m_mesh, which is the first member
+        struct cache_t::entry_t
+        {
+            mesh_t       m_mesh;
+            key_t        m_key;
+            u64 volatile m_state; // read without the lock by threads waiting for the load
+            u32          m_refs;
+            bool         m_linked; // in a bucket, otherwise it was replaced or failed
+            entry_t*     m_next;   // in the bucket
+            entry_t*     m_lru_prev;
+            entry_t*     m_lru_next;
+            block_t*     m_blocks;
+        };
+
+        static inline u32 get_bucket(u64 id, u32 bucket_count) { return (u32)((id * 0x9E3779B97F4A7C15ULL) >> 32) & (bucket_count - 1); }
+
+        static inline u64 get_state(cache_t::entry_t* entry) { return nparallel::atomic_add(&entry->m_state, 0); }
+
+        cache_t::cache_t()
+            : m_allocator(nullptr)
+            , m_buckets(nullptr)
+            , m_bucket_count(0)
+            , m_lru_head(nullptr)
+            , m_lru_tail(nullptr)
+            , m_budget(0)
+        {
+        }
+
+        void cache_t::init(nply::allocator_t* allocator, u64 budget, u32 buckets)
+        {
+            m_allocator    = allocator;
+            m_bucket_count = 16;
+            while (m_bucket_count < buckets)
+                m_bucket_count *= 2;
+            m_buckets = (entry_t**)allocator->alloc(sizeof(entry_t*) * m_bucket_count);
+            for (u32 i = 0; i < m_bucket_count; ++i)
+                m_buckets[i] = nullptr;
+            m_lru_head          = nullptr;
+            m_lru_tail          = nullptr;
+            m_budget            = budget;
+            m_stats.m_hits      = 0;
+            m_stats.m_loads     = 0;
+            m_stats.m_failed    = 0;
+            m_stats.m_evictions = 0;
+            m_stats.m_size      = 0;
+            m_stats.m_count     = 0;
+        }
+
+        void cache_t::exit()
+        {
+            for (u32 i = 0; i < m_bucket_count; ++i)
+            {
+                entry_t* entry = m_buckets[i];
+                while (entry != nullptr)
+                {
+                    entry_t* next = entry->m_next;
+                    ASSERT(entry->m_refs == 0);
+                    destroy(entry);
+                    entry = next;
+                }
+            }
+            m_allocator->dealloc(m_buckets);
+            m_buckets      = nullptr;
+            m_bucket_count = 0;
+            m_lru_head     = nullptr;
+            m_lru_tail     = nullptr;
+        }
+
+        cache_t::entry_t* cache_t::find(u64 id) const
+        {
+            entry_t* entry = m_buckets[get_bucket(id, m_bucket_count)];
+            while (entry != nullptr && entry->m_key.m_id != id)
+                entry = entry->m_next;
+            return entry;
+        }
+
+        void cache_t::unlink(entry_t* entry)
+        {
+            entry_t** link = &m_buckets[get_bucket(entry->m_key.m_id, m_bucket_count)];
+            while (*link != entry)
+                link = &(*link)->m_next;
+            *link           = entry->m_next;
+            entry->m_next   = nullptr;
+            entry->m_linked = false;
+        }
+
+        void cache_t::lru_remove(entry_t* entry)
+        {
+            if (entry->m_lru_prev != nullptr)
+                entry->m_lru_prev->m_lru_next = entry->m_lru_next;
+            else
+                m_lru_head = entry->m_lru_next;
+            if (entry->m_lru_next != nullptr)
+                entry->m_lru_next->m_lru_prev = entry->m_lru_prev;
+            else
+                m_lru_tail = entry->m_lru_prev;
+            entry->m_lru_prev = nullptr;
+            entry->m_lru_next = nullptr;
+        }
+
+        void cache_t::evict()
+        {
+            while (m_stats.m_size > m_budget && m_lru_tail != nullptr)
+            {
+                entry_t* entry = m_lru_tail;
+                lru_remove(entry);
+                unlink(entry);
+                destroy(entry);
+                m_stats.m_evictions++;
+            }
+        }
+
+        void cache_t::destroy(entry_t* entry)
+        {
+            if (entry->m_state == STATE_READY)
+            {
+                m_stats.m_size -= entry->m_mesh.m_size;
+                m_stats.m_count--;
+            }
+            block_t* block = entry->m_blocks;
+            while (block != nullptr)
+            {
+                block_t* next = block->m_next;
+                m_allocator->dealloc(block->m_raw);
+                block = next;
+            }
+            m_allocator->dealloc(entry);
+        }
+
+        mesh_t const* cache_t::acquire(key_t const& key, loader_t* loader)
+        {
+            m_lock.lock();
+            entry_t* entry = find(key.m_id);
+            if (entry != nullptr && entry->m_key.m_stamp != key.m_stamp)
+            {
+                // the file changed, the old mesh stays valid for the threads that still use it
+                unlink(entry);
+                if (entry->m_refs == 0)
+                {
+                    lru_remove(entry);
+                    destroy(entry);
+                }
+                entry = nullptr;
+            }
+
+            if (entry != nullptr)
+            {
+                if (entry->m_refs == 0)
+                    lru_remove(entry);
+                entry->m_refs++;
+                m_stats.m_hits++;
+                m_lock.unlock();
+
+                while (get_state(entry) == STATE_LOADING)
+                {
+                    if (!loader->wait())
+                    {
+                        release(&entry->m_mesh);
+                        return nullptr;
+                    }
+                }
+                if (get_state(entry) == STATE_FAILED)
+                {
+                    release(&entry->m_mesh);
+                    return nullptr;
+                }
+                return &entry->m_mesh;
+            }
+
+            entry = (entry_t*)m_allocator->alloc(sizeof(entry_t));
+            if (entry == nullptr)
+            {
+                m_lock.unlock();
+                return nullptr;
+            }
+            entry->m_key      = key;
+            entry->m_state    = STATE_LOADING;
+            entry->m_refs     = 1;
+            entry->m_linked   = true;
+            entry->m_lru_prev = nullptr;
+            entry->m_lru_next = nullptr;
+            entry->m_blocks   = nullptr;
+
+            u32 const bucket   = get_bucket(key.m_id, m_bucket_count);
+            entry->m_next      = m_buckets[bucket];
+            m_buckets[bucket]  = entry;
+            m_stats.m_loads++;
+            m_lock.unlock();
+
+            // decode without holding the lock, other files can be loaded and cached meshes handed out
+            tracking_allocator_t memory(m_allocator);
+            mesh_t               mesh;
+            mesh.m_vertices       = nullptr;
+            mesh.m_vertex_count   = 0;
+            mesh.m_triangles      = nullptr;
+            mesh.m_triangle_count = 0;
+            mesh.m_user           = nullptr;
+            bool const ok         = loader->load(key, &memory, mesh);
+            mesh.m_size           = memory.m_size;
+
+            m_lock.lock();
+            entry->m_mesh   = mesh;
+            entry->m_blocks = memory.m_head;
+            if (ok)
+            {
+                m_stats.m_size += mesh.m_size;
+                m_stats.m_count++;
+            }
+            else
+            {
+                // not cached, the next request tries again
+                m_stats.m_failed++;
+                if (entry->m_linked)
+                    unlink(entry);
+            }
+            nparallel::atomic_cas(&entry->m_state, STATE_LOADING, ok ? STATE_READY : STATE_FAILED);
+            evict();
+            m_lock.unlock();
+
+            if (!ok)
+            {
+                release(&entry->m_mesh);
+                return nullptr;
+            }
+            return &entry->m_mesh;
+        }
+
+        void cache_t::release(mesh_t const* mesh)
+        {
+            if (mesh == nullptr)
+                return;
+            entry_t* entry = (entry_t*)mesh;
+
+            m_lock.lock();
+            ASSERT(entry->m_refs > 0);
+            if (--entry->m_refs == 0)
+            {
+                if (entry->m_linked && entry->m_state == STATE_READY)
+                {
+                    entry->m_lru_prev = nullptr;
+                    entry->m_lru_next = m_lru_head;
+                    if (m_lru_head != nullptr)
+                        m_lru_head->m_lru_prev = entry;
+                    else
+                        m_lru_tail = entry;
+                    m_lru_head = entry;
+                    evict();
+                }
+                else
+                {
+                    destroy(entry);
+                }
+            }
+            m_lock.unlock();
+        }
+
+        void cache_t::set_budget(u64 budget)
+        {
+            m_lock.lock();
+            m_budget = budget;
+            evict();
+            m_lock.unlock();
+        }
+
+        stats_t cache_t::get_stats()
+        {
+            m_lock.lock();
+            stats_t const stats = m_stats;
+            m_lock.unlock();
+            return stats;
+        }
+
+    } // namespace ncache
+} // namespace ncore
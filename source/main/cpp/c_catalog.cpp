@@ -0,0 +1,332 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_catalog.h"
+
+namespace ncore
+{
+    namespace ncatalog
+    {
+        // Image layout (offsets relative to the start of the image, 8 byte aligned):
+        //
+        //   header_t
+        //   entry_t entries[count]  (sorted by path)
+        //   per entry: the path (zero terminated) and the nply::info_t image
+        //
+        // @note: The image is stored in the native (little) endian format.
+
+        const u32 c_magic   = ('P' << 0) | ('L' << 8) | ('Y' << 16) | ('C' << 24);
+        const u32 c_version = 1;
+
+        const u64 c_probe_size     = 4 * 1024; // most headers fit in the first 4 KB
+        const u64 c_max_probe_size = 1024 * 1024;
+
+        struct header_t
+        {
+            u32 m_magic;
+            u32 m_version;
+            u64 m_size;
+            u64 m_count;
+            u64 m_entries_offset;
+        };
+
+        struct entry_t
+        {
+            u64 m_path_offset;
+            u64 m_info_offset;
+            u64 m_info_size; // 0 = not a ply file or not readable
+            u64 m_stamp;
+        };
+
+        static inline u64 align8(u64 size) { return (size + 7) & ~(u64)7; }
+
+        static inline header_t const* get_header(catalog_t const& catalog) { return (header_t const*)catalog.m_data; }
+        static inline entry_t const*  get_entry(catalog_t const& catalog, u64 index) { return (entry_t const*)(catalog.m_data + get_header(catalog)->m_entries_offset) + index; }
+
+        static inline u64 str_length(const char* str)
+        {
+            u64 len = 0;
+            while (str[len] != 0)
+                len++;
+            return len;
+        }
+
+        static inline s32 str_compare(const char* a, const char* b)
+        {
+            while (*a != 0 && *a == *b)
+            {
+                a++;
+                b++;
+            }
+            return (s32)(u8)*a - (s32)(u8)*b;
+        }
+
+        static inline void copy(u8* dst, u8 const* src, u64 size)
+        {
+            for (u64 i = 0; i < size; ++i)
+                dst[i] = src[i];
+        }
+
+        struct result_t
+        {
+            const u8* m_info;
+            u64       m_info_size;
+            u64       m_stamp;
+        };
+
+        class probe_task_t : public nparallel::task_t
+        {
+        public:
+            source_t*        m_source;
+            nply::scratch_t* m_scratch;
+            const char**     m_paths;
+            u64              m_count;
+            s32              m_parts;
+            catalog_t const* m_previous;
+            result_t*        m_results;
+
+            bool reuse(const char* path, result_t& result)
+            {
+                if (m_previous == nullptr || result.m_stamp == 0)
+                    return false;
+                s64 const index = find(*m_previous, path);
+                if (index < 0 || get_stamp(*m_previous, (u64)index) != result.m_stamp)
+                    return false;
+                nply::info_t info;
+                if (get_info(*m_previous, (u64)index, info))
+                {
+                    result.m_info      = info.m_data;
+                    result.m_info_size = info.m_size;
+                }
+                return true;
+            }
+
+            void probe(nply::arena_t* temp, nply::arena_t* out, const char* path, result_t& result)
+            {
+                nply::arena_t::marker_t const marker = temp->mark();
+                for (u64 size = c_probe_size; size <= c_max_probe_size; size *= 4)
+                {
+                    u8* buffer = (u8*)temp->alloc(size);
+                    if (buffer == nullptr)
+                        break;
+                    u64 const n = m_source->read(path, buffer, size);
+                    if (n < 3 || buffer[0] != 'p' || buffer[1] != 'l' || buffer[2] != 'y')
+                        break;
+
+                    nply::info_t info;
+                    if (nply::probe(temp, buffer, n, info))
+                    {
+                        u8* image = (u8*)out->alloc(info.m_size, 8);
+                        if (image == nullptr)
+                            break;
+                        copy(image, info.m_data, info.m_size);
+                        result.m_info      = image;
+                        result.m_info_size = info.m_size;
+                        break;
+                    }
+                    if (n < size) // the whole file was read
+                        break;
+                    temp->rewind(marker);
+                }
+                temp->rewind(marker);
+            }
+
+            virtual void execute(s32 index)
+            {
+                nply::arena_t* temp = m_scratch->get(index * 2 + 0);
+                nply::arena_t* out  = m_scratch->get(index * 2 + 1);
+
+                u64 begin, end;
+                nparallel::get_range(m_count, m_parts, index, begin, end);
+                for (u64 i = begin; i < end; ++i)
+                {
+                    result_t& result   = m_results[i];
+                    result.m_info      = nullptr;
+                    result.m_info_size = 0;
+                    result.m_stamp     = m_source->stamp(m_paths[i]);
+                    if (!reuse(m_paths[i], result))
+                        probe(temp, out, m_paths[i], result);
+                }
+            }
+        };
+
+        // Heap sort of the entry order by path
+        static void sift_down(u64* order, const char** paths, u64 root, u64 count)
+        {
+            while (true)
+            {
+                u64 child = root * 2 + 1;
+                if (child >= count)
+                    break;
+                if (child + 1 < count && str_compare(paths[order[child]], paths[order[child + 1]]) < 0)
+                    child++;
+                if (str_compare(paths[order[root]], paths[order[child]]) >= 0)
+                    break;
+                u64 const t  = order[root];
+                order[root]  = order[child];
+                order[child] = t;
+                root         = child;
+            }
+        }
+
+        static void sort_by_path(u64* order, const char** paths, u64 count)
+        {
+            for (u64 i = count / 2; i > 0; --i)
+                sift_down(order, paths, i - 1, count);
+            for (u64 end = count; end > 1; --end)
+            {
+                u64 const t    = order[0];
+                order[0]       = order[end - 1];
+                order[end - 1] = t;
+                sift_down(order, paths, 0, end - 1);
+            }
+        }
+
+        bool build(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, nply::scratch_t* scratch, source_t* source, const char** paths, u64 path_count, catalog_t const* previous, catalog_t& catalog)
+        {
+            if (scratch->get_count() < 2)
+                return false;
+
+            scheduler     = nparallel::get_scheduler(scheduler);
+            s32 parts     = nparallel::get_parts(scheduler, path_count, 16);
+            s32 max_parts = scratch->get_count() / 2;
+            if (parts > max_parts)
+                parts = max_parts;
+
+            result_t* results = (result_t*)allocator->alloc(sizeof(result_t) * (path_count + 1));
+            u64*      order   = (u64*)allocator->alloc(sizeof(u64) * (path_count + 1));
+            if (results == nullptr || order == nullptr)
+            {
+                allocator->dealloc(order);
+                allocator->dealloc(results);
+                return false;
+            }
+
+            probe_task_t task;
+            task.m_source   = source;
+            task.m_scratch  = scratch;
+            task.m_paths    = paths;
+            task.m_count    = path_count;
+            task.m_parts    = parts;
+            task.m_previous = previous;
+            task.m_results  = results;
+            scheduler->run(&task, parts);
+
+            for (u64 i = 0; i < path_count; ++i)
+                order[i] = i;
+            sort_by_path(order, paths, path_count);
+
+            u64       offset         = align8(sizeof(header_t));
+            u64 const entries_offset = offset;
+            offset                   = align8(offset + sizeof(entry_t) * path_count);
+            for (u64 i = 0; i < path_count; ++i)
+                offset += align8(str_length(paths[i]) + 1) + results[i].m_info_size;
+
+            u8* image = (u8*)allocator->alloc(offset, 8);
+            if (image != nullptr)
+            {
+                header_t* hdr         = (header_t*)image;
+                hdr->m_magic          = c_magic;
+                hdr->m_version        = c_version;
+                hdr->m_size           = offset;
+                hdr->m_count          = path_count;
+                hdr->m_entries_offset = entries_offset;
+
+                entry_t* entries = (entry_t*)(image + entries_offset);
+                u64      cursor  = align8(entries_offset + sizeof(entry_t) * path_count);
+                for (u64 i = 0; i < path_count; ++i)
+                {
+                    u64 const       src    = order[i];
+                    result_t const& result = results[src];
+                    u64 const       len    = str_length(paths[src]);
+                    entry_t&        entry  = entries[i];
+
+                    entry.m_path_offset = cursor;
+                    copy(image + cursor, (u8 const*)paths[src], len);
+                    for (u64 p = len; p < align8(len + 1); ++p)
+                        image[cursor + p] = 0;
+                    cursor += align8(len + 1);
+
+                    entry.m_info_offset = cursor;
+                    entry.m_info_size   = result.m_info_size;
+                    entry.m_stamp       = result.m_stamp;
+                    copy(image + cursor, result.m_info, result.m_info_size);
+                    cursor += result.m_info_size;
+                }
+
+                catalog.m_data = image;
+                catalog.m_size = offset;
+            }
+
+            allocator->dealloc(order);
+            allocator->dealloc(results);
+            for (s32 i = 0; i < parts * 2; ++i)
+                scratch->get(i)->reset();
+            return image != nullptr;
+        }
+
+        // A path must end with its zero terminator inside the image
+        static bool is_terminated(const u8* data, u64 offset, u64 size)
+        {
+            for (; offset < size; ++offset)
+            {
+                if (data[offset] == 0)
+                    return true;
+            }
+            return false;
+        }
+
+        bool open(const u8* data, u64 size, catalog_t& catalog)
+        {
+            if (data == nullptr || size < sizeof(header_t) || ((uint_t)data & 7) != 0)
+                return false;
+            header_t const* hdr = (header_t const*)data;
+            if (hdr->m_magic != c_magic || hdr->m_version != c_version || hdr->m_size > size)
+                return false;
+            if (hdr->m_entries_offset > hdr->m_size || hdr->m_count > (hdr->m_size - hdr->m_entries_offset) / sizeof(entry_t))
+                return false;
+            entry_t const* entries = (entry_t const*)(data + hdr->m_entries_offset);
+            for (u64 i = 0; i < hdr->m_count; ++i)
+            {
+                entry_t const& entry = entries[i];
+                if (entry.m_info_offset > hdr->m_size || entry.m_info_size > hdr->m_size - entry.m_info_offset)
+                    return false;
+                if (!is_terminated(data, entry.m_path_offset, hdr->m_size))
+                    return false;
+            }
+            catalog.m_data = data;
+            catalog.m_size = hdr->m_size;
+            return true;
+        }
+
+        u64         get_count(catalog_t const& catalog) { return get_header(catalog)->m_count; }
+        const char* get_path(catalog_t const& catalog, u64 index) { return (const char*)catalog.m_data + get_entry(catalog, index)->m_path_offset; }
+        u64         get_stamp(catalog_t const& catalog, u64 index) { return get_entry(catalog, index)->m_stamp; }
+
+        bool get_info(catalog_t const& catalog, u64 index, nply::info_t& info)
+        {
+            entry_t const* entry = get_entry(catalog, index);
+            if (entry->m_info_size == 0)
+                return false;
+            return nply::open_info(catalog.m_data + entry->m_info_offset, entry->m_info_size, info);
+        }
+
+        s64 find(catalog_t const& catalog, const char* path)
+        {
+            u64 lo = 0;
+            u64 hi = get_count(catalog);
+            while (lo < hi)
+            {
+                u64 const mid = (lo + hi) / 2;
+                s32 const c   = str_compare(get_path(catalog, mid), path);
+                if (c == 0)
+                    return (s64)mid;
+                if (c < 0)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return -1;
+        }
+
+    } // namespace ncatalog
+} // namespace ncore
@@ -0,0 +1,294 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_compressed.h"
+
+namespace ncore
+{
+    namespace ncompressed
+    {
+        const u64 c_min_produce = 64 * 1024;
+
+        static inline void copy(u8* dst, u8 const* src, u64 size)
+        {
+            for (u64 i = 0; i < size; ++i)
+                dst[i] = src[i];
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Window
+        // ----------------------------------------------------------------------------------------
+
+        void window_reader_t::init_window(nply::allocator_t* allocator)
+        {
+            m_allocator    = allocator;
+            m_window       = nullptr;
+            m_capacity     = 0;
+            m_begin        = 0;
+            m_used         = 0;
+            m_scanned      = 0;
+            m_line_end     = 0;
+            m_decompressed = 0;
+            m_failed       = false;
+        }
+
+        void window_reader_t::exit_window()
+        {
+            m_allocator->dealloc(m_window);
+            m_window   = nullptr;
+            m_capacity = 0;
+            m_begin    = 0;
+            m_used     = 0;
+            m_scanned  = 0;
+        }
+
+        u8* window_reader_t::reserve(u64 size)
+        {
+            if (m_begin > 0)
+            {
+                u64 const keep = m_used - m_begin;
+                for (u64 i = 0; i < keep; ++i)
+                    m_window[i] = m_window[m_begin + i];
+                m_scanned -= m_begin;
+                m_used     = keep;
+                m_begin    = 0;
+            }
+            if (m_used + size > m_capacity)
+            {
+                u64 capacity = m_capacity * 2;
+                if (capacity < m_used + size)
+                    capacity = m_used + size;
+                u8* window = (u8*)m_allocator->alloc(capacity);
+                if (window == nullptr)
+                {
+                    m_failed = true;
+                    return nullptr;
+                }
+                copy(window, m_window, m_used);
+                m_allocator->dealloc(m_window);
+                m_window   = window;
+                m_capacity = capacity;
+            }
+            return m_window + m_used;
+        }
+
+        bool window_reader_t::read_line(const char*& str, const char*& end)
+        {
+            // Decompress until the window holds a complete line or there is no more data
+            bool more = true;
+            while (more)
+            {
+                const char* window = (const char*)m_window;
+                const char* line;
+                const char* line_end;
+                nply::g_ReadLine(window + m_scanned, window + m_used, line, line_end);
+                // a '\r' at the very end may still be followed by its '\n'
+                if (line_end < window + m_used && (line_end + 1 < window + m_used || *line_end == '\n'))
+                    break;
+                m_scanned = (u64)(line_end - window);
+                more      = produce(c_min_produce);
+            }
+            if (m_failed || m_begin == m_used)
+                return false;
+
+            const char* window = (const char*)m_window;
+            const char* cursor = nply::g_ReadLine(window + m_begin, window + m_used, str, end);
+            m_begin            = (u64)(cursor - window);
+            m_scanned          = m_begin;
+            m_line_end         = (u32)(cursor - end);
+            return true;
+        }
+
+        bool window_reader_t::read_data(u64 size, const u8*& begin, const u8*& end)
+        {
+            while (m_used - m_begin < size)
+            {
+                if (!produce(size - (m_used - m_begin)))
+                    return false;
+            }
+            begin    = m_window + m_begin;
+            end      = begin + size;
+            m_begin += size;
+            if (m_scanned < m_begin)
+                m_scanned = m_begin;
+            return true;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Stream
+        // ----------------------------------------------------------------------------------------
+
+        void stream_reader_t::init(nply::allocator_t* allocator, input_t* input, codec_t* codec, u64 chunk_size)
+        {
+            init_window(allocator);
+            m_input       = input;
+            m_codec       = codec;
+            m_chunk_size  = chunk_size > 0 ? chunk_size : 1;
+            m_chunk       = (u8*)allocator->alloc(m_chunk_size);
+            m_chunk_begin = 0;
+            m_chunk_end   = 0;
+            m_offset      = 0;
+            m_input_end   = false;
+            m_stream_end  = false;
+            m_failed      = m_chunk == nullptr;
+        }
+
+        void stream_reader_t::exit()
+        {
+            m_allocator->dealloc(m_chunk);
+            m_chunk = nullptr;
+            exit_window();
+        }
+
+        bool stream_reader_t::produce(u64 size)
+        {
+            if (m_stream_end || m_failed)
+                return false;
+
+            u64 const room = size > m_chunk_size ? size : m_chunk_size;
+            u8*       dst  = reserve(room);
+            if (dst == nullptr)
+                return false;
+
+            u64 total = 0;
+            while (total < room && !m_stream_end)
+            {
+                if (m_chunk_begin == m_chunk_end && !m_input_end)
+                {
+                    u64 const n    = m_input->read_at(m_offset, m_chunk, m_chunk_size);
+                    m_offset      += n;
+                    m_chunk_begin  = 0;
+                    m_chunk_end    = n;
+                    m_input_end    = n == 0;
+                }
+
+                u64  consumed = 0;
+                u64  produced = 0;
+                bool end      = false;
+                if (!m_codec->stream(m_chunk + m_chunk_begin, m_chunk_end - m_chunk_begin, consumed, dst + total, room - total, produced, end))
+                {
+                    m_failed = true;
+                    break;
+                }
+                m_chunk_begin += consumed;
+                total         += produced;
+                m_stream_end   = end;
+
+                // the input ended before the stream did
+                if (consumed == 0 && produced == 0 && !end && m_input_end)
+                {
+                    m_failed = true;
+                    break;
+                }
+            }
+            m_used         += total;
+            m_decompressed += total;
+            return total > 0;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Frames
+        // ----------------------------------------------------------------------------------------
+
+        class frame_task_t : public nparallel::task_t
+        {
+        public:
+            input_t*       m_input;
+            codec_t*       m_codec;
+            frame_t const* m_frames; // of the batch
+            u8*            m_src;
+            u8*            m_dst;
+            u64 volatile   m_errors;
+
+            virtual void execute(s32 index)
+            {
+                u64 src = 0;
+                u64 dst = 0;
+                for (s32 i = 0; i < index; ++i)
+                {
+                    src += m_frames[i].m_size;
+                    dst += m_frames[i].m_decompressed_size;
+                }
+                frame_t const& frame = m_frames[index];
+                if (m_input->read_at(frame.m_offset, m_src + src, frame.m_size) != frame.m_size || !m_codec->frame(m_src + src, frame.m_size, m_dst + dst, frame.m_decompressed_size))
+                    nparallel::atomic_add(&m_errors, 1);
+            }
+        };
+
+        void frames_reader_t::init(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, input_t* input, codec_t* codec, frame_t const* frames, u64 frame_count, s32 batch)
+        {
+            init_window(allocator);
+            m_scheduler       = nparallel::get_scheduler(scheduler);
+            m_input           = input;
+            m_codec           = codec;
+            m_frames          = frames;
+            m_frame_count     = frame_count;
+            m_next            = 0;
+            m_batch           = batch > 0 ? batch : m_scheduler->concurrency() * 2;
+            m_compressed      = nullptr;
+            m_compressed_size = 0;
+            if (m_batch < 1)
+                m_batch = 1;
+        }
+
+        void frames_reader_t::exit()
+        {
+            m_allocator->dealloc(m_compressed);
+            m_compressed      = nullptr;
+            m_compressed_size = 0;
+            exit_window();
+        }
+
+        bool frames_reader_t::produce(u64 size)
+        {
+            if (m_next >= m_frame_count || m_failed)
+                return false;
+
+            // A batch of frames, more when the batch does not hold 'size' bytes
+            u64 const first      = m_next;
+            u64       last       = m_next;
+            u64       bytes      = 0;
+            u64       compressed = 0;
+            while (last < m_frame_count && ((last - first) < (u64)m_batch || bytes < size))
+            {
+                bytes      += m_frames[last].m_decompressed_size;
+                compressed += m_frames[last].m_size;
+                last++;
+            }
+
+            if (compressed > m_compressed_size)
+            {
+                m_allocator->dealloc(m_compressed);
+                m_compressed      = (u8*)m_allocator->alloc(compressed);
+                m_compressed_size = m_compressed != nullptr ? compressed : 0;
+                if (m_compressed == nullptr)
+                {
+                    m_failed = true;
+                    return false;
+                }
+            }
+            u8* dst = reserve(bytes);
+            if (dst == nullptr)
+                return false;
+
+            frame_task_t task;
+            task.m_input  = m_input;
+            task.m_codec  = m_codec;
+            task.m_frames = m_frames + first;
+            task.m_src    = m_compressed;
+            task.m_dst    = dst;
+            task.m_errors = 0;
+            m_scheduler->run(&task, (s32)(last - first));
+            if (task.m_errors != 0)
+            {
+                m_failed = true;
+                return false;
+            }
+
+            m_next          = last;
+            m_used         += bytes;
+            m_decompressed += bytes;
+            return true;
+        }
+
+    } // namespace ncompressed
+} // namespace ncore
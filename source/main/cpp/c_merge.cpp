@@ -0,0 +1,210 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_merge.h"
+
+namespace ncore
+{
+    namespace nmerge
+    {
+        const u64 c_min_part    = 4096;         // vertices + triangles per part
+        const u64 c_max_indexed = (u64)1 << 32; // vertices that 32-bit indices can address
+
+        static inline f32 determinant(nmesh::matrix_t const& matrix)
+        {
+            f32 const(*m)[4] = matrix.m;
+            return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        }
+
+        // The mesh that holds vertex / triangle 'item': the last one starting at or before it, empty
+        // meshes in front of it start at the same offset
+        static u32 find_vertex_mesh(range_t const* ranges, u32 count, u64 item)
+        {
+            u32 lo = 0;
+            u32 hi = count;
+            while (hi - lo > 1)
+            {
+                u32 const mid = (lo + hi) / 2;
+                if (ranges[mid].m_vertex_offset <= item)
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+
+        static u32 find_triangle_mesh(range_t const* ranges, u32 count, u64 item)
+        {
+            u32 lo = 0;
+            u32 hi = count;
+            while (hi - lo > 1)
+            {
+                u32 const mid = (lo + hi) / 2;
+                if (ranges[mid].m_triangle_offset <= item)
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+
+        static void write_vertices(mesh_t const& mesh, u64 begin, u64 end, nply::vertex_t* out)
+        {
+            nply::vertex_t const* in = mesh.m_vertices;
+            if (mesh.m_transform == nullptr)
+            {
+                for (u64 i = begin; i < end; ++i)
+                    *out++ = in[i];
+                return;
+            }
+
+            nmesh::matrix_t const& m = *mesh.m_transform;
+            for (u64 i = begin; i < end; ++i, ++out)
+            {
+                f32 const x = in[i].x, y = in[i].y, z = in[i].z;
+                out->x      = m.m[0][0] * x + m.m[0][1] * y + m.m[0][2] * z + m.m[0][3];
+                out->y      = m.m[1][0] * x + m.m[1][1] * y + m.m[1][2] * z + m.m[1][3];
+                out->z      = m.m[2][0] * x + m.m[2][1] * y + m.m[2][2] * z + m.m[2][3];
+            }
+        }
+
+        static void write_triangles(mesh_t const& mesh, u64 base, u64 begin, u64 end, nply::triangle_t* out)
+        {
+            nply::triangle_t const* in     = mesh.m_triangles;
+            u32 const               offset = (u32)base;
+            bool const              mirror = mesh.m_transform != nullptr && determinant(*mesh.m_transform) < 0.0f;
+            for (u64 i = begin; i < end; ++i, ++out)
+            {
+                nply::triangle_t const& t = in[i];
+                ASSERT(t.v1 < mesh.m_vertex_count && t.v2 < mesh.m_vertex_count && t.v3 < mesh.m_vertex_count);
+                out->v1 = t.v1 + offset;
+                out->v2 = (mirror ? t.v3 : t.v2) + offset;
+                out->v3 = (mirror ? t.v2 : t.v3) + offset;
+            }
+        }
+
+        // Every part writes its share of the vertices and its share of the triangles, walking over
+        // the meshes that overlap that share
+        class write_task_t : public nparallel::task_t
+        {
+        public:
+            mesh_t const*     m_meshes;
+            range_t const*    m_ranges;
+            u32               m_mesh_count;
+            nply::vertex_t*   m_vertices;
+            u64               m_vertex_count;
+            nply::triangle_t* m_triangles;
+            u64               m_triangle_count;
+            s32               m_parts;
+
+            virtual void execute(s32 index)
+            {
+                u64 begin, end;
+                nparallel::get_range(m_vertex_count, m_parts, index, begin, end);
+                for (u32 i = find_vertex_mesh(m_ranges, m_mesh_count, begin); begin < end; ++i)
+                {
+                    range_t const& range = m_ranges[i];
+                    u64            stop  = range.m_vertex_offset + range.m_vertex_count;
+                    stop                 = stop < end ? stop : end;
+                    if (begin < stop)
+                        write_vertices(m_meshes[i], begin - range.m_vertex_offset, stop - range.m_vertex_offset, m_vertices + begin);
+                    begin = stop;
+                }
+
+                nparallel::get_range(m_triangle_count, m_parts, index, begin, end);
+                for (u32 i = find_triangle_mesh(m_ranges, m_mesh_count, begin); begin < end; ++i)
+                {
+                    range_t const& range = m_ranges[i];
+                    u64            stop  = range.m_triangle_offset + range.m_triangle_count;
+                    stop                 = stop < end ? stop : end;
+                    if (begin < stop)
+                        write_triangles(m_meshes[i], range.m_vertex_offset, begin - range.m_triangle_offset, stop - range.m_triangle_offset, m_triangles + begin);
+                    begin = stop;
+                }
+            }
+        };
+
+        bool plan(mesh_t const* meshes, u32 mesh_count, range_t* ranges, u64& vertex_count, u64& triangle_count)
+        {
+            u64 vertices  = 0;
+            u64 triangles = 0;
+            for (u32 i = 0; i < mesh_count; ++i)
+            {
+                ranges[i].m_vertex_offset   = vertices;
+                ranges[i].m_vertex_count    = meshes[i].m_vertex_count;
+                ranges[i].m_triangle_offset = triangles;
+                ranges[i].m_triangle_count  = meshes[i].m_triangle_count;
+                vertices                   += meshes[i].m_vertex_count;
+                triangles                  += meshes[i].m_triangle_count;
+            }
+            vertex_count   = vertices;
+            triangle_count = triangles;
+            return vertices <= c_max_indexed;
+        }
+
+        void write(nparallel::scheduler_t* scheduler, mesh_t const* meshes, u32 mesh_count, range_t const* ranges, nply::vertex_t* vertices, nply::triangle_t* triangles)
+        {
+            if (mesh_count == 0)
+                return;
+            range_t const& last = ranges[mesh_count - 1];
+
+            scheduler = nparallel::get_scheduler(scheduler);
+            write_task_t task;
+            task.m_meshes         = meshes;
+            task.m_ranges         = ranges;
+            task.m_mesh_count     = mesh_count;
+            task.m_vertices       = vertices;
+            task.m_vertex_count   = last.m_vertex_offset + last.m_vertex_count;
+            task.m_triangles      = triangles;
+            task.m_triangle_count = last.m_triangle_offset + last.m_triangle_count;
+            task.m_parts          = nparallel::get_parts(scheduler, task.m_vertex_count + task.m_triangle_count, c_min_part);
+            scheduler->run(&task, task.m_parts);
+        }
+
+        bool merge(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, mesh_t const* meshes, u32 mesh_count, merged_t& merged)
+        {
+            merged.m_vertices       = nullptr;
+            merged.m_vertex_count   = 0;
+            merged.m_triangles      = nullptr;
+            merged.m_triangle_count = 0;
+            merged.m_range_count    = 0;
+            merged.m_ranges         = (range_t*)allocator->alloc(sizeof(range_t) * (mesh_count > 0 ? mesh_count : 1));
+            if (merged.m_ranges == nullptr)
+                return false;
+
+            u64 vertex_count, triangle_count;
+            if (!plan(meshes, mesh_count, merged.m_ranges, vertex_count, triangle_count))
+            {
+                release(allocator, merged);
+                return false;
+            }
+
+            merged.m_vertices  = (nply::vertex_t*)allocator->alloc(sizeof(nply::vertex_t) * (vertex_count > 0 ? vertex_count : 1));
+            merged.m_triangles = (nply::triangle_t*)allocator->alloc(sizeof(nply::triangle_t) * (triangle_count > 0 ? triangle_count : 1));
+            if (merged.m_vertices == nullptr || merged.m_triangles == nullptr)
+            {
+                release(allocator, merged);
+                return false;
+            }
+
+            write(scheduler, meshes, mesh_count, merged.m_ranges, merged.m_vertices, merged.m_triangles);
+            merged.m_vertex_count   = vertex_count;
+            merged.m_triangle_count = triangle_count;
+            merged.m_range_count    = mesh_count;
+            return true;
+        }
+
+        void release(nply::allocator_t* allocator, merged_t& merged)
+        {
+            allocator->dealloc(merged.m_vertices);
+            allocator->dealloc(merged.m_triangles);
+            allocator->dealloc(merged.m_ranges);
+            merged.m_vertices       = nullptr;
+            merged.m_vertex_count   = 0;
+            merged.m_triangles      = nullptr;
+            merged.m_triangle_count = 0;
+            merged.m_ranges         = nullptr;
+            merged.m_range_count    = 0;
+        }
+
+    } // namespace nmerge
+} // namespace ncore
@@ -0,0 +1,418 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_mesh.h"
+
+#if defined(__AVX__)
+#    include <immintrin.h>
+#    define MESH_USE_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#    include <emmintrin.h>
+#    define MESH_USE_SSE
+#endif
+
+#include <math.h>
+
+namespace ncore
+{
+    namespace nmesh
+    {
+        const s32 c_max_parts     = 64;
+        const u64 c_min_part_size = 64 * 1024;
+
+        static s32 get_parts(nparallel::scheduler_t* scheduler, u64 count)
+        {
+            s32 const parts = nparallel::get_parts(scheduler, count, c_min_part_size);
+            return parts > c_max_parts ? c_max_parts : parts;
+        }
+
+        matrix_t identity()
+        {
+            matrix_t r;
+            for (s32 i = 0; i < 4; ++i)
+                for (s32 j = 0; j < 4; ++j)
+                    r.m[i][j] = (i == j) ? 1.0f : 0.0f;
+            return r;
+        }
+
+        matrix_t translate(nply::vertex_t const& v)
+        {
+            matrix_t r = identity();
+            r.m[0][3]  = v.x;
+            r.m[1][3]  = v.y;
+            r.m[2][3]  = v.z;
+            return r;
+        }
+
+        matrix_t scale(nply::vertex_t const& v)
+        {
+            matrix_t r = identity();
+            r.m[0][0]  = v.x;
+            r.m[1][1]  = v.y;
+            r.m[2][2]  = v.z;
+            return r;
+        }
+
+        matrix_t mul(matrix_t const& a, matrix_t const& b)
+        {
+            matrix_t r;
+            for (s32 i = 0; i < 4; ++i)
+            {
+                for (s32 j = 0; j < 4; ++j)
+                {
+                    r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+                }
+            }
+            return r;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // AoS <-> SoA
+        // ----------------------------------------------------------------------------------------
+
+        class convert_task_t : public nparallel::task_t
+        {
+        public:
+            nply::vertex_t* m_vertices;
+            positions_t     m_positions;
+            s32             m_parts;
+            bool            m_to_soa;
+
+            virtual void execute(s32 index)
+            {
+                u64 begin, end;
+                nparallel::get_range(m_positions.m_count, m_parts, index, begin, end);
+                if (m_to_soa)
+                {
+                    for (u64 i = begin; i < end; ++i)
+                    {
+                        m_positions.m_x[i] = m_vertices[i].x;
+                        m_positions.m_y[i] = m_vertices[i].y;
+                        m_positions.m_z[i] = m_vertices[i].z;
+                    }
+                }
+                else
+                {
+                    for (u64 i = begin; i < end; ++i)
+                    {
+                        m_vertices[i].x = m_positions.m_x[i];
+                        m_vertices[i].y = m_positions.m_y[i];
+                        m_vertices[i].z = m_positions.m_z[i];
+                    }
+                }
+            }
+        };
+
+        void to_soa(nparallel::scheduler_t* scheduler, nply::vertex_t const* vertices, positions_t& positions)
+        {
+            scheduler = nparallel::get_scheduler(scheduler);
+            convert_task_t task;
+            task.m_vertices  = (nply::vertex_t*)vertices;
+            task.m_positions = positions;
+            task.m_parts     = get_parts(scheduler, positions.m_count);
+            task.m_to_soa    = true;
+            scheduler->run(&task, task.m_parts);
+        }
+
+        void to_aos(nparallel::scheduler_t* scheduler, positions_t const& positions, nply::vertex_t* vertices)
+        {
+            scheduler = nparallel::get_scheduler(scheduler);
+            convert_task_t task;
+            task.m_vertices  = vertices;
+            task.m_positions = positions;
+            task.m_parts     = get_parts(scheduler, positions.m_count);
+            task.m_to_soa    = false;
+            scheduler->run(&task, task.m_parts);
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Bounds
+        // ----------------------------------------------------------------------------------------
+
+        static void min_max(f32 const* a, u64 begin, u64 end, f32& out_min, f32& out_max)
+        {
+            f32 mn = out_min;
+            f32 mx = out_max;
+            u64 i  = begin;
+#if defined(MESH_USE_AVX)
+            if ((end - i) >= 8)
+            {
+                __m256 vmn = _mm256_set1_ps(mn);
+                __m256 vmx = _mm256_set1_ps(mx);
+                for (; (i + 8) <= end; i += 8)
+                {
+                    __m256 const v = _mm256_loadu_ps(a + i);
+                    vmn            = _mm256_min_ps(vmn, v);
+                    vmx            = _mm256_max_ps(vmx, v);
+                }
+                f32 lmn[8], lmx[8];
+                _mm256_storeu_ps(lmn, vmn);
+                _mm256_storeu_ps(lmx, vmx);
+                for (s32 j = 0; j < 8; ++j)
+                {
+                    mn = lmn[j] < mn ? lmn[j] : mn;
+                    mx = lmx[j] > mx ? lmx[j] : mx;
+                }
+            }
+#elif defined(MESH_USE_SSE)
+            if ((end - i) >= 4)
+            {
+                __m128 vmn = _mm_set1_ps(mn);
+                __m128 vmx = _mm_set1_ps(mx);
+                for (; (i + 4) <= end; i += 4)
+                {
+                    __m128 const v = _mm_loadu_ps(a + i);
+                    vmn            = _mm_min_ps(vmn, v);
+                    vmx            = _mm_max_ps(vmx, v);
+                }
+                f32 lmn[4], lmx[4];
+                _mm_storeu_ps(lmn, vmn);
+                _mm_storeu_ps(lmx, vmx);
+                for (s32 j = 0; j < 4; ++j)
+                {
+                    mn = lmn[j] < mn ? lmn[j] : mn;
+                    mx = lmx[j] > mx ? lmx[j] : mx;
+                }
+            }
+#endif
+            for (; i < end; ++i)
+            {
+                mn = a[i] < mn ? a[i] : mn;
+                mx = a[i] > mx ? a[i] : mx;
+            }
+            out_min = mn;
+            out_max = mx;
+        }
+
+        class bounds_task_t : public nparallel::task_t
+        {
+        public:
+            positions_t m_positions;
+            s32         m_parts;
+            n3d::box_t  m_boxes[c_max_parts];
+
+            virtual void execute(s32 index)
+            {
+                u64 begin, end;
+                nparallel::get_range(m_positions.m_count, m_parts, index, begin, end);
+                n3d::box_t& box = m_boxes[index];
+                n3d::box_empty(box);
+                min_max(m_positions.m_x, begin, end, box.m_min[0], box.m_max[0]);
+                min_max(m_positions.m_y, begin, end, box.m_min[1], box.m_max[1]);
+                min_max(m_positions.m_z, begin, end, box.m_min[2], box.m_max[2]);
+            }
+        };
+
+        n3d::box_t bounds(nparallel::scheduler_t* scheduler, positions_t const& positions)
+        {
+            scheduler = nparallel::get_scheduler(scheduler);
+            bounds_task_t task;
+            task.m_positions = positions;
+            task.m_parts     = get_parts(scheduler, positions.m_count);
+            scheduler->run(&task, task.m_parts);
+
+            n3d::box_t box;
+            n3d::box_empty(box);
+            for (s32 i = 0; i < task.m_parts; ++i)
+                n3d::box_extend(box, task.m_boxes[i]);
+            return box;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Transform
+        // ----------------------------------------------------------------------------------------
+
+        class transform_task_t : public nparallel::task_t
+        {
+        public:
+            matrix_t    m_matrix;
+            positions_t m_positions;
+            s32         m_parts;
+
+            virtual void execute(s32 index)
+            {
+                u64 begin, end;
+                nparallel::get_range(m_positions.m_count, m_parts, index, begin, end);
+
+                f32* const     x = m_positions.m_x;
+                f32* const     y = m_positions.m_y;
+                f32* const     z = m_positions.m_z;
+                matrix_t const& m = m_matrix;
+                u64            i = begin;
+#if defined(MESH_USE_AVX)
+                __m256 const m00 = _mm256_set1_ps(m.m[0][0]), m01 = _mm256_set1_ps(m.m[0][1]), m02 = _mm256_set1_ps(m.m[0][2]), m03 = _mm256_set1_ps(m.m[0][3]);
+                __m256 const m10 = _mm256_set1_ps(m.m[1][0]), m11 = _mm256_set1_ps(m.m[1][1]), m12 = _mm256_set1_ps(m.m[1][2]), m13 = _mm256_set1_ps(m.m[1][3]);
+                __m256 const m20 = _mm256_set1_ps(m.m[2][0]), m21 = _mm256_set1_ps(m.m[2][1]), m22 = _mm256_set1_ps(m.m[2][2]), m23 = _mm256_set1_ps(m.m[2][3]);
+                for (; (i + 8) <= end; i += 8)
+                {
+                    __m256 const vx = _mm256_loadu_ps(x + i);
+                    __m256 const vy = _mm256_loadu_ps(y + i);
+                    __m256 const vz = _mm256_loadu_ps(z + i);
+                    _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, vx), _mm256_mul_ps(m01, vy)), _mm256_add_ps(_mm256_mul_ps(m02, vz), m03)));
+                    _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, vx), _mm256_mul_ps(m11, vy)), _mm256_add_ps(_mm256_mul_ps(m12, vz), m13)));
+                    _mm256_storeu_ps(z + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m20, vx), _mm256_mul_ps(m21, vy)), _mm256_add_ps(_mm256_mul_ps(m22, vz), m23)));
+                }
+#elif defined(MESH_USE_SSE)
+                __m128 const m00 = _mm_set1_ps(m.m[0][0]), m01 = _mm_set1_ps(m.m[0][1]), m02 = _mm_set1_ps(m.m[0][2]), m03 = _mm_set1_ps(m.m[0][3]);
+                __m128 const m10 = _mm_set1_ps(m.m[1][0]), m11 = _mm_set1_ps(m.m[1][1]), m12 = _mm_set1_ps(m.m[1][2]), m13 = _mm_set1_ps(m.m[1][3]);
+                __m128 const m20 = _mm_set1_ps(m.m[2][0]), m21 = _mm_set1_ps(m.m[2][1]), m22 = _mm_set1_ps(m.m[2][2]), m23 = _mm_set1_ps(m.m[2][3]);
+                for (; (i + 4) <= end; i += 4)
+                {
+                    __m128 const vx = _mm_loadu_ps(x + i);
+                    __m128 const vy = _mm_loadu_ps(y + i);
+                    __m128 const vz = _mm_loadu_ps(z + i);
+                    _mm_storeu_ps(x + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, vx), _mm_mul_ps(m01, vy)), _mm_add_ps(_mm_mul_ps(m02, vz), m03)));
+                    _mm_storeu_ps(y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, vx), _mm_mul_ps(m11, vy)), _mm_add_ps(_mm_mul_ps(m12, vz), m13)));
+                    _mm_storeu_ps(z + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, vx), _mm_mul_ps(m21, vy)), _mm_add_ps(_mm_mul_ps(m22, vz), m23)));
+                }
+#endif
+                for (; i < end; ++i)
+                {
+                    f32 const vx = x[i];
+                    f32 const vy = y[i];
+                    f32 const vz = z[i];
+                    x[i]         = m.m[0][0] * vx + m.m[0][1] * vy + m.m[0][2] * vz + m.m[0][3];
+                    y[i]         = m.m[1][0] * vx + m.m[1][1] * vy + m.m[1][2] * vz + m.m[1][3];
+                    z[i]         = m.m[2][0] * vx + m.m[2][1] * vy + m.m[2][2] * vz + m.m[2][3];
+                }
+            }
+        };
+
+        void transform(nparallel::scheduler_t* scheduler, matrix_t const& matrix, positions_t& positions)
+        {
+            scheduler = nparallel::get_scheduler(scheduler);
+            transform_task_t task;
+            task.m_matrix    = matrix;
+            task.m_positions = positions;
+            task.m_parts     = get_parts(scheduler, positions.m_count);
+            scheduler->run(&task, task.m_parts);
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Volume and surface area, triangles index the positions so these are gathers, the
+        // partial sums are accumulated in double precision.
+        // ----------------------------------------------------------------------------------------
+
+        class triangle_sum_task_t : public nparallel::task_t
+        {
+        public:
+            positions_t             m_positions;
+            nply::triangle_t const* m_triangles;
+            u64                     m_triangle_count;
+            s32                     m_parts;
+            bool                    m_volume;
+            f64                     m_sums[c_max_parts];
+
+            virtual void execute(s32 index)
+            {
+                u64 begin, end;
+                nparallel::get_range(m_triangle_count, m_parts, index, begin, end);
+
+                f32 const* x   = m_positions.m_x;
+                f32 const* y   = m_positions.m_y;
+                f32 const* z   = m_positions.m_z;
+                f64        sum = 0.0;
+                for (u64 i = begin; i < end; ++i)
+                {
+                    nply::triangle_t const& t = m_triangles[i];
+                    f64 const               x1 = x[t.v1], y1 = y[t.v1], z1 = z[t.v1];
+                    f64 const               x2 = x[t.v2], y2 = y[t.v2], z2 = z[t.v2];
+                    f64 const               x3 = x[t.v3], y3 = y[t.v3], z3 = z[t.v3];
+                    if (m_volume)
+                    {
+                        sum += x1 * (y2 * z3 - y3 * z2) - x2 * (y1 * z3 - y3 * z1) + x3 * (y1 * z2 - y2 * z1);
+                    }
+                    else
+                    {
+                        f64 const ax = x2 - x1, ay = y2 - y1, az = z2 - z1;
+                        f64 const bx = x3 - x1, by = y3 - y1, bz = z3 - z1;
+                        f64 const cx = ay * bz - az * by;
+                        f64 const cy = az * bx - ax * bz;
+                        f64 const cz = ax * by - ay * bx;
+                        sum += sqrt(cx * cx + cy * cy + cz * cz);
+                    }
+                }
+                m_sums[index] = sum;
+            }
+        };
+
+        static f64 triangle_sum(nparallel::scheduler_t* scheduler, positions_t const& positions, nply::triangle_t const* triangles, u64 triangle_count, bool volume)
+        {
+            scheduler = nparallel::get_scheduler(scheduler);
+            triangle_sum_task_t task;
+            task.m_positions      = positions;
+            task.m_triangles      = triangles;
+            task.m_triangle_count = triangle_count;
+            task.m_parts          = get_parts(scheduler, triangle_count);
+            task.m_volume         = volume;
+            scheduler->run(&task, task.m_parts);
+
+            f64 sum = 0.0;
+            for (s32 i = 0; i < task.m_parts; ++i)
+                sum += task.m_sums[i];
+            return sum;
+        }
+
+        f64 signed_volume(nparallel::scheduler_t* scheduler, positions_t const& positions, nply::triangle_t const* triangles, u64 triangle_count) { return triangle_sum(scheduler, positions, triangles, triangle_count, true) / 6.0; }
+        f64 surface_area(nparallel::scheduler_t* scheduler, positions_t const& positions, nply::triangle_t const* triangles, u64 triangle_count) { return triangle_sum(scheduler, positions, triangles, triangle_count, false) / 2.0; }
+
+        // ----------------------------------------------------------------------------------------
+        // Fitting
+        // ----------------------------------------------------------------------------------------
+
+        matrix_t fit_inside_matrix(n3d::box_t const& current, n3d::box_t const& box, nply::vertex_t const& anchor)
+        {
+            f32 s = n3d::c_f32_max;
+            for (s32 i = 0; i < 3; ++i)
+            {
+                f32 const size = current.m_max[i] - current.m_min[i];
+                if (size > 0.0f)
+                {
+                    f32 const si = (box.m_max[i] - box.m_min[i]) / size;
+                    s            = si < s ? si : s;
+                }
+            }
+            if (s == n3d::c_f32_max)
+                s = 1.0f;
+
+            f32 const* a = &anchor.x;
+            nply::vertex_t to_origin, scaling, to_box;
+            to_origin.x = -current.m_min[0];
+            to_origin.y = -current.m_min[1];
+            to_origin.z = -current.m_min[2];
+            scaling.x   = s;
+            scaling.y   = s;
+            scaling.z   = s;
+            f32* dst    = &to_box.x;
+            for (s32 i = 0; i < 3; ++i)
+            {
+                f32 const extra = (box.m_max[i] - box.m_min[i]) - (current.m_max[i] - current.m_min[i]) * s;
+                dst[i]          = box.m_min[i] + extra * a[i];
+            }
+            return mul(translate(to_box), mul(scale(scaling), translate(to_origin)));
+        }
+
+        matrix_t fit_inside(nparallel::scheduler_t* scheduler, positions_t& positions, n3d::box_t const& box, nply::vertex_t const& anchor)
+        {
+            n3d::box_t const current = bounds(scheduler, positions);
+            if (n3d::box_is_empty(current))
+                return identity();
+            matrix_t const matrix = fit_inside_matrix(current, box, anchor);
+            transform(scheduler, matrix, positions);
+            return matrix;
+        }
+
+        matrix_t unit_cube(nparallel::scheduler_t* scheduler, positions_t& positions)
+        {
+            n3d::box_t box;
+            nply::vertex_t anchor;
+            for (s32 i = 0; i < 3; ++i)
+            {
+                box.m_min[i] = -0.5f;
+                box.m_max[i] = 0.5f;
+            }
+            anchor.x = anchor.y = anchor.z = 0.5f;
+            return fit_inside(scheduler, positions, box, anchor);
+        }
+
+    } // namespace nmesh
+} // namespace ncore
@@ -0,0 +1,538 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_meshlet.h"
+
+#include <math.h>
+
+namespace ncore
+{
+    namespace nmeshlet
+    {
+        const u8  c_no_slot      = 0xFF;
+        const u32 c_no_triangle  = 0xFFFFFFFF;
+        const f32 c_min_cone_dot = 0.1f; // narrower than this the cone is not worth testing
+
+        static void get_limits(config_t const& config, u32& max_vertices, u32& max_triangles)
+        {
+            max_vertices  = config.m_max_vertices < 3 ? 3 : config.m_max_vertices;
+            max_vertices  = max_vertices > (u32)MAX_VERTICES ? (u32)MAX_VERTICES : max_vertices;
+            max_triangles = config.m_max_triangles < 1 ? 1 : config.m_max_triangles;
+            max_triangles = max_triangles > (u32)MAX_TRIANGLES ? (u32)MAX_TRIANGLES : max_triangles;
+        }
+
+        // A meshlet is only closed when the next triangle does not fit, so every meshlet but the last
+        // one has max_triangles triangles or at least max_vertices - 2 vertices (a third of that in
+        // triangles). The output arrays are sized for that worst case.
+        static u32 get_max_meshlets(u32 triangle_count, u32 max_vertices, u32 max_triangles)
+        {
+            u32 min_triangles = max_vertices / 3;
+            if (min_triangles > max_triangles)
+                min_triangles = max_triangles;
+            return triangle_count / min_triangles + 1;
+        }
+
+        static bool alloc_meshlets(nply::allocator_t* allocator, mesh_t const& mesh, u32 max_vertices, u32 max_triangles, meshlets_t& meshlets)
+        {
+            u32 const max_meshlets = get_max_meshlets(mesh.m_triangle_count, max_vertices, max_triangles);
+            u64       vertex_refs  = (u64)max_meshlets * max_vertices;
+            if (vertex_refs > (u64)mesh.m_triangle_count * 3)
+                vertex_refs = (u64)mesh.m_triangle_count * 3;
+
+            meshlets.m_meshlets       = (meshlet_t*)allocator->alloc(sizeof(meshlet_t) * max_meshlets);
+            meshlets.m_vertices       = (u32*)allocator->alloc(sizeof(u32) * (vertex_refs + 1));
+            meshlets.m_triangles      = (u8*)allocator->alloc((u64)mesh.m_triangle_count * 3 + 1);
+            meshlets.m_meshlet_count  = 0;
+            meshlets.m_vertex_count   = 0;
+            meshlets.m_triangle_count = 0;
+            return meshlets.m_meshlets != nullptr && meshlets.m_vertices != nullptr && meshlets.m_triangles != nullptr;
+        }
+
+        static void free_meshlets(nply::allocator_t* allocator, meshlets_t& meshlets)
+        {
+            allocator->dealloc(meshlets.m_triangles);
+            allocator->dealloc(meshlets.m_vertices);
+            allocator->dealloc(meshlets.m_meshlets);
+            meshlets.m_meshlets       = nullptr;
+            meshlets.m_vertices       = nullptr;
+            meshlets.m_triangles      = nullptr;
+            meshlets.m_meshlet_count  = 0;
+            meshlets.m_vertex_count   = 0;
+            meshlets.m_triangle_count = 0;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Bounds
+        // ----------------------------------------------------------------------------------------
+
+        static inline f32 distance_sq(f32 const a[3], f32 const b[3])
+        {
+            f32 const dx = a[0] - b[0];
+            f32 const dy = a[1] - b[1];
+            f32 const dz = a[2] - b[2];
+            return dx * dx + dy * dy + dz * dz;
+        }
+
+        static inline void get_position(nply::vertex_t const& v, f32 p[3])
+        {
+            p[0] = v.x;
+            p[1] = v.y;
+            p[2] = v.z;
+        }
+
+        // Ritter's sphere: start from the widest pair of axis extremes and grow to include the rest
+        static void compute_sphere(mesh_t const& mesh, u32 const* vertices, u32 count, meshlet_t& meshlet)
+        {
+            u32 lo[3] = {vertices[0], vertices[0], vertices[0]};
+            u32 hi[3] = {vertices[0], vertices[0], vertices[0]};
+            for (u32 i = 1; i < count; ++i)
+            {
+                f32 p[3];
+                get_position(mesh.m_vertices[vertices[i]], p);
+                for (s32 a = 0; a < 3; ++a)
+                {
+                    f32 l[3], h[3];
+                    get_position(mesh.m_vertices[lo[a]], l);
+                    get_position(mesh.m_vertices[hi[a]], h);
+                    if (p[a] < l[a])
+                        lo[a] = vertices[i];
+                    if (p[a] > h[a])
+                        hi[a] = vertices[i];
+                }
+            }
+
+            f32 a[3], b[3];
+            f32 widest = -1.0f;
+            for (s32 axis = 0; axis < 3; ++axis)
+            {
+                f32 l[3], h[3];
+                get_position(mesh.m_vertices[lo[axis]], l);
+                get_position(mesh.m_vertices[hi[axis]], h);
+                f32 const d = distance_sq(l, h);
+                if (d > widest)
+                {
+                    widest = d;
+                    for (s32 k = 0; k < 3; ++k)
+                    {
+                        a[k] = l[k];
+                        b[k] = h[k];
+                    }
+                }
+            }
+
+            f32 center[3] = {(a[0] + b[0]) * 0.5f, (a[1] + b[1]) * 0.5f, (a[2] + b[2]) * 0.5f};
+            f32 radius    = sqrtf(widest) * 0.5f;
+            for (u32 i = 0; i < count; ++i)
+            {
+                f32 p[3];
+                get_position(mesh.m_vertices[vertices[i]], p);
+                f32 const d = sqrtf(distance_sq(p, center));
+                if (d > radius)
+                {
+                    f32 const grown = (radius + d) * 0.5f;
+                    f32 const t     = (grown - radius) / d;
+                    center[0]      += (p[0] - center[0]) * t;
+                    center[1]      += (p[1] - center[1]) * t;
+                    center[2]      += (p[2] - center[2]) * t;
+                    radius          = grown;
+                }
+            }
+
+            meshlet.m_center[0] = center[0];
+            meshlet.m_center[1] = center[1];
+            meshlet.m_center[2] = center[2];
+            meshlet.m_radius    = radius;
+        }
+
+        static bool get_normal(mesh_t const& mesh, nply::triangle_t const& tri, f32 n[3], f32 p0[3])
+        {
+            f32 p1[3], p2[3];
+            get_position(mesh.m_vertices[tri.v1], p0);
+            get_position(mesh.m_vertices[tri.v2], p1);
+            get_position(mesh.m_vertices[tri.v3], p2);
+            f32 const ux  = p1[0] - p0[0];
+            f32 const uy  = p1[1] - p0[1];
+            f32 const uz  = p1[2] - p0[2];
+            f32 const vx  = p2[0] - p0[0];
+            f32 const vy  = p2[1] - p0[1];
+            f32 const vz  = p2[2] - p0[2];
+            n[0]          = uy * vz - uz * vy;
+            n[1]          = uz * vx - ux * vz;
+            n[2]          = ux * vy - uy * vx;
+            f32 const len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (len == 0.0f)
+                return false;
+            n[0] /= len;
+            n[1] /= len;
+            n[2] /= len;
+            return true;
+        }
+
+        // The cone axis is the average normal and the cutoff the sine of the widest angle to it. The apex
+        // is moved back along the axis until it lies behind every triangle plane, so that the test also
+        // holds for a perspective eye close to the meshlet.
+        static void compute_cone(mesh_t const& mesh, u32 const* vertices, u8 const* triangles, u32 triangle_count, meshlet_t& meshlet)
+        {
+            meshlet.m_cone_apex[0] = meshlet.m_center[0];
+            meshlet.m_cone_apex[1] = meshlet.m_center[1];
+            meshlet.m_cone_apex[2] = meshlet.m_center[2];
+            meshlet.m_cone_axis[0] = 0.0f;
+            meshlet.m_cone_axis[1] = 0.0f;
+            meshlet.m_cone_axis[2] = 0.0f;
+            meshlet.m_cone_cutoff  = 2.0f;
+
+            f32 axis[3] = {0.0f, 0.0f, 0.0f};
+            for (u32 i = 0; i < triangle_count; ++i)
+            {
+                nply::triangle_t tri;
+                tri.v1 = vertices[triangles[i * 3 + 0]];
+                tri.v2 = vertices[triangles[i * 3 + 1]];
+                tri.v3 = vertices[triangles[i * 3 + 2]];
+                f32 n[3], p0[3];
+                if (get_normal(mesh, tri, n, p0))
+                {
+                    axis[0] += n[0];
+                    axis[1] += n[1];
+                    axis[2] += n[2];
+                }
+            }
+            f32 const len = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            if (len == 0.0f)
+                return;
+            axis[0] /= len;
+            axis[1] /= len;
+            axis[2] /= len;
+
+            f32 min_dot = 1.0f;
+            f32 max_t   = 0.0f;
+            for (u32 i = 0; i < triangle_count; ++i)
+            {
+                nply::triangle_t tri;
+                tri.v1 = vertices[triangles[i * 3 + 0]];
+                tri.v2 = vertices[triangles[i * 3 + 1]];
+                tri.v3 = vertices[triangles[i * 3 + 2]];
+                f32 n[3], p0[3];
+                if (!get_normal(mesh, tri, n, p0))
+                    continue;
+                f32 const d = n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2];
+                if (d < min_dot)
+                    min_dot = d;
+                if (d > 0.0f)
+                {
+                    f32 const t = ((meshlet.m_center[0] - p0[0]) * n[0] + (meshlet.m_center[1] - p0[1]) * n[1] + (meshlet.m_center[2] - p0[2]) * n[2]) / d;
+                    if (t > max_t)
+                        max_t = t;
+                }
+            }
+
+            meshlet.m_cone_axis[0] = axis[0];
+            meshlet.m_cone_axis[1] = axis[1];
+            meshlet.m_cone_axis[2] = axis[2];
+            if (min_dot < c_min_cone_dot)
+                return;
+            meshlet.m_cone_apex[0] = meshlet.m_center[0] - axis[0] * max_t;
+            meshlet.m_cone_apex[1] = meshlet.m_center[1] - axis[1] * max_t;
+            meshlet.m_cone_apex[2] = meshlet.m_center[2] - axis[2] * max_t;
+            meshlet.m_cone_cutoff  = sqrtf(1.0f - min_dot * min_dot);
+        }
+
+        bool is_backfacing(meshlet_t const& meshlet, f32 const eye[3])
+        {
+            f32 const dx  = meshlet.m_cone_apex[0] - eye[0];
+            f32 const dy  = meshlet.m_cone_apex[1] - eye[1];
+            f32 const dz  = meshlet.m_cone_apex[2] - eye[2];
+            f32 const len = sqrtf(dx * dx + dy * dy + dz * dz);
+            return dx * meshlet.m_cone_axis[0] + dy * meshlet.m_cone_axis[1] + dz * meshlet.m_cone_axis[2] >= meshlet.m_cone_cutoff * len;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Builder
+        // ----------------------------------------------------------------------------------------
+
+        struct builder_t
+        {
+            mesh_t const* m_mesh;
+            u32*          m_offsets;   // of the triangles of a vertex in m_adjacency
+            u32*          m_adjacency; // triangles of every vertex
+            u32*          m_live;      // triangles of a vertex that are not in a meshlet yet
+            u8*           m_emitted;   // per triangle
+            u8*           m_slots;     // local index of a vertex in the current meshlet
+            meshlets_t*   m_out;
+        };
+
+        static void build_adjacency(builder_t& b)
+        {
+            mesh_t const& mesh = *b.m_mesh;
+            for (u32 v = 0; v <= mesh.m_vertex_count; ++v)
+                b.m_offsets[v] = 0;
+            for (u32 t = 0; t < mesh.m_triangle_count; ++t)
+            {
+                nply::triangle_t const& tri = mesh.m_triangles[t];
+                b.m_offsets[tri.v1]++;
+                b.m_offsets[tri.v2]++;
+                b.m_offsets[tri.v3]++;
+            }
+            u32 sum = 0;
+            for (u32 v = 0; v < mesh.m_vertex_count; ++v)
+            {
+                u32 const n    = b.m_offsets[v];
+                b.m_offsets[v] = sum;
+                b.m_live[v]    = n;
+                sum           += n;
+            }
+            b.m_offsets[mesh.m_vertex_count] = sum;
+
+            // m_slots is not in use yet, fill the lists from the end with m_live as the cursor
+            for (u32 t = mesh.m_triangle_count; t > 0; --t)
+            {
+                nply::triangle_t const& tri = mesh.m_triangles[t - 1];
+                b.m_adjacency[b.m_offsets[tri.v1] + --b.m_live[tri.v1]] = t - 1;
+                b.m_adjacency[b.m_offsets[tri.v2] + --b.m_live[tri.v2]] = t - 1;
+                b.m_adjacency[b.m_offsets[tri.v3] + --b.m_live[tri.v3]] = t - 1;
+            }
+            for (u32 v = 0; v < mesh.m_vertex_count; ++v)
+            {
+                b.m_live[v]  = b.m_offsets[v + 1] - b.m_offsets[v];
+                b.m_slots[v] = c_no_slot;
+            }
+            for (u32 t = 0; t < mesh.m_triangle_count; ++t)
+                b.m_emitted[t] = 0;
+        }
+
+        // Number of vertices of the triangle that are not in the current meshlet
+        static inline u32 count_new(builder_t const& b, u32 t)
+        {
+            nply::triangle_t const& tri = b.m_mesh->m_triangles[t];
+            u32                     n   = b.m_slots[tri.v1] == c_no_slot ? 1 : 0;
+            if (b.m_slots[tri.v2] == c_no_slot && tri.v2 != tri.v1)
+                n++;
+            if (b.m_slots[tri.v3] == c_no_slot && tri.v3 != tri.v1 && tri.v3 != tri.v2)
+                n++;
+            return n;
+        }
+
+        // The triangle next to the meshlet that adds the fewest vertices
+        static u32 find_candidate(builder_t const& b, meshlet_t const& meshlet)
+        {
+            u32        best     = c_no_triangle;
+            u32        best_new = 4;
+            u32 const* vertices = b.m_out->m_vertices + meshlet.m_vertex_offset;
+            for (u32 i = 0; i < meshlet.m_vertex_count; ++i)
+            {
+                u32 const v = vertices[i];
+                if (b.m_live[v] == 0)
+                    continue;
+                for (u32 a = b.m_offsets[v]; a < b.m_offsets[v + 1]; ++a)
+                {
+                    u32 const t = b.m_adjacency[a];
+                    if (b.m_emitted[t])
+                        continue;
+                    u32 const n = count_new(b, t);
+                    if (n < best_new)
+                    {
+                        best     = t;
+                        best_new = n;
+                        if (n == 0)
+                            return best;
+                    }
+                }
+            }
+            return best;
+        }
+
+        static u8 add_vertex(builder_t& b, meshlet_t& meshlet, u32 v)
+        {
+            if (b.m_slots[v] == c_no_slot)
+            {
+                b.m_out->m_vertices[meshlet.m_vertex_offset + meshlet.m_vertex_count] = v;
+                b.m_slots[v]                                                          = (u8)meshlet.m_vertex_count;
+                meshlet.m_vertex_count++;
+            }
+            b.m_live[v]--;
+            return b.m_slots[v];
+        }
+
+        static void add_triangle(builder_t& b, meshlet_t& meshlet, u32 t)
+        {
+            nply::triangle_t const& tri   = b.m_mesh->m_triangles[t];
+            u8*                     local = b.m_out->m_triangles + (meshlet.m_triangle_offset + meshlet.m_triangle_count) * 3;
+            local[0]                      = add_vertex(b, meshlet, tri.v1);
+            local[1]                      = add_vertex(b, meshlet, tri.v2);
+            local[2]                      = add_vertex(b, meshlet, tri.v3);
+            meshlet.m_triangle_count++;
+            b.m_emitted[t] = 1;
+        }
+
+        static void close_meshlet(builder_t& b, meshlet_t& meshlet)
+        {
+            meshlets_t& out      = *b.m_out;
+            u32 const*  vertices = out.m_vertices + meshlet.m_vertex_offset;
+            compute_sphere(*b.m_mesh, vertices, meshlet.m_vertex_count, meshlet);
+            compute_cone(*b.m_mesh, vertices, out.m_triangles + meshlet.m_triangle_offset * 3, meshlet.m_triangle_count, meshlet);
+            for (u32 i = 0; i < meshlet.m_vertex_count; ++i)
+                b.m_slots[vertices[i]] = c_no_slot;
+
+            out.m_meshlet_count++;
+            out.m_vertex_count   += meshlet.m_vertex_count;
+            out.m_triangle_count += meshlet.m_triangle_count;
+        }
+
+        static meshlet_t& open_meshlet(builder_t& b)
+        {
+            meshlets_t& out           = *b.m_out;
+            meshlet_t&  meshlet       = out.m_meshlets[out.m_meshlet_count];
+            meshlet.m_vertex_offset   = out.m_vertex_count;
+            meshlet.m_triangle_offset = out.m_triangle_count;
+            meshlet.m_vertex_count    = 0;
+            meshlet.m_triangle_count  = 0;
+            return meshlet;
+        }
+
+        // Fill the (pre-allocated) output of one mesh, the temporary arrays come from 'temp'
+        static bool build_mesh(nply::allocator_t* temp, mesh_t const& mesh, u32 max_vertices, u32 max_triangles, meshlets_t& out)
+        {
+            for (u32 t = 0; t < mesh.m_triangle_count; ++t)
+            {
+                nply::triangle_t const& tri = mesh.m_triangles[t];
+                if (tri.v1 >= mesh.m_vertex_count || tri.v2 >= mesh.m_vertex_count || tri.v3 >= mesh.m_vertex_count)
+                    return false;
+            }
+
+            builder_t b;
+            b.m_mesh      = &mesh;
+            b.m_offsets   = (u32*)temp->alloc(sizeof(u32) * ((u64)mesh.m_vertex_count + 1));
+            b.m_adjacency = (u32*)temp->alloc(sizeof(u32) * ((u64)mesh.m_triangle_count * 3 + 1));
+            b.m_live      = (u32*)temp->alloc(sizeof(u32) * ((u64)mesh.m_vertex_count + 1));
+            b.m_emitted   = (u8*)temp->alloc((u64)mesh.m_triangle_count + 1);
+            b.m_slots     = (u8*)temp->alloc((u64)mesh.m_vertex_count + 1);
+            b.m_out       = &out;
+
+            bool const ok = b.m_offsets != nullptr && b.m_adjacency != nullptr && b.m_live != nullptr && b.m_emitted != nullptr && b.m_slots != nullptr;
+            if (ok)
+            {
+                build_adjacency(b);
+
+                u32        cursor  = 0; // triangles in front of it are all in a meshlet
+                meshlet_t* meshlet = &open_meshlet(b);
+                while (true)
+                {
+                    u32 t = find_candidate(b, *meshlet);
+                    if (t == c_no_triangle)
+                    {
+                        // nothing connected is left, continue in file order
+                        while (cursor < mesh.m_triangle_count && b.m_emitted[cursor])
+                            cursor++;
+                        if (cursor == mesh.m_triangle_count)
+                            break;
+                        t = cursor;
+                    }
+                    if (meshlet->m_triangle_count == max_triangles || meshlet->m_vertex_count + count_new(b, t) > max_vertices)
+                    {
+                        close_meshlet(b, *meshlet);
+                        meshlet = &open_meshlet(b);
+                    }
+                    add_triangle(b, *meshlet, t);
+                }
+                if (meshlet->m_triangle_count > 0)
+                    close_meshlet(b, *meshlet);
+            }
+
+            temp->dealloc(b.m_slots);
+            temp->dealloc(b.m_emitted);
+            temp->dealloc(b.m_live);
+            temp->dealloc(b.m_adjacency);
+            temp->dealloc(b.m_offsets);
+            return ok;
+        }
+
+        bool build(nply::allocator_t* allocator, mesh_t const& mesh, config_t const& config, meshlets_t& meshlets)
+        {
+            u32 max_vertices, max_triangles;
+            get_limits(config, max_vertices, max_triangles);
+            if (!alloc_meshlets(allocator, mesh, max_vertices, max_triangles, meshlets) || !build_mesh(allocator, mesh, max_vertices, max_triangles, meshlets))
+            {
+                free_meshlets(allocator, meshlets);
+                return false;
+            }
+            return true;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Many meshes
+        // ----------------------------------------------------------------------------------------
+
+        // Meshes differ a lot in size, so a task takes the next mesh when it is done with one instead
+        // of working on a fixed range
+        class meshes_task_t : public nparallel::task_t
+        {
+        public:
+            nply::scratch_t* m_scratch;
+            mesh_t const*    m_meshes;
+            u32              m_mesh_count;
+            u32              m_max_vertices;
+            u32              m_max_triangles;
+            meshlets_t*      m_meshlets;
+            u64 volatile     m_next;
+            u64 volatile     m_errors;
+
+            virtual void execute(s32 index)
+            {
+                nply::arena_t* temp = m_scratch->get(index);
+                while (true)
+                {
+                    u64 const i = nparallel::atomic_add(&m_next, 1);
+                    if (i >= m_mesh_count)
+                        break;
+                    nply::arena_t::marker_t const marker = temp->mark();
+                    if (!build_mesh(temp, m_meshes[i], m_max_vertices, m_max_triangles, m_meshlets[i]))
+                    {
+                        m_meshlets[i].m_meshlet_count  = 0;
+                        m_meshlets[i].m_vertex_count   = 0;
+                        m_meshlets[i].m_triangle_count = 0;
+                        nparallel::atomic_add(&m_errors, 1);
+                    }
+                    temp->rewind(marker);
+                }
+            }
+        };
+
+        bool build(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, nply::scratch_t* scratch, mesh_t const* meshes, u32 mesh_count, config_t const& config, meshlets_t* meshlets)
+        {
+            u32 max_vertices, max_triangles;
+            get_limits(config, max_vertices, max_triangles);
+
+            for (u32 i = 0; i < mesh_count; ++i)
+            {
+                if (!alloc_meshlets(allocator, meshes[i], max_vertices, max_triangles, meshlets[i]))
+                {
+                    for (u32 j = 0; j <= i; ++j)
+                        free_meshlets(allocator, meshlets[j]);
+                    return false;
+                }
+            }
+
+            scheduler = nparallel::get_scheduler(scheduler);
+            s32 parts = scheduler->concurrency();
+            if (parts > scratch->get_count())
+                parts = scratch->get_count();
+            if (parts > (s32)mesh_count)
+                parts = (s32)mesh_count;
+
+            meshes_task_t task;
+            task.m_scratch       = scratch;
+            task.m_meshes        = meshes;
+            task.m_mesh_count    = mesh_count;
+            task.m_max_vertices  = max_vertices;
+            task.m_max_triangles = max_triangles;
+            task.m_meshlets      = meshlets;
+            task.m_next          = 0;
+            task.m_errors        = 0;
+            if (parts > 0)
+                scheduler->run(&task, parts);
+
+            for (s32 i = 0; i < parts; ++i)
+                scratch->get(i)->reset();
+            return task.m_errors == 0;
+        }
+
+    } // namespace nmeshlet
+} // namespace ncore
@@ -0,0 +1,70 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_parallel.h"
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#    include <emmintrin.h>
+#    define PARALLEL_USE_SSE
+#endif
+
+namespace ncore
+{
+    namespace nparallel
+    {
+        class serial_scheduler_t : public scheduler_t
+        {
+        public:
+            virtual s32 concurrency() { return 1; }
+            virtual void run(task_t* task, s32 count)
+            {
+                for (s32 i = 0; i < count; ++i)
+                    task->execute(i);
+            }
+        };
+
+        u64 atomic_add(u64 volatile* counter, u64 value)
+        {
+#if defined(_MSC_VER)
+            return (u64)_InterlockedExchangeAdd64((__int64 volatile*)counter, (__int64)value);
+#else
+            return __atomic_fetch_add(counter, value, __ATOMIC_ACQ_REL);
+#endif
+        }
+
+        u64 atomic_cas(u64 volatile* value, u64 expected, u64 desired)
+        {
+#if defined(_MSC_VER)
+            return (u64)_InterlockedCompareExchange64((__int64 volatile*)value, (__int64)desired, (__int64)expected);
+#else
+            __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+            return expected;
+#endif
+        }
+
+        void spinlock_t::lock()
+        {
+            while (atomic_cas(&m_state, 0, 1) != 0)
+            {
+                while (m_state != 0)
+                {
+#if defined(PARALLEL_USE_SSE)
+                    _mm_pause();
+#endif
+                }
+            }
+        }
+
+        void spinlock_t::unlock() { atomic_cas(&m_state, 1, 0); }
+
+        scheduler_t* get_serial_scheduler()
+        {
+            static serial_scheduler_t s_serial_scheduler;
+            return &s_serial_scheduler;
+        }
+
+    } // namespace nparallel
+} // namespace ncore
@@ -2,20 +2,147 @@
 #include "ccore/c_debug.h"
 #include "c3dff/c_ply.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#    include <emmintrin.h>
+#    define PLY_USE_SSE
+#endif
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
 namespace ncore
 {
     namespace nply
     {
-        const char* g_ReadLine(const char* text_cursor, const char* text_end, const char*& str, const char*& end)
+        // ----------------------------------------------------------------------------------------
+        // Scanning
+        // ----------------------------------------------------------------------------------------
+
+        // Text is scanned 16 bytes at a time: a block is compared against the characters of
+        // interest and turned into a bit mask (bit i = byte i), boundaries are then found with bit
+        // operations instead of a branch per byte. The remainder of a buffer is scanned per byte.
+
+        static inline u32 count_trailing_zeros(u32 mask)
         {
-            str = text_cursor;
-            end = text_cursor;
-            while (*end != '\n' && *end != '\r' && end < text_end)
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return (u32)index;
+#else
+            return (u32)__builtin_ctz(mask);
+#endif
+        }
+
+        static inline bool is_space(char c) { return c == ' ' || c == '\t'; }
+
+#if defined(PLY_USE_SSE)
+        static inline u32 newline_mask(const char* block)
+        {
+            __m128i const b = _mm_loadu_si128((__m128i const*)block);
+            return (u32)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(b, _mm_set1_epi8('\r'))));
+        }
+
+        static inline u32 space_mask(const char* block)
+        {
+            __m128i const b = _mm_loadu_si128((__m128i const*)block);
+            return (u32)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(b, _mm_set1_epi8('\t'))));
+        }
+#endif
+
+        static inline const char* find_newline(const char* str, const char* end)
+        {
+#if defined(PLY_USE_SSE)
+            for (; end - str >= 16; str += 16)
             {
-                end++;
+                u32 const mask = newline_mask(str);
+                if (mask != 0)
+                    return str + count_trailing_zeros(mask);
+            }
+#endif
+            while (str < end && *str != '\n' && *str != '\r')
+                str++;
+            return str;
+        }
+
+        // The first character that is (not) a space or a tab
+        static inline const char* find_space(const char* str, const char* end, bool space)
+        {
+#if defined(PLY_USE_SSE)
+            u32 const invert = space ? 0 : 0xFFFF;
+            for (; end - str >= 16; str += 16)
+            {
+                u32 const mask = space_mask(str) ^ invert;
+                if (mask != 0)
+                    return str + count_trailing_zeros(mask);
+            }
+#endif
+            while (str < end && is_space(*str) != space)
+                str++;
+            return str;
+        }
+
+        // Index the tokens of a line in one pass, writes the (begin, end) offsets of up to 'max_tokens'
+        // tokens and returns the number of tokens in the line. The starts of the tokens are the bytes
+        // that are not a space but follow one, the ends are the spaces that follow a token.
+        static u32 index_tokens(const char* str, const char* end, u32* offsets, u32 max_tokens)
+        {
+            u32         starts = 0;
+            u32         ends   = 0;
+            u32         prev   = 1; // a space in front of the line
+            const char* cursor = str;
+#if defined(PLY_USE_SSE)
+            for (; end - cursor >= 16; cursor += 16)
+            {
+                u32 const space   = space_mask(cursor);
+                u32 const shifted = (space << 1) | prev; // bit i = byte i - 1 is a space
+                u32       begin   = ~space & shifted & 0xFFFF;
+                u32       finish  = space & ~shifted & 0xFFFF;
+                prev              = space >> 15;
+                u32 const base    = (u32)(cursor - str);
+                for (; begin != 0; begin &= begin - 1, ++starts)
+                {
+                    if (starts < max_tokens)
+                        offsets[starts * 2] = base + count_trailing_zeros(begin);
+                }
+                for (; finish != 0; finish &= finish - 1, ++ends)
+                {
+                    if (ends < max_tokens)
+                        offsets[ends * 2 + 1] = base + count_trailing_zeros(finish);
+                }
+            }
+#endif
+            for (; cursor < end; ++cursor)
+            {
+                u32 const space = is_space(*cursor) ? 1 : 0;
+                if (space == 0 && prev != 0)
+                {
+                    if (starts < max_tokens)
+                        offsets[starts * 2] = (u32)(cursor - str);
+                    starts++;
+                }
+                else if (space != 0 && prev == 0)
+                {
+                    if (ends < max_tokens)
+                        offsets[ends * 2 + 1] = (u32)(cursor - str);
+                    ends++;
+                }
+                prev = space;
             }
+            if (ends < starts && ends < max_tokens)
+                offsets[ends * 2 + 1] = (u32)(end - str);
+            return starts;
+        }
+
+        const char* g_ReadLine(const char* text_cursor, const char* text_end, const char*& str, const char*& end)
+        {
+            str = text_cursor;
+            end = find_newline(text_cursor, text_end);
+            // consume exactly one line terminator, binary data may directly follow 'end_header'
             text_cursor = end;
-            while ((*text_cursor == '\n' || *text_cursor == '\r') && text_cursor < text_end)
+            if (text_cursor < text_end && *text_cursor == '\r')
+                text_cursor++;
+            if (text_cursor < text_end && *text_cursor == '\n')
                 text_cursor++;
             return text_cursor;
         }
@@ -142,15 +269,15 @@ namespace ncore
 
         struct buffer_t
         {
-            u32 m_size; // size in bytes
+            u64 m_size; // size in bytes
             u8* m_buffer;
         };
 
         struct element_t
         {
             string_t     m_name;
-            u32          m_index;
-            u32          m_count;
+            s32          m_index; // passed to the handlers, < 0 = skip this element
+            u64          m_count;
             s32          m_prop_count;
             property_t** m_prop_array;
             etype*       m_prop_type_array;
@@ -170,13 +297,6 @@ namespace ncore
             comment_t* m_next;
         };
 
-        enum eformat
-        {
-            FORMAT_ASCII = 0, // ASCII
-            FORMAT_BLE,       // Binary Little Endian
-            FORMAT_BBE,       // Binary Big Endian
-        };
-
         struct header_t
         {
             eformat    m_format;
@@ -196,18 +316,107 @@ namespace ncore
             comment_t*   m_comments;
             objinfo_t*   m_obj_info;
             element_t*   m_elements;
+            ticker_t*    m_ticker; // nullptr = no statistics
+            stats_t      m_stats;
+            error_t      m_error;
+            u32          m_validate;
+            u64          m_header_size; // bytes, including the line end of 'end_header'
         };
 
+        static bool set_error(ply_t* ply, eerror kind, s32 element, u64 record, u64 offset)
+        {
+            ply->m_error.m_kind    = kind;
+            ply->m_error.m_element = element;
+            ply->m_error.m_record  = record;
+            ply->m_error.m_offset  = offset;
+            return false;
+        }
+
+        static inline bool stats_enabled(ply_t const* ply)
+        {
+#ifdef C3DFF_DISABLE_STATS
+            return false;
+#else
+            return ply->m_ticker != nullptr;
+#endif
+        }
+
         ply_t* create(allocator_t* allocator)
         {
-            ply_t* ply      = construct<ply_t>(allocator);
+            ply_t* ply = construct<ply_t>(allocator);
+            if (ply == nullptr)
+                return nullptr;
             ply->m_alloc    = allocator;
             ply->m_hdr      = nullptr;
             ply->m_comments = nullptr;
+            ply->m_obj_info = nullptr;
             ply->m_elements = nullptr;
+            ply->m_ticker   = nullptr;
+            reset_stats(ply);
+            set_error(ply, ERROR_NONE, -1, 0, 0);
+            ply->m_validate    = VALIDATE_NONE;
+            ply->m_header_size = 0;
             return ply;
         }
 
+        error_t const& get_error(ply_t const* ply) { return ply->m_error; }
+
+        const char* get_error_name(eerror kind)
+        {
+            switch (kind)
+            {
+                case ERROR_NONE: return "none";
+                case ERROR_NOT_PLY: return "not a ply file";
+                case ERROR_HEADER: return "malformed header";
+                case ERROR_FORMAT: return "unknown format";
+                case ERROR_TYPE: return "unknown property type";
+                case ERROR_TRUNCATED: return "truncated file";
+                case ERROR_VALUE: return "malformed value";
+                case ERROR_MEMORY: return "out of memory";
+                case ERROR_INDEX: return "index out of range";
+                case ERROR_NOT_FINITE: return "NaN or Inf";
+            }
+            return "unknown";
+        }
+
+        void set_validation(ply_t* ply, u32 validate_flags) { ply->m_validate = validate_flags; }
+
+        void enable_stats(ply_t* ply, ticker_t* ticker)
+        {
+#ifndef C3DFF_DISABLE_STATS
+            ply->m_ticker = ticker;
+#endif
+            reset_stats(ply);
+        }
+
+        void reset_stats(ply_t* ply)
+        {
+            stats_t& stats = ply->m_stats;
+            for (s32 i = 0; i < stats_t::PHASE_COUNT; i++)
+                stats.m_ticks[i] = 0;
+            stats.m_frequency     = ply->m_ticker != nullptr ? ply->m_ticker->frequency() : 0;
+            stats.m_bytes_read    = 0;
+            stats.m_bytes_skipped = 0;
+            stats.m_reader_calls  = 0;
+            stats.m_items_decoded = 0;
+            stats.m_items_skipped = 0;
+        }
+
+        stats_t const* get_stats(ply_t const* ply) { return stats_enabled(ply) ? &ply->m_stats : nullptr; }
+
+        void add_stats(stats_t& dst, stats_t const& src)
+        {
+            for (s32 i = 0; i < stats_t::PHASE_COUNT; i++)
+                dst.m_ticks[i] += src.m_ticks[i];
+            if (dst.m_frequency == 0)
+                dst.m_frequency = src.m_frequency;
+            dst.m_bytes_read += src.m_bytes_read;
+            dst.m_bytes_skipped += src.m_bytes_skipped;
+            dst.m_reader_calls += src.m_reader_calls;
+            dst.m_items_decoded += src.m_items_decoded;
+            dst.m_items_skipped += src.m_items_skipped;
+        }
+
         static void add_comment(ply_t* ply, comment_t* comment)
         {
             comment->m_next = nullptr;
@@ -220,34 +429,53 @@ namespace ncore
                 ply->m_comments->m_next = comment;
             }
             ply->m_comments = comment;
+            ply->m_hdr->m_num_comments++;
         }
 
-        static void skip_whitespace(string_t& line)
+        static void add_obj_info(ply_t* ply, objinfo_t* obj_info)
         {
-            while (line.m_str < line.m_end)
+            obj_info->m_next = nullptr;
+            if (ply->m_hdr->m_obj_info == nullptr)
             {
-                if (line.m_str[0] != ' ' && line.m_str[0] != '\t')
-                    break;
-                line.m_str++;
+                ply->m_hdr->m_obj_info = obj_info;
+            }
+            else
+            {
+                ply->m_obj_info->m_next = obj_info;
+            }
+            ply->m_obj_info = obj_info;
+            ply->m_hdr->m_num_obj_info++;
+        }
+
+        static void add_element(ply_t* ply, element_t* element)
+        {
+            element->m_next  = nullptr;
+            element->m_index = (s32)ply->m_hdr->m_num_elements;
+            if (ply->m_hdr->m_elements == nullptr)
+            {
+                ply->m_hdr->m_elements = element;
+            }
+            else
+            {
+                ply->m_elements->m_next = element;
             }
+            ply->m_elements = element;
+            ply->m_hdr->m_num_elements++;
         }
 
+        static void skip_whitespace(string_t& line) { line.m_str = find_space(line.m_str, line.m_end, false); }
+
         static string_t read_token(string_t& line)
         {
             skip_whitespace(line);
             const char* token = line.m_str;
-            while (line.m_str < line.m_end)
-            {
-                if (line.m_str[0] == ' ' || line.m_str[0] == '\t')
-                    break;
-                line.m_str++;
-            }
+            line.m_str        = find_space(line.m_str, line.m_end, true);
             return string_t(token, line.m_str);
         }
 
-        static u32 parse_u32(string_t const& token)
+        static u64 parse_u64(string_t const& token)
         {
-            u32         v   = 0;
+            u64         v   = 0;
             const char* str = token.m_str;
             while (str < token.m_end)
             {
@@ -280,7 +508,7 @@ namespace ncore
             add_comment(ply, comment);
         }
 
-        void read_header_format(ply_t* ply, string_t& line)
+        bool read_header_format(ply_t* ply, string_t& line)
         {
             string_t token = read_token(line);
             if (token == "ascii")
@@ -289,19 +517,28 @@ namespace ncore
                 ply->m_hdr->m_format = FORMAT_BLE;
             else if (token == "binary_big_endian")
                 ply->m_hdr->m_format = FORMAT_BBE;
+            else
+                return false;
             string_t version_str  = read_token(line);
             ply->m_hdr->m_version = make_string(ply, version_str);
+            return true;
         }
 
         element_t* read_header_element(ply_t* ply, string_t& line)
         {
+            string_t const name_str  = read_token(line);
+            string_t const str_count = read_token(line);
+            if (name_str.is_empty() || str_count.is_empty())
+                return nullptr;
             element_t* elem     = construct<element_t>(ply->m_alloc);
-            string_t   name_str = read_token(line);
             elem->m_name        = make_string(ply, name_str);
-            string_t str_count  = read_token(line);
-            elem->m_count       = parse_u32(str_count);
-            elem->m_prop_array  = nullptr;
+            elem->m_count       = parse_u64(str_count);
             elem->m_prop_count  = 0;
+            elem->m_prop_array  = nullptr;
+            elem->m_next        = nullptr;
+
+            elem->m_prop_type_array  = nullptr;
+            elem->m_prop_index_array = nullptr;
             return elem;
         }
 
@@ -328,14 +565,47 @@ namespace ncore
             return prop;
         }
 
+        // e.g. 'obj_info num_cols 640', kept as a line of text like a comment
         void read_header_obj_info(ply_t* ply, string_t& line)
         {
-            // @todo: need information, haven't seen any .ply files with this
+            objinfo_t* obj_info = construct<objinfo_t>(ply->m_alloc);
+            skip_whitespace(line);
+            obj_info->m_comment = make_string(ply, line);
+            add_obj_info(ply, obj_info);
         }
 
+        static bool parse_header(ply_t* ply, reader_t* reader);
+
         bool read_header(ply_t* ply, reader_t* reader)
+        {
+            if (!stats_enabled(ply))
+                return parse_header(ply, reader);
+            u64 const start = ply->m_ticker->ticks();
+            bool const ok   = parse_header(ply, reader);
+            ply->m_stats.m_ticks[stats_t::PHASE_HEADER] += ply->m_ticker->ticks() - start;
+            return ok;
+        }
+
+        static inline bool header_line(reader_t* reader, string_t& line, u64& offset)
+        {
+            if (!reader->read_line(line.m_str, line.m_end))
+                return false;
+            offset += (u64)(line.m_end - line.m_str) + reader->line_end_size();
+            return true;
+        }
+
+        static inline bool is_valid_property(property_t const* prop)
+        {
+            if (type_is_list(prop->m_property_type))
+                return type_sizeof(prop->m_property_type) > 0 && type_sizeof(prop->m_list_count_type) > 0;
+            return type_sizeof(prop->m_property_type) > 0;
+        }
+
+        static bool parse_header(ply_t* ply, reader_t* reader)
         {
             ply->m_hdr                 = construct<header_t>(ply->m_alloc);
+            if (ply->m_hdr == nullptr)
+                return set_error(ply, ERROR_MEMORY, -1, 0, 0);
             ply->m_hdr->m_format       = FORMAT_ASCII;
             ply->m_hdr->m_version      = string_t();
             ply->m_hdr->m_num_comments = 0;
@@ -344,18 +614,31 @@ namespace ncore
             ply->m_hdr->m_comments     = nullptr;
             ply->m_hdr->m_obj_info     = nullptr;
             ply->m_hdr->m_elements     = nullptr;
+            set_error(ply, ERROR_NONE, -1, 0, 0);
 
             element_t* element = nullptr;
+            u64        offset  = 0; // of the start of the next line
+            bool       magic   = false;
 
             string_t line;
-            while (reader->read_line(line.m_str, line.m_end))
+            while (true)
             {
-                string_t token = read_token(line);
+                u64 line_offset = offset; // of the line that holds 'token'
+                if (!header_line(reader, line, offset))
+                    return set_error(ply, magic ? ERROR_TRUNCATED : ERROR_NOT_PLY, -1, 0, offset);
 
-                if (token == "ply" || token.is_empty())
+                string_t token = read_token(line);
+                if (token.is_empty())
                 {
                     continue;
                 }
+                if (!magic)
+                {
+                    if (token != "ply")
+                        return set_error(ply, ERROR_NOT_PLY, -1, 0, line_offset);
+                    magic = true;
+                    continue;
+                }
 
                 while (true)
                 {
@@ -365,38 +648,58 @@ namespace ncore
                     }
                     else if (token == "format")
                     {
-                        read_header_format(ply, line);
+                        if (!read_header_format(ply, line))
+                            return set_error(ply, ERROR_FORMAT, -1, 0, line_offset);
                     }
                     else if (token == "element")
                     {
                         element = read_header_element(ply, line);
+                        if (element == nullptr)
+                            return set_error(ply, ERROR_HEADER, -1, 0, line_offset);
+                        add_element(ply, element);
                     }
                     else if (token == "property")
                     {
-                        ASSERT(element != nullptr);
+                        if (element == nullptr)
+                            return set_error(ply, ERROR_HEADER, -1, 0, line_offset);
 
-                        // TODO: need to make this dynamic?
-                        property_t* properties[32];
-                        s32         prop_count = 0;
+                        // scans can have many properties per element, grow the array when needed
+                        s32          prop_max   = 32;
+                        s32          prop_count = 0;
+                        property_t** properties = (property_t**)ply->m_alloc->alloc(sizeof(property_t*) * prop_max);
                         do
                         {
-                            properties[prop_count++] = read_header_property(ply, element, line);
+                            if (prop_count == prop_max)
+                            {
+                                property_t** grown = (property_t**)ply->m_alloc->alloc(sizeof(property_t*) * prop_max * 2);
+                                for (s32 i = 0; i < prop_count; i++)
+                                    grown[i] = properties[i];
+                                ply->m_alloc->dealloc(properties);
+                                properties = grown;
+                                prop_max *= 2;
+                            }
+                            property_t* prop = read_header_property(ply, element, line);
+                            if (!is_valid_property(prop))
+                                return set_error(ply, ERROR_TYPE, -1, 0, line_offset);
+                            if (prop->m_name.is_empty())
+                                return set_error(ply, ERROR_HEADER, -1, 0, line_offset);
+                            properties[prop_count++] = prop;
                             do
                             {
-                                if (!reader->read_line(line.m_str, line.m_end))
-                                    return false;
+                                line_offset = offset;
+                                if (!header_line(reader, line, offset))
+                                    return set_error(ply, ERROR_TRUNCATED, -1, 0, offset);
                                 token = read_token(line);
                             } while (token.is_empty());
                         } while (token == "property");
 
                         element->m_prop_count       = prop_count;
-                        element->m_prop_array       = (property_t**)ply->m_alloc->alloc(sizeof(property_t*) * prop_count);
+                        element->m_prop_array       = properties;
                         element->m_prop_type_array  = (etype*)ply->m_alloc->alloc(sizeof(etype) * prop_count);
                         element->m_prop_index_array = (s32*)ply->m_alloc->alloc(sizeof(s32) * prop_count);
                         for (s32 i = 0; i < prop_count; i++)
                         {
                             property_t* prop               = properties[i];
-                            element->m_prop_array[i]       = prop;
                             element->m_prop_type_array[i]  = prop->m_property_type;
                             element->m_prop_index_array[i] = i;
                         }
@@ -406,17 +709,21 @@ namespace ncore
                     {
                         read_header_obj_info(ply, line);
                     }
+                    else if (token == "end_header")
+                    {
+                        ply->m_header_size = offset;
+                        return true;
+                    }
                     else
                     {
-                        return (token == "end_header");
+                        return set_error(ply, ERROR_HEADER, -1, 0, line_offset);
                     }
                     break;
                 }
             }
-            return false;
         }
 
-        u32 get_element_count(ply_t* ply, const char* element_name)
+        u64 get_element_count(ply_t* ply, const char* element_name)
         {
             element_t* elem = ply->m_hdr->m_elements;
             while (elem != nullptr)
@@ -442,7 +749,56 @@ namespace ncore
             }
         }
 
-        bool set_property_index(ply_t* ply, const char* element_name, const char* property_name, s32 index) { return false; }
+
+        static element_t* find_element(ply_t* ply, const char* element_name)
+        {
+            element_t* elem = ply->m_hdr->m_elements;
+            while (elem != nullptr)
+            {
+                if (elem->m_name == element_name)
+                    return elem;
+                elem = elem->m_next;
+            }
+            return nullptr;
+        }
+
+        bool set_property_index(ply_t* ply, const char* element_name, const char* property_name, s32 index)
+        {
+            element_t* elem = find_element(ply, element_name);
+            if (elem == nullptr)
+                return false;
+            for (s32 i = 0; i < elem->m_prop_count; i++)
+            {
+                if (elem->m_prop_array[i]->m_name == property_name)
+                {
+                    elem->m_prop_index_array[i] = index;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool select_properties(ply_t* ply, const char* element_name, const char** property_names, s32 property_count)
+        {
+            element_t* elem = find_element(ply, element_name);
+            if (elem == nullptr)
+                return false;
+            s32 found = 0;
+            for (s32 i = 0; i < elem->m_prop_count; i++)
+            {
+                elem->m_prop_index_array[i] = INDEX_NONE;
+                for (s32 j = 0; j < property_count; j++)
+                {
+                    if (elem->m_prop_array[i]->m_name == property_names[j])
+                    {
+                        elem->m_prop_index_array[i] = j;
+                        found++;
+                        break;
+                    }
+                }
+            }
+            return found == property_count;
+        }
 
         static inline void trim_whitespace(const char*& str, const char*& end)
         {
@@ -457,6 +813,8 @@ namespace ncore
             const char* str = _str.m_str;
             const char* end = _str.m_end;
             trim_whitespace(str, end);
+            if (str < end && *str == '+')
+                str++;
             u64 v = 0;
             while (str < end)
             {
@@ -470,7 +828,7 @@ namespace ncore
         static s64 parse_int(string_t const& _str)
         {
             string_t   str    = _str;
-            const char prefix = *str.m_str;
+            const char prefix = str.is_empty() ? 0 : *str.m_str;
             if (prefix == '-' || prefix == '+')
                 str.m_str++;
             s64 const v = (s64)parse_uint(str);
@@ -479,230 +837,1273 @@ namespace ncore
             return v;
         }
 
-        static f32 parse_float32(string_t const& str)
+        static const f64 c_pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+        static bool match_word(const char* str, const char* end, const char* word)
         {
-            string_t intpart(str.m_str, str.m_str);
-            string_t decpart(str.m_str, str.m_end);
-            trim_whitespace(intpart.m_str, decpart.m_end);
-            while (intpart.m_end < decpart.m_end)
+            for (; *word != 0; ++str, ++word)
             {
-                if (*intpart.m_end == '.')
-                {
-                    decpart.m_str = intpart.m_end + 1;
-                    break;
-                }
-                intpart.m_end++;
+                if (str == end || (*str | 0x20) != *word)
+                    return false;
             }
-            u64 const intvalue = parse_int(intpart);
-            u64 const decvalue = parse_int(decpart);
-            f32 const fint     = (f32)intvalue;
-            f32 const fdec     = (f32)decvalue / (f32)(decpart.length() * 10);
-            return fint + fdec;
+            return str == end;
+        }
+
+        // [+-]nan, [+-]inf and [+-]infinity in any case, as printf writes them
+        static bool parse_non_finite(const char* str, const char* end, f64& v)
+        {
+            bool negative = false;
+            if (str < end && (*str == '-' || *str == '+'))
+                negative = (*str++ == '-');
+
+            u64 bits;
+            if (match_word(str, end, "nan"))
+                bits = 0x7FF8000000000000ull;
+            else if (match_word(str, end, "inf") || match_word(str, end, "infinity"))
+                bits = 0x7FF0000000000000ull;
+            else
+                return false;
+            if (negative)
+                bits |= 0x8000000000000000ull;
+
+            u8 const* src = (u8 const*)&bits;
+            u8*       dst = (u8*)&v;
+            for (u32 i = 0; i < sizeof(f64); i++)
+                dst[i] = src[i];
+            return true;
         }
 
-        static f64 parse_float64(string_t const& str)
+        // Parses [+-]digits[.digits][(e|E)[+-]digits] and the non-finite words above
+        static f64 parse_float(string_t const& _str)
         {
-            string_t intpart(str.m_str, str.m_str);
-            string_t decpart(str.m_str, str.m_end);
-            trim_whitespace(intpart.m_str, decpart.m_end);
-            while (intpart.m_end < decpart.m_end)
+            const char* str = _str.m_str;
+            const char* end = _str.m_end;
+            trim_whitespace(str, end);
+
+            f64 non_finite;
+            if (parse_non_finite(str, end, non_finite))
+                return non_finite;
+
+            bool negative = false;
+            if (str < end && (*str == '-' || *str == '+'))
+                negative = (*str++ == '-');
+
+            u64 mantissa = 0;
+            s32 exponent = 0;
+            s32 digits   = 0;
+            while (str < end && *str >= '0' && *str <= '9')
             {
-                if (*intpart.m_end == '.')
+                if (digits < 19)
                 {
-                    decpart.m_str = intpart.m_end + 1;
-                    break;
+                    mantissa = mantissa * 10 + (*str - '0');
+                    if (mantissa != 0)
+                        digits++;
                 }
-                intpart.m_end++;
+                else
+                {
+                    exponent++;
+                }
+                str++;
+            }
+            if (str < end && *str == '.')
+            {
+                str++;
+                while (str < end && *str >= '0' && *str <= '9')
+                {
+                    if (digits < 19)
+                    {
+                        mantissa = mantissa * 10 + (*str - '0');
+                        exponent--;
+                        if (mantissa != 0)
+                            digits++;
+                    }
+                    str++;
+                }
+            }
+            if (str < end && (*str == 'e' || *str == 'E'))
+            {
+                string_t exponent_str(str + 1, end);
+                exponent += (s32)parse_int(exponent_str);
+            }
+
+            f64 v = (f64)mantissa;
+            if (exponent > 0)
+            {
+                while (exponent > 22)
+                {
+                    v *= c_pow10[22];
+                    exponent -= 22;
+                }
+                v *= c_pow10[exponent];
+            }
+            else if (exponent < 0)
+            {
+                while (exponent < -22)
+                {
+                    v /= c_pow10[22];
+                    exponent += 22;
+                }
+                v /= c_pow10[-exponent];
             }
-            u64 const intvalue = parse_int(intpart);
-            u64 const decvalue = parse_int(decpart);
-            f64 const fint     = (f64)intvalue;
-            f64 const fdec     = (f64)decvalue / (f64)(decpart.length() * 10);
-            return fint + fdec;
+            return negative ? -v : v;
         }
 
         u32 handler_t::get_offset(s32 property_index, etype* property_type_array, s32 property_count)
         {
             ASSERT(property_index < property_count);
             u32 offset = 0;
-            // D_FOR_I(0, property_index)
             for (s32 i = 0; i < property_index; i++)
             {
+                // the size of a list depends on the data, the offset of a property following a list is not fixed
+                ASSERT(!type_is_list(property_type_array[i]));
                 offset += type_sizeof(property_type_array[i]);
             }
             return offset;
         }
 
-        static s64 read_int(etype property_type, u32 property_offset, void* property_data)
+        // Records are packed, values are not aligned
+        template <typename T> static inline T load(u8 const* src)
+        {
+            T   v;
+            u8* dst = (u8*)&v;
+            for (u32 i = 0; i < sizeof(T); i++)
+                dst[i] = src[i];
+            return v;
+        }
+
+        template <typename T> static inline void store(u8* dst, T v)
+        {
+            u8 const* src = (u8 const*)&v;
+            for (u32 i = 0; i < sizeof(T); i++)
+                dst[i] = src[i];
+        }
+
+        template <typename T> T read_property(T _default, etype property_type, u32 property_offset, void* property_data)
         {
-            s64 v = 0;
+            u8 const* src = (u8 const*)property_data + property_offset;
             switch (property_type)
             {
-                case TYPE_INT8: v = *((s8*)((u8*)property_data + property_offset)); break;
-                case TYPE_INT16: v = *((s16*)((u8*)property_data + property_offset)); break;
-                case TYPE_INT32: v = *((s32*)((u8*)property_data + property_offset)); break;
+                case TYPE_INT8: return (T)load<s8>(src);
+                case TYPE_INT16: return (T)load<s16>(src);
+                case TYPE_INT32: return (T)load<s32>(src);
+                case TYPE_UINT8: return (T)load<u8>(src);
+                case TYPE_UINT16: return (T)load<u16>(src);
+                case TYPE_UINT32: return (T)load<u32>(src);
+                case TYPE_FLOAT32: return (T)load<f32>(src);
+                case TYPE_FLOAT64: return (T)load<f64>(src);
                 default: break;
             }
-            return v;
+            return _default;
         }
-        static u64 read_uint(etype property_type, u32 property_offset, void* property_data)
+
+        s8  handler_t::read_s8(etype property_type, u32 property_offset, void* property_data) { return read_property<s8>(0, property_type, property_offset, property_data); }
+        s16 handler_t::read_s16(etype property_type, u32 property_offset, void* property_data) { return read_property<s16>(0, property_type, property_offset, property_data); }
+        s32 handler_t::read_s32(etype property_type, u32 property_offset, void* property_data) { return read_property<s32>(0, property_type, property_offset, property_data); }
+        u8  handler_t::read_u8(etype property_type, u32 property_offset, void* property_data) { return read_property<u8>(0, property_type, property_offset, property_data); }
+        u16 handler_t::read_u16(etype property_type, u32 property_offset, void* property_data) { return read_property<u16>(0, property_type, property_offset, property_data); }
+        u32 handler_t::read_u32(etype property_type, u32 property_offset, void* property_data) { return read_property<u32>(0, property_type, property_offset, property_data); }
+        f32 handler_t::read_f32(etype property_type, u32 property_offset, void* property_data) { return read_property<f32>(0.0f, property_type, property_offset, property_data); }
+        f64 handler_t::read_f64(etype property_type, u32 property_offset, void* property_data) { return read_property<f64>(0.0, property_type, property_offset, property_data); }
+
+        // ----------------------------------------------------------------------------------------
+        // Decoding
+        //
+        // Only the properties that have an index (>= 0) are decoded, they are written to a record
+        // in file order:
+        //   - scalars in their own type
+        //   - lists as a u32 count followed by the items
+        // Elements that no handler accepts (setup returned false) are skipped, in binary files
+        // fixed-size elements are skipped with a single seek, in ASCII files line by line.
+        // ----------------------------------------------------------------------------------------
+
+        static const u64 c_batch_size = 64 * 1024; // bytes per read_data call for fixed-size records
+
+        // @note: Assumes a little endian host, big endian files are byte swapped
+        static inline void copy_value(u8* dst, u8 const* src, s32 size, bool swap)
         {
-            u64 v = 0;
-            switch (property_type)
+            if (swap)
             {
-                case TYPE_UINT8: v = *((u8*)((u8*)property_data + property_offset)); break;
-                case TYPE_UINT16: v = *((u16*)((u8*)property_data + property_offset)); break;
-                case TYPE_UINT32: v = *((u32*)((u8*)property_data + property_offset)); break;
-                default: break;
+                for (s32 i = 0; i < size; i++)
+                    dst[i] = src[size - 1 - i];
+            }
+            else
+            {
+                for (s32 i = 0; i < size; i++)
+                    dst[i] = src[i];
             }
-            return v;
         }
-        static f32 read_float32(f32 _default, etype property_type, u32 property_offset, void* property_data)
+
+        static inline u32 read_count(etype count_type, u8 const* src, bool swap)
         {
-            switch (property_type)
+            u8 value[4];
+            copy_value(value, src, type_sizeof(count_type), swap);
+            return read_property<u32>(0, count_type, 0, value);
+        }
+
+        static inline etype list_item_type(etype type) { return (etype)(type & ~TYPE_LIST); }
+
+        struct column_t
+        {
+            u32 m_src; // offset in the file record
+            u32 m_dst; // offset in the decoded record
+            s32 m_size;
+        };
+
+        struct decoder_t
+        {
+            ply_t*     m_ply;
+            reader_t*  m_reader;
+            bool       m_swap;
+            element_t* m_elem;
+            etype*     m_types; // selected properties
+            s32*       m_indices;
+            s32        m_count;
+            u8*        m_record;
+            u64        m_record_size;
+            handler_t* m_handlers[2];
+            s32        m_handler_count;
+            handler_t* m_record_handlers[2]; // take the raw fixed-size records
+            s32        m_record_handler_count;
+            ticker_t*  m_ticker; // nullptr = no statistics
+            stats_t*   m_stats;
+            u64        m_offset;  // in the file
+            bool       m_offset_known;
+            s32        m_element; // position in the header
+            u32        m_validate;
+            bool       m_validating; // current element
+            bool       m_all_f32;    // all selected properties are floats
+            u8*        m_checks;     // per selected property
+            u64        m_index_limit;
+            u64        m_first; // records of the element to decode (fixed-size only)
+            u64        m_items;
+            u32*       m_tokens; // (begin, end) offsets of the tokens of the current line (ASCII)
+            u32        m_token_max;
+        };
+
+        static inline bool timed(decoder_t const& d)
+        {
+#ifdef C3DFF_DISABLE_STATS
+            return false;
+#else
+            return d.m_ticker != nullptr;
+#endif
+        }
+
+        static inline u64 now(decoder_t const& d) { return timed(d) ? d.m_ticker->ticks() : 0; }
+
+        // Forwards to the user reader and accounts the time spent waiting on it
+        class stats_reader_t : public reader_t
+        {
+        public:
+            reader_t* m_reader;
+            ticker_t* m_ticker;
+            stats_t*  m_stats;
+
+            virtual bool read_line(const char*& str, const char*& end)
             {
-                case TYPE_FLOAT32: return *((f32*)((u8*)property_data + property_offset));
-                default: break;
+                u64 const  start = m_ticker->ticks();
+                bool const ok    = m_reader->read_line(str, end);
+                m_stats->m_ticks[stats_t::PHASE_IO] += m_ticker->ticks() - start;
+                m_stats->m_reader_calls++;
+                if (ok)
+                    m_stats->m_bytes_read += (u64)(end - str);
+                return ok;
             }
-            return _default;
+
+            virtual u32 line_end_size() const { return m_reader->line_end_size(); }
+
+            virtual bool read_data(u64 size, const u8*& begin, const u8*& end)
+            {
+                u64 const  start = m_ticker->ticks();
+                bool const ok    = m_reader->read_data(size, begin, end);
+                m_stats->m_ticks[stats_t::PHASE_IO] += m_ticker->ticks() - start;
+                m_stats->m_reader_calls++;
+                if (ok)
+                    m_stats->m_bytes_read += (u64)(end - begin);
+                return ok;
+            }
+
+            virtual bool skip_data(u64 size)
+            {
+                u64 const  start = m_ticker->ticks();
+                bool const ok    = m_reader->skip_data(size);
+                m_stats->m_ticks[stats_t::PHASE_IO] += m_ticker->ticks() - start;
+                m_stats->m_reader_calls++;
+                if (ok)
+                    m_stats->m_bytes_skipped += size;
+                return ok;
+            }
+        };
+
+        // Makes sure the record can hold 'size' bytes, the first 'used' bytes are kept
+        static bool reserve_record(decoder_t& d, u64 used, u64 size)
+        {
+            if (size <= d.m_record_size)
+                return true;
+            u64 new_size = d.m_record_size * 2;
+            if (new_size < size)
+                new_size = size;
+            u8* record = (u8*)d.m_ply->m_alloc->alloc(new_size);
+            if (record == nullptr)
+                return false;
+            for (u64 i = 0; i < used; i++)
+                record[i] = d.m_record[i];
+            d.m_ply->m_alloc->dealloc(d.m_record);
+            d.m_record      = record;
+            d.m_record_size = new_size;
+            return true;
         }
-        static f64 read_float64(f64 _default, etype property_type, u32 property_offset, void* property_data)
+
+        static inline bool fail(decoder_t& d, eerror kind, u64 record) { return set_error(d.m_ply, kind, d.m_element, record, d.m_offset_known ? d.m_offset : c_offset_unknown); }
+
+        // All reads of the body go through these, they keep track of the offset in the file
+        static inline bool next_line(decoder_t& d, string_t& line)
         {
-            switch (property_type)
+            do
             {
-                case TYPE_FLOAT64: return *((f64*)((u8*)property_data + property_offset));
-                default: break;
+                if (!d.m_reader->read_line(line.m_str, line.m_end))
+                    return false;
+                d.m_offset += (u64)(line.m_end - line.m_str) + d.m_reader->line_end_size();
+            } while (line.is_empty());
+            return true;
+        }
+
+        static inline bool next_data(decoder_t& d, u64 size, const u8*& begin, const u8*& end)
+        {
+            if (!d.m_reader->read_data(size, begin, end) || (u64)(end - begin) != size)
+                return false;
+            d.m_offset += size;
+            return true;
+        }
+
+        static inline bool skip_bytes(decoder_t& d, u64 size)
+        {
+            if (!d.m_reader->skip_data(size))
+                return false;
+            d.m_offset += size;
+            return true;
+        }
+
+        static inline void dispatch(decoder_t& d, u8* record)
+        {
+            for (s32 h = 0; h < d.m_handler_count; h++)
+                d.m_handlers[h]->read(d.m_elem->m_index, d.m_types, d.m_count, record);
+        }
+
+        // Per record, the fixed-size path times whole batches instead
+        static inline void dispatch_timed(decoder_t& d)
+        {
+            if (!timed(d))
+            {
+                dispatch(d, d.m_record);
+                return;
             }
-            return _default;
+            u64 const start = d.m_ticker->ticks();
+            dispatch(d, d.m_record);
+            d.m_stats->m_ticks[stats_t::PHASE_HANDLER] += d.m_ticker->ticks() - start;
         }
 
-        template <typename T> T read_integer(T _default, etype property_type, u32 property_offset, void* property_data)
+        // ----------------------------------------------------------------------------------------
+        // Validation
+        // ----------------------------------------------------------------------------------------
+
+        enum
         {
-            switch (type_type(property_type))
+            CHECK_INDEX  = 1,
+            CHECK_FINITE = 2,
+        };
+
+        // Returns the position of the first NaN or Inf (all exponent bits set), or 'count'
+        static u64 find_not_finite_f32(u8 const* data, u64 count)
+        {
+            u64 i = 0;
+#if defined(PLY_USE_SSE)
+            __m128i const exponent = _mm_set1_epi32(0x7F800000);
+            for (; (i + 4) <= count; i += 4)
             {
-                case TYPE_SIGNED: return (T)read_int(property_type, property_offset, property_data);
-                case TYPE_UNSIGNED: return (T)read_uint(property_type, property_offset, property_data);
-                default: break;
+                __m128i const v = _mm_and_si128(_mm_loadu_si128((__m128i const*)(data + i * 4)), exponent);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, exponent)) != 0)
+                    break;
             }
-            return _default;
+#endif
+            for (; i < count; ++i)
+            {
+                if ((load<u32>(data + i * 4) & 0x7F800000) == 0x7F800000)
+                    return i;
+            }
+            return count;
         }
 
-        s8  handler_t::read_s8(etype property_type, u32 property_offset, void* property_data) { return read_integer<s8>(0, property_type, property_offset, property_data); }
-        s16 handler_t::read_s16(etype property_type, u32 property_offset, void* property_data) { return read_integer<s16>(0, property_type, property_offset, property_data); }
-        s32 handler_t::read_s32(etype property_type, u32 property_offset, void* property_data) { return read_integer<s32>(0, property_type, property_offset, property_data); }
-        u8  handler_t::read_u8(etype property_type, u32 property_offset, void* property_data) { return read_integer<u8>(0, property_type, property_offset, property_data); }
-        u16 handler_t::read_u16(etype property_type, u32 property_offset, void* property_data) { return read_integer<u16>(0, property_type, property_offset, property_data); }
-        u32 handler_t::read_u32(etype property_type, u32 property_offset, void* property_data) { return read_integer<u32>(0, property_type, property_offset, property_data); }
-        f32 handler_t::read_f32(etype property_type, u32 property_offset, void* property_data) { return read_float32(0.0f, property_type, property_offset, property_data); }
-        f64 handler_t::read_f64(etype property_type, u32 property_offset, void* property_data) { return read_float64(0.0, property_type, property_offset, property_data); }
+        static u64 find_not_finite_f64(u8 const* data, u64 count)
+        {
+            for (u64 i = 0; i < count; ++i)
+            {
+                if ((load<u64>(data + i * 8) & 0x7FF0000000000000ull) == 0x7FF0000000000000ull)
+                    return i;
+            }
+            return count;
+        }
 
-        // TODO: endian format
-        static inline u8* write_bytes(u8* dst, u8 const* src, s32 size)
+        static inline s64 load_int(etype type, u8 const* src)
         {
-            while (size > 0)
+            switch (type)
             {
-                *dst++ = *src++;
-                --size;
+                case TYPE_INT8: return load<s8>(src);
+                case TYPE_UINT8: return load<u8>(src);
+                case TYPE_INT16: return load<s16>(src);
+                case TYPE_UINT16: return load<u16>(src);
+                case TYPE_INT32: return load<s32>(src);
+                case TYPE_UINT32: return load<u32>(src);
+                case TYPE_FLOAT32: return (s64)load<f32>(src);
+                case TYPE_FLOAT64: return (s64)load<f64>(src);
+                default: break;
             }
-            return dst;
+            return 0;
         }
 
-        template <typename T> u8* write_data(T v, u8* dst) { return write_bytes(dst, (u8 const*)&v, sizeof(T)); }
+        // Returns the position of the first index that is negative or >= limit, or 'count'
+        static u64 find_out_of_range(etype type, u8 const* data, u64 count, u64 limit)
+        {
+            u64       i    = 0;
+            s32 const size = type_sizeof(type);
+#if defined(PLY_USE_SSE)
+            if (size == 4 && (type == TYPE_INT32 || type == TYPE_UINT32) && limit > 0 && limit <= 0x7FFFFFFF)
+            {
+                // as unsigned, negative indices are out of range as well; SSE2 only has a signed
+                // compare so both sides are biased by 2^31
+                __m128i const bias = _mm_set1_epi32((s32)0x80000000);
+                __m128i const last = _mm_set1_epi32((s32)((u32)limit - 1) ^ (s32)0x80000000);
+                for (; (i + 4) <= count; i += 4)
+                {
+                    __m128i const v = _mm_xor_si128(_mm_loadu_si128((__m128i const*)(data + i * 4)), bias);
+                    if (_mm_movemask_epi8(_mm_cmpgt_epi32(v, last)) != 0)
+                        break;
+                }
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                s64 const index = load_int(type, data + i * size);
+                if (index < 0 || (u64)index >= limit)
+                    return i;
+            }
+            return count;
+        }
 
-        bool read_element_data_ascii(ply_t* ply, reader_t* reader, element_t* elem, handler_t** handler_array, s32 handler_count)
+        static bool check_values(etype type, u8 check, u8 const* data, u64 count, u64 limit, eerror& error)
         {
-            u8 dst_buffer[128];
-            for (s64 i = 0; i < elem->m_count; i++)
+            if ((check & CHECK_INDEX) != 0 && find_out_of_range(type, data, count, limit) < count)
             {
-                string_t line;
-                do
+                error = ERROR_INDEX;
+                return false;
+            }
+            if ((check & CHECK_FINITE) != 0)
+            {
+                u64 const first = type == TYPE_FLOAT32 ? find_not_finite_f32(data, count) : find_not_finite_f64(data, count);
+                if (first < count)
                 {
-                    if (!reader->read_line(line.m_str, line.m_end))
-                        return false;
-                } while (line.is_empty());
+                    error = ERROR_NOT_FINITE;
+                    return false;
+                }
+            }
+            return true;
+        }
 
-                u8* dst = dst_buffer;
-                // D_FOR(s32, i, 0, elem->m_prop_count)
-                for (s32 i = 0; i < elem->m_prop_count; i++)
+        // A decoded record, see the layout at the top of this section
+        static bool validate_record(decoder_t& d, u8 const* record, u64 r)
+        {
+            eerror error  = ERROR_NONE;
+            u64    cursor = 0;
+            for (s32 i = 0; i < d.m_count; i++)
+            {
+                etype const type = d.m_types[i];
+                if (type_is_list(type))
+                {
+                    etype const item_type = list_item_type(type);
+                    u32 const   n         = load<u32>(record + cursor);
+                    if (d.m_checks[i] != 0 && !check_values(item_type, d.m_checks[i], record + cursor + 4, n, d.m_index_limit, error))
+                        return fail(d, error, r);
+                    cursor += 4 + (u64)n * type_sizeof(item_type);
+                }
+                else
                 {
-                    property_t* prop = elem->m_prop_array[i];
+                    if (d.m_checks[i] != 0 && !check_values(type, d.m_checks[i], record + cursor, 1, d.m_index_limit, error))
+                        return fail(d, error, r);
+                    cursor += type_sizeof(type);
+                }
+            }
+            return true;
+        }
+
+        // Fixed-size records: when every selected property is a float the batch is one float array
+        static bool validate_batch(decoder_t& d, u8 const* records, u64 n, u64 size, u64 first)
+        {
+            if (size > 0 && d.m_all_f32)
+            {
+                u64 const i = find_not_finite_f32(records, n * size / 4);
+                if (i < n * size / 4)
+                    return fail(d, ERROR_NOT_FINITE, first + (i * 4) / size);
+                return true;
+            }
+            for (u64 r = 0; r < n; r++, records += size)
+            {
+                if (!validate_record(d, records, first + r))
+                    return false;
+            }
+            return true;
+        }
+
+        static inline bool is_index_list(element_t const* elem, property_t const* prop)
+        {
+            return type_is_list(prop->m_property_type) && elem->m_name == "face" && (prop->m_name == "vertex_indices" || prop->m_name == "vertex_index");
+        }
 
-                    string_t value_str = read_token(line);
+        // Decides per selected property what to check, returns false when nothing needs checking
+        static bool setup_checks(decoder_t& d)
+        {
+            element_t const* elem = d.m_elem;
+            bool             any  = false;
+            d.m_all_f32           = d.m_count > 0;
+            for (s32 i = 0, s = 0; i < elem->m_prop_count; i++)
+            {
+                if (elem->m_prop_index_array[i] < 0)
+                    continue;
+                property_t const* prop  = elem->m_prop_array[i];
+                etype const       item  = list_item_type(prop->m_property_type);
+                u8                check = 0;
+                if ((d.m_validate & VALIDATE_INDICES) != 0 && is_index_list(elem, prop))
+                    check |= CHECK_INDEX;
+                if ((d.m_validate & VALIDATE_FINITE) != 0 && type_is_float(item))
+                    check |= CHECK_FINITE;
+                if (prop->m_property_type != TYPE_FLOAT32)
+                    d.m_all_f32 = false;
+                d.m_checks[s++] = check;
+                any             = any || check != 0;
+            }
+            if (!any || (d.m_validate & VALIDATE_FINITE) == 0)
+                d.m_all_f32 = false;
+            return any;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Elements
+        // ----------------------------------------------------------------------------------------
+
+        // Returns the record size of an element without lists, or 0
+        static u64 get_stride(element_t const* elem)
+        {
+            u64 stride = 0;
+            for (s32 i = 0; i < elem->m_prop_count; i++)
+            {
+                if (type_is_list(elem->m_prop_type_array[i]))
+                    return 0;
+                stride += type_sizeof(elem->m_prop_type_array[i]);
+            }
+            return stride;
+        }
 
-                    if (prop->m_property_type == TYPE_FLOAT32)
+        static bool skip_element_ascii(decoder_t& d)
+        {
+            string_t line;
+            for (u64 r = 0; r < d.m_elem->m_count; r++)
+            {
+                if (!next_line(d, line))
+                    return fail(d, ERROR_TRUNCATED, r);
+            }
+            return true;
+        }
+
+        static bool skip_element_binary(decoder_t& d)
+        {
+            element_t const* elem   = d.m_elem;
+            u64 const        stride = get_stride(elem);
+            if (stride > 0 || elem->m_prop_count == 0)
+                return skip_bytes(d, stride * elem->m_count) || fail(d, ERROR_TRUNCATED, 0);
+
+            const u8* begin;
+            const u8* end;
+            for (u64 r = 0; r < elem->m_count; r++)
+            {
+                for (s32 i = 0; i < elem->m_prop_count; i++)
+                {
+                    property_t const* prop = elem->m_prop_array[i];
+                    if (type_is_list(prop->m_property_type))
                     {
-                        f32 f = parse_float32(value_str);
-                        write_data<f32>(f, dst);
+                        if (!next_data(d, type_sizeof(prop->m_list_count_type), begin, end))
+                            return fail(d, ERROR_TRUNCATED, r);
+                        u32 const n = read_count(prop->m_list_count_type, begin, d.m_swap);
+                        if (!skip_bytes(d, (u64)n * type_sizeof(prop->m_property_type)))
+                            return fail(d, ERROR_TRUNCATED, r);
                     }
-                    else if (prop->m_property_type == TYPE_FLOAT64)
+                    else if (!skip_bytes(d, type_sizeof(prop->m_property_type)))
                     {
-                        f64 f = parse_float64(value_str);
-                        write_data<f64>(f, dst);
+                        return fail(d, ERROR_TRUNCATED, r);
                     }
-                    else if (type_is_int(prop->m_property_type))
+                }
+            }
+            return true;
+        }
+
+        // Fixed-size records, read in batches. Record handlers get the batch as-is, for the others only
+        // the selected columns are copied.
+        static bool read_element_fixed_binary(decoder_t& d, u64 stride)
+        {
+            element_t const* elem = d.m_elem;
+
+            column_t* columns = (column_t*)d.m_ply->m_alloc->alloc(sizeof(column_t) * (elem->m_prop_count + 1));
+            if (columns == nullptr)
+                return fail(d, ERROR_MEMORY, 0);
+            s32 column_count = 0;
+            u32 src          = 0;
+            u32 dst          = 0;
+            for (s32 i = 0; i < elem->m_prop_count; i++)
+            {
+                s32 const sz = type_sizeof(elem->m_prop_type_array[i]);
+                if (elem->m_prop_index_array[i] >= 0)
+                {
+                    columns[column_count].m_src  = src;
+                    columns[column_count].m_dst  = dst;
+                    columns[column_count].m_size = sz;
+                    column_count++;
+                    dst += sz;
+                }
+                src += sz;
+            }
+
+            // a batch is first converted into records, validated and then handed to the handlers
+            bool const convert   = d.m_handler_count > 0 || d.m_validating;
+            u64 const  batch     = stride < c_batch_size ? c_batch_size / stride : 1;
+            bool       ok        = reserve_record(d, 0, batch * dst + 1) || fail(d, ERROR_MEMORY, 0);
+            u64        remaining = d.m_items;
+            while (ok && remaining > 0)
+            {
+                u64 const n     = remaining < batch ? remaining : batch;
+                u64 const first = d.m_first + d.m_items - remaining;
+                const u8* begin;
+                const u8* end;
+                if (!next_data(d, n * stride, begin, end))
+                {
+                    ok = fail(d, ERROR_TRUNCATED, first);
+                    break;
+                }
+
+                u64 const t0     = now(d);
+                u8*       record = d.m_record;
+                for (u64 r = 0; r < n && convert; r++, record += dst)
+                {
+                    u8 const* row = begin + r * stride;
+                    for (s32 c = 0; c < column_count; c++)
+                        copy_value(record + columns[c].m_dst, row + columns[c].m_src, columns[c].m_size, d.m_swap);
+                }
+                // the records of the batch before a failing one are still delivered, so that the handlers
+                // stop at the same record as on the record by record paths
+                u64 valid = n;
+                if (d.m_validating && !validate_batch(d, d.m_record, n, dst, first))
+                {
+                    ok    = false;
+                    valid = d.m_ply->m_error.m_record - first;
+                }
+                u64 const t1 = now(d);
+                for (s32 h = 0; h < d.m_record_handler_count && valid > 0; h++)
+                    d.m_record_handlers[h]->read_records(d.m_elem->m_index, begin, valid);
+                record = d.m_record;
+                for (u64 r = 0; r < valid && d.m_handler_count > 0; r++, record += dst)
+                    dispatch(d, record);
+                if (timed(d))
+                {
+                    u64 const t2 = d.m_ticker->ticks();
+                    d.m_stats->m_ticks[stats_t::PHASE_CONVERT] += t1 - t0;
+                    d.m_stats->m_ticks[stats_t::PHASE_HANDLER] += t2 - t1;
+                }
+                remaining -= n;
+            }
+            d.m_ply->m_alloc->dealloc(columns);
+            return ok;
+        }
+
+        // Records with lists, property by property
+        static bool read_element_binary(decoder_t& d)
+        {
+            element_t const* elem = d.m_elem;
+            const u8*        begin;
+            const u8*        end;
+            for (u64 r = 0; r < elem->m_count; r++)
+            {
+                u64 dst = 0;
+                for (s32 i = 0; i < elem->m_prop_count; i++)
+                {
+                    property_t const* prop     = elem->m_prop_array[i];
+                    bool const        selected = elem->m_prop_index_array[i] >= 0;
+                    if (type_is_list(prop->m_property_type))
                     {
-                        s64 i = parse_int(value_str);
-                        switch (prop->m_property_type)
+                        if (!next_data(d, type_sizeof(prop->m_list_count_type), begin, end))
+                            return fail(d, ERROR_TRUNCATED, r);
+                        u32 const n         = read_count(prop->m_list_count_type, begin, d.m_swap);
+                        s32 const item_size = type_sizeof(prop->m_property_type);
+                        if (!selected)
+                        {
+                            if (!skip_bytes(d, (u64)n * item_size))
+                                return fail(d, ERROR_TRUNCATED, r);
+                            continue;
+                        }
+                        if (!reserve_record(d, dst, dst + 4 + (u64)n * item_size))
+                            return fail(d, ERROR_MEMORY, r);
+                        store<u32>(d.m_record + dst, n);
+                        dst += 4;
+                        if (n > 0)
                         {
-                            case TYPE_INT8: write_data<s8>(i, dst); break;
-                            case TYPE_INT16: write_data<s16>(i, dst); break;
-                            case TYPE_INT32: write_data<s32>(i, dst); break;
-                            default: break;
+                            if (!next_data(d, (u64)n * item_size, begin, end))
+                                return fail(d, ERROR_TRUNCATED, r);
+                            for (u32 j = 0; j < n; j++, begin += item_size, dst += item_size)
+                                copy_value(d.m_record + dst, begin, item_size, d.m_swap);
                         }
                     }
-                    else if (type_is_uint(prop->m_property_type))
+                    else
                     {
-                        u64 i = parse_uint(value_str);
-                        switch (prop->m_property_type)
+                        s32 const sz = type_sizeof(prop->m_property_type);
+                        if (!selected)
                         {
-                            case TYPE_UINT8: write_data<u8>(i, dst); break;
-                            case TYPE_UINT16: write_data<u16>(i, dst); break;
-                            case TYPE_UINT32: write_data<u32>(i, dst); break;
-                            default: break;
+                            if (!skip_bytes(d, sz))
+                                return fail(d, ERROR_TRUNCATED, r);
+                            continue;
                         }
+                        if (!reserve_record(d, dst, dst + sz))
+                            return fail(d, ERROR_MEMORY, r);
+                        if (!next_data(d, sz, begin, end))
+                            return fail(d, ERROR_TRUNCATED, r);
+                        copy_value(d.m_record + dst, begin, sz, d.m_swap);
+                        dst += sz;
                     }
                 }
+                if (d.m_validating && !validate_record(d, d.m_record, r))
+                    return false;
+                dispatch_timed(d);
+            }
+            return true;
+        }
 
-                // D_FOR(s32, i, 0, handler_count)
-                for (s32 i = 0; i < handler_count; i++)
-                    handler_array[i]->read(elem->m_index, elem->m_prop_type_array, elem->m_prop_count, dst);
+        static void write_value(u8* dst, etype type, string_t const& token)
+        {
+            switch (type)
+            {
+                case TYPE_INT8: store<s8>(dst, (s8)parse_int(token)); break;
+                case TYPE_INT16: store<s16>(dst, (s16)parse_int(token)); break;
+                case TYPE_INT32: store<s32>(dst, (s32)parse_int(token)); break;
+                case TYPE_UINT8: store<u8>(dst, (u8)parse_uint(token)); break;
+                case TYPE_UINT16: store<u16>(dst, (u16)parse_uint(token)); break;
+                case TYPE_UINT32: store<u32>(dst, (u32)parse_uint(token)); break;
+                case TYPE_FLOAT32: store<f32>(dst, (f32)parse_float(token)); break;
+                case TYPE_FLOAT64: store<f64>(dst, parse_float(token)); break;
+                default: break;
             }
+        }
+
+        // A number starts with a digit, a sign or a '.', anything else is not a value
+        static inline bool is_number(string_t const& token)
+        {
+            char const c = token.m_str[0];
+            return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+        }
+
+        // Float properties also take nan and inf, validation decides whether those are accepted
+        static inline bool is_value(string_t const& token, etype type)
+        {
+            f64 v;
+            return is_number(token) || (type_is_float(type) && parse_non_finite(token.m_str, token.m_end, v));
+        }
+
+        // Index the tokens of a line, the index grows with the line that has the most tokens
+        static bool index_line(decoder_t& d, string_t const& line, u32& count)
+        {
+            count = index_tokens(line.m_str, line.m_end, d.m_tokens, d.m_token_max);
+            if (count <= d.m_token_max)
+                return true;
+            u32 const max    = count > d.m_token_max * 2 ? count : d.m_token_max * 2;
+            u32*      tokens = (u32*)d.m_ply->m_alloc->alloc(sizeof(u32) * 2 * (u64)max);
+            if (tokens == nullptr)
+                return false;
+            d.m_ply->m_alloc->dealloc(d.m_tokens);
+            d.m_tokens    = tokens;
+            d.m_token_max = max;
+            index_tokens(line.m_str, line.m_end, d.m_tokens, d.m_token_max);
             return true;
         }
 
-        void read_elements_ascii(ply_t* ply, reader_t* reader, handler_t** handler_array, s32 handler_count)
+        static inline string_t get_token(decoder_t const& d, string_t const& line, u32 index) { return string_t(line.m_str + d.m_tokens[index * 2], line.m_str + d.m_tokens[index * 2 + 1]); }
+
+        static bool read_element_ascii(decoder_t& d)
         {
-            element_t* elem = ply->m_hdr->m_elements;
-            while (elem != nullptr)
+            element_t const* elem = d.m_elem;
+            for (u64 r = 0; r < elem->m_count; r++)
             {
-                read_element_data_ascii(ply, reader, elem, handler_array, handler_count);
-                elem = elem->m_next;
+                string_t line;
+                if (!next_line(d, line))
+                    return fail(d, ERROR_TRUNCATED, r);
+
+                u32 count;
+                if (!index_line(d, line, count))
+                    return fail(d, ERROR_MEMORY, r);
+
+                u64 dst = 0;
+                u32 t   = 0;
+                for (s32 i = 0; i < elem->m_prop_count; i++)
+                {
+                    property_t const* prop     = elem->m_prop_array[i];
+                    bool const        selected = elem->m_prop_index_array[i] >= 0;
+                    if (t == count)
+                        return fail(d, ERROR_VALUE, r);
+                    string_t const token = get_token(d, line, t++);
+                    bool const list = type_is_list(prop->m_property_type);
+                    if (list ? !is_number(token) : !is_value(token, prop->m_property_type))
+                        return fail(d, ERROR_VALUE, r);
+                    if (list)
+                    {
+                        u32 const   n         = (u32)parse_uint(token);
+                        etype const item_type = list_item_type(prop->m_property_type);
+                        s32 const   item_size = type_sizeof(item_type);
+                        if (n > count - t)
+                            return fail(d, ERROR_VALUE, r);
+                        if (!selected)
+                        {
+                            t += n;
+                            continue;
+                        }
+                        if (!reserve_record(d, dst, dst + 4 + (u64)n * item_size))
+                            return fail(d, ERROR_MEMORY, r);
+                        store<u32>(d.m_record + dst, n);
+                        dst += 4;
+                        for (u32 j = 0; j < n; j++)
+                        {
+                            string_t const item = get_token(d, line, t++);
+                            if (!is_value(item, item_type))
+                                return fail(d, ERROR_VALUE, r);
+                            write_value(d.m_record + dst, item_type, item);
+                            dst += item_size;
+                        }
+                    }
+                    else if (selected)
+                    {
+                        s32 const sz = type_sizeof(prop->m_property_type);
+                        if (!reserve_record(d, dst, dst + sz))
+                            return fail(d, ERROR_MEMORY, r);
+                        write_value(d.m_record + dst, prop->m_property_type, token);
+                        dst += sz;
+                    }
+                }
+                if (d.m_validating && !validate_record(d, d.m_record, r))
+                    return false;
+                dispatch_timed(d);
+            }
+            return true;
+        }
+
+        static u64 get_vertex_count(ply_t* ply)
+        {
+            for (element_t const* elem = ply->m_hdr->m_elements; elem != nullptr; elem = elem->m_next)
+            {
+                if (elem->m_name == "vertex")
+                    return elem->m_count;
             }
+            return 0;
         }
 
-        void read_data(ply_t* ply, reader_t* reader, handler_t* handler1, handler_t* handler2)
+        static bool begin_decode(decoder_t& d, ply_t* ply, reader_t* reader, stats_reader_t& stats_reader)
         {
-            s32 const  handler_count    = 2;
-            handler_t* handler_array[2] = {handler1, handler2};
+            d.m_ply          = ply;
+            d.m_reader       = reader;
+            d.m_swap         = ply->m_hdr->m_format == FORMAT_BBE;
+            d.m_record       = nullptr;
+            d.m_record_size  = 0;
+            d.m_tokens       = nullptr;
+            d.m_token_max    = 0;
+            d.m_ticker       = nullptr;
+            d.m_stats        = nullptr;
+            d.m_offset       = ply->m_header_size;
+            d.m_offset_known = true;
+            d.m_element      = -1;
+            d.m_validate     = ply->m_validate;
+            d.m_index_limit  = (ply->m_validate & VALIDATE_INDICES) != 0 ? get_vertex_count(ply) : 0;
+            set_error(ply, ERROR_NONE, -1, 0, 0);
+            if (!reserve_record(d, 0, 256))
+                return fail(d, ERROR_MEMORY, 0);
 
-            element_t* elem = ply->m_hdr->m_elements;
-            while (elem != nullptr)
+            if (stats_enabled(ply))
+            {
+                stats_reader.m_reader = reader;
+                stats_reader.m_ticker = ply->m_ticker;
+                stats_reader.m_stats  = &ply->m_stats;
+                d.m_reader            = &stats_reader;
+                d.m_ticker            = ply->m_ticker;
+                d.m_stats             = &ply->m_stats;
+            }
+            return true;
+        }
+
+        // Records [first, first + count) of the element, only fixed-size binary elements can be decoded
+        // partially, all others are decoded completely
+        static bool decode_element(decoder_t& d, element_t* elem, handler_t** handler_array, s32 handler_count, u64 first, u64 count)
+        {
+            ply_t* ply        = d.m_ply;
+            bool const binary = ply->m_hdr->m_format != FORMAT_ASCII;
+            d.m_elem          = elem;
+            d.m_first         = first;
+            d.m_items         = count;
+
+            // the selected properties, this is what the handlers see
+            d.m_count   = 0;
+            d.m_types   = (etype*)ply->m_alloc->alloc(sizeof(etype) * (elem->m_prop_count + 1));
+            d.m_indices = (s32*)ply->m_alloc->alloc(sizeof(s32) * (elem->m_prop_count + 1));
+            d.m_checks  = (u8*)ply->m_alloc->alloc(elem->m_prop_count + 1);
+            if (d.m_types == nullptr || d.m_indices == nullptr || d.m_checks == nullptr)
+                return fail(d, ERROR_MEMORY, first);
+            for (s32 i = 0; i < elem->m_prop_count; i++)
+            {
+                if (elem->m_prop_index_array[i] >= 0)
+                {
+                    d.m_types[d.m_count]   = elem->m_prop_type_array[i];
+                    d.m_indices[d.m_count] = elem->m_prop_index_array[i];
+                    d.m_count++;
+                }
+            }
+
+            u64 const stride         = binary ? get_stride(elem) : 0;
+            d.m_handler_count        = 0;
+            d.m_record_handler_count = 0;
+            if (elem->m_index >= 0)
             {
                 for (s32 i = 0; i < handler_count; ++i)
-                    handler_array[i]->setup(elem->m_index, elem->m_count, elem->m_prop_type_array, elem->m_prop_index_array, elem->m_prop_count);
-                elem = elem->m_next;
+                {
+                    handler_t* handler = handler_array[i];
+                    if (handler == nullptr)
+                        continue;
+                    if (stride > 0 && handler->setup_records(elem->m_index, count, elem->m_prop_type_array, elem->m_prop_index_array, elem->m_prop_count, ply->m_hdr->m_format))
+                        d.m_record_handlers[d.m_record_handler_count++] = handler;
+                    else if (handler->setup(elem->m_index, count, d.m_types, d.m_indices, d.m_count))
+                        d.m_handlers[d.m_handler_count++] = handler;
+                }
+            }
+
+            bool const skip = d.m_handler_count == 0 && d.m_record_handler_count == 0;
+            d.m_validating  = !skip && d.m_validate != VALIDATE_NONE && setup_checks(d);
+
+            // whatever is not io, conversion or handler time is parsing
+            u64 start = 0;
+            u64 other = 0;
+            if (timed(d))
+            {
+                start = d.m_ticker->ticks();
+                other = d.m_stats->m_ticks[stats_t::PHASE_IO] + d.m_stats->m_ticks[stats_t::PHASE_CONVERT] + d.m_stats->m_ticks[stats_t::PHASE_HANDLER];
+            }
+
+            bool ok;
+            if (skip)
+            {
+                ok = binary ? skip_element_binary(d) : skip_element_ascii(d);
+            }
+            else if (binary)
+            {
+                ok = stride > 0 ? read_element_fixed_binary(d, stride) : read_element_binary(d);
+            }
+            else
+            {
+                ok = read_element_ascii(d);
+            }
+
+            if (timed(d))
+            {
+                u64 const elapsed = d.m_ticker->ticks() - start;
+                u64 const spent   = d.m_stats->m_ticks[stats_t::PHASE_IO] + d.m_stats->m_ticks[stats_t::PHASE_CONVERT] + d.m_stats->m_ticks[stats_t::PHASE_HANDLER] - other;
+                if (elapsed > spent)
+                    d.m_stats->m_ticks[stats_t::PHASE_PARSE] += elapsed - spent;
+                if (skip)
+                    d.m_stats->m_items_skipped += count;
+                else
+                    d.m_stats->m_items_decoded += count;
+            }
+
+            ply->m_alloc->dealloc(d.m_checks);
+            ply->m_alloc->dealloc(d.m_indices);
+            ply->m_alloc->dealloc(d.m_types);
+            return ok;
+        }
+
+        bool read_data(ply_t* ply, reader_t* reader, handler_t* handler1, handler_t* handler2)
+        {
+            handler_t*     handler_array[2] = {handler1, handler2};
+            decoder_t      d;
+            stats_reader_t stats_reader;
+            if (!begin_decode(d, ply, reader, stats_reader))
+                return false;
+
+            bool ok = true;
+            for (element_t* elem = ply->m_hdr->m_elements; ok && elem != nullptr; elem = elem->m_next)
+            {
+                d.m_element++;
+                ok = decode_element(d, elem, handler_array, 2, 0, elem->m_count);
+            }
+            ply->m_alloc->dealloc(d.m_record);
+            ply->m_alloc->dealloc(d.m_tokens);
+            return ok;
+        }
+
+        bool read_records(ply_t* ply, const char* element_name, u64 first, u64 count, reader_t* reader, handler_t* handler)
+        {
+            decoder_t      d;
+            stats_reader_t stats_reader;
+            if (!begin_decode(d, ply, reader, stats_reader))
+                return false;
+
+            // the offset of the element is known when all elements before it have fixed-size records
+            element_t* elem   = ply->m_hdr->m_elements;
+            bool       offset = true;
+            for (; elem != nullptr && elem->m_name != element_name; elem = elem->m_next)
+            {
+                u64 const stride = get_stride(elem);
+                offset           = offset && (stride > 0 || elem->m_prop_count == 0);
+                d.m_offset += stride * elem->m_count;
+                d.m_element++;
             }
+            d.m_element++;
 
-            // now read in the data, can be in ASCII or BINARY format
-            if (ply->m_hdr->m_format == FORMAT_ASCII)
+            bool ok;
+            if (elem == nullptr || ply->m_hdr->m_format == FORMAT_ASCII || get_stride(elem) == 0 || first + count > elem->m_count)
             {
-                read_elements_ascii(ply, reader, handler_array, handler_count);
+                ok = fail(d, ERROR_FORMAT, first);
             }
             else
             {
-                // TODO: read binary format
+                d.m_offset       = d.m_offset + first * get_stride(elem);
+                d.m_offset_known = offset;
+                ok               = decode_element(d, elem, &handler, 1, first, count);
             }
+            ply->m_alloc->dealloc(d.m_record);
+            ply->m_alloc->dealloc(d.m_tokens);
+            return ok;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Probe
+        // ----------------------------------------------------------------------------------------
+
+        // Image layout (offsets relative to the start of the image, 8 byte aligned):
+        //
+        //   info_header_t
+        //   info_element_t  elements[num_elements]
+        //   info_property_t properties[num_properties]
+        //   u32             texts[num_comments + num_obj_info]
+        //   char            strings[]  (zero terminated)
+
+        const u32 c_info_magic   = ('P' << 0) | ('L' << 8) | ('Y' << 16) | ('I' << 24);
+        const u32 c_info_version = 1;
+
+        struct info_header_t
+        {
+            u32 m_magic;
+            u32 m_version;
+            u64 m_size;
+            u64 m_body_offset;
+            u32 m_format;
+            u32 m_num_elements;
+            u32 m_num_properties; // of all elements
+            u32 m_num_comments;
+            u32 m_num_obj_info;
+            u32 m_elements_offset;
+            u32 m_properties_offset;
+            u32 m_texts_offset; // u32 offsets of the comments followed by the obj_info
+        };
+
+        struct info_element_t
+        {
+            u64 m_count;
+            u32 m_name;
+            u32 m_first_property;
+            u32 m_num_properties;
+            u32 m_pad;
+        };
+
+        struct info_property_t
+        {
+            u32 m_name;
+            u16 m_type;
+            u16 m_list_count_type;
+        };
+
+        static inline u64 align8(u64 size) { return (size + 7) & ~(u64)7; }
+
+        static u32 write_text(u8* image, u64& cursor, string_t const& str)
+        {
+            u32 const offset = (u32)cursor;
+            char*     dst    = (char*)image + cursor;
+            for (const char* src = str.m_str; src < str.m_end; ++src)
+                *dst++ = *src;
+            *dst = 0;
+            cursor += str.length() + 1;
+            return offset;
+        }
+
+        bool probe(allocator_t* allocator, const u8* data, u64 size, info_t& info)
+        {
+            if (size < 4 || data[0] != 'p' || data[1] != 'l' || data[2] != 'y' || (data[3] != '\n' && data[3] != '\r'))
+                return false;
+
+            memory_reader_t reader(data, size);
+            ply_t*          ply = create(allocator);
+            if (ply == nullptr || !read_header(ply, &reader))
+                return false;
+
+            // The 'end_header' line must be terminated within the data, otherwise the body offset is not known
+            u64 const body_offset = reader.offset();
+            if (data[body_offset - 1] == '\r' && body_offset == size)
+                return false;
+            if (data[body_offset - 1] != '\n' && data[body_offset - 1] != '\r')
+                return false;
+
+            header_t const* hdr = ply->m_hdr;
+
+            u32 num_properties = 0;
+            u64 text_size      = 0;
+            for (element_t const* elem = hdr->m_elements; elem != nullptr; elem = elem->m_next)
+            {
+                num_properties += elem->m_prop_count;
+                text_size += elem->m_name.length() + 1;
+                for (s32 i = 0; i < elem->m_prop_count; i++)
+                    text_size += elem->m_prop_array[i]->m_name.length() + 1;
+            }
+            for (comment_t const* c = hdr->m_comments; c != nullptr; c = c->m_next)
+                text_size += c->m_comment.length() + 1;
+            for (objinfo_t const* o = hdr->m_obj_info; o != nullptr; o = o->m_next)
+                text_size += o->m_comment.length() + 1;
+
+            u64       offset            = align8(sizeof(info_header_t));
+            u64 const elements_offset   = offset;
+            offset                      = align8(offset + sizeof(info_element_t) * hdr->m_num_elements);
+            u64 const properties_offset = offset;
+            offset                      = align8(offset + sizeof(info_property_t) * num_properties);
+            u64 const texts_offset      = offset;
+            offset                      = offset + sizeof(u32) * (hdr->m_num_comments + hdr->m_num_obj_info);
+            u64 const image_size        = align8(offset + text_size);
+
+            u8* image = (u8*)allocator->alloc(image_size);
+            if (image == nullptr)
+                return false;
+            for (u64 i = 0; i < image_size; ++i)
+                image[i] = 0;
+
+            info_header_t* ih       = (info_header_t*)image;
+            ih->m_magic             = c_info_magic;
+            ih->m_version           = c_info_version;
+            ih->m_format            = (u32)hdr->m_format;
+            ih->m_size              = image_size;
+            ih->m_body_offset       = body_offset;
+            ih->m_num_elements      = hdr->m_num_elements;
+            ih->m_num_properties    = num_properties;
+            ih->m_num_comments      = hdr->m_num_comments;
+            ih->m_num_obj_info      = hdr->m_num_obj_info;
+            ih->m_elements_offset   = (u32)elements_offset;
+            ih->m_properties_offset = (u32)properties_offset;
+            ih->m_texts_offset      = (u32)texts_offset;
+
+            info_element_t*  elements   = (info_element_t*)(image + elements_offset);
+            info_property_t* properties = (info_property_t*)(image + properties_offset);
+            u32*             texts      = (u32*)(image + texts_offset);
+            u64              cursor     = offset;
+
+            u32 e = 0;
+            u32 p = 0;
+            for (element_t const* elem = hdr->m_elements; elem != nullptr; elem = elem->m_next, ++e)
+            {
+                elements[e].m_count          = elem->m_count;
+                elements[e].m_name           = write_text(image, cursor, elem->m_name);
+                elements[e].m_first_property = p;
+                elements[e].m_num_properties = (u32)elem->m_prop_count;
+                for (s32 i = 0; i < elem->m_prop_count; i++, ++p)
+                {
+                    property_t const* prop          = elem->m_prop_array[i];
+                    properties[p].m_name            = write_text(image, cursor, prop->m_name);
+                    properties[p].m_type            = (u16)prop->m_property_type;
+                    properties[p].m_list_count_type = (u16)prop->m_list_count_type;
+                }
+            }
+            u32 t = 0;
+            for (comment_t const* c = hdr->m_comments; c != nullptr; c = c->m_next)
+                texts[t++] = write_text(image, cursor, c->m_comment);
+            for (objinfo_t const* o = hdr->m_obj_info; o != nullptr; o = o->m_next)
+                texts[t++] = write_text(image, cursor, o->m_comment);
+
+            info.m_data = image;
+            info.m_size = image_size;
+            return true;
+        }
+
+        bool open_info(const u8* data, u64 size, info_t& info)
+        {
+            if (data == nullptr || size < sizeof(info_header_t) || ((uint_t)data & 7) != 0)
+                return false;
+            info_header_t const* ih = (info_header_t const*)data;
+            if (ih->m_magic != c_info_magic || ih->m_version != c_info_version || ih->m_size > size)
+                return false;
+            if (ih->m_elements_offset + (u64)sizeof(info_element_t) * ih->m_num_elements > ih->m_size)
+                return false;
+            if (ih->m_properties_offset + (u64)sizeof(info_property_t) * ih->m_num_properties > ih->m_size)
+                return false;
+            if (ih->m_texts_offset + (u64)sizeof(u32) * (ih->m_num_comments + ih->m_num_obj_info) > ih->m_size)
+                return false;
+            info.m_data = data;
+            info.m_size = ih->m_size;
+            return true;
+        }
+
+        static inline info_header_t const*   get_info_header(info_t const& info) { return (info_header_t const*)info.m_data; }
+        static inline info_element_t const*  get_info_element(info_t const& info, s32 element) { return (info_element_t const*)(info.m_data + get_info_header(info)->m_elements_offset) + element; }
+        static inline info_property_t const* get_info_property(info_t const& info, s32 element, s32 property)
+        {
+            return (info_property_t const*)(info.m_data + get_info_header(info)->m_properties_offset) + get_info_element(info, element)->m_first_property + property;
+        }
+        static inline const char* get_info_text(info_t const& info, u32 offset) { return (const char*)info.m_data + offset; }
+
+        eformat get_format(info_t const& info) { return (eformat)get_info_header(info)->m_format; }
+        u64     get_body_offset(info_t const& info) { return get_info_header(info)->m_body_offset; }
+        s32     get_num_elements(info_t const& info) { return (s32)get_info_header(info)->m_num_elements; }
+
+        static inline string_t make_cstring(const char* str)
+        {
+            const char* end = str;
+            while (*end != 0)
+                end++;
+            return string_t(str, end);
+        }
+
+        u64 get_element_count(info_t const& info, const char* element_name)
+        {
+            s32 const num_elements = get_num_elements(info);
+            for (s32 e = 0; e < num_elements; ++e)
+            {
+                info_element_t const* elem = get_info_element(info, e);
+                if (make_cstring(get_info_text(info, elem->m_name)) == element_name)
+                    return elem->m_count;
+            }
+            return 0;
+        }
+
+        const char* get_element_name(info_t const& info, s32 element) { return get_info_text(info, get_info_element(info, element)->m_name); }
+        u64         get_element_items(info_t const& info, s32 element) { return get_info_element(info, element)->m_count; }
+        s32         get_num_properties(info_t const& info, s32 element) { return (s32)get_info_element(info, element)->m_num_properties; }
+        const char* get_property_name(info_t const& info, s32 element, s32 property) { return get_info_text(info, get_info_property(info, element, property)->m_name); }
+        etype       get_property_type(info_t const& info, s32 element, s32 property) { return (etype)get_info_property(info, element, property)->m_type; }
+        etype       get_property_count_type(info_t const& info, s32 element, s32 property) { return (etype)get_info_property(info, element, property)->m_list_count_type; }
+
+        s32         get_num_comments(info_t const& info) { return (s32)get_info_header(info)->m_num_comments; }
+        const char* get_comment(info_t const& info, s32 index)
+        {
+            u32 const* texts = (u32 const*)(info.m_data + get_info_header(info)->m_texts_offset);
+            return get_info_text(info, texts[index]);
+        }
+        s32         get_num_obj_info(info_t const& info) { return (s32)get_info_header(info)->m_num_obj_info; }
+        const char* get_obj_info(info_t const& info, s32 index)
+        {
+            u32 const* texts = (u32 const*)(info.m_data + get_info_header(info)->m_texts_offset);
+            return get_info_text(info, texts[get_info_header(info)->m_num_comments + index]);
         }
 
     } // namespace nply
-} // namespace ncore
\ No newline at end of file
+} // namespace ncore
@@ -0,0 +1,377 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_pointcloud.h"
+
+#include <math.h>
+
+namespace ncore
+{
+    namespace npointcloud
+    {
+        // Voxel coordinates are stored with 21 bits per axis, the top bit marks a used slot
+        const s32 c_coord_bits = 21;
+        const s32 c_coord_bias = 1 << (c_coord_bits - 1);
+        const u64 c_coord_mask = (1 << c_coord_bits) - 1;
+        const u64 c_used_bit   = (u64)1 << 63;
+        const s32 c_max_k      = 32;
+
+        static inline u64 hash(u64 k)
+        {
+            k ^= k >> 33;
+            k *= 0xff51afd7ed558ccdULL;
+            k ^= k >> 33;
+            k *= 0xc4ceb9fe1a85ec53ULL;
+            k ^= k >> 33;
+            return k;
+        }
+
+        // Clamped in float, a coordinate far outside of the grid does not fit an s32
+        static inline s32 to_cell(f32 v, f32 inv_voxel_size)
+        {
+            f32 c = floorf(v * inv_voxel_size);
+            if (!(c >= (f32)-c_coord_bias))
+                c = (f32)-c_coord_bias;
+            else if (c >= (f32)c_coord_bias)
+                c = (f32)(c_coord_bias - 1);
+            return (s32)c;
+        }
+
+        static inline u64 make_key(s32 x, s32 y, s32 z) { return c_used_bit | ((u64)(x + c_coord_bias) << (2 * c_coord_bits)) | ((u64)(y + c_coord_bias) << c_coord_bits) | (u64)(z + c_coord_bias); }
+
+        static inline void get_cell(u64 key, s32& x, s32& y, s32& z)
+        {
+            x = (s32)((key >> (2 * c_coord_bits)) & c_coord_mask) - c_coord_bias;
+            y = (s32)((key >> c_coord_bits) & c_coord_mask) - c_coord_bias;
+            z = (s32)(key & c_coord_mask) - c_coord_bias;
+        }
+
+        // All tables of a given capacity or none of them
+        static bool alloc_tables(nply::allocator_t* allocator, u32 capacity, s32 attribute_count, u64*& keys, u32*& counts, f64*& sums, f32*& attributes)
+        {
+            keys       = (u64*)allocator->alloc(sizeof(u64) * capacity);
+            counts     = (u32*)allocator->alloc(sizeof(u32) * capacity);
+            sums       = (f64*)allocator->alloc(sizeof(f64) * 3 * capacity);
+            attributes = attribute_count > 0 ? (f32*)allocator->alloc(sizeof(f32) * attribute_count * capacity) : nullptr;
+            if (keys == nullptr || counts == nullptr || sums == nullptr || (attribute_count > 0 && attributes == nullptr))
+            {
+                allocator->dealloc(keys);
+                allocator->dealloc(counts);
+                allocator->dealloc(sums);
+                allocator->dealloc(attributes);
+                keys       = nullptr;
+                counts     = nullptr;
+                sums       = nullptr;
+                attributes = nullptr;
+                return false;
+            }
+            for (u32 i = 0; i < capacity; ++i)
+                keys[i] = 0;
+            return true;
+        }
+
+        voxel_grid_handler_t::voxel_grid_handler_t(nply::allocator_t* allocator, f32 voxel_size, s32 attribute_count, u32 initial_capacity)
+            : m_allocator(allocator)
+            , m_voxel_size(voxel_size)
+            , m_inv_voxel_size(1.0f / voxel_size)
+            , m_attribute_count(attribute_count < MAX_ATTRIBUTES ? attribute_count : (s32)MAX_ATTRIBUTES)
+            , m_capacity(16)
+            , m_count(0)
+            , m_removed(0)
+            , m_input_count(0)
+            , m_out_of_memory(false)
+            , m_keys(nullptr)
+            , m_counts(nullptr)
+            , m_sums(nullptr)
+            , m_attributes(nullptr)
+        {
+            while (m_capacity < initial_capacity)
+                m_capacity <<= 1;
+            if (!alloc_tables(m_allocator, m_capacity, m_attribute_count, m_keys, m_counts, m_sums, m_attributes))
+                m_capacity = 0; // insert tries again with a small table
+            for (s32 i = 0; i < (3 + MAX_ATTRIBUTES); ++i)
+            {
+                m_property_type[i]   = nply::TYPE_INVALID;
+                m_property_offset[i] = 0;
+            }
+        }
+
+        bool voxel_grid_handler_t::setup(s32 element_index, u64 num_items, nply::etype* property_type_array, s32* property_index_array, s32 property_count)
+        {
+            if (element_index == nply::INDEX_VERTEX)
+            {
+                for (s32 i = 0; i < property_count; i++)
+                {
+                    s32 const index = property_index_array[i];
+                    if (index >= 0 && index < (3 + m_attribute_count))
+                    {
+                        m_property_type[index]   = property_type_array[i];
+                        m_property_offset[index] = get_offset(i, property_type_array, property_count);
+                    }
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void voxel_grid_handler_t::read(s32 element_index, nply::etype* property_type_array, s32 property_count, void* property_data)
+        {
+            if (element_index == nply::INDEX_VERTEX)
+            {
+                f32 const x = read_f32(m_property_type[0], m_property_offset[0], property_data);
+                f32 const y = read_f32(m_property_type[1], m_property_offset[1], property_data);
+                f32 const z = read_f32(m_property_type[2], m_property_offset[2], property_data);
+                f32       attributes[MAX_ATTRIBUTES];
+                for (s32 i = 0; i < m_attribute_count; ++i)
+                    attributes[i] = read_f32(m_property_type[3 + i], m_property_offset[3 + i], property_data);
+                insert(x, y, z, attributes);
+            }
+        }
+
+        void voxel_grid_handler_t::release()
+        {
+            m_allocator->dealloc(m_keys);
+            m_allocator->dealloc(m_counts);
+            m_allocator->dealloc(m_sums);
+            m_allocator->dealloc(m_attributes);
+            m_keys       = nullptr;
+            m_counts     = nullptr;
+            m_sums       = nullptr;
+            m_attributes = nullptr;
+            m_capacity   = 0;
+            m_count      = 0;
+            m_removed    = 0;
+        }
+
+        s32 voxel_grid_handler_t::find(u64 key) const
+        {
+            if (m_capacity == 0)
+                return -1;
+            u32 const mask = m_capacity - 1;
+            u32       slot = (u32)hash(key) & mask;
+            while (m_keys[slot] != 0)
+            {
+                if (m_keys[slot] == key)
+                    return (s32)slot;
+                slot = (slot + 1) & mask;
+            }
+            return -1;
+        }
+
+        // @note: Arena allocators ignore dealloc, the old table then stays behind in the arena. Growing
+        //        by a factor of 2 keeps the total at less than twice the final table size.
+        //        When allocation fails the current table is kept and false is returned.
+        bool voxel_grid_handler_t::grow()
+        {
+            u32 const capacity = m_capacity > 0 ? m_capacity * 2 : 16;
+            u64*      keys;
+            u32*      counts;
+            f64*      sums;
+            f32*      attributes;
+            if (!alloc_tables(m_allocator, capacity, m_attribute_count, keys, counts, sums, attributes))
+                return false;
+
+            u32 const old_capacity   = m_capacity;
+            u64*      old_keys       = m_keys;
+            u32*      old_counts     = m_counts;
+            f64*      old_sums       = m_sums;
+            f32*      old_attributes = m_attributes;
+
+            m_capacity   = capacity;
+            m_keys       = keys;
+            m_counts     = counts;
+            m_sums       = sums;
+            m_attributes = attributes;
+
+            u32 const mask = m_capacity - 1;
+            for (u32 i = 0; i < old_capacity; ++i)
+            {
+                if (old_keys[i] == 0)
+                    continue;
+                u32 slot = (u32)hash(old_keys[i]) & mask;
+                while (m_keys[slot] != 0)
+                    slot = (slot + 1) & mask;
+                m_keys[slot]         = old_keys[i];
+                m_counts[slot]       = old_counts[i];
+                m_sums[slot * 3 + 0] = old_sums[i * 3 + 0];
+                m_sums[slot * 3 + 1] = old_sums[i * 3 + 1];
+                m_sums[slot * 3 + 2] = old_sums[i * 3 + 2];
+                for (s32 a = 0; a < m_attribute_count; ++a)
+                    m_attributes[slot * m_attribute_count + a] = old_attributes[i * m_attribute_count + a];
+            }
+
+            m_allocator->dealloc(old_keys);
+            m_allocator->dealloc(old_counts);
+            m_allocator->dealloc(old_sums);
+            m_allocator->dealloc(old_attributes);
+            return true;
+        }
+
+        bool voxel_grid_handler_t::insert(f32 x, f32 y, f32 z, f32 const* attributes)
+        {
+            m_input_count++;
+            if (!isfinite(x) || !isfinite(y) || !isfinite(z))
+                return true;
+
+            // keep the load factor below 1/2
+            if ((m_count + 1) * 2 > m_capacity && !grow())
+            {
+                m_out_of_memory = true;
+                return false;
+            }
+
+            u64 const key  = make_key(to_cell(x, m_inv_voxel_size), to_cell(y, m_inv_voxel_size), to_cell(z, m_inv_voxel_size));
+            u32 const mask = m_capacity - 1;
+            u32       slot = (u32)hash(key) & mask;
+            while (m_keys[slot] != 0 && m_keys[slot] != key)
+                slot = (slot + 1) & mask;
+
+            if (m_keys[slot] == 0 || m_counts[slot] == 0)
+            {
+                // a new voxel, or one that was removed as an outlier and starts over
+                if (m_keys[slot] == 0)
+                    m_count++;
+                else
+                    m_removed--;
+                m_keys[slot]         = key;
+                m_counts[slot]       = 0;
+                m_sums[slot * 3 + 0] = 0.0;
+                m_sums[slot * 3 + 1] = 0.0;
+                m_sums[slot * 3 + 2] = 0.0;
+                for (s32 a = 0; a < m_attribute_count; ++a)
+                    m_attributes[slot * m_attribute_count + a] = 0.0f;
+            }
+
+            // Attributes are kept as a running mean, the position as a sum in double precision
+            u32 const n = ++m_counts[slot];
+            m_sums[slot * 3 + 0] += x;
+            m_sums[slot * 3 + 1] += y;
+            m_sums[slot * 3 + 2] += z;
+            if (attributes != nullptr)
+            {
+                f32* dst = m_attributes + slot * m_attribute_count;
+                for (s32 a = 0; a < m_attribute_count; ++a)
+                    dst[a] += (attributes[a] - dst[a]) / (f32)n;
+            }
+            return true;
+        }
+
+        u32 voxel_grid_handler_t::remove_outliers(s32 k, f32 std_ratio, s32 search_radius)
+        {
+            if (m_count == m_removed || k <= 0)
+                return 0;
+            if (k > c_max_k)
+                k = c_max_k;
+
+            // Mean distance to the k nearest neighbours per slot, < 0 for free/removed slots and isolated points
+            f32* mean_distance = (f32*)m_allocator->alloc(sizeof(f32) * m_capacity);
+            if (mean_distance == nullptr)
+                return 0;
+
+            f64 sum    = 0.0;
+            f64 sum_sq = 0.0;
+            u32 n      = 0;
+            for (u32 s = 0; s < m_capacity; ++s)
+            {
+                mean_distance[s] = -1.0f;
+                if (m_keys[s] == 0 || m_counts[s] == 0)
+                    continue;
+
+                f64 const px = m_sums[s * 3 + 0] / m_counts[s];
+                f64 const py = m_sums[s * 3 + 1] / m_counts[s];
+                f64 const pz = m_sums[s * 3 + 2] / m_counts[s];
+                s32       cx, cy, cz;
+                get_cell(m_keys[s], cx, cy, cz);
+
+                // k smallest squared distances, sorted
+                f32 nearest[c_max_k];
+                s32 found = 0;
+                for (s32 dz = -search_radius; dz <= search_radius; ++dz)
+                {
+                    for (s32 dy = -search_radius; dy <= search_radius; ++dy)
+                    {
+                        for (s32 dx = -search_radius; dx <= search_radius; ++dx)
+                        {
+                            if (dx == 0 && dy == 0 && dz == 0)
+                                continue;
+                            s32 const o = find(make_key(cx + dx, cy + dy, cz + dz));
+                            if (o < 0 || m_counts[o] == 0)
+                                continue;
+                            f64 const ox = m_sums[o * 3 + 0] / m_counts[o] - px;
+                            f64 const oy = m_sums[o * 3 + 1] / m_counts[o] - py;
+                            f64 const oz = m_sums[o * 3 + 2] / m_counts[o] - pz;
+                            f32 const d  = (f32)(ox * ox + oy * oy + oz * oz);
+                            if (found == k && d >= nearest[k - 1])
+                                continue;
+                            s32 j = found < k ? found++ : k - 1;
+                            while (j > 0 && nearest[j - 1] > d)
+                            {
+                                nearest[j] = nearest[j - 1];
+                                --j;
+                            }
+                            nearest[j] = d;
+                        }
+                    }
+                }
+
+                if (found == 0)
+                    continue;
+
+                f32 mean = 0.0f;
+                for (s32 i = 0; i < found; ++i)
+                    mean += sqrtf(nearest[i]);
+                mean /= (f32)found;
+                mean_distance[s] = mean;
+                sum += mean;
+                sum_sq += (f64)mean * mean;
+                n++;
+            }
+
+            f64 const mean      = n > 0 ? sum / n : 0.0;
+            f64 const variance  = n > 0 ? (sum_sq / n) - (mean * mean) : 0.0;
+            f64 const threshold = mean + std_ratio * (variance > 0.0 ? sqrt(variance) : 0.0);
+
+            // A point without neighbours in the search radius has all of them further away than the
+            // radius, it is an outlier when that is already above the threshold. Without any distances
+            // to compare with nothing is removed.
+            f64 const isolated = (f64)search_radius * m_voxel_size;
+
+            u32 removed = 0;
+            for (u32 s = 0; s < m_capacity && n > 0; ++s)
+            {
+                if (m_keys[s] == 0 || m_counts[s] == 0)
+                    continue;
+                f64 const distance = mean_distance[s] < 0.0f ? isolated : mean_distance[s];
+                if (distance > threshold)
+                {
+                    m_counts[s] = 0;
+                    removed++;
+                }
+            }
+            m_removed += removed;
+            m_allocator->dealloc(mean_distance);
+            return removed;
+        }
+
+        u32 voxel_grid_handler_t::get_points(nply::vertex_t* positions, f32* attributes, u32 max_points) const
+        {
+            u32 n = 0;
+            for (u32 s = 0; s < m_capacity && n < max_points; ++s)
+            {
+                if (m_keys[s] == 0 || m_counts[s] == 0)
+                    continue;
+                f64 const inv = 1.0 / (f64)m_counts[s];
+                positions[n].x = (f32)(m_sums[s * 3 + 0] * inv);
+                positions[n].y = (f32)(m_sums[s * 3 + 1] * inv);
+                positions[n].z = (f32)(m_sums[s * 3 + 2] * inv);
+                if (attributes != nullptr)
+                {
+                    for (s32 a = 0; a < m_attribute_count; ++a)
+                        attributes[n * m_attribute_count + a] = m_attributes[s * m_attribute_count + a];
+                }
+                n++;
+            }
+            return n;
+        }
+
+    } // namespace npointcloud
+} // namespace ncore
@@ -0,0 +1,421 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_quantize.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#    include <emmintrin.h>
+#    define QUANTIZE_USE_SSE
+#endif
+
+#include <math.h>
+
+namespace ncore
+{
+    namespace nquantize
+    {
+        // Image layout (offsets relative to the start of the image, 8 byte aligned):
+        //
+        //   header_t
+        //   u16 positions[vertex_count * 3]  (x, y, z interleaved)
+        //   u16 normals[vertex_count * 2]    (octahedral u, v, optional)
+        //   indices                          (u16[triangle_count * 3] or a varint stream)
+        //
+        // @note: The image is stored in the native (little) endian format.
+
+        const u32 c_magic       = ('Q' << 0) | ('M' << 8) | ('S' << 16) | ('H' << 24);
+        const u32 c_version     = 1;
+        const u32 c_has_normals = 1;
+
+        struct header_t
+        {
+            u32 m_magic;
+            u32 m_version;
+            u32 m_vertex_count;
+            u32 m_triangle_count;
+            u32 m_flags;
+            u32 m_index_format;
+            f32 m_min[3];
+            f32 m_scale[3]; // position = min + q * scale
+            u64 m_positions_offset;
+            u64 m_normals_offset;
+            u64 m_indices_offset;
+            u64 m_indices_size;
+            u64 m_size;
+        };
+
+        static inline u64 align8(u64 size) { return (size + 7) & ~(u64)7; }
+
+        // [offset, offset + size) lies within 'total' bytes and starts on a u16
+        static inline bool is_block(u64 offset, u64 size, u64 total) { return (offset & 1) == 0 && offset <= total && size <= total - offset; }
+
+        static inline header_t const* get_header(compact_mesh_t const& mesh) { return (header_t const*)mesh.m_data; }
+
+        static inline f32 abs_f32(f32 v) { return v < 0.0f ? -v : v; }
+        static inline f32 sign_f32(f32 v) { return v < 0.0f ? -1.0f : 1.0f; }
+
+        static inline u16 quantize_unorm16(f32 v)
+        {
+            v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+            return (u16)(v * 65535.0f + 0.5f);
+        }
+
+        void oct_encode(f32 x, f32 y, f32 z, u16& u, u16& v)
+        {
+            f32 const l1 = abs_f32(x) + abs_f32(y) + abs_f32(z);
+            if (l1 <= 0.0f)
+            {
+                u = v = 32768;
+                return;
+            }
+            f32 ox = x / l1;
+            f32 oy = y / l1;
+            if (z < 0.0f)
+            {
+                f32 const tx = (1.0f - abs_f32(oy)) * sign_f32(ox);
+                f32 const ty = (1.0f - abs_f32(ox)) * sign_f32(oy);
+                ox           = tx;
+                oy           = ty;
+            }
+            u = quantize_unorm16(ox * 0.5f + 0.5f);
+            v = quantize_unorm16(oy * 0.5f + 0.5f);
+        }
+
+        void oct_decode(u16 u, u16 v, f32& x, f32& y, f32& z)
+        {
+            x           = (f32)u * (2.0f / 65535.0f) - 1.0f;
+            y           = (f32)v * (2.0f / 65535.0f) - 1.0f;
+            z           = 1.0f - abs_f32(x) - abs_f32(y);
+            f32 const t = z < 0.0f ? -z : 0.0f;
+            x += x >= 0.0f ? -t : t;
+            y += y >= 0.0f ? -t : t;
+            f32 const len = sqrtf(x * x + y * y + z * z);
+            if (len > 0.0f)
+            {
+                x /= len;
+                y /= len;
+                z /= len;
+            }
+        }
+
+        static inline u32 zigzag(s32 v) { return ((u32)v << 1) ^ (u32)(v >> 31); }
+        static inline s32 unzigzag(u32 v) { return (s32)(v >> 1) ^ -(s32)(v & 1); }
+
+        static inline u32 varint_size(u32 v)
+        {
+            u32 n = 1;
+            while (v >= 0x80)
+            {
+                v >>= 7;
+                n++;
+            }
+            return n;
+        }
+
+        static inline u8* write_varint(u8* dst, u32 v)
+        {
+            while (v >= 0x80)
+            {
+                *dst++ = (u8)(v | 0x80);
+                v >>= 7;
+            }
+            *dst++ = (u8)v;
+            return dst;
+        }
+
+        static inline u8 const* read_varint(u8 const* src, u8 const* end, u32& v)
+        {
+            v         = 0;
+            u32 shift = 0;
+            while (src < end && shift < 35)
+            {
+                u8 const b = *src++;
+                v |= (u32)(b & 0x7F) << shift;
+                if ((b & 0x80) == 0)
+                    return src;
+                shift += 7;
+            }
+            return nullptr;
+        }
+
+        bool encode(nply::allocator_t* allocator, nply::vertex_t const* vertices, f32 const* normals, u32 vertex_count, nply::triangle_t const* triangles, u32 triangle_count, compact_mesh_t& mesh)
+        {
+            n3d::box_t box;
+            n3d::box_empty(box);
+            for (u32 i = 0; i < vertex_count; ++i)
+                n3d::box_extend(box, vertices[i]);
+            if (vertex_count == 0)
+            {
+                for (s32 a = 0; a < 3; ++a)
+                    box.m_min[a] = box.m_max[a] = 0.0f;
+            }
+
+            // Index stream, delta to the previous index, zigzag and varint
+            u32 const index_count = triangle_count * 3;
+            u64       varint_size_total = 0;
+            {
+                u32 prev = 0;
+                for (u32 i = 0; i < triangle_count; ++i)
+                {
+                    u32 const* idx = &triangles[i].v1;
+                    for (s32 j = 0; j < 3; ++j)
+                    {
+                        if (idx[j] >= vertex_count)
+                            return false;
+                        varint_size_total += varint_size(zigzag((s32)(idx[j] - prev)));
+                        prev = idx[j];
+                    }
+                }
+            }
+            u64 const     u16_size     = (u64)index_count * 2;
+            eindex_format index_format = (vertex_count <= 65536 && u16_size <= varint_size_total) ? INDEX_FORMAT_U16 : INDEX_FORMAT_VARINT;
+            u64 const     indices_size = index_format == INDEX_FORMAT_U16 ? u16_size : varint_size_total;
+
+            u64 offset                 = align8(sizeof(header_t));
+            u64 const positions_offset = offset;
+            offset += align8((u64)vertex_count * 3 * sizeof(u16));
+            u64 const normals_offset = offset;
+            if (normals != nullptr)
+                offset += align8((u64)vertex_count * 2 * sizeof(u16));
+            u64 const indices_offset = offset;
+            offset += align8(indices_size);
+
+            u8* image = (u8*)allocator->alloc(offset);
+            if (image == nullptr)
+                return false;
+            for (u64 i = 0; i < offset; ++i)
+                image[i] = 0;
+
+            header_t* hdr         = (header_t*)image;
+            hdr->m_magic          = c_magic;
+            hdr->m_version        = c_version;
+            hdr->m_vertex_count   = vertex_count;
+            hdr->m_triangle_count = triangle_count;
+            hdr->m_flags          = normals != nullptr ? c_has_normals : 0;
+            hdr->m_index_format   = index_format;
+            for (s32 a = 0; a < 3; ++a)
+            {
+                f32 const extent = box.m_max[a] - box.m_min[a];
+                hdr->m_min[a]    = box.m_min[a];
+                hdr->m_scale[a]  = extent > 0.0f ? extent / 65535.0f : 0.0f;
+            }
+            hdr->m_positions_offset = positions_offset;
+            hdr->m_normals_offset   = normals != nullptr ? normals_offset : 0;
+            hdr->m_indices_offset   = indices_offset;
+            hdr->m_indices_size     = indices_size;
+            hdr->m_size             = offset;
+
+            u16* positions = (u16*)(image + positions_offset);
+            for (u32 i = 0; i < vertex_count; ++i)
+            {
+                f32 const* p = &vertices[i].x;
+                for (s32 a = 0; a < 3; ++a)
+                {
+                    f32 const extent       = box.m_max[a] - box.m_min[a];
+                    positions[i * 3 + a] = extent > 0.0f ? quantize_unorm16((p[a] - box.m_min[a]) / extent) : 0;
+                }
+            }
+
+            if (normals != nullptr)
+            {
+                u16* dst = (u16*)(image + normals_offset);
+                for (u32 i = 0; i < vertex_count; ++i)
+                    oct_encode(normals[i * 3 + 0], normals[i * 3 + 1], normals[i * 3 + 2], dst[i * 2 + 0], dst[i * 2 + 1]);
+            }
+
+            if (index_format == INDEX_FORMAT_U16)
+            {
+                u16* dst = (u16*)(image + indices_offset);
+                for (u32 i = 0; i < triangle_count; ++i)
+                {
+                    dst[i * 3 + 0] = (u16)triangles[i].v1;
+                    dst[i * 3 + 1] = (u16)triangles[i].v2;
+                    dst[i * 3 + 2] = (u16)triangles[i].v3;
+                }
+            }
+            else
+            {
+                u8* dst  = image + indices_offset;
+                u32 prev = 0;
+                for (u32 i = 0; i < triangle_count; ++i)
+                {
+                    u32 const* idx = &triangles[i].v1;
+                    for (s32 j = 0; j < 3; ++j)
+                    {
+                        dst  = write_varint(dst, zigzag((s32)(idx[j] - prev)));
+                        prev = idx[j];
+                    }
+                }
+            }
+
+            mesh.m_data = image;
+            mesh.m_size = offset;
+            return true;
+        }
+
+        bool open(const u8* data, u64 size, compact_mesh_t& mesh)
+        {
+            if (data == nullptr || size < sizeof(header_t) || ((uint_t)data & 7) != 0)
+                return false;
+            header_t const* hdr = (header_t const*)data;
+            if (hdr->m_magic != c_magic || hdr->m_version != c_version || hdr->m_size > size)
+                return false;
+            if (!is_block(hdr->m_positions_offset, (u64)hdr->m_vertex_count * 3 * sizeof(u16), hdr->m_size))
+                return false;
+            if ((hdr->m_flags & c_has_normals) != 0 && !is_block(hdr->m_normals_offset, (u64)hdr->m_vertex_count * 2 * sizeof(u16), hdr->m_size))
+                return false;
+            if (!is_block(hdr->m_indices_offset, hdr->m_indices_size, hdr->m_size))
+                return false;
+            if (hdr->m_index_format == INDEX_FORMAT_U16)
+            {
+                // decode_indices reads all of them without looking at the size
+                if (hdr->m_indices_size < (u64)hdr->m_triangle_count * 3 * sizeof(u16))
+                    return false;
+            }
+            else if (hdr->m_index_format != INDEX_FORMAT_VARINT)
+            {
+                return false;
+            }
+            mesh.m_data = data;
+            mesh.m_size = hdr->m_size;
+            return true;
+        }
+
+        u32           get_vertex_count(compact_mesh_t const& mesh) { return get_header(mesh)->m_vertex_count; }
+        u32           get_triangle_count(compact_mesh_t const& mesh) { return get_header(mesh)->m_triangle_count; }
+        bool          has_normals(compact_mesh_t const& mesh) { return (get_header(mesh)->m_flags & c_has_normals) != 0; }
+        eindex_format get_index_format(compact_mesh_t const& mesh) { return (eindex_format)get_header(mesh)->m_index_format; }
+
+        n3d::box_t get_bounds(compact_mesh_t const& mesh)
+        {
+            header_t const* hdr = get_header(mesh);
+            n3d::box_t      box;
+            for (s32 a = 0; a < 3; ++a)
+            {
+                box.m_min[a] = hdr->m_min[a];
+                box.m_max[a] = hdr->m_min[a] + hdr->m_scale[a] * 65535.0f;
+            }
+            return box;
+        }
+
+        nply::vertex_t get_position(compact_mesh_t const& mesh, u32 index)
+        {
+            header_t const* hdr = get_header(mesh);
+            u16 const*      q   = (u16 const*)(mesh.m_data + hdr->m_positions_offset) + index * 3;
+            nply::vertex_t  v;
+            v.x = hdr->m_min[0] + (f32)q[0] * hdr->m_scale[0];
+            v.y = hdr->m_min[1] + (f32)q[1] * hdr->m_scale[1];
+            v.z = hdr->m_min[2] + (f32)q[2] * hdr->m_scale[2];
+            return v;
+        }
+
+        void decode_positions(compact_mesh_t const& mesh, nply::vertex_t* vertices)
+        {
+            header_t const* hdr   = get_header(mesh);
+            u16 const*      src   = (u16 const*)(mesh.m_data + hdr->m_positions_offset);
+            f32*            dst   = &vertices->x;
+            u32 const       count = hdr->m_vertex_count * 3;
+            u32             i     = 0;
+
+#ifdef QUANTIZE_USE_SSE
+            // The x, y, z pattern repeats every 3 SSE registers (12 values), decode 24 values (8 vertices) per iteration
+            __m128 offset[3], scale[3];
+            for (s32 r = 0; r < 3; ++r)
+            {
+                f32 o[4], s[4];
+                for (s32 j = 0; j < 4; ++j)
+                {
+                    o[j] = hdr->m_min[(r * 4 + j) % 3];
+                    s[j] = hdr->m_scale[(r * 4 + j) % 3];
+                }
+                offset[r] = _mm_loadu_ps(o);
+                scale[r]  = _mm_loadu_ps(s);
+            }
+            __m128i const zero = _mm_setzero_si128();
+            for (; (i + 24) <= count; i += 24)
+            {
+                __m128i const a = _mm_loadu_si128((__m128i const*)(src + i));
+                __m128i const b = _mm_loadu_si128((__m128i const*)(src + i + 8));
+                __m128i const c = _mm_loadu_si128((__m128i const*)(src + i + 16));
+                _mm_storeu_ps(dst + i + 0, _mm_add_ps(offset[0], _mm_mul_ps(scale[0], _mm_cvtepi32_ps(_mm_unpacklo_epi16(a, zero)))));
+                _mm_storeu_ps(dst + i + 4, _mm_add_ps(offset[1], _mm_mul_ps(scale[1], _mm_cvtepi32_ps(_mm_unpackhi_epi16(a, zero)))));
+                _mm_storeu_ps(dst + i + 8, _mm_add_ps(offset[2], _mm_mul_ps(scale[2], _mm_cvtepi32_ps(_mm_unpacklo_epi16(b, zero)))));
+                _mm_storeu_ps(dst + i + 12, _mm_add_ps(offset[0], _mm_mul_ps(scale[0], _mm_cvtepi32_ps(_mm_unpackhi_epi16(b, zero)))));
+                _mm_storeu_ps(dst + i + 16, _mm_add_ps(offset[1], _mm_mul_ps(scale[1], _mm_cvtepi32_ps(_mm_unpacklo_epi16(c, zero)))));
+                _mm_storeu_ps(dst + i + 20, _mm_add_ps(offset[2], _mm_mul_ps(scale[2], _mm_cvtepi32_ps(_mm_unpackhi_epi16(c, zero)))));
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                u32 const a = i % 3;
+                dst[i]      = hdr->m_min[a] + (f32)src[i] * hdr->m_scale[a];
+            }
+        }
+
+        void decode_normals(compact_mesh_t const& mesh, f32* normals)
+        {
+            header_t const* hdr = get_header(mesh);
+            if ((hdr->m_flags & c_has_normals) == 0)
+                return;
+            u16 const* src = (u16 const*)(mesh.m_data + hdr->m_normals_offset);
+            for (u32 i = 0; i < hdr->m_vertex_count; ++i)
+                oct_decode(src[i * 2 + 0], src[i * 2 + 1], normals[i * 3 + 0], normals[i * 3 + 1], normals[i * 3 + 2]);
+        }
+
+        bool decode_indices(compact_mesh_t const& mesh, nply::triangle_t* triangles)
+        {
+            header_t const* hdr   = get_header(mesh);
+            u32 const       count = hdr->m_triangle_count * 3;
+            u32*            dst   = &triangles->v1;
+            if (hdr->m_index_format == INDEX_FORMAT_U16)
+            {
+                u16 const* src = (u16 const*)(mesh.m_data + hdr->m_indices_offset);
+                u32 const  n   = hdr->m_vertex_count;
+                u32        i   = 0;
+#ifdef QUANTIZE_USE_SSE
+                // SSE2 only has a signed 16-bit max, both sides are biased by 2^15
+                __m128i const zero = _mm_setzero_si128();
+                __m128i const bias = _mm_set1_epi16((s16)0x8000);
+                __m128i       high = bias;
+                for (; (i + 8) <= count; i += 8)
+                {
+                    __m128i const v = _mm_loadu_si128((__m128i const*)(src + i));
+                    high            = _mm_max_epi16(high, _mm_xor_si128(v, bias));
+                    _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(v, zero));
+                    _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(v, zero));
+                }
+                u16 lanes[8];
+                _mm_storeu_si128((__m128i*)lanes, high);
+                for (s32 j = 0; j < 8; ++j)
+                {
+                    if (i > 0 && (u32)(lanes[j] ^ 0x8000) >= n)
+                        return false;
+                }
+#endif
+                for (; i < count; ++i)
+                {
+                    dst[i] = src[i];
+                    if (dst[i] >= n)
+                        return false;
+                }
+                return true;
+            }
+
+            u8 const* src  = mesh.m_data + hdr->m_indices_offset;
+            u8 const* end  = src + hdr->m_indices_size;
+            u32       prev = 0;
+            for (u32 i = 0; i < count; ++i)
+            {
+                u32 v;
+                src = read_varint(src, end, v);
+                if (src == nullptr)
+                    return false;
+                prev   = prev + (u32)unzigzag(v);
+                dst[i] = prev;
+                if (prev >= hdr->m_vertex_count)
+                    return false;
+            }
+            return true;
+        }
+
+    } // namespace nquantize
+} // namespace ncore
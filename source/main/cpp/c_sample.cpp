@@ -0,0 +1,558 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_sample.h"
+
+#include <math.h>
+
+namespace ncore
+{
+    namespace nsample
+    {
+        const s32 c_max_parts = 64;
+        const u64 c_block     = 4096; // points per random stream
+        const u32 c_min_part  = 16 * 1024;
+        const u64 c_max_index = 0xFFFFFFFFULL;
+        const u32 c_cell_bits = 21;
+        const u32 c_no_cell   = 0xFFFFFFFF;
+
+        // splitmix64, turns the seed and the block index into independent stream states
+        static inline u64 mix(u64 x)
+        {
+            x += 0x9E3779B97F4A7C15ULL;
+            x  = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            x  = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+            return x ^ (x >> 31);
+        }
+
+        // xorshift64*
+        struct random_t
+        {
+            u64 m_state;
+
+            random_t(u64 seed, u64 stream)
+                : m_state(mix(seed ^ mix(stream)))
+            {
+                if (m_state == 0)
+                    m_state = 1;
+            }
+
+            inline u64 next()
+            {
+                m_state ^= m_state >> 12;
+                m_state ^= m_state << 25;
+                m_state ^= m_state >> 27;
+                return m_state * 0x2545F4914F6CDD1DULL;
+            }
+        };
+
+        static inline f32 unit24(u64 bits) { return (f32)(bits & 0xFFFFFF) * (1.0f / 16777216.0f); } // [0, 1)
+
+        // ----------------------------------------------------------------------------------------
+        // Alias table
+        // ----------------------------------------------------------------------------------------
+
+        class area_task_t : public nparallel::task_t
+        {
+        public:
+            mesh_t const* m_mesh;
+            f64*          m_areas;
+            s32           m_parts;
+            f64           m_sums[c_max_parts];
+
+            virtual void execute(s32 index)
+            {
+                nmesh::positions_t const& p = m_mesh->m_positions;
+                u64                       begin, end;
+                nparallel::get_range(m_mesh->m_triangle_count, m_parts, index, begin, end);
+                f64 sum = 0.0;
+                for (u64 t = begin; t < end; ++t)
+                {
+                    nply::triangle_t const& tri = m_mesh->m_triangles[t];
+                    f64 const               ux  = (f64)p.m_x[tri.v2] - p.m_x[tri.v1];
+                    f64 const               uy  = (f64)p.m_y[tri.v2] - p.m_y[tri.v1];
+                    f64 const               uz  = (f64)p.m_z[tri.v2] - p.m_z[tri.v1];
+                    f64 const               vx  = (f64)p.m_x[tri.v3] - p.m_x[tri.v1];
+                    f64 const               vy  = (f64)p.m_y[tri.v3] - p.m_y[tri.v1];
+                    f64 const               vz  = (f64)p.m_z[tri.v3] - p.m_z[tri.v1];
+                    f64 const               cx  = uy * vz - uz * vy;
+                    f64 const               cy  = uz * vx - ux * vz;
+                    f64 const               cz  = ux * vy - uy * vx;
+                    m_areas[t]                  = 0.5 * sqrt(cx * cx + cy * cy + cz * cz);
+                    sum                        += m_areas[t];
+                }
+                m_sums[index] = sum;
+            }
+        };
+
+        bool build(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, mesh_t const& mesh, table_t& table)
+        {
+            table.m_probability = nullptr;
+            table.m_alias       = nullptr;
+            table.m_count       = 0;
+            table.m_area        = 0.0;
+            if (mesh.m_triangle_count == 0 || mesh.m_triangle_count > c_max_index)
+                return false;
+            scheduler = nparallel::get_scheduler(scheduler);
+
+            u32 const n      = (u32)mesh.m_triangle_count;
+            f64*      scaled = (f64*)allocator->alloc(sizeof(f64) * n);
+            u32*      small  = (u32*)allocator->alloc(sizeof(u32) * n);
+            u32*      large  = (u32*)allocator->alloc(sizeof(u32) * n);
+            f32*      prob   = (f32*)allocator->alloc(sizeof(f32) * n);
+            u32*      alias  = (u32*)allocator->alloc(sizeof(u32) * n);
+            bool      ok     = scaled != nullptr && small != nullptr && large != nullptr && prob != nullptr && alias != nullptr;
+
+            f64 area = 0.0;
+            if (ok)
+            {
+                area_task_t task;
+                task.m_mesh  = &mesh;
+                task.m_areas = scaled;
+                task.m_parts = nparallel::get_parts(scheduler, n, c_min_part);
+                task.m_parts = task.m_parts > c_max_parts ? c_max_parts : task.m_parts;
+                scheduler->run(&task, task.m_parts);
+                for (s32 i = 0; i < task.m_parts; ++i)
+                    area += task.m_sums[i];
+                ok = area > 0.0;
+            }
+
+            if (ok)
+            {
+                // Vose: pair every slot below the average with one above it
+                u32 small_count = 0;
+                u32 large_count = 0;
+                for (u32 i = 0; i < n; ++i)
+                {
+                    scaled[i] = scaled[i] * (f64)n / area;
+                    if (scaled[i] < 1.0)
+                        small[small_count++] = i;
+                    else
+                        large[large_count++] = i;
+                }
+                while (small_count > 0 && large_count > 0)
+                {
+                    u32 const s = small[--small_count];
+                    u32 const l = large[--large_count];
+                    prob[s]     = (f32)scaled[s];
+                    alias[s]    = l;
+                    scaled[l]   = (scaled[l] + scaled[s]) - 1.0;
+                    if (scaled[l] < 1.0)
+                        small[small_count++] = l;
+                    else
+                        large[large_count++] = l;
+                }
+                // what is left is (up to rounding) exactly average
+                while (large_count > 0)
+                {
+                    u32 const l = large[--large_count];
+                    prob[l]     = 1.0f;
+                    alias[l]    = l;
+                }
+                while (small_count > 0)
+                {
+                    u32 const s = small[--small_count];
+                    prob[s]     = 1.0f;
+                    alias[s]    = s;
+                }
+
+                table.m_probability = prob;
+                table.m_alias       = alias;
+                table.m_count       = n;
+                table.m_area        = area;
+            }
+            else
+            {
+                allocator->dealloc(alias);
+                allocator->dealloc(prob);
+            }
+
+            allocator->dealloc(large);
+            allocator->dealloc(small);
+            allocator->dealloc(scaled);
+            return ok;
+        }
+
+        void release(nply::allocator_t* allocator, table_t& table)
+        {
+            allocator->dealloc(table.m_alias);
+            allocator->dealloc(table.m_probability);
+            table.m_probability = nullptr;
+            table.m_alias       = nullptr;
+            table.m_count       = 0;
+            table.m_area        = 0.0;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Sample
+        // ----------------------------------------------------------------------------------------
+
+        class sample_task_t : public nparallel::task_t
+        {
+        public:
+            mesh_t const*  m_mesh;
+            table_t const* m_table;
+            points_t*      m_points;
+            u64            m_seed;
+            u64            m_blocks;
+            s32            m_parts;
+
+            virtual void execute(s32 index)
+            {
+                nmesh::positions_t const& src = m_mesh->m_positions;
+                nmesh::positions_t&       dst = m_points->m_positions;
+                table_t const&            tab = *m_table;
+
+                u64 begin, end;
+                nparallel::get_range(m_blocks, m_parts, index, begin, end);
+                for (u64 block = begin; block < end; ++block)
+                {
+                    random_t  rng(m_seed, block);
+                    u64 const first = block * c_block;
+                    u64 const last  = (first + c_block) < m_points->m_count ? (first + c_block) : m_points->m_count;
+                    for (u64 i = first; i < last; ++i)
+                    {
+                        u64 const r    = rng.next();
+                        u32 const slot = (u32)(((r >> 32) * tab.m_count) >> 32);
+                        u32 const t    = unit24(r) < tab.m_probability[slot] ? slot : tab.m_alias[slot];
+
+                        // uniform barycentric coordinates (Osada et al. 2002)
+                        u64 const r2 = rng.next();
+                        f32 const s  = sqrtf(unit24(r2 >> 40));
+                        f32 const v  = unit24(r2 >> 16);
+                        f32 const b0 = 1.0f - s;
+                        f32 const b1 = s * (1.0f - v);
+                        f32 const b2 = s * v;
+
+                        nply::triangle_t const& tri = m_mesh->m_triangles[t];
+                        dst.m_x[i]                  = b0 * src.m_x[tri.v1] + b1 * src.m_x[tri.v2] + b2 * src.m_x[tri.v3];
+                        dst.m_y[i]                  = b0 * src.m_y[tri.v1] + b1 * src.m_y[tri.v2] + b2 * src.m_y[tri.v3];
+                        dst.m_z[i]                  = b0 * src.m_z[tri.v1] + b1 * src.m_z[tri.v2] + b2 * src.m_z[tri.v3];
+                        for (s32 a = 0; a < m_points->m_attribute_count; ++a)
+                        {
+                            f32 const* values            = m_mesh->m_attributes[a];
+                            m_points->m_attributes[a][i] = b0 * values[tri.v1] + b1 * values[tri.v2] + b2 * values[tri.v3];
+                        }
+                        m_points->m_triangles[i] = t;
+                    }
+                }
+            }
+        };
+
+        static bool alloc_points(nply::allocator_t* allocator, u64 count, s32 attribute_count, points_t& points)
+        {
+            points.m_positions.m_x     = (f32*)allocator->alloc(sizeof(f32) * (count + 1));
+            points.m_positions.m_y     = (f32*)allocator->alloc(sizeof(f32) * (count + 1));
+            points.m_positions.m_z     = (f32*)allocator->alloc(sizeof(f32) * (count + 1));
+            points.m_positions.m_count = count;
+            points.m_attributes        = (f32**)allocator->alloc(sizeof(f32*) * (attribute_count + 1));
+            points.m_attribute_count   = 0;
+            points.m_triangles         = (u32*)allocator->alloc(sizeof(u32) * (count + 1));
+            points.m_count             = count;
+
+            bool ok = points.m_positions.m_x != nullptr && points.m_positions.m_y != nullptr && points.m_positions.m_z != nullptr && points.m_attributes != nullptr && points.m_triangles != nullptr;
+            for (s32 a = 0; ok && a < attribute_count; ++a)
+            {
+                points.m_attributes[a] = (f32*)allocator->alloc(sizeof(f32) * (count + 1));
+                ok                     = points.m_attributes[a] != nullptr;
+                if (ok)
+                    points.m_attribute_count++;
+            }
+            if (!ok)
+                release(allocator, points);
+            return ok;
+        }
+
+        void release(nply::allocator_t* allocator, points_t& points)
+        {
+            for (s32 a = 0; a < points.m_attribute_count; ++a)
+                allocator->dealloc(points.m_attributes[a]);
+            allocator->dealloc(points.m_attributes);
+            allocator->dealloc(points.m_triangles);
+            allocator->dealloc(points.m_positions.m_z);
+            allocator->dealloc(points.m_positions.m_y);
+            allocator->dealloc(points.m_positions.m_x);
+            points.m_positions.m_x     = nullptr;
+            points.m_positions.m_y     = nullptr;
+            points.m_positions.m_z     = nullptr;
+            points.m_positions.m_count = 0;
+            points.m_attributes        = nullptr;
+            points.m_attribute_count   = 0;
+            points.m_triangles         = nullptr;
+            points.m_count             = 0;
+        }
+
+        bool sample(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, mesh_t const& mesh, table_t const& table, u64 count, config_t const& config, points_t& points)
+        {
+            if (table.m_count == 0 || table.m_count != mesh.m_triangle_count || count > c_max_index)
+                return false;
+            scheduler = nparallel::get_scheduler(scheduler);
+
+            s32 const attribute_count = config.m_attributes ? mesh.m_attribute_count : 0;
+            if (!alloc_points(allocator, count, attribute_count, points))
+                return false;
+
+            sample_task_t task;
+            task.m_mesh   = &mesh;
+            task.m_table  = &table;
+            task.m_points = &points;
+            task.m_seed   = config.m_seed;
+            task.m_blocks = (count + c_block - 1) / c_block;
+            task.m_parts  = nparallel::get_parts(scheduler, task.m_blocks, 1);
+            scheduler->run(&task, task.m_parts);
+
+            if (config.m_min_distance > 0.0f && !thin(allocator, scheduler, points, config.m_min_distance))
+            {
+                release(allocator, points);
+                return false;
+            }
+            return true;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Poisson-disk thinning
+        // ----------------------------------------------------------------------------------------
+
+        // Points grouped by grid cell (cell size = the minimum distance), so the points that can be too
+        // close to a point are in the 3x3x3 cells around its own
+        struct grid_t
+        {
+            f32  m_min[3];
+            f32  m_inv_cell;
+            u64* m_keys; // hash, cell coordinates + 1, 0 = empty slot
+            u32* m_ids;  // cell of a slot
+            u64  m_capacity;
+            u64* m_cells;  // coordinates of a cell
+            u32* m_first;  // of a cell in m_points, cell_count + 1
+            u32* m_points; // indices, grouped by cell in point order
+            u32  m_cell_count;
+        };
+
+        static inline u64 hash_key(u64 key) { return key * 0x9E3779B97F4A7C15ULL; }
+
+        static inline u64 cell_key(grid_t const& g, f32 x, f32 y, f32 z)
+        {
+            f32 const p[3] = {x, y, z};
+            u64       key  = 0;
+            for (s32 a = 0; a < 3; ++a)
+            {
+                f32 const q   = (p[a] - g.m_min[a]) * g.m_inv_cell;
+                u32 const max = (1u << c_cell_bits) - 1;
+                u64 const c   = q <= 0.0f ? 0 : (q >= (f32)max ? max : (u32)q);
+                key          |= c << (a * c_cell_bits);
+            }
+            return key;
+        }
+
+        static u32 find_cell(grid_t const& g, u64 key)
+        {
+            u64 slot = (hash_key(key) >> 20) & (g.m_capacity - 1);
+            while (g.m_keys[slot] != 0)
+            {
+                if (g.m_keys[slot] == key + 1)
+                    return g.m_ids[slot];
+                slot = (slot + 1) & (g.m_capacity - 1);
+            }
+            return c_no_cell;
+        }
+
+        static u32 insert_cell(grid_t& g, u64 key)
+        {
+            u64 slot = (hash_key(key) >> 20) & (g.m_capacity - 1);
+            while (g.m_keys[slot] != 0)
+            {
+                if (g.m_keys[slot] == key + 1)
+                    return g.m_ids[slot];
+                slot = (slot + 1) & (g.m_capacity - 1);
+            }
+            g.m_keys[slot]            = key + 1;
+            g.m_ids[slot]             = g.m_cell_count;
+            g.m_cells[g.m_cell_count] = key;
+            return g.m_cell_count++;
+        }
+
+        class thin_task_t : public nparallel::task_t
+        {
+        public:
+            grid_t const*             m_grid;
+            nmesh::positions_t const* m_positions;
+            u8*                       m_keep;
+            u32 const*                m_cells; // of the phase
+            u32                       m_count;
+            s32                       m_parts;
+            f32                       m_min_distance_sq;
+
+            virtual void execute(s32 index)
+            {
+                grid_t const&             g = *m_grid;
+                nmesh::positions_t const& p = *m_positions;
+                u64                       begin, end;
+                nparallel::get_range(m_count, m_parts, index, begin, end);
+                for (u64 c = begin; c < end; ++c)
+                {
+                    u32 const cell = m_cells[c];
+                    u64 const key  = g.m_cells[cell];
+                    u32 const max  = (1u << c_cell_bits) - 1;
+
+                    u32 neighbours[27];
+                    s32 neighbour_count = 0;
+                    for (s32 n = 0; n < 27; ++n)
+                    {
+                        s32 const d[3] = {n % 3 - 1, (n / 3) % 3 - 1, n / 9 - 1};
+                        u64       k    = 0;
+                        bool      in   = true;
+                        for (s32 a = 0; a < 3; ++a)
+                        {
+                            s64 const v = (s64)((key >> (a * c_cell_bits)) & max) + d[a];
+                            in          = in && v >= 0 && v <= (s64)max;
+                            k          |= (u64)(v & max) << (a * c_cell_bits);
+                        }
+                        u32 const id = in ? find_cell(g, k) : c_no_cell;
+                        if (id != c_no_cell)
+                            neighbours[neighbour_count++] = id;
+                    }
+
+                    // the cells of the other phases are not written while this phase runs
+                    for (u32 i = g.m_first[cell]; i < g.m_first[cell + 1]; ++i)
+                    {
+                        u32 const pi   = g.m_points[i];
+                        bool      keep = true;
+                        for (s32 n = 0; keep && n < neighbour_count; ++n)
+                        {
+                            u32 const other = neighbours[n];
+                            for (u32 j = g.m_first[other]; j < g.m_first[other + 1]; ++j)
+                            {
+                                u32 const pj = g.m_points[j];
+                                if (!m_keep[pj])
+                                    continue;
+                                f32 const dx = p.m_x[pi] - p.m_x[pj];
+                                f32 const dy = p.m_y[pi] - p.m_y[pj];
+                                f32 const dz = p.m_z[pi] - p.m_z[pj];
+                                if (dx * dx + dy * dy + dz * dz < m_min_distance_sq)
+                                {
+                                    keep = false;
+                                    break;
+                                }
+                            }
+                        }
+                        m_keep[pi] = keep ? 1 : 0;
+                    }
+                }
+            }
+        };
+
+        bool thin(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, points_t& points, f32 min_distance)
+        {
+            u64 const count = points.m_count;
+            if (count == 0 || !(min_distance > 0.0f))
+                return true;
+            if (count > c_max_index)
+                return false;
+            scheduler = nparallel::get_scheduler(scheduler);
+
+            grid_t g;
+            g.m_capacity = 16;
+            while (g.m_capacity < count * 2)
+                g.m_capacity *= 2;
+            g.m_keys       = (u64*)allocator->alloc(sizeof(u64) * g.m_capacity);
+            g.m_ids        = (u32*)allocator->alloc(sizeof(u32) * g.m_capacity);
+            g.m_cells      = (u64*)allocator->alloc(sizeof(u64) * count);
+            g.m_first      = (u32*)allocator->alloc(sizeof(u32) * (count + 1));
+            g.m_points     = (u32*)allocator->alloc(sizeof(u32) * count);
+            g.m_cell_count = 0;
+            u32* point_cell = (u32*)allocator->alloc(sizeof(u32) * count);
+            u32* phased     = (u32*)allocator->alloc(sizeof(u32) * count); // cells ordered by phase
+            u8*  keep       = (u8*)allocator->alloc(count);
+
+            bool const ok = g.m_keys != nullptr && g.m_ids != nullptr && g.m_cells != nullptr && g.m_first != nullptr && g.m_points != nullptr && point_cell != nullptr && phased != nullptr && keep != nullptr;
+            if (ok)
+            {
+                n3d::box_t const bounds = nmesh::bounds(scheduler, points.m_positions);
+                for (s32 a = 0; a < 3; ++a)
+                    g.m_min[a] = bounds.m_min[a];
+                g.m_inv_cell = 1.0f / min_distance;
+                for (u64 i = 0; i < g.m_capacity; ++i)
+                    g.m_keys[i] = 0;
+
+                // cells and their points, in point order
+                nmesh::positions_t const& p = points.m_positions;
+                for (u64 i = 0; i < count; ++i)
+                {
+                    point_cell[i] = insert_cell(g, cell_key(g, p.m_x[i], p.m_y[i], p.m_z[i]));
+                    keep[i]       = 0;
+                }
+                for (u32 c = 0; c <= g.m_cell_count; ++c)
+                    g.m_first[c] = 0;
+                for (u64 i = 0; i < count; ++i)
+                    g.m_first[point_cell[i] + 1]++;
+                for (u32 c = 0; c < g.m_cell_count; ++c)
+                    g.m_first[c + 1] += g.m_first[c];
+                for (u64 i = 0; i < count; ++i)
+                    g.m_points[g.m_first[point_cell[i]]++] = (u32)i;
+                for (u32 c = g.m_cell_count; c > 0; --c)
+                    g.m_first[c] = g.m_first[c - 1];
+                g.m_first[0] = 0;
+
+                // cells of the same phase are at least 2 cells apart, they do not see each other's points
+                u32 const max = (1u << c_cell_bits) - 1;
+                u32       phase_first[28];
+                for (s32 i = 0; i < 28; ++i)
+                    phase_first[i] = 0;
+                for (u32 c = 0; c < g.m_cell_count; ++c)
+                {
+                    u64 const key   = g.m_cells[c];
+                    u32 const phase = (u32)((key & max) % 3) + (u32)(((key >> c_cell_bits) & max) % 3) * 3 + (u32)(((key >> (2 * c_cell_bits)) & max) % 3) * 9;
+                    point_cell[c]   = phase; // no longer needed per point
+                    phase_first[phase + 1]++;
+                }
+                for (s32 i = 0; i < 27; ++i)
+                    phase_first[i + 1] += phase_first[i];
+                for (u32 c = 0; c < g.m_cell_count; ++c)
+                    phased[phase_first[point_cell[c]]++] = c;
+                for (s32 i = 27; i > 0; --i)
+                    phase_first[i] = phase_first[i - 1];
+                phase_first[0] = 0;
+
+                thin_task_t task;
+                task.m_grid            = &g;
+                task.m_positions       = &points.m_positions;
+                task.m_keep            = keep;
+                task.m_min_distance_sq = min_distance * min_distance;
+                for (s32 phase = 0; phase < 27; ++phase)
+                {
+                    task.m_cells = phased + phase_first[phase];
+                    task.m_count = phase_first[phase + 1] - phase_first[phase];
+                    task.m_parts = nparallel::get_parts(scheduler, task.m_count, 16);
+                    if (task.m_count > 0)
+                        scheduler->run(&task, task.m_parts);
+                }
+
+                u64 kept = 0;
+                for (u64 i = 0; i < count; ++i)
+                {
+                    if (!keep[i])
+                        continue;
+                    points.m_positions.m_x[kept] = points.m_positions.m_x[i];
+                    points.m_positions.m_y[kept] = points.m_positions.m_y[i];
+                    points.m_positions.m_z[kept] = points.m_positions.m_z[i];
+                    points.m_triangles[kept]     = points.m_triangles[i];
+                    for (s32 a = 0; a < points.m_attribute_count; ++a)
+                        points.m_attributes[a][kept] = points.m_attributes[a][i];
+                    kept++;
+                }
+                points.m_count             = kept;
+                points.m_positions.m_count = kept;
+            }
+
+            allocator->dealloc(keep);
+            allocator->dealloc(phased);
+            allocator->dealloc(point_cell);
+            allocator->dealloc(g.m_points);
+            allocator->dealloc(g.m_first);
+            allocator->dealloc(g.m_cells);
+            allocator->dealloc(g.m_ids);
+            allocator->dealloc(g.m_keys);
+            return ok;
+        }
+
+    } // namespace nsample
+} // namespace ncore
@@ -0,0 +1,457 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_svo.h"
+
+namespace ncore
+{
+    namespace nsvo
+    {
+        // Image layout (all offsets are relative to the start of the image and 8 byte aligned):
+        //
+        //   header_t
+        //   level 0 .. depth-1 : u8 masks[node_count] (padded to 8), u32 ranks[(node_count + 63) / 64] (padded to 8)
+        //   u8 values[voxel_count]
+        //
+        // @note: The image is stored in the native (little) endian format.
+
+        const u32 c_magic   = ('S' << 0) | ('V' << 8) | ('O' << 16) | ('C' << 24);
+        const u32 c_version = 1;
+
+        struct level_t
+        {
+            u64 m_masks_offset;
+            u64 m_ranks_offset;
+            u32 m_node_count;
+            u32 m_pad;
+        };
+
+        struct header_t
+        {
+            u32     m_magic;
+            u32     m_version;
+            u32     m_depth;
+            u32     m_voxel_count;
+            u64     m_size;
+            u64     m_values_offset;
+            level_t m_levels[c_max_depth];
+        };
+
+        static inline u64 align8(u64 size) { return (size + 7) & ~(u64)7; }
+
+        static inline u32 popcount(u64 v)
+        {
+            v = v - ((v >> 1) & 0x5555555555555555ULL);
+            v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+            v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+            return (u32)((v * 0x0101010101010101ULL) >> 56);
+        }
+
+        static inline u32 spread_bits(u32 v)
+        {
+            v &= 0x000003FF;
+            v = (v | (v << 16)) & 0xFF0000FF;
+            v = (v | (v << 8)) & 0x0300F00F;
+            v = (v | (v << 4)) & 0x030C30C3;
+            v = (v | (v << 2)) & 0x09249249;
+            return v;
+        }
+
+        static inline u32 compact_bits(u32 v)
+        {
+            v &= 0x09249249;
+            v = (v | (v >> 2)) & 0x030C30C3;
+            v = (v | (v >> 4)) & 0x0300F00F;
+            v = (v | (v >> 8)) & 0xFF0000FF;
+            v = (v | (v >> 16)) & 0x000003FF;
+            return v;
+        }
+
+        static inline u32 morton_encode(u32 x, u32 y, u32 z) { return spread_bits(x) | (spread_bits(y) << 1) | (spread_bits(z) << 2); }
+
+        static inline const header_t* get_header(svo_t const& svo) { return (const header_t*)svo.m_data; }
+
+        // Sum of the bits of all masks in front of 'node'
+        static u32 rank(const u8* masks, const u32* ranks, u32 node)
+        {
+            u32       r     = ranks[node >> 6];
+            u64 const* word = (const u64*)(masks + (node & ~63));
+            u32       bytes = node & 63;
+            while (bytes >= 8)
+            {
+                r += popcount(*word++);
+                bytes -= 8;
+            }
+            if (bytes > 0)
+            {
+                u64 v = 0;
+                for (u32 i = 0; i < bytes; ++i)
+                    v |= (u64)((const u8*)word)[i] << (i * 8);
+                r += popcount(v);
+            }
+            return r;
+        }
+
+        // Reduce the sorted keys of one level to the keys of the parent level, writing one
+        // child mask per parent node. Returns the number of parent nodes.
+        static u32 reduce_level(u32* keys, u32 count, u8* masks)
+        {
+            u32 n = 0;
+            u32 i = 0;
+            while (i < count)
+            {
+                u32 const parent = keys[i] >> 3;
+                u8        mask   = 0;
+                while (i < count && (keys[i] >> 3) == parent)
+                {
+                    mask |= (u8)(1 << (keys[i] & 7));
+                    i++;
+                }
+                if (masks != nullptr)
+                    masks[n] = mask;
+                keys[n++] = parent;
+            }
+            return n;
+        }
+
+        // Build the image from sorted and unique morton codes
+        static bool build_sorted(nply::allocator_t* allocator, u32 depth, u32 const* codes, u8 const* values, u32 voxel_count, svo_t& svo)
+        {
+            u32* keys = (u32*)allocator->alloc(sizeof(u32) * (voxel_count + 1));
+            if (keys == nullptr)
+                return false;
+
+            // First pass, count the nodes of every level
+            u32 node_counts[c_max_depth];
+            for (u32 i = 0; i < voxel_count; ++i)
+                keys[i] = codes[i];
+            u32 count = voxel_count;
+            for (s32 l = (s32)depth - 1; l >= 0; --l)
+            {
+                count          = reduce_level(keys, count, nullptr);
+                node_counts[l] = count;
+            }
+
+            // Layout
+            u64 offset = align8(sizeof(header_t));
+            u64 masks_offsets[c_max_depth];
+            u64 ranks_offsets[c_max_depth];
+            for (u32 l = 0; l < depth; ++l)
+            {
+                masks_offsets[l] = offset;
+                offset += align8(node_counts[l]);
+                ranks_offsets[l] = offset;
+                offset += align8(sizeof(u32) * ((node_counts[l] + 63) / 64));
+            }
+            u64 const values_offset = offset;
+            offset += align8(voxel_count);
+
+            u8* image = (u8*)allocator->alloc(offset);
+            if (image == nullptr)
+            {
+                allocator->dealloc(keys);
+                return false;
+            }
+            for (u64 i = 0; i < offset; ++i)
+                image[i] = 0;
+
+            header_t* hdr        = (header_t*)image;
+            hdr->m_magic         = c_magic;
+            hdr->m_version       = c_version;
+            hdr->m_depth         = depth;
+            hdr->m_voxel_count   = voxel_count;
+            hdr->m_size          = offset;
+            hdr->m_values_offset = values_offset;
+            for (u32 l = 0; l < depth; ++l)
+            {
+                hdr->m_levels[l].m_masks_offset = masks_offsets[l];
+                hdr->m_levels[l].m_ranks_offset = ranks_offsets[l];
+                hdr->m_levels[l].m_node_count   = node_counts[l];
+            }
+
+            // Second pass, write the masks of every level
+            for (u32 i = 0; i < voxel_count; ++i)
+                keys[i] = codes[i];
+            count = voxel_count;
+            for (s32 l = (s32)depth - 1; l >= 0; --l)
+                count = reduce_level(keys, count, image + masks_offsets[l]);
+
+            // Rank tables
+            for (u32 l = 0; l < depth; ++l)
+            {
+                u8 const* masks = image + masks_offsets[l];
+                u32*      ranks = (u32*)(image + ranks_offsets[l]);
+                u32       r     = 0;
+                for (u32 i = 0; i < node_counts[l]; ++i)
+                {
+                    if ((i & 63) == 0)
+                        ranks[i >> 6] = r;
+                    r += popcount(masks[i]);
+                }
+            }
+
+            u8* dst_values = image + values_offset;
+            for (u32 i = 0; i < voxel_count; ++i)
+                dst_values[i] = values[i];
+
+            allocator->dealloc(keys);
+            svo.m_data = image;
+            svo.m_size = offset;
+            return true;
+        }
+
+        // Stable LSD radix sort of (code << 8 | value) on the code bits, nullptr when allocation failed
+        static u64* sort_voxels(nply::allocator_t* allocator, u32 depth, voxel_t const* voxels, u32 voxel_count)
+        {
+            u64* a = (u64*)allocator->alloc(sizeof(u64) * (voxel_count + 1));
+            u64* b = (u64*)allocator->alloc(sizeof(u64) * (voxel_count + 1));
+            if (a == nullptr || b == nullptr)
+            {
+                allocator->dealloc(a);
+                allocator->dealloc(b);
+                return nullptr;
+            }
+            for (u32 i = 0; i < voxel_count; ++i)
+            {
+                voxel_t const& v = voxels[i];
+                a[i]             = ((u64)morton_encode(v.x, v.y, v.z) << 8) | v.value;
+            }
+
+            u32 const bits = depth * 3;
+            for (u32 shift = 0; shift < bits; shift += 8)
+            {
+                u32 histogram[256];
+                for (u32 i = 0; i < 256; ++i)
+                    histogram[i] = 0;
+                for (u32 i = 0; i < voxel_count; ++i)
+                    histogram[(a[i] >> (8 + shift)) & 0xFF]++;
+                u32 sum = 0;
+                for (u32 i = 0; i < 256; ++i)
+                {
+                    u32 const c  = histogram[i];
+                    histogram[i] = sum;
+                    sum += c;
+                }
+                for (u32 i = 0; i < voxel_count; ++i)
+                    b[histogram[(a[i] >> (8 + shift)) & 0xFF]++] = a[i];
+                u64* t = a;
+                a      = b;
+                b      = t;
+            }
+            allocator->dealloc(b);
+            return a;
+        }
+
+        static bool valid_voxels(u32 depth, voxel_t const* voxels, u32 voxel_count)
+        {
+            u32 const size = 1 << depth;
+            for (u32 i = 0; i < voxel_count; ++i)
+            {
+                if (voxels[i].x >= size || voxels[i].y >= size || voxels[i].z >= size)
+                    return false;
+            }
+            return true;
+        }
+
+        bool build(nply::allocator_t* allocator, u32 depth, voxel_t* voxels, u32 voxel_count, svo_t& svo)
+        {
+            if (depth == 0 || depth > c_max_depth || !valid_voxels(depth, voxels, voxel_count))
+                return false;
+
+            u64* sorted = sort_voxels(allocator, depth, voxels, voxel_count);
+            u32* codes  = (u32*)allocator->alloc(sizeof(u32) * (voxel_count + 1));
+            u8*  values = (u8*)allocator->alloc(voxel_count + 1);
+            bool ok     = sorted != nullptr && codes != nullptr && values != nullptr;
+
+            // Unique (last one wins) and remove empty voxels
+            u32 n = 0;
+            for (u32 i = 0; ok && i < voxel_count; ++i)
+            {
+                if ((i + 1) < voxel_count && (sorted[i] >> 8) == (sorted[i + 1] >> 8))
+                    continue;
+                if ((sorted[i] & 0xFF) == 0)
+                    continue;
+                codes[n]  = (u32)(sorted[i] >> 8);
+                values[n] = (u8)(sorted[i] & 0xFF);
+                n++;
+            }
+            ok = ok && build_sorted(allocator, depth, codes, values, n, svo);
+
+            allocator->dealloc(sorted);
+            allocator->dealloc(codes);
+            allocator->dealloc(values);
+            return ok;
+        }
+
+        // Expand the levels into the (sorted) morton codes of all the voxels, 'codes' should be able to hold voxel_count entries
+        static void decode_codes(svo_t const& svo, u32* codes)
+        {
+            header_t const* hdr = get_header(svo);
+            if (hdr->m_voxel_count == 0)
+                return;
+
+            codes[0]  = 0;
+            u32 count = 1;
+            for (u32 l = 0; l < hdr->m_depth; ++l)
+            {
+                u8 const* masks = svo.m_data + hdr->m_levels[l].m_masks_offset;
+                u32 const total = (l + 1) < hdr->m_depth ? hdr->m_levels[l + 1].m_node_count : hdr->m_voxel_count;
+
+                // Children of node i are never in front of i, so expand in place from the back
+                u32 dst = total;
+                for (s32 i = (s32)count - 1; i >= 0; --i)
+                {
+                    u32 const parent = codes[i];
+                    u8 const  mask   = masks[i];
+                    for (s32 c = 7; c >= 0; --c)
+                    {
+                        if (mask & (1 << c))
+                            codes[--dst] = (parent << 3) | (u32)c;
+                    }
+                }
+                ASSERT(dst == 0);
+                count = total;
+            }
+        }
+
+        bool merge(nply::allocator_t* allocator, svo_t const& svo, voxel_t* voxels, u32 voxel_count, svo_t& merged)
+        {
+            header_t const* hdr   = get_header(svo);
+            u32 const       depth = hdr->m_depth;
+            if (!valid_voxels(depth, voxels, voxel_count))
+                return false;
+
+            u32 const existing_count  = hdr->m_voxel_count;
+            u32*      existing_codes  = (u32*)allocator->alloc(sizeof(u32) * (existing_count + 1));
+            u8 const* existing_values = svo.m_data + hdr->m_values_offset;
+            u64*      sorted          = sort_voxels(allocator, depth, voxels, voxel_count);
+            u32 const max_count       = existing_count + voxel_count;
+            u32*      codes           = (u32*)allocator->alloc(sizeof(u32) * (max_count + 1));
+            u8*       values          = (u8*)allocator->alloc(max_count + 1);
+            bool      ok              = existing_codes != nullptr && sorted != nullptr && codes != nullptr && values != nullptr;
+            if (ok)
+                decode_codes(svo, existing_codes);
+
+            // Merge the two sorted streams, the new voxels win
+            u32 n = 0;
+            u32 i = 0;
+            u32 j = 0;
+            while (ok && (i < existing_count || j < voxel_count))
+            {
+                u32 code;
+                u8  value;
+                if (j < voxel_count)
+                {
+                    // skip to the last of the duplicates
+                    while ((j + 1) < voxel_count && (sorted[j] >> 8) == (sorted[j + 1] >> 8))
+                        j++;
+                }
+                if (j >= voxel_count || (i < existing_count && existing_codes[i] < (u32)(sorted[j] >> 8)))
+                {
+                    code  = existing_codes[i];
+                    value = existing_values[i];
+                    i++;
+                }
+                else
+                {
+                    code  = (u32)(sorted[j] >> 8);
+                    value = (u8)(sorted[j] & 0xFF);
+                    if (i < existing_count && existing_codes[i] == code)
+                        i++;
+                    j++;
+                }
+                if (value != 0)
+                {
+                    codes[n]  = code;
+                    values[n] = value;
+                    n++;
+                }
+            }
+
+            ok = ok && build_sorted(allocator, depth, codes, values, n, merged);
+
+            allocator->dealloc(existing_codes);
+            allocator->dealloc(sorted);
+            allocator->dealloc(codes);
+            allocator->dealloc(values);
+            return ok;
+        }
+
+        bool open(const u8* data, u64 size, svo_t& svo)
+        {
+            if (data == nullptr || size < sizeof(header_t) || ((uint_t)data & 7) != 0)
+                return false;
+
+            header_t const* hdr = (header_t const*)data;
+            if (hdr->m_magic != c_magic || hdr->m_version != c_version)
+                return false;
+            if (hdr->m_depth == 0 || hdr->m_depth > c_max_depth || hdr->m_size > size)
+                return false;
+            if ((hdr->m_values_offset + hdr->m_voxel_count) > hdr->m_size)
+                return false;
+            for (u32 l = 0; l < hdr->m_depth; ++l)
+            {
+                level_t const& level = hdr->m_levels[l];
+                if ((level.m_masks_offset + level.m_node_count) > hdr->m_size)
+                    return false;
+                if ((level.m_ranks_offset + sizeof(u32) * ((level.m_node_count + 63) / 64)) > hdr->m_size)
+                    return false;
+            }
+
+            svo.m_data = data;
+            svo.m_size = hdr->m_size;
+            return true;
+        }
+
+        u32 get_depth(svo_t const& svo) { return get_header(svo)->m_depth; }
+        u32 get_voxel_count(svo_t const& svo) { return get_header(svo)->m_voxel_count; }
+
+        u8 get_voxel(svo_t const& svo, u32 x, u32 y, u32 z)
+        {
+            header_t const* hdr   = get_header(svo);
+            u32 const       depth = hdr->m_depth;
+            u32 const       size  = 1 << depth;
+            if (hdr->m_voxel_count == 0 || x >= size || y >= size || z >= size)
+                return 0;
+
+            u32 const code = morton_encode(x, y, z);
+            u32       node = 0;
+            for (u32 l = 0; l < depth; ++l)
+            {
+                level_t const& level = hdr->m_levels[l];
+                u8 const*      masks = svo.m_data + level.m_masks_offset;
+                u32 const*     ranks = (u32 const*)(svo.m_data + level.m_ranks_offset);
+                u32 const      child = (code >> (3 * (depth - 1 - l))) & 7;
+                u8 const       mask  = masks[node];
+                if ((mask & (1 << child)) == 0)
+                    return 0;
+                node = rank(masks, ranks, node) + popcount(mask & ((1 << child) - 1));
+            }
+            return svo.m_data[hdr->m_values_offset + node];
+        }
+
+        u32 decode(svo_t const& svo, voxel_t* voxels, u32 voxel_max)
+        {
+            header_t const* hdr = get_header(svo);
+            if (voxel_max < hdr->m_voxel_count)
+                return 0;
+
+            // Use the output array as scratch for the codes, a voxel_t is larger than a u32
+            u32* codes = (u32*)(voxels + voxel_max) - hdr->m_voxel_count;
+            decode_codes(svo, codes);
+
+            u8 const* values = svo.m_data + hdr->m_values_offset;
+            for (u32 i = 0; i < hdr->m_voxel_count; ++i)
+            {
+                u32 const code = codes[i];
+                voxel_t&  v    = voxels[i];
+                v.x            = (u16)compact_bits(code);
+                v.y            = (u16)compact_bits(code >> 1);
+                v.z            = (u16)compact_bits(code >> 2);
+                v.value        = values[i];
+                v.pad          = 0;
+            }
+            return hdr->m_voxel_count;
+        }
+
+    } // namespace nsvo
+} // namespace ncore
@@ -0,0 +1,259 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_synthetic.h"
+
+namespace ncore
+{
+    namespace nsynthetic
+    {
+        // Buffers the output and hands it to the writer in chunks
+        class output_t
+        {
+        public:
+            enum
+            {
+                BUFFER_SIZE = 16 * 1024,
+            };
+
+            output_t(writer_t* writer)
+                : m_writer(writer)
+                , m_used(0)
+                , m_ok(true)
+            {
+            }
+
+            inline void put(u8 c)
+            {
+                if (m_used == BUFFER_SIZE)
+                    flush();
+                m_buffer[m_used++] = c;
+            }
+
+            void text(const char* str)
+            {
+                while (*str != 0)
+                    put((u8)*str++);
+            }
+
+            void text_uint(u64 v)
+            {
+                char digits[24];
+                s32  n = 0;
+                do
+                {
+                    digits[n++] = (char)('0' + (v % 10));
+                    v /= 10;
+                } while (v != 0);
+                while (n > 0)
+                    put((u8)digits[--n]);
+            }
+
+            void text_int(s64 v)
+            {
+                if (v < 0)
+                {
+                    put('-');
+                    text_uint((u64)(-v));
+                }
+                else
+                {
+                    text_uint((u64)v);
+                }
+            }
+
+            // Fixed notation with 6 decimals
+            void text_float(f64 v)
+            {
+                if (v < 0.0)
+                {
+                    put('-');
+                    v = -v;
+                }
+                u64 const scaled = (u64)(v * 1000000.0 + 0.5);
+                text_uint(scaled / 1000000);
+                put('.');
+                u64 frac = scaled % 1000000;
+                for (u64 d = 100000; d > 0; d /= 10)
+                {
+                    put((u8)('0' + frac / d));
+                    frac %= d;
+                }
+            }
+
+            // Binary, in little or big endian byte order (host is little endian)
+            void bytes(const void* data, s32 size, bool big_endian)
+            {
+                u8 const* src = (u8 const*)data;
+                for (s32 i = 0; i < size; ++i)
+                    put(big_endian ? src[size - 1 - i] : src[i]);
+            }
+
+            void flush()
+            {
+                if (m_used > 0 && m_ok)
+                    m_ok = m_writer->write(m_buffer, m_used);
+                m_used = 0;
+            }
+
+            writer_t* m_writer;
+            u32       m_used;
+            bool      m_ok;
+            u8        m_buffer[BUFFER_SIZE];
+        };
+
+        // xorshift64*, deterministic for a given seed
+        struct random_t
+        {
+            u64 m_state;
+
+            random_t(u32 seed)
+                : m_state(0x9E3779B97F4A7C15ull ^ (u64)seed)
+            {
+                if (m_state == 0)
+                    m_state = 1;
+            }
+
+            inline u64 next()
+            {
+                m_state ^= m_state >> 12;
+                m_state ^= m_state << 25;
+                m_state ^= m_state >> 27;
+                return m_state * 0x2545F4914F6CDD1Dull;
+            }
+
+            inline f64 next_f64() { return (f64)(next() >> 11) * (1.0 / 9007199254740992.0); } // [0, 1)
+        };
+
+        static const char* type_name(nply::etype type)
+        {
+            switch (type)
+            {
+                case nply::TYPE_INT8: return "char";
+                case nply::TYPE_UINT8: return "uchar";
+                case nply::TYPE_INT16: return "short";
+                case nply::TYPE_UINT16: return "ushort";
+                case nply::TYPE_INT32: return "int";
+                case nply::TYPE_UINT32: return "uint";
+                case nply::TYPE_FLOAT32: return "float";
+                case nply::TYPE_FLOAT64: return "double";
+                default: break;
+            }
+            return "uchar";
+        }
+
+        template <typename T> static inline void write_binary(output_t& out, T v, bool big_endian) { out.bytes(&v, sizeof(T), big_endian); }
+
+        static void write_value(output_t& out, nply::eformat format, nply::etype type, f64 value)
+        {
+            if (format == nply::FORMAT_ASCII)
+            {
+                if (nply::type_is_float(type))
+                    out.text_float(value);
+                else if (nply::type_is_int(type))
+                    out.text_int((s64)value);
+                else
+                    out.text_uint((u64)value);
+                return;
+            }
+
+            bool const big_endian = format == nply::FORMAT_BBE;
+            switch (type)
+            {
+                case nply::TYPE_INT8: write_binary<s8>(out, (s8)value, big_endian); break;
+                case nply::TYPE_UINT8: write_binary<u8>(out, (u8)value, big_endian); break;
+                case nply::TYPE_INT16: write_binary<s16>(out, (s16)value, big_endian); break;
+                case nply::TYPE_UINT16: write_binary<u16>(out, (u16)value, big_endian); break;
+                case nply::TYPE_INT32: write_binary<s32>(out, (s32)value, big_endian); break;
+                case nply::TYPE_UINT32: write_binary<u32>(out, (u32)value, big_endian); break;
+                case nply::TYPE_FLOAT32: write_binary<f32>(out, (f32)value, big_endian); break;
+                case nply::TYPE_FLOAT64: write_binary<f64>(out, value, big_endian); break;
+                default: break;
+            }
+        }
+
+        static inline void separate(output_t& out, nply::eformat format, bool last)
+        {
+            if (format == nply::FORMAT_ASCII)
+                out.put(last ? '\n' : ' ');
+        }
+
+        bool generate(config_t const& config, writer_t* writer)
+        {
+            output_t out(writer);
+
+            out.text("ply\nformat ");
+            out.text(config.m_format == nply::FORMAT_ASCII ? "ascii" : (config.m_format == nply::FORMAT_BLE ? "binary_little_endian" : "binary_big_endian"));
+            out.text(" 1.0\ncomment synthetic seed ");
+            out.text_uint(config.m_seed);
+            out.text("\nelement vertex ");
+            out.text_uint(config.m_vertex_count);
+            out.text("\n");
+            const char* axis[3] = {"x", "y", "z"};
+            for (s32 i = 0; i < 3; ++i)
+            {
+                out.text("property ");
+                out.text(type_name(config.m_position_type));
+                out.text(" ");
+                out.text(axis[i]);
+                out.text("\n");
+            }
+            for (s32 i = 0; i < config.m_attribute_count; ++i)
+            {
+                out.text("property ");
+                out.text(type_name(config.m_attribute_type));
+                out.text(" a");
+                out.text_uint((u64)i);
+                out.text("\n");
+            }
+            if (config.m_face_count > 0)
+            {
+                out.text("element face ");
+                out.text_uint(config.m_face_count);
+                out.text("\nproperty list ");
+                out.text(type_name(config.m_count_type));
+                out.text(" ");
+                out.text(type_name(config.m_index_type));
+                out.text(" vertex_indices\n");
+            }
+            out.text("end_header\n");
+
+            random_t  rng(config.m_seed);
+            s32 const vertex_properties = 3 + config.m_attribute_count;
+            for (u64 v = 0; v < config.m_vertex_count; ++v)
+            {
+                for (s32 p = 0; p < vertex_properties; ++p)
+                {
+                    if (p < 3)
+                    {
+                        f64 const value = rng.next_f64() * 200.0 - 100.0;
+                        write_value(out, config.m_format, config.m_position_type, value);
+                    }
+                    else
+                    {
+                        f64 value = (f64)(rng.next() % 256);
+                        if (nply::type_is_float(config.m_attribute_type))
+                            value = value / 255.0;
+                        write_value(out, config.m_format, config.m_attribute_type, value);
+                    }
+                    separate(out, config.m_format, p == vertex_properties - 1);
+                }
+            }
+
+            u64 const vertex_count = config.m_vertex_count > 0 ? config.m_vertex_count : 1;
+            for (u64 f = 0; f < config.m_face_count; ++f)
+            {
+                write_value(out, config.m_format, config.m_count_type, (f64)config.m_face_arity);
+                separate(out, config.m_format, false);
+                for (s32 k = 0; k < config.m_face_arity; ++k)
+                {
+                    write_value(out, config.m_format, config.m_index_type, (f64)(rng.next() % vertex_count));
+                    separate(out, config.m_format, k == config.m_face_arity - 1);
+                }
+            }
+
+            out.flush();
+            return out.m_ok;
+        }
+
+    } // namespace nsynthetic
+} // namespace ncore
@@ -0,0 +1,522 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_tessellate.h"
+
+namespace ncore
+{
+    namespace ntessellate
+    {
+        // Every round runs the same passes over ranges of the triangles:
+        //
+        //   classify   mark the edges that are too long, count the triangles that will be emitted
+        //   insert     put the marked edges in a lock-free hash, the first triangle (index) owns an edge
+        //   own        count the edges every part owns, their midpoints are numbered in triangle order
+        //   midpoint   copy the vertices, the owner of an edge appends its midpoint
+        //   emit       write the 1 to 4 triangles of every triangle, the midpoints come from the hash
+        //
+        // Numbering the midpoints by owner (instead of by hash slot or by whoever came first) makes the
+        // result independent of the number of threads and the order in which they run.
+
+        const s32 c_max_parts = 64;
+        const u32 c_min_part  = 4 * 1024;
+        const u64 c_no_owner  = 0xFFFFFFFFFFFFFFFFULL;
+        const u64 c_max_index = 0xFFFFFFFFULL; // vertex indices are u32
+
+        struct round_t
+        {
+            mesh_t const* m_src;
+            mesh_t*       m_dst;
+            f32           m_max_length_sq; // < 0: split nothing
+            s32           m_parts;
+            u8*           m_masks; // bit e: edge e is split, bit 3 + e: the triangle owns edge e
+            u64*          m_keys;  // edge hash, 0 = empty slot
+            u64*          m_values;
+            u64           m_capacity;
+            u32           m_shift;
+            u64           m_edges[c_max_parts];     // edges to split, later the edges that are owned
+            u64           m_triangles[c_max_parts]; // triangles to emit, later the first one of the part
+            u64           m_vertices[c_max_parts];  // the first midpoint of the part
+        };
+
+        static s32 get_parts(nparallel::scheduler_t* scheduler, u64 count)
+        {
+            s32 const parts = nparallel::get_parts(scheduler, count, c_min_part);
+            return parts > c_max_parts ? c_max_parts : parts;
+        }
+
+        static inline u32 get_corner(nply::triangle_t const& tri, s32 i) { return i == 0 ? tri.v1 : (i == 1 ? tri.v2 : tri.v3); }
+
+        // lo < hi for every edge that is split, so a key is never 0
+        static inline u64 edge_key(u32 a, u32 b) { return a < b ? (((u64)a << 32) | b) : (((u64)b << 32) | a); }
+
+        static inline f32 distance_sq(nmesh::positions_t const& p, u32 a, u32 b)
+        {
+            f32 const dx = p.m_x[a] - p.m_x[b];
+            f32 const dy = p.m_y[a] - p.m_y[b];
+            f32 const dz = p.m_z[a] - p.m_z[b];
+            return dx * dx + dy * dy + dz * dz;
+        }
+
+        // Distance of vertex 'a' to the midpoint of edge (b, c)
+        static inline f32 distance_to_midpoint_sq(nmesh::positions_t const& p, u32 a, u32 b, u32 c)
+        {
+            f32 const dx = p.m_x[a] - (p.m_x[b] + p.m_x[c]) * 0.5f;
+            f32 const dy = p.m_y[a] - (p.m_y[b] + p.m_y[c]) * 0.5f;
+            f32 const dz = p.m_z[a] - (p.m_z[b] + p.m_z[c]) * 0.5f;
+            return dx * dx + dy * dy + dz * dz;
+        }
+
+        static inline u64 find_slot(round_t const& r, u64 key)
+        {
+            u64 slot = (key * 0x9E3779B97F4A7C15ULL) >> r.m_shift;
+            while (r.m_keys[slot] != key)
+                slot = (slot + 1) & (r.m_capacity - 1);
+            return slot;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Passes
+        // ----------------------------------------------------------------------------------------
+
+        class classify_task_t : public nparallel::task_t
+        {
+        public:
+            round_t* m_round;
+
+            virtual void execute(s32 index)
+            {
+                round_t& r = *m_round;
+                u64      begin, end;
+                nparallel::get_range(r.m_src->m_triangle_count, r.m_parts, index, begin, end);
+                u64 edges     = 0;
+                u64 triangles = 0;
+                for (u64 t = begin; t < end; ++t)
+                {
+                    nply::triangle_t const& tri  = r.m_src->m_triangles[t];
+                    u8                      mask = 0;
+                    for (s32 e = 0; e < 3; ++e)
+                    {
+                        // measured from the lower index, both triangles of an edge see the same length
+                        u32 const a = get_corner(tri, e);
+                        u32 const b = get_corner(tri, (e + 1) % 3);
+                        if (r.m_max_length_sq >= 0.0f && distance_sq(r.m_src->m_positions, a < b ? a : b, a < b ? b : a) > r.m_max_length_sq)
+                        {
+                            mask |= (u8)(1 << e);
+                            edges++;
+                        }
+                    }
+                    r.m_masks[t] = mask;
+                    triangles   += 1 + (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1);
+                }
+                r.m_edges[index]     = edges;
+                r.m_triangles[index] = triangles;
+            }
+        };
+
+        class clear_task_t : public nparallel::task_t
+        {
+        public:
+            round_t* m_round;
+
+            virtual void execute(s32 index)
+            {
+                round_t& r = *m_round;
+                u64      begin, end;
+                nparallel::get_range(r.m_capacity, r.m_parts, index, begin, end);
+                for (u64 i = begin; i < end; ++i)
+                {
+                    r.m_keys[i]   = 0;
+                    r.m_values[i] = c_no_owner;
+                }
+            }
+        };
+
+        class insert_task_t : public nparallel::task_t
+        {
+        public:
+            round_t* m_round;
+
+            virtual void execute(s32 index)
+            {
+                round_t& r = *m_round;
+                u64      begin, end;
+                nparallel::get_range(r.m_src->m_triangle_count, r.m_parts, index, begin, end);
+                for (u64 t = begin; t < end; ++t)
+                {
+                    u8 const mask = r.m_masks[t];
+                    if (mask == 0)
+                        continue;
+                    nply::triangle_t const& tri = r.m_src->m_triangles[t];
+                    for (s32 e = 0; e < 3; ++e)
+                    {
+                        if ((mask & (1 << e)) == 0)
+                            continue;
+                        u64 const key  = edge_key(get_corner(tri, e), get_corner(tri, (e + 1) % 3));
+                        u64       slot = (key * 0x9E3779B97F4A7C15ULL) >> r.m_shift;
+                        while (true)
+                        {
+                            u64 const prev = nparallel::atomic_cas(&r.m_keys[slot], 0, key);
+                            if (prev == 0 || prev == key)
+                                break;
+                            slot = (slot + 1) & (r.m_capacity - 1);
+                        }
+
+                        u64 const owner   = t * 3 + e;
+                        u64       current = r.m_values[slot];
+                        while (owner < current)
+                        {
+                            u64 const prev = nparallel::atomic_cas(&r.m_values[slot], current, owner);
+                            if (prev == current)
+                                break;
+                            current = prev;
+                        }
+                    }
+                }
+            }
+        };
+
+        class own_task_t : public nparallel::task_t
+        {
+        public:
+            round_t* m_round;
+
+            virtual void execute(s32 index)
+            {
+                round_t& r = *m_round;
+                u64      begin, end;
+                nparallel::get_range(r.m_src->m_triangle_count, r.m_parts, index, begin, end);
+                u64 owned = 0;
+                for (u64 t = begin; t < end; ++t)
+                {
+                    u8 const mask = r.m_masks[t];
+                    if (mask == 0)
+                        continue;
+                    nply::triangle_t const& tri = r.m_src->m_triangles[t];
+                    for (s32 e = 0; e < 3; ++e)
+                    {
+                        if ((mask & (1 << e)) == 0)
+                            continue;
+                        u64 const slot = find_slot(r, edge_key(get_corner(tri, e), get_corner(tri, (e + 1) % 3)));
+                        if (r.m_values[slot] == t * 3 + e)
+                        {
+                            r.m_masks[t] |= (u8)(8 << e);
+                            owned++;
+                        }
+                    }
+                }
+                r.m_edges[index] = owned;
+            }
+        };
+
+        class midpoint_task_t : public nparallel::task_t
+        {
+        public:
+            round_t* m_round;
+
+            virtual void execute(s32 index)
+            {
+                round_t&      r   = *m_round;
+                mesh_t const& src = *r.m_src;
+                mesh_t&       dst = *r.m_dst;
+
+                u64 begin, end;
+                nparallel::get_range(src.m_positions.m_count, r.m_parts, index, begin, end);
+                for (u64 i = begin; i < end; ++i)
+                {
+                    dst.m_positions.m_x[i] = src.m_positions.m_x[i];
+                    dst.m_positions.m_y[i] = src.m_positions.m_y[i];
+                    dst.m_positions.m_z[i] = src.m_positions.m_z[i];
+                }
+                for (s32 a = 0; a < src.m_attribute_count; ++a)
+                {
+                    f32 const* s = src.m_attributes[a];
+                    f32*       d = dst.m_attributes[a];
+                    for (u64 i = begin; i < end; ++i)
+                        d[i] = s[i];
+                }
+
+                u64 vertex = r.m_vertices[index];
+                nparallel::get_range(src.m_triangle_count, r.m_parts, index, begin, end);
+                for (u64 t = begin; t < end; ++t)
+                {
+                    u8 const mask = r.m_masks[t];
+                    if ((mask & 0x38) == 0)
+                        continue;
+                    nply::triangle_t const& tri = src.m_triangles[t];
+                    for (s32 e = 0; e < 3; ++e)
+                    {
+                        if ((mask & (8 << e)) == 0)
+                            continue;
+                        u32 const a  = get_corner(tri, e);
+                        u32 const b  = get_corner(tri, (e + 1) % 3);
+                        u32 const lo = a < b ? a : b;
+                        u32 const hi = a < b ? b : a;
+
+                        r.m_values[find_slot(r, edge_key(lo, hi))] = vertex;
+
+                        dst.m_positions.m_x[vertex] = (src.m_positions.m_x[lo] + src.m_positions.m_x[hi]) * 0.5f;
+                        dst.m_positions.m_y[vertex] = (src.m_positions.m_y[lo] + src.m_positions.m_y[hi]) * 0.5f;
+                        dst.m_positions.m_z[vertex] = (src.m_positions.m_z[lo] + src.m_positions.m_z[hi]) * 0.5f;
+                        for (s32 i = 0; i < src.m_attribute_count; ++i)
+                            dst.m_attributes[i][vertex] = (src.m_attributes[i][lo] + src.m_attributes[i][hi]) * 0.5f;
+                        vertex++;
+                    }
+                }
+            }
+        };
+
+        class emit_task_t : public nparallel::task_t
+        {
+        public:
+            round_t* m_round;
+
+            inline void emit(nply::triangle_t*& out, u32 v1, u32 v2, u32 v3)
+            {
+                out->v1 = v1;
+                out->v2 = v2;
+                out->v3 = v3;
+                out++;
+            }
+
+            virtual void execute(s32 index)
+            {
+                round_t&                  r   = *m_round;
+                mesh_t const&             src = *r.m_src;
+                nmesh::positions_t const& p   = src.m_positions;
+                nply::triangle_t*         out = r.m_dst->m_triangles + r.m_triangles[index];
+
+                u64 begin, end;
+                nparallel::get_range(src.m_triangle_count, r.m_parts, index, begin, end);
+                for (u64 t = begin; t < end; ++t)
+                {
+                    nply::triangle_t const& tri  = src.m_triangles[t];
+                    u8 const                mask = r.m_masks[t] & 7;
+                    if (mask == 0)
+                    {
+                        *out++ = tri;
+                        continue;
+                    }
+
+                    u32 c[3] = {tri.v1, tri.v2, tri.v3};
+                    u32 m[3] = {0, 0, 0};
+                    s32 n    = 0;
+                    for (s32 e = 0; e < 3; ++e)
+                    {
+                        if (mask & (1 << e))
+                        {
+                            m[e] = (u32)r.m_values[find_slot(r, edge_key(c[e], c[(e + 1) % 3]))];
+                            n++;
+                        }
+                    }
+
+                    if (n == 1)
+                    {
+                        s32 const i = (mask & 1) ? 0 : ((mask & 2) ? 1 : 2);
+                        emit(out, c[i], m[i], c[(i + 2) % 3]);
+                        emit(out, m[i], c[(i + 1) % 3], c[(i + 2) % 3]);
+                    }
+                    else if (n == 2)
+                    {
+                        // 'a' and 'b' split the edges next to corner i + 2, the quad that is left is cut
+                        // along its shorter diagonal
+                        s32 const i  = (mask & 1) == 0 ? 0 : ((mask & 2) == 0 ? 1 : 2);
+                        u32 const c0 = c[i];
+                        u32 const c1 = c[(i + 1) % 3];
+                        u32 const c2 = c[(i + 2) % 3];
+                        u32 const a  = m[(i + 1) % 3];
+                        u32 const b  = m[(i + 2) % 3];
+                        emit(out, a, c2, b);
+                        if (distance_to_midpoint_sq(p, c0, c1, c2) <= distance_to_midpoint_sq(p, c1, c2, c0))
+                        {
+                            emit(out, c0, c1, a);
+                            emit(out, c0, a, b);
+                        }
+                        else
+                        {
+                            emit(out, c0, c1, b);
+                            emit(out, c1, a, b);
+                        }
+                    }
+                    else
+                    {
+                        emit(out, c[0], m[0], m[2]);
+                        emit(out, m[0], c[1], m[1]);
+                        emit(out, m[2], m[1], c[2]);
+                        emit(out, m[0], m[1], m[2]);
+                    }
+                }
+            }
+        };
+
+        // ----------------------------------------------------------------------------------------
+        // Split
+        // ----------------------------------------------------------------------------------------
+
+        static bool alloc_mesh(nply::allocator_t* allocator, u64 vertex_count, s32 attribute_count, u64 triangle_count, mesh_t& mesh)
+        {
+            mesh.m_positions.m_x     = (f32*)allocator->alloc(sizeof(f32) * (vertex_count + 1));
+            mesh.m_positions.m_y     = (f32*)allocator->alloc(sizeof(f32) * (vertex_count + 1));
+            mesh.m_positions.m_z     = (f32*)allocator->alloc(sizeof(f32) * (vertex_count + 1));
+            mesh.m_positions.m_count = vertex_count;
+            mesh.m_attributes        = (f32**)allocator->alloc(sizeof(f32*) * (attribute_count + 1));
+            mesh.m_attribute_count   = 0;
+            mesh.m_triangles         = (nply::triangle_t*)allocator->alloc(sizeof(nply::triangle_t) * (triangle_count + 1));
+            mesh.m_triangle_count    = triangle_count;
+
+            bool ok = mesh.m_positions.m_x != nullptr && mesh.m_positions.m_y != nullptr && mesh.m_positions.m_z != nullptr && mesh.m_attributes != nullptr && mesh.m_triangles != nullptr;
+            for (s32 a = 0; ok && a < attribute_count; ++a)
+            {
+                mesh.m_attributes[a] = (f32*)allocator->alloc(sizeof(f32) * (vertex_count + 1));
+                ok                   = mesh.m_attributes[a] != nullptr;
+                if (ok)
+                    mesh.m_attribute_count++;
+            }
+            if (!ok)
+                release(allocator, mesh);
+            return ok;
+        }
+
+        void release(nply::allocator_t* allocator, mesh_t& mesh)
+        {
+            for (s32 a = 0; a < mesh.m_attribute_count; ++a)
+                allocator->dealloc(mesh.m_attributes[a]);
+            allocator->dealloc(mesh.m_attributes);
+            allocator->dealloc(mesh.m_triangles);
+            allocator->dealloc(mesh.m_positions.m_z);
+            allocator->dealloc(mesh.m_positions.m_y);
+            allocator->dealloc(mesh.m_positions.m_x);
+            mesh.m_positions.m_x     = nullptr;
+            mesh.m_positions.m_y     = nullptr;
+            mesh.m_positions.m_z     = nullptr;
+            mesh.m_positions.m_count = 0;
+            mesh.m_attributes        = nullptr;
+            mesh.m_attribute_count   = 0;
+            mesh.m_triangles         = nullptr;
+            mesh.m_triangle_count    = 0;
+        }
+
+        // One round from 'src' into 'dst', 'split' is false when no edge was too long (dst is a copy)
+        static bool split_round(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, mesh_t const& src, f32 max_length_sq, mesh_t& dst, bool& split)
+        {
+            round_t r;
+            r.m_src           = &src;
+            r.m_dst           = &dst;
+            r.m_max_length_sq = max_length_sq;
+            r.m_parts         = get_parts(scheduler, src.m_triangle_count > src.m_positions.m_count ? src.m_triangle_count : src.m_positions.m_count);
+            r.m_masks         = (u8*)allocator->alloc(src.m_triangle_count + 1);
+            r.m_keys          = nullptr;
+            r.m_values        = nullptr;
+            r.m_capacity      = 0;
+            r.m_shift         = 64;
+            if (r.m_masks == nullptr)
+                return false;
+
+            classify_task_t classify;
+            classify.m_round = &r;
+            scheduler->run(&classify, r.m_parts);
+
+            u64 edges     = 0;
+            u64 triangles = 0;
+            for (s32 i = 0; i < r.m_parts; ++i)
+            {
+                edges        += r.m_edges[i];
+                triangles    += r.m_triangles[i];
+                r.m_edges[i]  = 0;
+            }
+            split = edges > 0;
+
+            bool ok = true;
+            if (split)
+            {
+                // at most half full
+                r.m_capacity = 16;
+                r.m_shift    = 60;
+                while (r.m_capacity < edges * 2)
+                {
+                    r.m_capacity *= 2;
+                    r.m_shift--;
+                }
+                r.m_keys   = (u64*)allocator->alloc(sizeof(u64) * r.m_capacity);
+                r.m_values = (u64*)allocator->alloc(sizeof(u64) * r.m_capacity);
+                ok         = r.m_keys != nullptr && r.m_values != nullptr;
+                if (ok)
+                {
+                    clear_task_t clear;
+                    clear.m_round = &r;
+                    scheduler->run(&clear, r.m_parts);
+
+                    insert_task_t insert;
+                    insert.m_round = &r;
+                    scheduler->run(&insert, r.m_parts);
+
+                    own_task_t own;
+                    own.m_round = &r;
+                    scheduler->run(&own, r.m_parts);
+                }
+            }
+
+            u64 vertices = src.m_positions.m_count;
+            for (s32 i = 0; i < r.m_parts; ++i)
+            {
+                r.m_vertices[i] = vertices;
+                vertices       += r.m_edges[i];
+            }
+            u64 first = 0;
+            for (s32 i = 0; i < r.m_parts; ++i)
+            {
+                u64 const n      = r.m_triangles[i];
+                r.m_triangles[i] = first;
+                first           += n;
+            }
+
+            ok = ok && vertices <= c_max_index && alloc_mesh(allocator, vertices, src.m_attribute_count, triangles, dst);
+            if (ok)
+            {
+                midpoint_task_t midpoint;
+                midpoint.m_round = &r;
+                scheduler->run(&midpoint, r.m_parts);
+
+                emit_task_t emit;
+                emit.m_round = &r;
+                scheduler->run(&emit, r.m_parts);
+            }
+
+            allocator->dealloc(r.m_values);
+            allocator->dealloc(r.m_keys);
+            allocator->dealloc(r.m_masks);
+            return ok;
+        }
+
+        bool split(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, mesh_t const& mesh, config_t const& config, mesh_t& result)
+        {
+            if (!(config.m_max_edge_length > 0.0f) || mesh.m_positions.m_count > c_max_index)
+                return false;
+            scheduler = nparallel::get_scheduler(scheduler);
+
+            f32 const max_length_sq = config.m_max_edge_length * config.m_max_edge_length;
+            mesh_t    current       = mesh;
+            bool      owned         = false; // current was allocated by an earlier round
+            for (s32 round = 0; round < config.m_max_rounds || !owned; ++round)
+            {
+                // when no round was run at all, a round that splits nothing makes the copy
+                mesh_t next;
+                bool   split = false;
+                if (!split_round(allocator, scheduler, current, round < config.m_max_rounds ? max_length_sq : -1.0f, next, split))
+                {
+                    if (owned)
+                        release(allocator, current);
+                    return false;
+                }
+                if (owned)
+                    release(allocator, current);
+                current = next;
+                owned   = true;
+                if (!split)
+                    break;
+            }
+            result = current;
+            return true;
+        }
+
+    } // namespace ntessellate
+} // namespace ncore
@@ -0,0 +1,539 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "c3dff/c_tiles.h"
+
+#include <math.h>
+
+namespace ncore
+{
+    namespace ntiles
+    {
+        // Image layout (offsets relative to the start of the image):
+        //
+        //   header_t                                     (HEADER_SIZE bytes)
+        //   tile_t tiles[tile_count]                     (the index, ends at m_index_size)
+        //   per tile: f32 records[count][3 + attribute_count], starting at a multiple of the alignment
+        //
+        // @note: The image is stored in the native (little) endian format.
+
+        const u32 c_magic   = ('T' << 0) | ('I' << 8) | ('L' << 16) | ('E' << 24);
+        const u32 c_version = 1;
+
+        const s32 c_max_parts   = 64;
+        const u32 c_min_part    = 16 * 1024;
+        const u32 c_bits        = 21; // per axis, 63 bit keys
+        const u32 c_radix       = 8;
+        const u64 c_max_indexed = (u64)1 << 32; // points that the u32 order can address
+
+        struct header_t
+        {
+            u32        m_magic;
+            u32        m_version;
+            u64        m_size;
+            u64        m_point_count;
+            u64        m_tiles_offset;
+            u64        m_index_size;
+            u32        m_tile_count;
+            s32        m_attribute_count;
+            u32        m_stride;
+            u32        m_curve;
+            u32        m_tile_size;
+            u32        m_alignment;
+            n3d::box_t m_bounds;
+            u8         m_pad[HEADER_SIZE - 88];
+        };
+
+        static inline u64 align_to(u64 size, u64 alignment) { return (size + alignment - 1) & ~(alignment - 1); }
+
+        static inline header_t const* get_header(tiled_t const& tiled) { return (header_t const*)tiled.m_data; }
+
+        static s32 get_parts(nparallel::scheduler_t* scheduler, u64 count)
+        {
+            s32 const parts = nparallel::get_parts(scheduler, count, c_min_part);
+            return parts > c_max_parts ? c_max_parts : parts;
+        }
+
+        static inline bool is_finite(nply::vertex_t const& v) { return isfinite(v.x) && isfinite(v.y) && isfinite(v.z); }
+
+        // ----------------------------------------------------------------------------------------
+        // Curves
+        // ----------------------------------------------------------------------------------------
+
+        static inline u64 spread_bits(u32 x)
+        {
+            u64 v = x & 0x1FFFFF;
+            v     = (v | (v << 32)) & 0x001F00000000FFFFULL;
+            v     = (v | (v << 16)) & 0x001F0000FF0000FFULL;
+            v     = (v | (v << 8)) & 0x100F00F00F00F00FULL;
+            v     = (v | (v << 4)) & 0x10C30C30C30C30C3ULL;
+            v     = (v | (v << 2)) & 0x1249249249249249ULL;
+            return v;
+        }
+
+        static inline u64 morton_encode(u32 x, u32 y, u32 z) { return spread_bits(x) | (spread_bits(y) << 1) | (spread_bits(z) << 2); }
+
+        // Skilling's transform of the coordinates to the transposed hilbert index, which is then
+        // interleaved the same way as a morton code ('Programming the Hilbert curve', 2004)
+        static inline u64 hilbert_encode(u32 x, u32 y, u32 z)
+        {
+            u32 X[3] = {x, y, z};
+
+            for (u32 q = 1u << (c_bits - 1); q > 1; q >>= 1)
+            {
+                u32 const p = q - 1;
+                for (s32 i = 0; i < 3; ++i)
+                {
+                    if (X[i] & q)
+                    {
+                        X[0] ^= p;
+                    }
+                    else
+                    {
+                        u32 const t = (X[0] ^ X[i]) & p;
+                        X[0] ^= t;
+                        X[i] ^= t;
+                    }
+                }
+            }
+
+            X[1] ^= X[0];
+            X[2] ^= X[1];
+            u32 t = 0;
+            for (u32 q = 1u << (c_bits - 1); q > 1; q >>= 1)
+            {
+                if (X[2] & q)
+                    t ^= q - 1;
+            }
+            X[0] ^= t;
+            X[1] ^= t;
+            X[2] ^= t;
+
+            return (spread_bits(X[0]) << 2) | (spread_bits(X[1]) << 1) | spread_bits(X[2]);
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Sort
+        // ----------------------------------------------------------------------------------------
+
+        class bounds_task_t : public nparallel::task_t
+        {
+        public:
+            nply::vertex_t const* m_points;
+            u64                   m_count;
+            s32                   m_parts;
+            n3d::box_t            m_boxes[c_max_parts];
+
+            virtual void execute(s32 index)
+            {
+                u64 begin, end;
+                nparallel::get_range(m_count, m_parts, index, begin, end);
+                n3d::box_t& box = m_boxes[index];
+                n3d::box_empty(box);
+                for (u64 i = begin; i < end; ++i)
+                {
+                    if (is_finite(m_points[i]))
+                        n3d::box_extend(box, m_points[i]);
+                }
+            }
+        };
+
+        class key_task_t : public nparallel::task_t
+        {
+        public:
+            nply::vertex_t const* m_points;
+            u64                   m_count;
+            s32                   m_parts;
+            ecurve                m_curve;
+            f32                   m_min[3];
+            f32                   m_scale; // the same for all axes, the cells of the curve are cubes
+            u64*                  m_keys;
+            u32*                  m_values;
+
+            // Mapped in float, NaN goes to 0 and Inf to the border
+            inline u32 quantize(f32 v, s32 axis) const
+            {
+                f32 const q   = (v - m_min[axis]) * m_scale;
+                u32 const max = (1u << c_bits) - 1;
+                return !(q > 0.0f) ? 0 : (q >= (f32)max ? max : (u32)q);
+            }
+
+            virtual void execute(s32 index)
+            {
+                u64 begin, end;
+                nparallel::get_range(m_count, m_parts, index, begin, end);
+                for (u64 i = begin; i < end; ++i)
+                {
+                    nply::vertex_t const& p = m_points[i];
+                    u32 const             x = quantize(p.x, 0);
+                    u32 const             y = quantize(p.y, 1);
+                    u32 const             z = quantize(p.z, 2);
+                    m_keys[i]               = m_curve == CURVE_HILBERT ? hilbert_encode(x, y, z) : morton_encode(x, y, z);
+                    m_values[i]             = (u32)i;
+                }
+            }
+        };
+
+        // One pass of a stable LSD radix sort: every part counts the digits of its range, the
+        // counts are turned into per-part offsets and every part scatters its range.
+        struct radix_t
+        {
+            u64  m_count;
+            s32  m_parts;
+            u32  m_shift;
+            u64* m_keys[2];
+            u32* m_values[2];
+            s32  m_src;
+            u64* m_histograms; // 256 per part
+        };
+
+        class histogram_task_t : public nparallel::task_t
+        {
+        public:
+            radix_t* m_radix;
+
+            virtual void execute(s32 index)
+            {
+                radix_t const& r = *m_radix;
+                u64            begin, end;
+                nparallel::get_range(r.m_count, r.m_parts, index, begin, end);
+                u64* histogram = r.m_histograms + index * 256;
+                for (u32 d = 0; d < 256; ++d)
+                    histogram[d] = 0;
+                u64 const* keys = r.m_keys[r.m_src];
+                for (u64 i = begin; i < end; ++i)
+                    histogram[(keys[i] >> r.m_shift) & 0xFF]++;
+            }
+        };
+
+        class scatter_task_t : public nparallel::task_t
+        {
+        public:
+            radix_t* m_radix;
+
+            virtual void execute(s32 index)
+            {
+                radix_t const& r = *m_radix;
+                u64            begin, end;
+                nparallel::get_range(r.m_count, r.m_parts, index, begin, end);
+                u64*       offsets = r.m_histograms + index * 256;
+                u64 const* src_k   = r.m_keys[r.m_src];
+                u32 const* src_v   = r.m_values[r.m_src];
+                u64*       dst_k   = r.m_keys[r.m_src ^ 1];
+                u32*       dst_v   = r.m_values[r.m_src ^ 1];
+                for (u64 i = begin; i < end; ++i)
+                {
+                    u64 const o = offsets[(src_k[i] >> r.m_shift) & 0xFF]++;
+                    dst_k[o]    = src_k[i];
+                    dst_v[o]    = src_v[i];
+                }
+            }
+        };
+
+        // Turn the counts into offsets, false when all keys have the same digit (the pass can be skipped)
+        static bool prefix_sum(radix_t& r)
+        {
+            u64 sum = 0;
+            for (u32 d = 0; d < 256; ++d)
+            {
+                u64 total = 0;
+                for (s32 p = 0; p < r.m_parts; ++p)
+                {
+                    u64& h = r.m_histograms[p * 256 + d];
+                    u64  c = h;
+                    h      = sum + total;
+                    total += c;
+                }
+                if (total == r.m_count)
+                    return false;
+                sum += total;
+            }
+            return true;
+        }
+
+        bool sort(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, nply::vertex_t const* points, u64 point_count, ecurve curve, u32* order)
+        {
+            scheduler = nparallel::get_scheduler(scheduler);
+            if (point_count == 0)
+                return true;
+            if (point_count > c_max_indexed)
+                return false;
+
+            s32 const parts = get_parts(scheduler, point_count);
+
+            n3d::box_t bounds;
+            {
+                bounds_task_t task;
+                task.m_points = points;
+                task.m_count  = point_count;
+                task.m_parts  = parts;
+                scheduler->run(&task, parts);
+                n3d::box_empty(bounds);
+                for (s32 i = 0; i < parts; ++i)
+                    n3d::box_extend(bounds, task.m_boxes[i]);
+            }
+
+            radix_t r;
+            r.m_count      = point_count;
+            r.m_parts      = parts;
+            r.m_shift      = 0;
+            r.m_keys[0]    = (u64*)allocator->alloc(sizeof(u64) * point_count);
+            r.m_keys[1]    = (u64*)allocator->alloc(sizeof(u64) * point_count);
+            r.m_values[0]  = order;
+            r.m_values[1]  = (u32*)allocator->alloc(sizeof(u32) * point_count);
+            r.m_src        = 0;
+            r.m_histograms = (u64*)allocator->alloc(sizeof(u64) * 256 * parts);
+            if (r.m_keys[0] == nullptr || r.m_keys[1] == nullptr || r.m_values[1] == nullptr || r.m_histograms == nullptr)
+            {
+                allocator->dealloc(r.m_keys[0]);
+                allocator->dealloc(r.m_keys[1]);
+                allocator->dealloc(r.m_values[1]);
+                allocator->dealloc(r.m_histograms);
+                return false;
+            }
+
+            {
+                f32 extent = 0.0f;
+                for (s32 i = 0; i < 3; ++i)
+                    extent = (bounds.m_max[i] - bounds.m_min[i]) > extent ? (bounds.m_max[i] - bounds.m_min[i]) : extent;
+
+                key_task_t task;
+                task.m_points = points;
+                task.m_count  = point_count;
+                task.m_parts  = parts;
+                task.m_curve  = curve;
+                for (s32 i = 0; i < 3; ++i)
+                    task.m_min[i] = bounds.m_min[i];
+                task.m_scale  = extent > 0.0f ? (f32)((1u << c_bits) - 1) / extent : 0.0f;
+                task.m_keys   = r.m_keys[0];
+                task.m_values = r.m_values[0];
+                scheduler->run(&task, parts);
+            }
+
+            for (r.m_shift = 0; r.m_shift < c_bits * 3; r.m_shift += c_radix)
+            {
+                histogram_task_t histogram;
+                histogram.m_radix = &r;
+                scheduler->run(&histogram, parts);
+                if (!prefix_sum(r))
+                    continue;
+
+                scatter_task_t scatter;
+                scatter.m_radix = &r;
+                scheduler->run(&scatter, parts);
+                r.m_src ^= 1;
+            }
+
+            if (r.m_src != 0)
+            {
+                for (u64 i = 0; i < point_count; ++i)
+                    order[i] = r.m_values[1][i];
+            }
+
+            allocator->dealloc(r.m_keys[0]);
+            allocator->dealloc(r.m_keys[1]);
+            allocator->dealloc(r.m_values[1]);
+            allocator->dealloc(r.m_histograms);
+            return true;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Build
+        // ----------------------------------------------------------------------------------------
+
+        class tile_task_t : public nparallel::task_t
+        {
+        public:
+            nply::vertex_t const* m_points;
+            f32 const*            m_attributes;
+            s32                   m_attribute_count;
+            u32 const*            m_order;
+            u8*                   m_image;
+            tile_t*               m_tiles;
+            u32                   m_tile_count;
+            s32                   m_parts;
+
+            virtual void execute(s32 index)
+            {
+                u64 begin, end;
+                nparallel::get_range(m_tile_count, m_parts, index, begin, end);
+                for (u64 t = begin; t < end; ++t)
+                {
+                    tile_t& tile = m_tiles[t];
+                    n3d::box_empty(tile.m_box);
+                    f32* dst = (f32*)(m_image + tile.m_offset);
+                    for (u32 i = 0; i < tile.m_count; ++i)
+                    {
+                        u32 const             p = m_order[tile.m_first + i];
+                        nply::vertex_t const& v = m_points[p];
+                        if (is_finite(v))
+                            n3d::box_extend(tile.m_box, v);
+                        *dst++ = v.x;
+                        *dst++ = v.y;
+                        *dst++ = v.z;
+                        if (m_attribute_count > 0)
+                        {
+                            f32 const* a = m_attributes + (u64)p * m_attribute_count;
+                            for (s32 j = 0; j < m_attribute_count; ++j)
+                                *dst++ = a[j];
+                        }
+                    }
+                }
+            }
+        };
+
+        bool build(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, nply::vertex_t const* points, f32 const* attributes, s32 attribute_count, u64 point_count, config_t const& config, tiled_t& tiled)
+        {
+            scheduler = nparallel::get_scheduler(scheduler);
+            u32 const alignment = config.m_alignment < 8 ? 8 : config.m_alignment;
+            if (config.m_tile_size == 0 || (alignment & (alignment - 1)) != 0 || attribute_count < 0 || (attribute_count > 0 && attributes == nullptr))
+                return false;
+            if (point_count > c_max_indexed || (point_count + config.m_tile_size - 1) / config.m_tile_size > 0xFFFFFFFF)
+                return false;
+
+            u32* order = (u32*)allocator->alloc(sizeof(u32) * (point_count + 1));
+            if (order == nullptr || !sort(allocator, scheduler, points, point_count, (ecurve)config.m_curve, order))
+            {
+                allocator->dealloc(order);
+                return false;
+            }
+
+            u32 const stride       = (u32)sizeof(f32) * (3 + attribute_count);
+            u32 const tile_count   = (u32)((point_count + config.m_tile_size - 1) / config.m_tile_size);
+            u64 const tiles_offset = HEADER_SIZE;
+            u64 const index_size   = tiles_offset + sizeof(tile_t) * tile_count;
+            u64 const tile_bytes   = align_to((u64)config.m_tile_size * stride, alignment);
+            u64 const data_offset  = align_to(index_size, alignment);
+            u64 const size         = data_offset + (tile_count > 0 ? tile_bytes * (tile_count - 1) + (point_count - (u64)(tile_count - 1) * config.m_tile_size) * stride : 0);
+
+            u8* image = (u8*)allocator->alloc(size, 16);
+            if (image == nullptr)
+            {
+                allocator->dealloc(order);
+                return false;
+            }
+            for (u64 i = 0; i < data_offset; ++i)
+                image[i] = 0;
+
+            header_t* hdr          = (header_t*)image;
+            hdr->m_magic           = c_magic;
+            hdr->m_version         = c_version;
+            hdr->m_size            = size;
+            hdr->m_point_count     = point_count;
+            hdr->m_tiles_offset    = tiles_offset;
+            hdr->m_index_size      = index_size;
+            hdr->m_tile_count      = tile_count;
+            hdr->m_attribute_count = attribute_count;
+            hdr->m_stride          = stride;
+            hdr->m_curve           = config.m_curve;
+            hdr->m_tile_size       = config.m_tile_size;
+            hdr->m_alignment       = alignment;
+
+            tile_t* tiles = (tile_t*)(image + tiles_offset);
+            for (u32 t = 0; t < tile_count; ++t)
+            {
+                tile_t& tile  = tiles[t];
+                tile.m_first  = (u64)t * config.m_tile_size;
+                tile.m_count  = (point_count - tile.m_first) < config.m_tile_size ? (u32)(point_count - tile.m_first) : config.m_tile_size;
+                tile.m_offset = data_offset + tile_bytes * t;
+                tile.m_size   = (u64)tile.m_count * stride;
+            }
+
+            if (tile_count > 0)
+            {
+                tile_task_t task;
+                task.m_points          = points;
+                task.m_attributes      = attributes;
+                task.m_attribute_count = attribute_count;
+                task.m_order           = order;
+                task.m_image           = image;
+                task.m_tiles           = tiles;
+                task.m_tile_count      = tile_count;
+                task.m_parts           = nparallel::get_parts(scheduler, tile_count, 4);
+                scheduler->run(&task, task.m_parts);
+            }
+
+            // the padding between the tiles
+            for (u32 t = 0; t + 1 < tile_count; ++t)
+            {
+                for (u64 i = tiles[t].m_offset + tiles[t].m_size; i < tiles[t + 1].m_offset; ++i)
+                    image[i] = 0;
+            }
+
+            n3d::box_empty(hdr->m_bounds);
+            for (u32 t = 0; t < tile_count; ++t)
+                n3d::box_extend(hdr->m_bounds, tiles[t].m_box);
+
+            allocator->dealloc(order);
+            tiled.m_data = image;
+            tiled.m_size = size;
+            return true;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Image
+        // ----------------------------------------------------------------------------------------
+
+        u64 get_index_size(const u8* data, u64 size)
+        {
+            if (data == nullptr || size < HEADER_SIZE || ((uint_t)data & 7) != 0)
+                return 0;
+            header_t const* hdr = (header_t const*)data;
+            if (hdr->m_magic != c_magic || hdr->m_version != c_version)
+                return 0;
+            if (hdr->m_tiles_offset < HEADER_SIZE || hdr->m_index_size != hdr->m_tiles_offset + sizeof(tile_t) * hdr->m_tile_count || hdr->m_index_size > hdr->m_size)
+                return 0;
+            return hdr->m_index_size;
+        }
+
+        bool open(const u8* data, u64 size, tiled_t& tiled)
+        {
+            u64 const index_size = get_index_size(data, size);
+            if (index_size == 0 || index_size > size)
+                return false;
+            header_t const* hdr = (header_t const*)data;
+            if (hdr->m_stride != sizeof(f32) * (3 + hdr->m_attribute_count))
+                return false;
+            tile_t const* tiles = (tile_t const*)(data + hdr->m_tiles_offset);
+            for (u32 t = 0; t < hdr->m_tile_count; ++t)
+            {
+                if (tiles[t].m_offset < index_size || tiles[t].m_offset + tiles[t].m_size > hdr->m_size || tiles[t].m_size != (u64)tiles[t].m_count * hdr->m_stride || (tiles[t].m_offset & 3) != 0)
+                    return false;
+            }
+            tiled.m_data = data;
+            tiled.m_size = size < hdr->m_size ? size : hdr->m_size;
+            return true;
+        }
+
+        u64           get_point_count(tiled_t const& tiled) { return get_header(tiled)->m_point_count; }
+        u32           get_tile_count(tiled_t const& tiled) { return get_header(tiled)->m_tile_count; }
+        s32           get_attribute_count(tiled_t const& tiled) { return get_header(tiled)->m_attribute_count; }
+        u32           get_stride(tiled_t const& tiled) { return get_header(tiled)->m_stride; }
+        n3d::box_t    get_bounds(tiled_t const& tiled) { return get_header(tiled)->m_bounds; }
+        tile_t const& get_tile(tiled_t const& tiled, u32 index) { return ((tile_t const*)(tiled.m_data + get_header(tiled)->m_tiles_offset))[index]; }
+
+        u32 query(tiled_t const& tiled, n3d::box_t const& box, u32* tiles, u32 max_tiles)
+        {
+            header_t const* hdr   = get_header(tiled);
+            tile_t const*   index = (tile_t const*)(tiled.m_data + hdr->m_tiles_offset);
+            u32             n     = 0;
+            for (u32 t = 0; t < hdr->m_tile_count; ++t)
+            {
+                if (!n3d::box_overlaps(index[t].m_box, box))
+                    continue;
+                if (n < max_tiles)
+                    tiles[n] = t;
+                n++;
+            }
+            return n;
+        }
+
+        f32 const* get_points(tiled_t const& tiled, u32 index)
+        {
+            tile_t const& tile = get_tile(tiled, index);
+            if (tile.m_offset + tile.m_size > tiled.m_size)
+                return nullptr;
+            return (f32 const*)(tiled.m_data + tile.m_offset);
+        }
+
+    } // namespace ntiles
+} // namespace ncore
@@ -0,0 +1,111 @@
+#ifndef __C_3DFF_ARENA_H__
+#define __C_3DFF_ARENA_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+
+namespace ncore
+{
+    class alloc_t;
+
+    namespace nply
+    {
+        // A growable arena, memory is taken from a chain of chunks that are requested from the
+        // backing allocator when needed. Memory is released in bulk with reset() or rewind(),
+        // chunks are kept and reused so loading many files in one process does not go back to
+        // the backing allocator for every file.
+        // Allocations that do not fit in a chunk get a chunk of their own.
+        // @note: Not thread-safe, use one arena per thread (see scratch_t).
+        class arena_t : public allocator_t
+        {
+        public:
+            struct chunk_t;
+
+            struct marker_t
+            {
+                chunk_t* m_chunk;
+                u64      m_used;
+            };
+
+            arena_t();
+
+            void init(alloc_t* backing, u64 chunk_size = 4 * 1024 * 1024);
+            void exit(); // return all chunks to the backing allocator
+
+            void     reset(); // release everything, chunks are kept
+            marker_t mark() const;
+            void     rewind(marker_t const& marker);
+            void     trim(); // return the chunks that are not in use to the backing allocator
+
+            u64 get_used() const;     // bytes handed out (including alignment padding)
+            u64 get_reserved() const; // bytes held from the backing allocator
+
+        protected:
+            virtual void* v_alloc(u64 size, u32 alignment);
+
+            chunk_t* new_chunk(u64 size);
+
+            alloc_t* m_backing;
+            u64      m_chunk_size;
+            chunk_t* m_first;
+            chunk_t* m_current;
+        };
+
+        // A pool of fixed size items on top of an allocator, freed items are kept in a free list
+        class pool_t : public allocator_t
+        {
+        public:
+            pool_t();
+
+            void init(allocator_t* allocator, u32 item_size, u32 item_alignment = 16, u32 items_per_block = 256);
+            void reset(); // forget all items, the memory of the blocks is not reused
+
+            u32 get_item_size() const { return m_item_size; }
+            u32 get_count() const { return m_count; }
+
+        protected:
+            virtual void* v_alloc(u64 size, u32 alignment);
+            virtual void  v_dealloc(void* ptr);
+
+            allocator_t* m_allocator;
+            u32          m_item_size;
+            u32          m_item_alignment;
+            u32          m_items_per_block;
+            u32          m_count;
+            void*        m_free_list;
+            u8*          m_block_cursor;
+            u8*          m_block_end;
+        };
+
+        // Per-thread scratch arenas, a thread (or task) uses the arena of its own index so that
+        // parallel decoding never has to synchronize on the allocator.
+        class scratch_t
+        {
+        public:
+            enum
+            {
+                MAX_ARENAS = 64,
+            };
+
+            scratch_t();
+
+            void init(alloc_t* backing, s32 count, u64 chunk_size = 1024 * 1024);
+            void exit();
+
+            s32      get_count() const { return m_count; }
+            arena_t* get(s32 index); // index in [0, get_count())
+            void     reset(); // reset all arenas
+
+        protected:
+            s32     m_count;
+            arena_t m_arenas[MAX_ARENAS];
+        };
+
+    } // namespace nply
+
+} // namespace ncore
+
+#endif // __C_3DFF_ARENA_H__
@@ -0,0 +1,76 @@
+#ifndef __C_3DFF_BATCH_H__
+#define __C_3DFF_BATCH_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_arena.h"
+#include "c3dff/c_catalog.h"
+#include "c3dff/c_parallel.h"
+
+namespace ncore
+{
+    namespace nbatch
+    {
+        // File access, implemented by the user on top of their own file system.
+        // All functions are called concurrently from the tasks of the scheduler.
+        class source_t : public ncatalog::source_t
+        {
+        public:
+            virtual u64 size(const char* path) = 0; // 0 = not readable
+
+            // Read up to 'size' bytes at 'offset', returns the number of bytes read
+            virtual u64 read_at(const char* path, u64 offset, u8* buffer, u64 size) = 0;
+
+            virtual u64 read(const char* path, u8* buffer, u64 size) { return read_at(path, 0, buffer, size); }
+        };
+
+        struct result_t
+        {
+            u64                     m_index; // in the array of paths
+            const char*             m_path;
+            bool                    m_ok;
+            nply::error_t           m_error; // when not ok
+            nply::vertex_t const*   m_vertices;
+            u64                     m_vertex_count;
+            nply::triangle_t const* m_triangles;
+            u64                     m_triangle_count;
+        };
+
+        // Receives every file when it is done (loaded or failed). Called from the tasks of the scheduler,
+        // possibly concurrently, the data is only valid during the call.
+        class callback_t
+        {
+        public:
+            virtual void loaded(result_t const& result) = 0;
+        };
+
+        struct config_t
+        {
+            config_t()
+                : m_memory_budget(256 * 1024 * 1024)
+                , m_split_size(4 * 1024 * 1024)
+                , m_validate(nply::VALIDATE_NONE)
+            {
+            }
+            u64 m_memory_budget; // decoded meshes and read buffers in flight
+            u64 m_split_size;    // vertex data of binary files larger than this is decoded in parts of this size
+            u32 m_validate;      // see nply::set_validation
+        };
+
+        // Load many ply files as meshes ('vertex' x, y, z and 'face' triangles) over one scheduler.
+        // The headers are probed first (see ncatalog::build), then the files are decoded in waves that
+        // fit the memory budget. Within a wave every task works through its own share of the jobs and
+        // steals from the other tasks when it runs out; a small file is one job, the vertices of a large
+        // binary file are split into parts that are decoded in parallel.
+        // The decoded meshes of a wave are allocated from 'arena' (rewound after each wave), each task
+        // uses one arena of 'scratch' for its read buffers. Returns the number of files that loaded.
+        u64 load(nply::arena_t* arena, nparallel::scheduler_t* scheduler, nply::scratch_t* scratch, source_t* source, const char** paths, u64 path_count, config_t const& config, callback_t* callback);
+
+    } // namespace nbatch
+
+} // namespace ncore
+
+#endif // __C_3DFF_BATCH_H__
@@ -0,0 +1,76 @@
+#ifndef __C_3DFF_BOX_H__
+#define __C_3DFF_BOX_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+
+namespace ncore
+{
+    namespace n3d
+    {
+        const f32 c_f32_max = 3.402823466e+38f;
+
+        struct box_t
+        {
+            f32 m_min[3];
+            f32 m_max[3];
+        };
+
+        inline void box_empty(box_t& box)
+        {
+            for (s32 i = 0; i < 3; ++i)
+            {
+                box.m_min[i] = c_f32_max;
+                box.m_max[i] = -c_f32_max;
+            }
+        }
+
+        inline bool box_is_empty(box_t const& box) { return box.m_min[0] > box.m_max[0] || box.m_min[1] > box.m_max[1] || box.m_min[2] > box.m_max[2]; }
+
+        inline void box_extend(box_t& box, nply::vertex_t const& v)
+        {
+            box.m_min[0] = v.x < box.m_min[0] ? v.x : box.m_min[0];
+            box.m_min[1] = v.y < box.m_min[1] ? v.y : box.m_min[1];
+            box.m_min[2] = v.z < box.m_min[2] ? v.z : box.m_min[2];
+            box.m_max[0] = v.x > box.m_max[0] ? v.x : box.m_max[0];
+            box.m_max[1] = v.y > box.m_max[1] ? v.y : box.m_max[1];
+            box.m_max[2] = v.z > box.m_max[2] ? v.z : box.m_max[2];
+        }
+
+        inline void box_extend(box_t& box, box_t const& other)
+        {
+            for (s32 i = 0; i < 3; ++i)
+            {
+                box.m_min[i] = other.m_min[i] < box.m_min[i] ? other.m_min[i] : box.m_min[i];
+                box.m_max[i] = other.m_max[i] > box.m_max[i] ? other.m_max[i] : box.m_max[i];
+            }
+        }
+
+        inline f32 box_area(box_t const& box)
+        {
+            if (box_is_empty(box))
+                return 0.0f;
+            f32 const dx = box.m_max[0] - box.m_min[0];
+            f32 const dy = box.m_max[1] - box.m_min[1];
+            f32 const dz = box.m_max[2] - box.m_min[2];
+            return 2.0f * (dx * dy + dy * dz + dz * dx);
+        }
+
+        inline bool box_overlaps(box_t const& a, box_t const& b)
+        {
+            return a.m_min[0] <= b.m_max[0] && a.m_max[0] >= b.m_min[0] && a.m_min[1] <= b.m_max[1] && a.m_max[1] >= b.m_min[1] && a.m_min[2] <= b.m_max[2] && a.m_max[2] >= b.m_min[2];
+        }
+
+        inline bool box_contains(box_t const& box, nply::vertex_t const& v)
+        {
+            return v.x >= box.m_min[0] && v.x <= box.m_max[0] && v.y >= box.m_min[1] && v.y <= box.m_max[1] && v.z >= box.m_min[2] && v.z <= box.m_max[2];
+        }
+
+    } // namespace n3d
+
+} // namespace ncore
+
+#endif // __C_3DFF_BOX_H__
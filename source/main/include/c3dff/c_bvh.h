@@ -0,0 +1,78 @@
+#ifndef __C_3DFF_BVH_H__
+#define __C_3DFF_BVH_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_box.h"
+#include "c3dff/c_parallel.h"
+
+namespace ncore
+{
+    namespace nbvh
+    {
+        struct config_t
+        {
+            config_t()
+                : m_max_leaf_size(4)
+                , m_bin_count(16)
+            {
+            }
+            u32 m_max_leaf_size;
+            u32 m_bin_count; // <= 32
+        };
+
+        struct ray_t
+        {
+            nply::vertex_t m_origin;
+            nply::vertex_t m_direction;
+            f32            m_tmin;
+            f32            m_tmax;
+        };
+
+        struct hit_t
+        {
+            f32 m_t;
+            f32 m_u; // barycentric coordinates of the hit relative to v2 and v3
+            f32 m_v;
+            u32 m_triangle;
+        };
+
+        struct closest_t
+        {
+            nply::vertex_t m_point;
+            f32            m_distance_sq;
+            u32            m_triangle;
+        };
+
+        // A bounding volume hierarchy over a triangle mesh, built with a binned SAH and flattened
+        // into an array of 4-wide nodes that store the bounds of their children as SoA so that a
+        // ray or point is tested against all 4 children at once.
+        struct bvh_t;
+
+        // Build the BVH, the scheduler may be nullptr in which case the build runs on the calling thread.
+        // The vertex and triangle arrays are only read during the build. Returns nullptr when an
+        // allocation failed, the scratch memory of the build is given back to the allocator.
+        bvh_t* build(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, nply::vertex_t const* vertices, u32 vertex_count, nply::triangle_t const* triangles, u32 triangle_count, config_t const& config = config_t());
+        void   release(nply::allocator_t* allocator, bvh_t* bvh);
+
+        n3d::box_t get_bounds(bvh_t const* bvh);
+        u32        get_node_count(bvh_t const* bvh);
+
+        // Closest hit along the ray in [tmin, tmax]
+        bool raycast(bvh_t const* bvh, ray_t const& ray, hit_t& hit);
+
+        // Closest point on the mesh within 'max_distance' of 'point'
+        bool closest_point(bvh_t const* bvh, nply::vertex_t const& point, f32 max_distance, closest_t& closest);
+
+        // Collect the triangles whose bounds overlap the box, returns the number of overlapping
+        // triangles which can be larger than 'max_triangles' (only 'max_triangles' are written).
+        u32 overlap(bvh_t const* bvh, n3d::box_t const& box, u32* triangles, u32 max_triangles);
+
+    } // namespace nbvh
+
+} // namespace ncore
+
+#endif // __C_3DFF_BVH_H__
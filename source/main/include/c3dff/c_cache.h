@@ -0,0 +1,99 @@
+#ifndef __C_3DFF_CACHE_H__
+#define __C_3DFF_CACHE_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_parallel.h"
+
+namespace ncore
+{
+    namespace ncache
+    {
+        // A cache of decoded meshes shared by the threads of a process. A mesh is decoded once, all
+        // threads that ask for it get the same immutable mesh and hold on to it until they release it.
+        // Meshes that are not in use are evicted (least recently used first) when the cached meshes
+        // take more than the byte budget.
+
+        // A file: its identity (e.g. a hash of the path, or device + inode) and its modification time.
+        // Asking for an identity with a different stamp replaces the cached mesh.
+        struct key_t
+        {
+            u64 m_id;
+            u64 m_stamp;
+        };
+
+        struct mesh_t
+        {
+            nply::vertex_t const*   m_vertices;
+            u64                     m_vertex_count;
+            nply::triangle_t const* m_triangles;
+            u64                     m_triangle_count;
+            void const*             m_user; // anything else the loader decoded
+            u64                     m_size; // bytes allocated by the loader
+        };
+
+        class loader_t
+        {
+        public:
+            // Decode the file, all memory of the mesh must come from 'allocator' (it is released when
+            // the mesh is evicted and counts against the budget). Called on the thread that asked first.
+            virtual bool load(key_t const& key, nply::allocator_t* allocator, mesh_t& mesh) = 0;
+
+            // Called repeatedly while another thread loads the same file, yield or sleep here. Return
+            // false to stop waiting (acquire returns nullptr).
+            virtual bool wait() { return true; }
+        };
+
+        struct stats_t
+        {
+            u64 m_hits;
+            u64 m_loads;
+            u64 m_failed;
+            u64 m_evictions;
+            u64 m_size; // bytes of the cached meshes
+            u32 m_count;
+        };
+
+        class cache_t
+        {
+        public:
+            struct entry_t;
+
+            cache_t();
+
+            // 'allocator' must be thread-safe and release memory on dealloc
+            void init(nply::allocator_t* allocator, u64 budget, u32 buckets = 1024);
+            void exit(); // all meshes must have been released
+
+            // The mesh of a file, loading it when it is not cached. Returns nullptr when loading failed.
+            mesh_t const* acquire(key_t const& key, loader_t* loader);
+            void          release(mesh_t const* mesh);
+
+            void    set_budget(u64 budget); // evicts right away when the cache is over the new budget
+            stats_t get_stats();
+
+        protected:
+            entry_t* find(u64 id) const;
+            void     unlink(entry_t* entry); // from its bucket
+            void     lru_remove(entry_t* entry);
+            void     evict();
+            void     destroy(entry_t* entry);
+
+            nply::allocator_t*    m_allocator;
+            nparallel::spinlock_t m_lock;
+            entry_t**             m_buckets;
+            u32                   m_bucket_count; // power of 2
+            entry_t*              m_lru_head;     // most recently used, only meshes that are not in use
+            entry_t*              m_lru_tail;
+            u64                   m_budget;
+            stats_t               m_stats;
+        };
+
+    } // namespace ncache
+
+} // namespace ncore
+
+#endif // __C_3DFF_CACHE_H__
@@ -0,0 +1,57 @@
+#ifndef __C_3DFF_CATALOG_H__
+#define __C_3DFF_CATALOG_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_arena.h"
+#include "c3dff/c_parallel.h"
+
+namespace ncore
+{
+    namespace ncatalog
+    {
+        // File access, implemented by the user on top of their own file system.
+        // Both functions are called concurrently from the tasks of the scheduler.
+        class source_t
+        {
+        public:
+            // Read up to 'size' bytes from the start of the file, returns the number of bytes read (0 = failed)
+            virtual u64 read(const char* path, u8* buffer, u64 size) = 0;
+
+            // A value that changes when the file changes (e.g. modification time), 0 = unknown
+            virtual u64 stamp(const char* path) { return 0; }
+        };
+
+        // The header metadata (see nply::info_t) of many ply files as one flat image that is both the
+        // in-memory and the on-disk format. Entries are sorted by path.
+        struct catalog_t
+        {
+            const u8* m_data;
+            u64       m_size;
+        };
+
+        // Probe the headers of all files in parallel, only the first bytes of each file are read.
+        // Listing the files of a directory tree is up to the user, 'paths' is the result of that.
+        // Each part uses 2 arenas of 'scratch' (one for parsing, one for the results), they are reset
+        // when done. When a 'previous' catalog is given, files with an unchanged (non-zero) stamp are
+        // not read again.
+        bool build(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, nply::scratch_t* scratch, source_t* source, const char** paths, u64 path_count, catalog_t const* previous, catalog_t& catalog);
+
+        // Open a catalog image (e.g. a memory-mapped file), no data is copied. Fails when an entry or a
+        // zero terminated path does not lie within the image.
+        bool open(const u8* data, u64 size, catalog_t& catalog);
+
+        u64         get_count(catalog_t const& catalog);
+        const char* get_path(catalog_t const& catalog, u64 index);
+        u64         get_stamp(catalog_t const& catalog, u64 index);
+        bool        get_info(catalog_t const& catalog, u64 index, nply::info_t& info); // false = not a ply file or not readable
+        s64         find(catalog_t const& catalog, const char* path);                  // -1 = not found
+
+    } // namespace ncatalog
+
+} // namespace ncore
+
+#endif // __C_3DFF_CATALOG_H__
@@ -0,0 +1,128 @@
+#ifndef __C_3DFF_COMPRESSED_H__
+#define __C_3DFF_COMPRESSED_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_parallel.h"
+
+namespace ncore
+{
+    namespace ncompressed
+    {
+        // Readers that decompress a file (e.g. .ply.gz, .ply.zst) while it is being decoded, so no
+        // decompressed copy has to be written to disk first. The decompression itself is implemented
+        // by the user on top of the library they use (zlib, zstd, ...).
+
+        // The compressed bytes
+        class input_t
+        {
+        public:
+            // Read up to 'size' bytes at 'offset', returns the number of bytes read (0 = end or failed)
+            virtual u64 read_at(u64 offset, u8* buffer, u64 size) = 0;
+        };
+
+        class codec_t
+        {
+        public:
+            // Continue decompressing one stream, consuming from 'src' and producing into 'dst' as much as
+            // possible. Set 'end' when the end of the stream was reached, return false on corrupt data.
+            virtual bool stream(const u8* src, u64 src_size, u64& consumed, u8* dst, u64 dst_size, u64& produced, bool& end) = 0;
+
+            // Decompress one independent frame of which the decompressed size is known (e.g. a zstd frame
+            // or a BGZF block). Called concurrently from the tasks of the scheduler.
+            virtual bool frame(const u8* src, u64 src_size, u8* dst, u64 dst_size) { return false; }
+        };
+
+        // A frame of a multi-frame file, from the seek table of the format
+        struct frame_t
+        {
+            u64 m_offset; // compressed
+            u64 m_size;
+            u64 m_decompressed_size;
+        };
+
+        // The decompressed data is kept in one window, lines and records that cross the boundary of a
+        // chunk or a frame are contiguous. Pointers that are handed out stay valid until the next read.
+        class window_reader_t : public nply::reader_t
+        {
+        public:
+            virtual bool read_line(const char*& str, const char*& end);
+            virtual bool read_data(u64 size, const u8*& begin, const u8*& end);
+            virtual u32  line_end_size() const { return m_line_end; }
+
+            bool failed() const { return m_failed; } // corrupt or unreadable input, not just the end of the data
+            u64  get_decompressed() const { return m_decompressed; }
+
+        protected:
+            void init_window(nply::allocator_t* allocator);
+            void exit_window();
+
+            // Room for 'size' more bytes at the end of the window, the data in front of m_begin is dropped
+            u8* reserve(u64 size);
+
+            // Append decompressed data to the window (at least 'size' bytes when there is that much),
+            // returns false when nothing was added
+            virtual bool produce(u64 size) = 0;
+
+            nply::allocator_t* m_allocator;
+            u8*                m_window;
+            u64                m_capacity;
+            u64                m_begin;   // first byte not handed out
+            u64                m_used;    // end of the decompressed data
+            u64                m_scanned; // no line end in [m_begin, m_scanned)
+            u32                m_line_end;
+            u64                m_decompressed;
+            bool               m_failed;
+        };
+
+        // Decompresses a single stream (gzip, a zstd file without a seek table) on the calling thread
+        class stream_reader_t : public window_reader_t
+        {
+        public:
+            void init(nply::allocator_t* allocator, input_t* input, codec_t* codec, u64 chunk_size = 256 * 1024);
+            void exit();
+
+        protected:
+            virtual bool produce(u64 size);
+
+            input_t* m_input;
+            codec_t* m_codec;
+            u8*      m_chunk; // compressed
+            u64      m_chunk_size;
+            u64      m_chunk_begin;
+            u64      m_chunk_end;
+            u64      m_offset; // in the input
+            bool     m_input_end;
+            bool     m_stream_end;
+        };
+
+        // Decompresses the frames of a multi-frame file in parallel, a batch of frames (by default two
+        // per thread of the scheduler) is decompressed whenever the decoder has used up the previous one.
+        class frames_reader_t : public window_reader_t
+        {
+        public:
+            void init(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, input_t* input, codec_t* codec, frame_t const* frames, u64 frame_count, s32 batch = 0);
+            void exit();
+
+        protected:
+            virtual bool produce(u64 size);
+
+            nparallel::scheduler_t* m_scheduler;
+            input_t*                m_input;
+            codec_t*                m_codec;
+            frame_t const*          m_frames;
+            u64                     m_frame_count;
+            u64                     m_next; // frame
+            s32                     m_batch;
+            u8*                     m_compressed; // of a batch
+            u64                     m_compressed_size;
+        };
+
+    } // namespace ncompressed
+
+} // namespace ncore
+
+#endif // __C_3DFF_COMPRESSED_H__
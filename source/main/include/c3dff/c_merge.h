@@ -0,0 +1,68 @@
+#ifndef __C_3DFF_MERGE_H__
+#define __C_3DFF_MERGE_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_mesh.h"
+#include "c3dff/c_parallel.h"
+
+namespace ncore
+{
+    namespace nmerge
+    {
+        // Merge many meshes into one vertex and one index buffer. The offsets of every mesh are a
+        // prefix sum over the mesh sizes, after that all vertices and triangles are written in parallel
+        // (the work is split over the total number of elements, not over the meshes, so a few large
+        // meshes between many small ones do not hold up a thread). The indices of every mesh are
+        // rebased onto its first vertex in the merged buffer.
+
+        // A mesh to merge, the transform is optional (nullptr keeps the positions). Like nmesh::transform
+        // only the upper 3x4 part of the matrix is applied. Transforms that mirror the mesh (negative
+        // determinant) also swap the winding of its triangles so that front faces stay front faces.
+        struct mesh_t
+        {
+            nply::vertex_t const*   m_vertices;
+            u64                     m_vertex_count;
+            nply::triangle_t const* m_triangles;
+            u64                     m_triangle_count;
+            nmesh::matrix_t const*  m_transform;
+        };
+
+        // Where a mesh ended up in the merged buffers
+        struct range_t
+        {
+            u64 m_vertex_offset;
+            u64 m_vertex_count;
+            u64 m_triangle_offset;
+            u64 m_triangle_count;
+        };
+
+        struct merged_t
+        {
+            nply::vertex_t*   m_vertices;
+            u64               m_vertex_count;
+            nply::triangle_t* m_triangles;
+            u64               m_triangle_count;
+            range_t*          m_ranges; // one per mesh, in the order of the meshes
+            u32               m_range_count;
+        };
+
+        // Fill in the range of every mesh and the size of the merged buffers. Returns false when the
+        // merged vertices can not be indexed with 32 bits.
+        bool plan(mesh_t const* meshes, u32 mesh_count, range_t* ranges, u64& vertex_count, u64& triangle_count);
+
+        // Write the meshes into buffers of the size returned by plan (e.g. mapped GPU memory)
+        void write(nparallel::scheduler_t* scheduler, mesh_t const* meshes, u32 mesh_count, range_t const* ranges, nply::vertex_t* vertices, nply::triangle_t* triangles);
+
+        // Plan, allocate and write, returns false when the meshes do not fit or allocation failed
+        bool merge(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, mesh_t const* meshes, u32 mesh_count, merged_t& merged);
+        void release(nply::allocator_t* allocator, merged_t& merged);
+
+    } // namespace nmerge
+
+} // namespace ncore
+
+#endif // __C_3DFF_MERGE_H__
@@ -0,0 +1,60 @@
+#ifndef __C_3DFF_MESH_H__
+#define __C_3DFF_MESH_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_box.h"
+#include "c3dff/c_parallel.h"
+
+namespace ncore
+{
+    namespace nmesh
+    {
+        // Positions as separate x, y and z arrays (SoA)
+        struct positions_t
+        {
+            f32* m_x;
+            f32* m_y;
+            f32* m_z;
+            u64  m_count;
+        };
+
+        // Row-major 4x4 matrix, positions are column vectors (same convention as g3dff.Matrix)
+        struct matrix_t
+        {
+            f32 m[4][4];
+        };
+
+        matrix_t identity();
+        matrix_t translate(nply::vertex_t const& v);
+        matrix_t scale(nply::vertex_t const& v);
+        matrix_t mul(matrix_t const& a, matrix_t const& b); // a * b, b is applied first
+
+        // Convert between the vertex array (AoS) of the ply handlers and SoA, the destination arrays must be allocated
+        void to_soa(nparallel::scheduler_t* scheduler, nply::vertex_t const* vertices, positions_t& positions);
+        void to_aos(nparallel::scheduler_t* scheduler, positions_t const& positions, nply::vertex_t* vertices);
+
+        // All of the kernels below split the work over the scheduler (nullptr runs on the calling thread)
+        n3d::box_t bounds(nparallel::scheduler_t* scheduler, positions_t const& positions);
+        void       transform(nparallel::scheduler_t* scheduler, matrix_t const& matrix, positions_t& positions);
+
+        // Signed volume (positive for a closed mesh with counter-clockwise winding) and surface area
+        f64 signed_volume(nparallel::scheduler_t* scheduler, positions_t const& positions, nply::triangle_t const* triangles, u64 triangle_count);
+        f64 surface_area(nparallel::scheduler_t* scheduler, positions_t const& positions, nply::triangle_t const* triangles, u64 triangle_count);
+
+        // The matrix that scales (uniformly) and translates 'current' to fit inside of 'box', 'anchor' (0..1)
+        // determines where the result is placed along every axis that has room left.
+        matrix_t fit_inside_matrix(n3d::box_t const& current, n3d::box_t const& box, nply::vertex_t const& anchor);
+
+        // Fit the positions inside of the box / unit cube (centered at the origin), returns the applied matrix
+        matrix_t fit_inside(nparallel::scheduler_t* scheduler, positions_t& positions, n3d::box_t const& box, nply::vertex_t const& anchor);
+        matrix_t unit_cube(nparallel::scheduler_t* scheduler, positions_t& positions);
+
+    } // namespace nmesh
+
+} // namespace ncore
+
+#endif // __C_3DFF_MESH_H__
@@ -0,0 +1,82 @@
+#ifndef __C_3DFF_MESHLET_H__
+#define __C_3DFF_MESHLET_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_arena.h"
+#include "c3dff/c_parallel.h"
+
+namespace ncore
+{
+    namespace nmeshlet
+    {
+        // Meshes split into small clusters for GPU rendering. A meshlet references up to 64 vertices
+        // of the mesh and has up to 124 triangles whose indices are local (u8) to those vertices.
+        // Triangles are added greedily to keep connected triangles (and the order of the file) together.
+        enum
+        {
+            MAX_VERTICES  = 64,
+            MAX_TRIANGLES = 124,
+        };
+
+        struct meshlet_t
+        {
+            u32 m_vertex_offset;   // in meshlets_t::m_vertices
+            u32 m_triangle_offset; // in meshlets_t::m_triangles (3 local indices per triangle)
+            u32 m_vertex_count;
+            u32 m_triangle_count;
+            f32 m_center[3]; // bounding sphere
+            f32 m_radius;
+            f32 m_cone_apex[3]; // normal cone, see is_backfacing
+            f32 m_cone_axis[3];
+            f32 m_cone_cutoff; // > 1 when the normals are too spread out to cull
+        };
+
+        struct meshlets_t
+        {
+            meshlet_t* m_meshlets;
+            u32        m_meshlet_count;
+            u32*       m_vertices; // mesh vertex index of every meshlet vertex
+            u32        m_vertex_count;
+            u8*        m_triangles; // local vertex indices
+            u32        m_triangle_count;
+        };
+
+        struct config_t
+        {
+            config_t()
+                : m_max_vertices(MAX_VERTICES)
+                , m_max_triangles(MAX_TRIANGLES)
+            {
+            }
+            u32 m_max_vertices;  // 3 .. MAX_VERTICES
+            u32 m_max_triangles; // 1 .. MAX_TRIANGLES
+        };
+
+        struct mesh_t
+        {
+            nply::vertex_t const*   m_vertices;
+            u32                     m_vertex_count;
+            nply::triangle_t const* m_triangles;
+            u32                     m_triangle_count;
+        };
+
+        // Build the meshlets of one mesh, the output and temporary memory come from 'allocator'
+        bool build(nply::allocator_t* allocator, mesh_t const& mesh, config_t const& config, meshlets_t& meshlets);
+
+        // Build the meshlets of many meshes in parallel, one mesh per invocation. The output of every
+        // mesh is allocated from 'allocator' up front, each task uses an arena of 'scratch' for the
+        // temporary memory (reset when done). Returns false when a mesh failed (its meshlet count is 0).
+        bool build(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, nply::scratch_t* scratch, mesh_t const* meshes, u32 mesh_count, config_t const& config, meshlets_t* meshlets);
+
+        // True when all triangles of the meshlet face away from 'eye'
+        bool is_backfacing(meshlet_t const& meshlet, f32 const eye[3]);
+
+    } // namespace nmeshlet
+
+} // namespace ncore
+
+#endif // __C_3DFF_MESHLET_H__
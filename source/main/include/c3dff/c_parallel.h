@@ -0,0 +1,76 @@
+#ifndef __C_3DFF_PARALLEL_H__
+#define __C_3DFF_PARALLEL_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+namespace ncore
+{
+    namespace nparallel
+    {
+        class task_t
+        {
+        public:
+            virtual void execute(s32 index) = 0;
+        };
+
+        // Runs 'count' invocations of a task and returns when all of them have completed.
+        // The user implements this on top of their own threads or job system, invocations
+        // can run in any order and concurrently.
+        class scheduler_t
+        {
+        public:
+            virtual s32  concurrency()                = 0;
+            virtual void run(task_t* task, s32 count) = 0;
+        };
+
+        // Atomically add 'value' to a counter shared by the invocations of a task, returns the previous value
+        u64 atomic_add(u64 volatile* counter, u64 value);
+
+        // Atomically replace 'value' with 'desired' when it equals 'expected', returns the previous value
+        u64 atomic_cas(u64 volatile* value, u64 expected, u64 desired);
+
+        // A lock for short critical sections, waiting threads spin
+        class spinlock_t
+        {
+        public:
+            spinlock_t()
+                : m_state(0)
+            {
+            }
+
+            void lock();
+            void unlock();
+
+        protected:
+            u64 volatile m_state;
+        };
+
+        // A scheduler that runs all invocations on the calling thread
+        scheduler_t* get_serial_scheduler();
+
+        inline scheduler_t* get_scheduler(scheduler_t* scheduler) { return scheduler != nullptr ? scheduler : get_serial_scheduler(); }
+
+        // Split 'count' items into 'parts' ranges and return the range of 'part'
+        inline void get_range(u64 count, s32 parts, s32 part, u64& begin, u64& end)
+        {
+            begin = (count * (u64)part) / (u64)parts;
+            end   = (count * (u64)(part + 1)) / (u64)parts;
+        }
+
+        // The number of parts to split 'count' items into, each part having at least 'min_items'
+        inline s32 get_parts(scheduler_t* scheduler, u64 count, u64 min_items)
+        {
+            u64       parts = count / (min_items > 0 ? min_items : 1);
+            u64 const limit = (u64)scheduler->concurrency() * 4;
+            if (parts > limit)
+                parts = limit;
+            return parts > 0 ? (s32)parts : 1;
+        }
+
+    } // namespace nparallel
+
+} // namespace ncore
+
+#endif // __C_3DFF_PARALLEL_H__
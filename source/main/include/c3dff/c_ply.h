@@ -12,7 +12,12 @@ namespace ncore
         class allocator_t
         {
         public:
-            virtual void* alloc(u32 size) = 0;
+            inline void* alloc(u64 size, u32 alignment = 16) { return v_alloc(size, alignment); }
+            inline void  dealloc(void* ptr) { v_dealloc(ptr); }
+
+        protected:
+            virtual void* v_alloc(u64 size, u32 alignment) = 0;
+            virtual void  v_dealloc(void* ptr) {} // allocators that only release in bulk (arena) can ignore this
         };
 
         const char* g_ReadLine(const char* text_cursor, const char* text_end, const char*& str, const char*& end);
@@ -21,7 +26,86 @@ namespace ncore
         {
         public:
             virtual bool read_line(const char*& str, const char*& end)         = 0;
-            virtual bool read_data(u32 size, const u8*& begin, const u8*& end) = 0;
+            virtual bool read_data(u64 size, const u8*& begin, const u8*& end) = 0;
+
+            // Skip over binary data that is not needed, readers that can seek should override this
+            virtual bool skip_data(u64 size)
+            {
+                const u8* begin;
+                const u8* end;
+                while (size > 0)
+                {
+                    u64 const n = size < (1024 * 1024) ? size : (1024 * 1024);
+                    if (!read_data(n, begin, end))
+                        return false;
+                    size -= n;
+                }
+                return true;
+            }
+
+            // The length of the terminator of the line last returned by read_line ("\n" or "\r" = 1,
+            // "\r\n" = 2, 0 for a last line without one), keeps the byte offsets in errors exact
+            virtual u32 line_end_size() const { return 1; }
+        };
+
+        // Reads a file that is completely in memory
+        class memory_reader_t : public reader_t
+        {
+        public:
+            memory_reader_t(const u8* data, u64 size)
+                : m_begin((const char*)data)
+                , m_cursor((const char*)data)
+                , m_end((const char*)data + size)
+                , m_line_end(0)
+            {
+            }
+
+            virtual bool read_line(const char*& str, const char*& end)
+            {
+                const char* cursor = g_ReadLine(m_cursor, m_end, str, end);
+                if (cursor > m_cursor)
+                {
+                    m_cursor   = cursor;
+                    m_line_end = (u32)(cursor - end);
+                    return true;
+                }
+                return false;
+            }
+
+            virtual bool read_data(u64 size, const u8*& begin, const u8*& end)
+            {
+                if (size > (u64)(m_end - m_cursor))
+                    return false;
+                begin = (const u8*)m_cursor;
+                m_cursor += size;
+                end = (const u8*)m_cursor;
+                return true;
+            }
+
+            virtual bool skip_data(u64 size)
+            {
+                if (size > (u64)(m_end - m_cursor))
+                    return false;
+                m_cursor += size;
+                return true;
+            }
+
+            virtual u32 line_end_size() const { return m_line_end; }
+
+            // Number of bytes consumed so far
+            u64 offset() const { return (u64)(m_cursor - m_begin); }
+
+            const char* m_begin;
+            const char* m_cursor;
+            const char* m_end;
+            u32         m_line_end;
+        };
+
+        enum eformat
+        {
+            FORMAT_ASCII = 0, // ASCII
+            FORMAT_BLE,       // Binary Little Endian
+            FORMAT_BBE,       // Binary Big Endian
         };
 
         enum etype
@@ -56,19 +140,31 @@ namespace ncore
         inline static bool  type_is_int64(etype type) { return type_is_int(type) && (type_sizeof(type) == 8); }
         inline static bool  type_is_uint(etype type) { return (type & TYPE_UNSIGNED) == TYPE_UNSIGNED; }
         inline static bool  type_is_uint8(etype type) { return type_is_uint(type) && (type_sizeof(type) == 1); }
-        inline static bool  type_is_uint16(etype type) { return type_is_uint(type) && (type_sizeof(type) == 1); }
-        inline static bool  type_is_uint32(etype type) { return type_is_uint(type) && (type_sizeof(type) == 1); }
-        inline static bool  type_is_uint64(etype type) { return type_is_uint(type) && (type_sizeof(type) == 1); }
+        inline static bool  type_is_uint16(etype type) { return type_is_uint(type) && (type_sizeof(type) == 2); }
+        inline static bool  type_is_uint32(etype type) { return type_is_uint(type) && (type_sizeof(type) == 4); }
+        inline static bool  type_is_uint64(etype type) { return type_is_uint(type) && (type_sizeof(type) == 8); }
         inline static bool  type_is_f32(etype type) { return (type & TYPE_FLOAT32) == TYPE_FLOAT32; }
         inline static bool  type_is_f64(etype type) { return (type & TYPE_FLOAT64) == TYPE_FLOAT64; }
         inline static bool  type_is_float(etype type) { return type_is_f32(type) || type_is_f64(type); }
 
+        // A handler only receives the properties that are selected (property index >= 0), 'setup' is
+        // called once per element and when it returns false the handler does not receive that element.
+        // Elements that no handler accepts are skipped without decoding.
+        // The record passed to 'read' holds the selected properties in file order, scalars in their
+        // own type and lists as a u32 count followed by the items.
         class handler_t
         {
         public:
-            virtual bool setup(s32 element_index, int_t num_items, etype* property_type_array, s32* property_index_array, s32 property_count) = 0;
+            virtual bool setup(s32 element_index, u64 num_items, etype* property_type_array, s32* property_index_array, s32 property_count) = 0;
             virtual void read(s32 element_index, etype* property_type, s32 property_count, void* property_data)                               = 0;
 
+            // Optional fast path for binary elements with fixed-size records. It is offered the complete
+            // layout of the element (all properties in file order, with their property index), when it
+            // returns true 'read_records' receives the raw file records in batches and 'setup' and 'read'
+            // are not called for that element. See c_ply_layout.h.
+            virtual bool setup_records(s32 element_index, u64 num_items, etype const* property_type_array, s32 const* property_index_array, s32 property_count, eformat format) { return false; }
+            virtual void read_records(s32 element_index, const u8* records, u64 record_count) {}
+
         protected:
             static u32 get_offset(s32 property_index, etype* property_type_array, s32 property_count);
             static s8  read_s8(etype property_type, u32 property_offset, void* property_data);
@@ -93,6 +189,7 @@ namespace ncore
 
         enum eindex
         {
+            INDEX_NONE   = -1, // element or property is not decoded
             INDEX_VERTEX = 0,
             INDEX_FACE   = 1,
             INDEX_PROP_X = 0,
@@ -103,13 +200,13 @@ namespace ncore
         class vertices_handler_t : public handler_t
         {
         public:
-            u32       m_vertex_max;
-            u32       m_vertex_count;
+            u64       m_vertex_max;
+            u64       m_vertex_count;
             vertex_t* m_vertex_array;
             etype     m_property_type[3];
             s32       m_property_offset[3];
 
-            vertices_handler_t(vertex_t* vertex_array, u32 vertex_max)
+            vertices_handler_t(vertex_t* vertex_array, u64 vertex_max)
                 : m_vertex_max(vertex_max)
                 , m_vertex_count(0)
                 , m_vertex_array(vertex_array)
@@ -121,13 +218,13 @@ namespace ncore
                 }
             }
 
-            virtual bool setup(s32 element_index, int_t num_items, etype* property_type_array, s32* property_index_array, s32 property_count)
+            virtual bool setup(s32 element_index, u64 num_items, etype* property_type_array, s32* property_index_array, s32 property_count)
             {
                 if (element_index == INDEX_VERTEX)
                 {
                     for (int i = 0; i < property_count; i++)
                     {
-                        if (property_index_array[i] >= 0)
+                        if (property_index_array[i] >= 0 && property_index_array[i] < 3)
                         {
                             m_property_type[property_index_array[i]]   = property_type_array[i];
                             m_property_offset[property_index_array[i]] = get_offset(i, property_type_array, property_count);
@@ -140,7 +237,7 @@ namespace ncore
 
             virtual void read(s32 element_index, etype* property_type_array, s32 property_count, void* property_data)
             {
-                if (element_index == INDEX_VERTEX)
+                if (element_index == INDEX_VERTEX && m_vertex_count < m_vertex_max)
                 {
                     vertex_t& v = m_vertex_array[m_vertex_count];
                     v.x         = read_f32(m_property_type[0], m_property_offset[0], property_data);
@@ -154,62 +251,191 @@ namespace ncore
         class triangles_handler_t : public handler_t
         {
         public:
-            u32         m_triangle_max;
-            u32         m_triangle_count;
+            u64         m_triangle_max;
+            u64         m_triangle_count;
             triangle_t* m_triangle_array;
-            etype       m_property_type;
-            s32         m_property_offset[4];
+            etype       m_property_type; // type of the list items
+            s32         m_property_offset;
 
-            triangles_handler_t(triangle_t* triangle_array, u32 triangle_max)
+            triangles_handler_t(triangle_t* triangle_array, u64 triangle_max)
                 : m_triangle_max(triangle_max)
                 , m_triangle_count(0)
                 , m_triangle_array(triangle_array)
             {
-                m_property_type = TYPE_INVALID;
-                for (int i = 0; i < 4; i++)
-                {
-                    m_property_offset[i] = 0;
-                }
+                m_property_type   = TYPE_INVALID;
+                m_property_offset = 0;
             }
 
-            virtual bool setup(s32 element_index, int_t num_items, etype* property_type_array, s32* property_index_array, s32 property_count)
+            virtual bool setup(s32 element_index, u64 num_items, etype* property_type_array, s32* property_index_array, s32 property_count)
             {
                 if (element_index == INDEX_FACE)
                 {
-                    ASSERT(type_is_list(property_type_array[0]));
-                    m_property_type = property_type_array[1];
-                    for (int i = 0; i < 4; i++)
+                    // the first list holds the vertex indices
+                    for (int i = 0; i < property_count; i++)
                     {
-                        m_property_offset[i] = get_offset(i, property_type_array, property_count);
+                        if (type_is_list(property_type_array[i]))
+                        {
+                            m_property_type   = (etype)(property_type_array[i] & ~TYPE_LIST);
+                            m_property_offset = get_offset(i, property_type_array, property_count);
+                            return true;
+                        }
                     }
-                    return true;
                 }
                 return false;
             }
 
+            // Polygons are split into a fan around their first vertex (n - 2 triangles, the array has to
+            // be sized for that), faces with fewer than 3 indices are skipped
             virtual void read(s32 element_index, etype* property_type_array, s32 property_count, void* property_data)
             {
-                if (element_index == INDEX_FACE)
+                if (element_index != INDEX_FACE)
+                    return;
+                u32 const count = read_u32(TYPE_UINT32, m_property_offset, property_data);
+                if (count < 3)
+                    return;
+                s32 const size  = type_sizeof(m_property_type);
+                u32 const first = read_u32(m_property_type, m_property_offset + 4, property_data);
+                u32       prev  = read_u32(m_property_type, m_property_offset + 4 + size, property_data);
+                for (u32 i = 2; i < count && m_triangle_count < m_triangle_max; ++i)
                 {
-                    triangle_t& t = m_triangle_array[m_triangle_count];
-                    ASSERT(read_s8(property_type_array[0], 0, property_data) == 3); // should be a triangle
-                    t.v1 = read_u32(m_property_type, m_property_offset[1], property_data);
-                    t.v2 = read_u32(m_property_type, m_property_offset[2], property_data);
-                    t.v3 = read_u32(m_property_type, m_property_offset[3], property_data);
-                    m_triangle_count++;
+                    u32 const   next = read_u32(m_property_type, m_property_offset + 4 + size * i, property_data);
+                    triangle_t& t    = m_triangle_array[m_triangle_count++];
+                    t.v1             = first;
+                    t.v2             = prev;
+                    t.v3             = next;
+                    prev             = next;
                 }
             }
         };
 
         struct ply_t;
-        ply_t* create(allocator_t* allocator);
+        ply_t* create(allocator_t* allocator); // nullptr when out of memory
 
         bool read_header(ply_t* ply, reader_t* reader);
-        u32  get_element_count(ply_t* ply, const char* element_name);
-        void set_element_index(ply_t* ply, const char* element_name, s32 index);
+        u64  get_element_count(ply_t* ply, const char* element_name);
+        void set_element_index(ply_t* ply, const char* element_name, s32 index); // INDEX_NONE = skip the element
         bool set_property_index(ply_t* ply, const char* element_name, const char* property_name, s32 index);
 
-        void read_data(ply_t* ply, reader_t* reader, handler_t* handler1, handler_t* handler2);
+        // Decode only the named properties of an element, their property index becomes their position in
+        // 'property_names' and all other properties are skipped. Returns false if a name was not found.
+        bool select_properties(ply_t* ply, const char* element_name, const char** property_names, s32 property_count);
+
+        bool read_data(ply_t* ply, reader_t* reader, handler_t* handler1, handler_t* handler2);
+
+        // Decode records [first, first + count) of a binary element with fixed-size records, the reader
+        // only provides the data of those records. This lets a large element be decoded in parts on
+        // several threads, each with its own ply_t (read_header on a copy of the header). When an element
+        // before it has variable-size records the position in the file is not known and errors report
+        // c_offset_unknown as their offset.
+        bool read_records(ply_t* ply, const char* element_name, u64 first, u64 count, reader_t* reader, handler_t* handler);
+
+        enum eerror
+        {
+            ERROR_NONE = 0,
+            ERROR_NOT_PLY,   // the file does not start with 'ply'
+            ERROR_HEADER,    // malformed header line, e.g. a property before any element
+            ERROR_FORMAT,    // unknown format
+            ERROR_TYPE,      // unknown property type
+            ERROR_TRUNCATED, // the file ends before the header or the data is complete
+            ERROR_VALUE,     // missing or malformed value in an ASCII file
+            ERROR_MEMORY,    // the allocator returned nullptr
+            ERROR_INDEX,     // face index out of range (validation)
+            ERROR_NOT_FINITE // NaN or Inf (validation)
+        };
+
+        // Where read_header or read_data failed, the offset is a byte offset in the file (line ends are
+        // counted as reported by reader_t::line_end_size)
+        const u64 c_offset_unknown = ~(u64)0;
+
+        struct error_t
+        {
+            eerror m_kind;
+            s32    m_element; // position of the element in the header, -1 = in the header itself
+            u64    m_record;  // record of that element
+            u64    m_offset;  // in the file, c_offset_unknown when it cannot be known (see read_records)
+        };
+
+        error_t const& get_error(ply_t const* ply);
+        const char*    get_error_name(eerror kind);
+
+        // Opt-in checks of the decoded data, done before the handlers see a record. A record that fails
+        // makes read_data stop with ERROR_INDEX or ERROR_NOT_FINITE, the handlers have then received
+        // exactly the records before it, so the data they hold is partial.
+        enum evalidate
+        {
+            VALIDATE_NONE    = 0,
+            VALIDATE_INDICES = 1, // 'vertex_indices'/'vertex_index' list items must be in [0, vertex count)
+            VALIDATE_FINITE  = 2, // float properties must not be NaN or Inf
+        };
+        void set_validation(ply_t* ply, u32 validate_flags);
+
+        // Clock for the decode statistics, implemented by the user (e.g. on top of rdtsc or the OS timer)
+        class ticker_t
+        {
+        public:
+            virtual u64 ticks()     = 0;
+            virtual u64 frequency() = 0; // ticks per second
+        };
+
+        // Decode statistics, only collected while a ticker is set with enable_stats(). Time is in ticks,
+        // divide by m_frequency for seconds. A ply_t is decoded by one thread, for a per-thread breakdown
+        // use one ply_t per thread and merge their statistics with add_stats().
+        // @note: Define C3DFF_DISABLE_STATS to compile the instrumentation out of the decoder.
+        struct stats_t
+        {
+            enum ephase
+            {
+                PHASE_HEADER = 0, // read_header
+                PHASE_IO,         // waiting on the reader (read_line, read_data and skip_data)
+                PHASE_PARSE,      // tokenizing, parsing numbers and decoding lists
+                PHASE_CONVERT,    // copying and byte swapping fixed-size records
+                PHASE_HANDLER,    // inside handler_t::read
+                PHASE_COUNT,
+            };
+
+            u64 m_ticks[PHASE_COUNT];
+            u64 m_frequency;
+            u64 m_bytes_read;    // returned by the reader
+            u64 m_bytes_skipped; // passed to skip_data
+            u64 m_reader_calls;
+            u64 m_items_decoded; // items of elements that were handed to a handler
+            u64 m_items_skipped;
+        };
+
+        void           enable_stats(ply_t* ply, ticker_t* ticker); // nullptr = disable
+        void           reset_stats(ply_t* ply);
+        stats_t const* get_stats(ply_t const* ply); // nullptr when disabled
+        void           add_stats(stats_t& dst, stats_t const& src);
+
+        // Header metadata as one flat image (format, element counts, property schema, comments,
+        // obj_info and the byte offset of the body), can be stored as-is and opened again without
+        // parsing.
+        struct info_t
+        {
+            const u8* m_data;
+            u64       m_size;
+        };
+
+        // Parse only the header from the first bytes of a file, returns false when the data is not a
+        // ply file or does not hold the complete header (read more bytes and try again).
+        // The parse itself also allocates from 'allocator', use an arena and copy the image out.
+        bool probe(allocator_t* allocator, const u8* data, u64 size, info_t& info);
+        bool open_info(const u8* data, u64 size, info_t& info);
+
+        eformat     get_format(info_t const& info);
+        u64         get_body_offset(info_t const& info);
+        u64         get_element_count(info_t const& info, const char* element_name);
+        s32         get_num_elements(info_t const& info);
+        const char* get_element_name(info_t const& info, s32 element);
+        u64         get_element_items(info_t const& info, s32 element);
+        s32         get_num_properties(info_t const& info, s32 element);
+        const char* get_property_name(info_t const& info, s32 element, s32 property);
+        etype       get_property_type(info_t const& info, s32 element, s32 property); // lists have TYPE_LIST set
+        etype       get_property_count_type(info_t const& info, s32 element, s32 property);
+        s32         get_num_comments(info_t const& info);
+        const char* get_comment(info_t const& info, s32 index);
+        s32         get_num_obj_info(info_t const& info);
+        const char* get_obj_info(info_t const& info, s32 index);
 
     } // namespace nply
 
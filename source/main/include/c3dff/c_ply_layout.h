@@ -0,0 +1,335 @@
+#ifndef __C_3DFF_PLY_LAYOUT_H__
+#define __C_3DFF_PLY_LAYOUT_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+
+namespace ncore
+{
+    namespace nply
+    {
+        // Compile-time record layouts, for files whose property layout is known up front (e.g. the
+        // few layouts a scanner writes). A layout lists the properties of an element in file order,
+        // each with the member of the user record it is decoded into:
+        //
+        //   struct point_t { f32 x, y, z; u8 r, g, b; };
+        //   typedef layout_t<point_t, field_t<f32, offsetof(point_t, x)>, field_t<f32, offsetof(point_t, y)>,
+        //                    field_t<f32, offsetof(point_t, z)>, field_t<u8, offsetof(point_t, r)>,
+        //                    field_t<u8, offsetof(point_t, g)>, field_t<u8, offsetof(point_t, b)> > point_layout_t;
+        //
+        //   records_handler_t<point_layout_t> handler(INDEX_VERTEX, points, count);
+        //
+        // When a binary element has exactly this layout (types and property indices 0..n-1, which is the
+        // default) the records are decoded by a fully unrolled loop straight from the file data. Any other
+        // layout (ASCII, other types, lists, reordered by select_properties) goes through the generic
+        // per-value path, properties are then matched to fields by property index and values are clamped
+        // to the range of the field type.
+
+        template <typename T> struct type_of_t
+        {
+            enum
+            {
+                TYPE = TYPE_INVALID
+            };
+        };
+        template <> struct type_of_t<s8>
+        {
+            enum
+            {
+                TYPE = TYPE_INT8
+            };
+        };
+        template <> struct type_of_t<u8>
+        {
+            enum
+            {
+                TYPE = TYPE_UINT8
+            };
+        };
+        template <> struct type_of_t<s16>
+        {
+            enum
+            {
+                TYPE = TYPE_INT16
+            };
+        };
+        template <> struct type_of_t<u16>
+        {
+            enum
+            {
+                TYPE = TYPE_UINT16
+            };
+        };
+        template <> struct type_of_t<s32>
+        {
+            enum
+            {
+                TYPE = TYPE_INT32
+            };
+        };
+        template <> struct type_of_t<u32>
+        {
+            enum
+            {
+                TYPE = TYPE_UINT32
+            };
+        };
+        template <> struct type_of_t<f32>
+        {
+            enum
+            {
+                TYPE = TYPE_FLOAT32
+            };
+        };
+        template <> struct type_of_t<f64>
+        {
+            enum
+            {
+                TYPE = TYPE_FLOAT64
+            };
+        };
+
+        // Converts a value of the generic path to the field type. A value outside the range of the type
+        // is clamped in f64 first, converting it is undefined; NaN becomes 0 for integer types.
+        template <typename T> struct convert_t
+        {
+            static inline T to(f64 value)
+            {
+                bool const signed_type = (T)-1 < (T)0;
+                u64 const  half        = ((u64)1 << (sizeof(T) * 8 - 1)) - 1;
+                f64 const  hi          = signed_type ? (f64)half : (f64)half * 2.0 + 1.0;
+                f64 const  lo          = signed_type ? -(f64)half - 1.0 : 0.0;
+                if (value != value)
+                    return (T)0;
+                if (value < lo)
+                    return (T)lo;
+                if (value > hi)
+                    return (T)hi;
+                return (T)value;
+            }
+        };
+        template <> struct convert_t<f32>
+        {
+            static inline f32 to(f64 value)
+            {
+                f64 const hi = 3.40282346638528859812e+38; // FLT_MAX, infinities and NaN convert as they are
+                if (value > hi && value <= 1.79769313486231570815e+308)
+                    return (f32)hi;
+                if (value < -hi && value >= -1.79769313486231570815e+308)
+                    return (f32)-hi;
+                return (f32)value;
+            }
+        };
+        template <> struct convert_t<f64>
+        {
+            static inline f64 to(f64 value) { return value; }
+        };
+
+        // A property of type T that is decoded into the record at byte OFFSET
+        template <typename T, u32 OFFSET> struct field_t
+        {
+            enum
+            {
+                TYPE  = type_of_t<T>::TYPE,
+                SIZE  = sizeof(T),
+                COUNT = 1,
+            };
+
+            // The loops have a constant trip count, the compiler turns them into a single (swapping) move
+            template <bool SWAP> static inline void decode(const u8* src, u8* record)
+            {
+                u8* dst = record + OFFSET;
+                for (s32 i = 0; i < SIZE; ++i)
+                    dst[i] = SWAP ? src[SIZE - 1 - i] : src[i];
+            }
+
+            static inline void assign(u8* record, f64 value)
+            {
+                T const   v   = convert_t<T>::to(value);
+                u8 const* src = (u8 const*)&v;
+                u8*       dst = record + OFFSET;
+                for (s32 i = 0; i < SIZE; ++i)
+                    dst[i] = src[i];
+            }
+        };
+
+        // Marks the unused fields of a layout
+        struct field_none_t
+        {
+            enum
+            {
+                TYPE  = TYPE_INVALID,
+                SIZE  = 0,
+                COUNT = 0,
+            };
+
+            template <bool SWAP> static inline void decode(const u8* src, u8* record) {}
+            static inline void                      assign(u8* record, f64 value) {}
+        };
+
+        template <typename R, typename F0, typename F1 = field_none_t, typename F2 = field_none_t, typename F3 = field_none_t, typename F4 = field_none_t, typename F5 = field_none_t, typename F6 = field_none_t, typename F7 = field_none_t,
+                  typename F8 = field_none_t, typename F9 = field_none_t, typename F10 = field_none_t, typename F11 = field_none_t>
+        struct layout_t
+        {
+            typedef R record_t;
+
+            enum
+            {
+                MAX_FIELDS = 12,
+                COUNT      = F0::COUNT + F1::COUNT + F2::COUNT + F3::COUNT + F4::COUNT + F5::COUNT + F6::COUNT + F7::COUNT + F8::COUNT + F9::COUNT + F10::COUNT + F11::COUNT,
+                STRIDE     = F0::SIZE + F1::SIZE + F2::SIZE + F3::SIZE + F4::SIZE + F5::SIZE + F6::SIZE + F7::SIZE + F8::SIZE + F9::SIZE + F10::SIZE + F11::SIZE,
+            };
+
+            static etype field_type(s32 field)
+            {
+                static const s32 s_types[MAX_FIELDS] = {F0::TYPE, F1::TYPE, F2::TYPE, F3::TYPE, F4::TYPE, F5::TYPE, F6::TYPE, F7::TYPE, F8::TYPE, F9::TYPE, F10::TYPE, F11::TYPE};
+                return (etype)s_types[field];
+            }
+
+            // True when the element is stored exactly as this layout
+            static bool match(etype const* property_type_array, s32 const* property_index_array, s32 property_count)
+            {
+                if (property_count != COUNT)
+                    return false;
+                for (s32 i = 0; i < property_count; ++i)
+                {
+                    if (property_type_array[i] != field_type(i) || property_index_array[i] != i)
+                        return false;
+                }
+                return true;
+            }
+
+            template <bool SWAP> static inline void decode(const u8* src, record_t& record)
+            {
+                u8* dst = (u8*)&record;
+                F0::template decode<SWAP>(src, dst);
+                F1::template decode<SWAP>(src + F0::SIZE, dst);
+                F2::template decode<SWAP>(src + F0::SIZE + F1::SIZE, dst);
+                F3::template decode<SWAP>(src + F0::SIZE + F1::SIZE + F2::SIZE, dst);
+                F4::template decode<SWAP>(src + F0::SIZE + F1::SIZE + F2::SIZE + F3::SIZE, dst);
+                F5::template decode<SWAP>(src + F0::SIZE + F1::SIZE + F2::SIZE + F3::SIZE + F4::SIZE, dst);
+                F6::template decode<SWAP>(src + F0::SIZE + F1::SIZE + F2::SIZE + F3::SIZE + F4::SIZE + F5::SIZE, dst);
+                F7::template decode<SWAP>(src + F0::SIZE + F1::SIZE + F2::SIZE + F3::SIZE + F4::SIZE + F5::SIZE + F6::SIZE, dst);
+                F8::template decode<SWAP>(src + F0::SIZE + F1::SIZE + F2::SIZE + F3::SIZE + F4::SIZE + F5::SIZE + F6::SIZE + F7::SIZE, dst);
+                F9::template decode<SWAP>(src + F0::SIZE + F1::SIZE + F2::SIZE + F3::SIZE + F4::SIZE + F5::SIZE + F6::SIZE + F7::SIZE + F8::SIZE, dst);
+                F10::template decode<SWAP>(src + F0::SIZE + F1::SIZE + F2::SIZE + F3::SIZE + F4::SIZE + F5::SIZE + F6::SIZE + F7::SIZE + F8::SIZE + F9::SIZE, dst);
+                F11::template decode<SWAP>(src + F0::SIZE + F1::SIZE + F2::SIZE + F3::SIZE + F4::SIZE + F5::SIZE + F6::SIZE + F7::SIZE + F8::SIZE + F9::SIZE + F10::SIZE, dst);
+            }
+
+            template <bool SWAP> static void decode(const u8* src, record_t* records, u64 count)
+            {
+                for (u64 i = 0; i < count; ++i, src += STRIDE)
+                    decode<SWAP>(src, records[i]);
+            }
+
+            static void assign(s32 field, record_t& record, f64 value)
+            {
+                u8* dst = (u8*)&record;
+                switch (field)
+                {
+                    case 0: F0::assign(dst, value); break;
+                    case 1: F1::assign(dst, value); break;
+                    case 2: F2::assign(dst, value); break;
+                    case 3: F3::assign(dst, value); break;
+                    case 4: F4::assign(dst, value); break;
+                    case 5: F5::assign(dst, value); break;
+                    case 6: F6::assign(dst, value); break;
+                    case 7: F7::assign(dst, value); break;
+                    case 8: F8::assign(dst, value); break;
+                    case 9: F9::assign(dst, value); break;
+                    case 10: F10::assign(dst, value); break;
+                    case 11: F11::assign(dst, value); break;
+                    default: break;
+                }
+            }
+        };
+
+        // Decodes one element into an array of layout records, with the specialized loop when the file
+        // matches the layout and the generic path otherwise. Fields without a property are set to 0.
+        template <typename L> class records_handler_t : public handler_t
+        {
+        public:
+            typedef typename L::record_t record_t;
+
+            s32       m_element_index;
+            record_t* m_record_array;
+            u64       m_record_max;
+            u64       m_record_count;
+            bool      m_specialized; // last element went through the specialized loop
+            bool      m_swap;
+            etype     m_property_type[L::MAX_FIELDS]; // generic path
+            u32       m_property_offset[L::MAX_FIELDS];
+
+            records_handler_t(s32 element_index, record_t* record_array, u64 record_max)
+                : m_element_index(element_index)
+                , m_record_array(record_array)
+                , m_record_max(record_max)
+                , m_record_count(0)
+                , m_specialized(false)
+                , m_swap(false)
+            {
+                for (s32 i = 0; i < L::MAX_FIELDS; ++i)
+                {
+                    m_property_type[i]   = TYPE_INVALID;
+                    m_property_offset[i] = 0;
+                }
+            }
+
+            virtual bool setup_records(s32 element_index, u64 num_items, etype const* property_type_array, s32 const* property_index_array, s32 property_count, eformat format)
+            {
+                if (element_index != m_element_index || !L::match(property_type_array, property_index_array, property_count))
+                    return false;
+                m_specialized = true;
+                m_swap        = format == FORMAT_BBE;
+                return true;
+            }
+
+            virtual void read_records(s32 element_index, const u8* records, u64 record_count)
+            {
+                u64 const room = m_record_max - m_record_count;
+                if (record_count > room)
+                    record_count = room;
+                if (m_swap)
+                    L::template decode<true>(records, m_record_array + m_record_count, record_count);
+                else
+                    L::template decode<false>(records, m_record_array + m_record_count, record_count);
+                m_record_count += record_count;
+            }
+
+            virtual bool setup(s32 element_index, u64 num_items, etype* property_type_array, s32* property_index_array, s32 property_count)
+            {
+                if (element_index != m_element_index)
+                    return false;
+                m_specialized = false;
+                for (s32 i = 0; i < L::MAX_FIELDS; ++i)
+                    m_property_type[i] = TYPE_INVALID;
+                for (s32 i = 0; i < property_count; ++i)
+                {
+                    s32 const field = property_index_array[i];
+                    if (field >= 0 && field < L::COUNT && !type_is_list(property_type_array[i]))
+                    {
+                        m_property_type[field]   = property_type_array[i];
+                        m_property_offset[field] = get_offset(i, property_type_array, property_count);
+                    }
+                }
+                return true;
+            }
+
+            virtual void read(s32 element_index, etype* property_type_array, s32 property_count, void* property_data)
+            {
+                if (m_record_count == m_record_max)
+                    return;
+                record_t& record = m_record_array[m_record_count++];
+                for (s32 i = 0; i < L::COUNT; ++i)
+                    L::assign(i, record, m_property_type[i] != TYPE_INVALID ? read_f64(m_property_type[i], m_property_offset[i], property_data) : 0.0);
+            }
+        };
+
+    } // namespace nply
+
+} // namespace ncore
+
+#endif // __C_3DFF_PLY_LAYOUT_H__
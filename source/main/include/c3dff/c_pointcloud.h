@@ -0,0 +1,78 @@
+#ifndef __C_3DFF_POINTCLOUD_H__
+#define __C_3DFF_POINTCLOUD_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+
+namespace ncore
+{
+    namespace npointcloud
+    {
+        // A vertex handler that does not store the points but accumulates them into a hashed voxel
+        // grid, only one averaged point per occupied voxel is kept. Memory use is proportional to
+        // the number of occupied voxels, not to the number of points in the file.
+        //
+        // Properties are mapped the same way as vertices_handler_t does (property index 0, 1 and 2 are
+        // x, y and z), property index 3 to (3 + attribute_count - 1) are averaged as attributes.
+        class voxel_grid_handler_t : public nply::handler_t
+        {
+        public:
+            enum
+            {
+                MAX_ATTRIBUTES = 13,
+            };
+
+            voxel_grid_handler_t(nply::allocator_t* allocator, f32 voxel_size, s32 attribute_count = 0, u32 initial_capacity = 65536);
+
+            // Give the tables back to the allocator, the handler is empty afterwards
+            void release();
+
+            virtual bool setup(s32 element_index, u64 num_items, nply::etype* property_type_array, s32* property_index_array, s32 property_count);
+            virtual void read(s32 element_index, nply::etype* property_type_array, s32 property_count, void* property_data);
+
+            // Returns false when the table could not grow, the point is dropped (see out_of_memory). Points
+            // with a NaN or Inf coordinate are skipped.
+            bool insert(f32 x, f32 y, f32 z, f32 const* attributes);
+
+            // Statistical outlier removal on the averaged points, a point is removed when the mean distance
+            // to its k nearest neighbours is larger than mean + (std_ratio * standard deviation) of all points.
+            // Neighbours are searched within 'search_radius' voxels, a point without any counts as having
+            // them at that distance. Returns the number of removed points.
+            u32 remove_outliers(s32 k, f32 std_ratio, s32 search_radius = 2);
+
+            u32  get_point_count() const { return m_count - m_removed; }
+            u64  get_input_count() const { return m_input_count; }
+            bool out_of_memory() const { return m_out_of_memory; } // points were dropped
+
+            // Write the averaged points, attributes are interleaved per point (attribute_count per point)
+            u32 get_points(nply::vertex_t* positions, f32* attributes, u32 max_points) const;
+
+        protected:
+            s32  find(u64 key) const;
+            bool grow();
+
+            nply::allocator_t* m_allocator;
+            f32                m_voxel_size;
+            f32                m_inv_voxel_size;
+            s32                m_attribute_count;
+            u32                m_capacity; // power of 2
+            u32                m_count;
+            u32                m_removed;
+            u64                m_input_count;
+            bool               m_out_of_memory;
+            u64*               m_keys;       // 0 = free slot
+            u32*               m_counts;     // 0 = removed
+            f64*               m_sums;       // 3 per slot
+            f32*               m_attributes; // attribute_count per slot
+            nply::etype        m_property_type[3 + MAX_ATTRIBUTES];
+            s32                m_property_offset[3 + MAX_ATTRIBUTES];
+        };
+
+    } // namespace npointcloud
+
+} // namespace ncore
+
+#endif // __C_3DFF_POINTCLOUD_H__
@@ -0,0 +1,58 @@
+#ifndef __C_3DFF_QUANTIZE_H__
+#define __C_3DFF_QUANTIZE_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_box.h"
+
+namespace ncore
+{
+    namespace nquantize
+    {
+        // A compact mesh stored as one flat image that is both the in-memory and the on-disk format:
+        //   - positions are quantized to 16 bits per axis relative to the bounding box of the mesh
+        //   - normals (optional) are octahedral encoded with 16 bits per component
+        //   - indices are stored as u16 or as zigzag delta + variable-length integers, whichever is smaller
+        struct compact_mesh_t
+        {
+            const u8* m_data;
+            u64       m_size;
+        };
+
+        enum eindex_format
+        {
+            INDEX_FORMAT_U16    = 0,
+            INDEX_FORMAT_VARINT = 1,
+        };
+
+        // Normals are optional (nullptr) and are 3 floats per vertex
+        bool encode(nply::allocator_t* allocator, nply::vertex_t const* vertices, f32 const* normals, u32 vertex_count, nply::triangle_t const* triangles, u32 triangle_count, compact_mesh_t& mesh);
+
+        // Open a compact mesh image (e.g. a memory-mapped file), no data is copied
+        bool open(const u8* data, u64 size, compact_mesh_t& mesh);
+
+        u32           get_vertex_count(compact_mesh_t const& mesh);
+        u32           get_triangle_count(compact_mesh_t const& mesh);
+        bool          has_normals(compact_mesh_t const& mesh);
+        eindex_format get_index_format(compact_mesh_t const& mesh);
+        n3d::box_t    get_bounds(compact_mesh_t const& mesh);
+
+        nply::vertex_t get_position(compact_mesh_t const& mesh, u32 index);
+
+        // Decode back to floats, the output arrays must hold 'vertex count' vertices / normals (3 floats)
+        void decode_positions(compact_mesh_t const& mesh, nply::vertex_t* vertices);
+        void decode_normals(compact_mesh_t const& mesh, f32* normals);
+        bool decode_indices(compact_mesh_t const& mesh, nply::triangle_t* triangles);
+
+        // Octahedral normal encoding
+        void oct_encode(f32 x, f32 y, f32 z, u16& u, u16& v);
+        void oct_decode(u16 u, u16 v, f32& x, f32& y, f32& z);
+
+    } // namespace nquantize
+
+} // namespace ncore
+
+#endif // __C_3DFF_QUANTIZE_H__
@@ -0,0 +1,80 @@
+#ifndef __C_3DFF_SAMPLE_H__
+#define __C_3DFF_SAMPLE_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_mesh.h"
+#include "c3dff/c_parallel.h"
+
+namespace ncore
+{
+    namespace nsample
+    {
+        // Uniformly distributed points on the surface of a mesh. Triangles are picked in proportion
+        // to their area from an alias table (constant time per point), the point in the triangle
+        // from two random numbers without rejection.
+
+        // The mesh, attribute arrays (SoA, one value per vertex) are optional
+        struct mesh_t
+        {
+            nmesh::positions_t      m_positions;
+            f32 const* const*       m_attributes;
+            s32                     m_attribute_count;
+            nply::triangle_t const* m_triangles;
+            u64                     m_triangle_count;
+        };
+
+        struct table_t
+        {
+            f32* m_probability; // of keeping the triangle of the slot, otherwise its alias
+            u32* m_alias;
+            u32  m_count;
+            f64  m_area; // total
+        };
+
+        struct config_t
+        {
+            config_t()
+                : m_seed(1)
+                , m_attributes(false)
+                , m_min_distance(0.0f)
+            {
+            }
+            u64  m_seed;
+            bool m_attributes;   // interpolate the attributes of the mesh at the points
+            f32  m_min_distance; // > 0: poisson-disk thinning of the points
+        };
+
+        // Points as SoA, with the triangle each one was taken from
+        struct points_t
+        {
+            nmesh::positions_t m_positions;
+            f32**              m_attributes;
+            s32                m_attribute_count;
+            u32*               m_triangles;
+            u64                m_count;
+        };
+
+        // Build the alias table over the triangle areas, false when the mesh has no area
+        bool build(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, mesh_t const& mesh, table_t& table);
+        void release(nply::allocator_t* allocator, table_t& table);
+
+        // Generate 'count' points (fewer after thinning). Every block of points has its own random
+        // stream derived from the seed, the points do not depend on the number of threads.
+        bool sample(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, mesh_t const& mesh, table_t const& table, u64 count, config_t const& config, points_t& points);
+        void release(nply::allocator_t* allocator, points_t& points);
+
+        // Remove points until no two are closer than 'min_distance', the remaining points are compacted
+        // in order. Grid cells of that size are processed in 27 interleaved phases (cells of a phase are
+        // far enough apart to be thinned in parallel), within a cell earlier points are kept first.
+        // Returns false when out of memory (nothing is removed).
+        bool thin(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, points_t& points, f32 min_distance);
+
+    } // namespace nsample
+
+} // namespace ncore
+
+#endif // __C_3DFF_SAMPLE_H__
@@ -0,0 +1,56 @@
+#ifndef __C_3DFF_SVO_H__
+#define __C_3DFF_SVO_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+
+namespace ncore
+{
+    namespace nsvo
+    {
+        // A voxel inside of a chunk, a value of 0 means 'empty' and will remove the voxel when merging
+        struct voxel_t
+        {
+            u16 x, y, z;
+            u8  value;
+            u8  pad;
+        };
+
+        // A sparse voxel octree of a single chunk stored as one flat, pointerless image.
+        // Every level holds one child-mask byte per node in breadth-first order, the children of a
+        // node are located by counting the bits of all the masks that come before it (a rank table
+        // per 64 masks keeps this constant time). The leaf level is the array of voxel values.
+        // The image can be written to disk as-is and opened again from (memory-mapped) bytes.
+        struct svo_t
+        {
+            const u8* m_data;
+            u64       m_size;
+        };
+
+        const u32 c_max_depth = 10; // 1024 x 1024 x 1024 voxels
+
+        // Build an SVO of (1 << depth)^3 voxels, the voxel array is used as scratch and will be modified
+        bool build(nply::allocator_t* allocator, u32 depth, voxel_t* voxels, u32 voxel_count, svo_t& svo);
+
+        // Merge voxels into an existing SVO and produce a new SVO, voxels that are already present
+        // will take the new value and voxels with a value of 0 are removed.
+        bool merge(nply::allocator_t* allocator, svo_t const& svo, voxel_t* voxels, u32 voxel_count, svo_t& merged);
+
+        // Open an SVO image (e.g. a memory-mapped file), no data is copied
+        bool open(const u8* data, u64 size, svo_t& svo);
+
+        u32 get_depth(svo_t const& svo);
+        u32 get_voxel_count(svo_t const& svo);
+        u8  get_voxel(svo_t const& svo, u32 x, u32 y, u32 z);
+
+        // Decode all voxels (in morton order), returns the number of voxels written
+        u32 decode(svo_t const& svo, voxel_t* voxels, u32 voxel_max);
+
+    } // namespace nsvo
+
+} // namespace ncore
+
+#endif // __C_3DFF_SVO_H__
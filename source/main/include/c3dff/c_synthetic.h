@@ -0,0 +1,56 @@
+#ifndef __C_3DFF_SYNTHETIC_H__
+#define __C_3DFF_SYNTHETIC_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+
+namespace ncore
+{
+    namespace nsynthetic
+    {
+        // Receives the generated file in chunks, e.g. to memory or to a file
+        class writer_t
+        {
+        public:
+            virtual bool write(const u8* data, u64 size) = 0;
+        };
+
+        struct config_t
+        {
+            config_t()
+                : m_format(nply::FORMAT_BLE)
+                , m_vertex_count(100000)
+                , m_face_count(0)
+                , m_face_arity(3)
+                , m_position_type(nply::TYPE_FLOAT32)
+                , m_attribute_count(0)
+                , m_attribute_type(nply::TYPE_UINT8)
+                , m_index_type(nply::TYPE_INT32)
+                , m_count_type(nply::TYPE_UINT8)
+                , m_seed(1)
+            {
+            }
+            nply::eformat m_format;
+            u64           m_vertex_count;
+            u64           m_face_count;
+            s32           m_face_arity;      // vertices per face, 3 = triangles
+            nply::etype   m_position_type;   // of x, y and z
+            s32           m_attribute_count; // extra vertex properties 'a0', 'a1', ... (e.g. normals, colors)
+            nply::etype   m_attribute_type;
+            nply::etype   m_index_type; // of the 'vertex_indices' list
+            nply::etype   m_count_type;
+            u32           m_seed;
+        };
+
+        // Generate a ply file with 'vertex' and 'face' elements, the content only depends on the config.
+        // Positions are in [-100, 100], attributes in [0, 255] and faces index random vertices.
+        bool generate(config_t const& config, writer_t* writer);
+
+    } // namespace nsynthetic
+
+} // namespace ncore
+
+#endif // __C_3DFF_SYNTHETIC_H__
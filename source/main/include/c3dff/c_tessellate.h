@@ -0,0 +1,52 @@
+#ifndef __C_3DFF_TESSELLATE_H__
+#define __C_3DFF_TESSELLATE_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_mesh.h"
+#include "c3dff/c_parallel.h"
+
+namespace ncore
+{
+    namespace ntessellate
+    {
+        // An indexed mesh with SoA vertex data. Every attribute array (normals, colors, uvs, ...) has
+        // one value per vertex, attributes are interpolated linearly (normals need to be normalized again).
+        struct mesh_t
+        {
+            nmesh::positions_t m_positions;
+            f32**              m_attributes;
+            s32                m_attribute_count;
+            nply::triangle_t*  m_triangles;
+            u64                m_triangle_count;
+        };
+
+        struct config_t
+        {
+            config_t()
+                : m_max_edge_length(1.0f)
+                , m_max_rounds(24)
+            {
+            }
+            f32 m_max_edge_length;
+            s32 m_max_rounds; // every round halves the edges that are too long
+        };
+
+        // Split the edges that are longer than m_max_edge_length at their midpoint until no edge is (or
+        // m_max_rounds is reached). A midpoint is shared by all triangles of the edge so a watertight mesh
+        // stays watertight, a triangle becomes 1 to 4 triangles per round depending on how many of its
+        // edges are split. The output arrays (including the attribute pointer array) are allocated from
+        // 'allocator', the result does not depend on the number of threads.
+        bool split(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, mesh_t const& mesh, config_t const& config, mesh_t& result);
+
+        // Release the arrays of a result of split()
+        void release(nply::allocator_t* allocator, mesh_t& mesh);
+
+    } // namespace ntessellate
+
+} // namespace ncore
+
+#endif // __C_3DFF_TESSELLATE_H__
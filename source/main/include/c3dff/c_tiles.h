@@ -0,0 +1,96 @@
+#ifndef __C_3DFF_TILES_H__
+#define __C_3DFF_TILES_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_box.h"
+#include "c3dff/c_parallel.h"
+
+namespace ncore
+{
+    namespace ntiles
+    {
+        // A point cloud reorganised for spatial range reads. The points are sorted along a space
+        // filling curve and cut into tiles of a fixed number of points, every tile has its bounding
+        // box in the tile index at the front of the image. A reader loads the header and the index
+        // (see get_index_size), queries the tiles that intersect a box and then only reads (or maps)
+        // the byte ranges of those tiles.
+        // The image is both the in-memory and the on-disk format.
+        struct tiled_t
+        {
+            const u8* m_data;
+            u64       m_size; // bytes available, can be just the index
+        };
+
+        enum ecurve
+        {
+            CURVE_MORTON  = 0,
+            CURVE_HILBERT = 1, // tiles are more compact, slightly slower to encode
+        };
+
+        struct config_t
+        {
+            config_t()
+                : m_tile_size(4096)
+                , m_curve(CURVE_HILBERT)
+                , m_alignment(4096)
+            {
+            }
+            u32 m_tile_size; // points per tile, the last tile has the remainder
+            u32 m_curve;     // see ecurve
+            u32 m_alignment; // of the tile data in the image (power of 2, e.g. the page size to map tiles)
+        };
+
+        // An entry of the tile index. The points of a tile are records of f32 x, y, z followed
+        // by the attributes of the point, they are found at [m_offset, m_offset + m_size) in the image.
+        struct tile_t
+        {
+            n3d::box_t m_box;
+            u32        m_count;
+            u32        m_pad;
+            u64        m_first; // of the points of the tile in the sorted order
+            u64        m_offset;
+            u64        m_size;
+        };
+
+        enum
+        {
+            HEADER_SIZE = 128, // read at least this much to call get_index_size
+        };
+
+        // The order of the points along the curve over their bounding box ('order' receives the
+        // point indices), the keys are sorted by a parallel radix sort. Points with a NaN or Inf
+        // coordinate are left out of the bounds (and the boxes of the tiles), they are sorted as if
+        // they were on its border. Returns false when the points can not be indexed with 32 bits.
+        bool sort(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, nply::vertex_t const* points, u64 point_count, ecurve curve, u32* order);
+
+        // Sort and tile the points and build the image, 'attributes' holds 'attribute_count' values per point (can be nullptr)
+        bool build(nply::allocator_t* allocator, nparallel::scheduler_t* scheduler, nply::vertex_t const* points, f32 const* attributes, s32 attribute_count, u64 point_count, config_t const& config, tiled_t& tiled);
+
+        // The number of bytes of the header and the tile index, 0 when this is not a tiled image
+        u64 get_index_size(const u8* data, u64 size);
+
+        // Open an image (e.g. a memory-mapped file) of which at least the index is available, no data is copied
+        bool open(const u8* data, u64 size, tiled_t& tiled);
+
+        u64           get_point_count(tiled_t const& tiled);
+        u32           get_tile_count(tiled_t const& tiled);
+        s32           get_attribute_count(tiled_t const& tiled);
+        u32           get_stride(tiled_t const& tiled); // bytes per point record
+        n3d::box_t    get_bounds(tiled_t const& tiled);
+        tile_t const& get_tile(tiled_t const& tiled, u32 index);
+
+        // The tiles whose box overlaps 'box', writes up to 'max_tiles' tile indices and returns the number of overlapping tiles
+        u32 query(tiled_t const& tiled, n3d::box_t const& box, u32* tiles, u32 max_tiles);
+
+        // The point records of a tile, nullptr when the tile is not inside of the opened bytes
+        f32 const* get_points(tiled_t const& tiled, u32 index);
+
+    } // namespace ntiles
+
+} // namespace ncore
+
+#endif // __C_3DFF_TILES_H__
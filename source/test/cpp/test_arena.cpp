@@ -0,0 +1,138 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_arena.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(arena)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        UNITTEST_FIXTURE_SETUP() {}
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        UNITTEST_TEST(alloc_and_grow)
+        {
+            nply::arena_t arena;
+            arena.init(Allocator, 4096);
+
+            u8* a = (u8*)arena.alloc(1000);
+            u8* b = (u8*)arena.alloc(1000, 64);
+            CHECK_NOT_NULL(a);
+            CHECK_NOT_NULL(b);
+            CHECK_EQUAL(0, (s32)((uint_t)b & 63));
+            CHECK_TRUE(b >= a + 1000);
+
+            // does not fit in the first chunk, a second one is added
+            u64 const reserved = arena.get_reserved();
+            u8*       c        = (u8*)arena.alloc(3000);
+            CHECK_NOT_NULL(c);
+            CHECK_TRUE(arena.get_reserved() > reserved);
+
+            // an allocation larger than the chunk size gets its own chunk
+            u8* d = (u8*)arena.alloc(64 * 1024);
+            CHECK_NOT_NULL(d);
+            for (s32 i = 0; i < 64 * 1024; ++i)
+                d[i] = (u8)i;
+            CHECK_TRUE(arena.get_used() >= 1000 + 1000 + 3000 + 64 * 1024);
+
+            arena.exit();
+            CHECK_EQUAL(0, arena.get_reserved());
+        }
+
+        UNITTEST_TEST(reset_reuses_chunks)
+        {
+            nply::arena_t arena;
+            arena.init(Allocator, 4096);
+
+            for (s32 i = 0; i < 16; ++i)
+                arena.alloc(1024);
+            u64 const reserved = arena.get_reserved();
+
+            arena.reset();
+            CHECK_EQUAL(0, arena.get_used());
+            for (s32 i = 0; i < 16; ++i)
+                arena.alloc(1024);
+            CHECK_EQUAL(reserved, arena.get_reserved());
+
+            arena.reset();
+            arena.trim();
+            CHECK_TRUE(arena.get_reserved() < reserved);
+
+            arena.exit();
+        }
+
+        UNITTEST_TEST(mark_and_rewind)
+        {
+            nply::arena_t arena;
+            arena.init(Allocator, 4096);
+
+            arena.alloc(100);
+            nply::arena_t::marker_t const marker = arena.mark();
+            u64 const                     used   = arena.get_used();
+            u8*                           first  = (u8*)arena.alloc(100);
+            for (s32 i = 0; i < 10; ++i)
+                arena.alloc(1000);
+            CHECK_TRUE(arena.get_used() > used);
+
+            arena.rewind(marker);
+            CHECK_EQUAL(used, arena.get_used());
+            CHECK_EQUAL(first, (u8*)arena.alloc(100));
+
+            arena.exit();
+        }
+
+        UNITTEST_TEST(pool)
+        {
+            nply::arena_t arena;
+            arena.init(Allocator, 4096);
+
+            nply::pool_t pool;
+            pool.init(&arena, 24, 8, 4);
+            CHECK_EQUAL(24, pool.get_item_size());
+
+            void* items[10];
+            for (s32 i = 0; i < 10; ++i)
+            {
+                items[i] = pool.alloc(24, 8);
+                CHECK_NOT_NULL(items[i]);
+            }
+            CHECK_EQUAL(10, pool.get_count());
+
+            pool.dealloc(items[3]);
+            pool.dealloc(items[7]);
+            CHECK_EQUAL(8, pool.get_count());
+            CHECK_EQUAL(items[7], pool.alloc(24, 8));
+            CHECK_EQUAL(items[3], pool.alloc(24, 8));
+            CHECK_EQUAL(10, pool.get_count());
+
+            arena.exit();
+        }
+
+        UNITTEST_TEST(scratch)
+        {
+            nply::scratch_t scratch;
+            scratch.init(Allocator, 4, 4096);
+            CHECK_EQUAL(4, scratch.get_count());
+            CHECK_TRUE(scratch.get(0) != scratch.get(1));
+            CHECK_TRUE(scratch.get(3) != scratch.get(0));
+
+            for (s32 i = 0; i < 4; ++i)
+                scratch.get(i)->alloc(512);
+            for (s32 i = 0; i < 4; ++i)
+                CHECK_TRUE(scratch.get(i)->get_used() >= 512);
+
+            scratch.reset();
+            for (s32 i = 0; i < 4; ++i)
+                CHECK_EQUAL(0, scratch.get(i)->get_used());
+
+            scratch.exit();
+        }
+    }
+}
+UNITTEST_SUITE_END
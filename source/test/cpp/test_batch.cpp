@@ -0,0 +1,226 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_batch.h"
+#include "c3dff/c_synthetic.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+// Files in memory, the path is "<index>"
+class batch_source : public nbatch::source_t
+{
+public:
+    enum
+    {
+        MAX_FILES = 16
+    };
+    const u8* m_data[MAX_FILES];
+    u64       m_size[MAX_FILES];
+    s32       m_count;
+    s32       m_reads;
+
+    virtual u64 size(const char* path)
+    {
+        s32 const i = index(path);
+        return i < m_count ? m_size[i] : 0;
+    }
+
+    virtual u64 read_at(const char* path, u64 offset, u8* buffer, u64 size)
+    {
+        s32 const i = index(path);
+        if (i >= m_count || offset >= m_size[i])
+            return 0;
+        m_reads++;
+        u64 const n = (m_size[i] - offset) < size ? (m_size[i] - offset) : size;
+        for (u64 b = 0; b < n; ++b)
+            buffer[b] = m_data[i][offset + b];
+        return n;
+    }
+
+    static s32 index(const char* path)
+    {
+        s32 i = 0;
+        while (*path != 0)
+            i = i * 10 + (*path++ - '0');
+        return i;
+    }
+};
+
+// Checks every result against decoding the file directly
+class batch_callback : public nbatch::callback_t
+{
+public:
+    batch_source*      m_source;
+    nply::allocator_t* m_allocator;
+    s32                m_calls;
+    s32                m_mismatches;
+    bool               m_ok[batch_source::MAX_FILES];
+    nply::eerror       m_error[batch_source::MAX_FILES];
+
+    virtual void loaded(nbatch::result_t const& result)
+    {
+        m_calls++;
+        m_ok[result.m_index]    = result.m_ok;
+        m_error[result.m_index] = result.m_error.m_kind;
+        if (!result.m_ok)
+            return;
+
+        u64 const             i   = result.m_index;
+        nply::ply_t*          ply = nply::create(m_allocator);
+        nply::memory_reader_t reader(m_source->m_data[i], m_source->m_size[i]);
+        nply::read_header(ply, &reader);
+        const char* xyz[3] = {"x", "y", "z"};
+        nply::select_properties(ply, "vertex", xyz, 3);
+        u64 const                 vertex_count   = nply::get_element_count(ply, "vertex");
+        u64 const                 triangle_count = nply::get_element_count(ply, "face");
+        nply::vertex_t*           vertices       = (nply::vertex_t*)m_allocator->alloc(sizeof(nply::vertex_t) * (vertex_count + 1));
+        nply::triangle_t*         triangles      = (nply::triangle_t*)m_allocator->alloc(sizeof(nply::triangle_t) * (triangle_count + 1));
+        nply::vertices_handler_t  vertices_handler(vertices, vertex_count);
+        nply::triangles_handler_t triangles_handler(triangles, triangle_count);
+        nply::read_data(ply, &reader, &vertices_handler, &triangles_handler);
+
+        if (vertex_count != result.m_vertex_count || triangle_count != result.m_triangle_count)
+        {
+            m_mismatches++;
+            return;
+        }
+        for (u64 v = 0; v < vertex_count; ++v)
+        {
+            if (vertices[v].x != result.m_vertices[v].x || vertices[v].y != result.m_vertices[v].y || vertices[v].z != result.m_vertices[v].z)
+            {
+                m_mismatches++;
+                return;
+            }
+        }
+        for (u64 t = 0; t < triangle_count; ++t)
+        {
+            if (triangles[t].v1 != result.m_triangles[t].v1 || triangles[t].v2 != result.m_triangles[t].v2 || triangles[t].v3 != result.m_triangles[t].v3)
+            {
+                m_mismatches++;
+                return;
+            }
+        }
+    }
+};
+
+UNITTEST_SUITE_BEGIN(batch)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_batch_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_batch_allocator;
+            sAllocator->init(Allocator, 32 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        static void add_file(batch_source& source, nsynthetic::config_t const& config)
+        {
+            u64 const    size = 2 * 1024 * 1024;
+            u8*          data = (u8*)sAllocator->alloc(size);
+            test_writer  writer(data, size);
+            CHECK_TRUE(nsynthetic::generate(config, &writer));
+            source.m_data[source.m_count] = data;
+            source.m_size[source.m_count] = writer.m_used;
+            source.m_count++;
+        }
+
+        static void add_text(batch_source& source, const char* text)
+        {
+            u64 len = 0;
+            while (text[len] != 0)
+                len++;
+            source.m_data[source.m_count] = (const u8*)text;
+            source.m_size[source.m_count] = len;
+            source.m_count++;
+        }
+
+        UNITTEST_TEST(atomic_add)
+        {
+            u64 volatile counter = 5;
+            CHECK_EQUAL(5, nparallel::atomic_add(&counter, 3));
+            CHECK_EQUAL(8, nparallel::atomic_add(&counter, (u64)-1));
+            CHECK_EQUAL(7, counter);
+        }
+
+        UNITTEST_TEST(load_files)
+        {
+            sAllocator->reset();
+
+            batch_source source;
+            source.m_count = 0;
+            source.m_reads = 0;
+
+            // 0..2: large binary files that are split, 3..5: small files in all formats
+            nsynthetic::config_t config;
+            config.m_vertex_count = 20000;
+            config.m_face_count   = 10000;
+            for (s32 i = 0; i < 3; ++i)
+            {
+                config.m_format = i == 1 ? nply::FORMAT_BBE : nply::FORMAT_BLE;
+                config.m_seed   = 100 + i;
+                add_file(source, config);
+            }
+            config.m_attribute_count = 2;
+            config.m_vertex_count    = 500;
+            config.m_face_count      = 300;
+            for (s32 i = 0; i < 3; ++i)
+            {
+                config.m_format = (nply::eformat)i;
+                config.m_seed   = 200 + i;
+                add_file(source, config);
+            }
+
+            // 6: not a ply file, 7: ends in the middle of the vertices, 8: no faces
+            add_text(source, "solid cube\n");
+            add_text(source, "ply\nformat ascii 1.0\nelement vertex 3\nproperty float x\nproperty float y\nproperty float z\nend_header\n1 2 3\n");
+            add_text(source, "ply\nformat ascii 1.0\nelement vertex 2\nproperty float z\nproperty float y\nproperty float x\nend_header\n1 2 3\n4 5 6\n");
+
+            const char* paths[] = {"0", "1", "2", "3", "4", "5", "6", "7", "8"};
+            s32 const   count   = 9;
+
+            nply::arena_t arena;
+            arena.init(Allocator, 1024 * 1024);
+            nply::scratch_t scratch;
+            scratch.init(Allocator, 4, 1024 * 1024);
+            test_scheduler scheduler;
+
+            batch_callback callback;
+            callback.m_source     = &source;
+            callback.m_allocator  = sAllocator;
+            callback.m_calls      = 0;
+            callback.m_mismatches = 0;
+
+            // a budget that only fits one large file per wave, parts of 64 KB
+            nbatch::config_t batch_config;
+            batch_config.m_split_size    = 64 * 1024;
+            batch_config.m_memory_budget = 4 * (batch_config.m_split_size + 1024 * 1024) + 600 * 1024;
+
+            CHECK_EQUAL(7, nbatch::load(&arena, &scheduler, &scratch, &source, paths, count, batch_config, &callback));
+            CHECK_EQUAL(count, callback.m_calls);
+            CHECK_EQUAL(0, callback.m_mismatches);
+            for (s32 i = 0; i < 6; ++i)
+                CHECK_TRUE(callback.m_ok[i]);
+            CHECK_FALSE(callback.m_ok[6]);
+            CHECK_EQUAL(nply::ERROR_NOT_PLY, callback.m_error[6]);
+            CHECK_FALSE(callback.m_ok[7]);
+            CHECK_EQUAL(nply::ERROR_TRUNCATED, callback.m_error[7]);
+            CHECK_TRUE(callback.m_ok[8]);
+
+            // everything is released again
+            CHECK_EQUAL(0, arena.get_used());
+
+            scratch.exit();
+            arena.exit();
+        }
+    }
+}
+UNITTEST_SUITE_END
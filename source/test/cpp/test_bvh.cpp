@@ -0,0 +1,259 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_bvh.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(bvh)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_bvh_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        static const u32         c_grid      = 32;
+        static nply::vertex_t*   sVertices   = nullptr;
+        static nply::triangle_t* sTriangles  = nullptr;
+        static u32               sTriCount   = 0;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_bvh_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        // A (c_grid x c_grid) quad grid in the XY plane at z = 0, spanning [0, c_grid]
+        static void make_grid()
+        {
+            sVertices  = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * (c_grid + 1) * (c_grid + 1));
+            sTriangles = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * c_grid * c_grid * 2);
+            for (u32 y = 0; y <= c_grid; ++y)
+            {
+                for (u32 x = 0; x <= c_grid; ++x)
+                {
+                    nply::vertex_t& v = sVertices[y * (c_grid + 1) + x];
+                    v.x               = (f32)x;
+                    v.y               = (f32)y;
+                    v.z               = 0.0f;
+                }
+            }
+            sTriCount = 0;
+            for (u32 y = 0; y < c_grid; ++y)
+            {
+                for (u32 x = 0; x < c_grid; ++x)
+                {
+                    u32 const i0 = y * (c_grid + 1) + x;
+                    u32 const i1 = i0 + 1;
+                    u32 const i2 = i0 + (c_grid + 1);
+                    u32 const i3 = i2 + 1;
+                    nply::triangle_t& t0 = sTriangles[sTriCount++];
+                    t0.v1                = i0;
+                    t0.v2                = i1;
+                    t0.v3                = i3;
+                    nply::triangle_t& t1 = sTriangles[sTriCount++];
+                    t1.v1                = i0;
+                    t1.v2                = i3;
+                    t1.v3                = i2;
+                }
+            }
+        }
+
+        static void test_queries(nbvh::bvh_t const* bvh)
+        {
+            n3d::box_t const bounds = nbvh::get_bounds(bvh);
+            CHECK_EQUAL(0.0f, bounds.m_min[0]);
+            CHECK_EQUAL((f32)c_grid, bounds.m_max[1]);
+
+            nbvh::ray_t ray;
+            ray.m_origin.x    = 10.25f;
+            ray.m_origin.y    = 20.75f;
+            ray.m_origin.z    = 5.0f;
+            ray.m_direction.x = 0.0f;
+            ray.m_direction.y = 0.0f;
+            ray.m_direction.z = -1.0f;
+            ray.m_tmin        = 0.0f;
+            ray.m_tmax        = 100.0f;
+            nbvh::hit_t hit;
+            CHECK_TRUE(nbvh::raycast(bvh, ray, hit));
+            CHECK_CLOSE(5.0f, hit.m_t, 0.0001f);
+            // quad (10, 20), upper-left triangle
+            CHECK_EQUAL((20 * c_grid + 10) * 2 + 1, hit.m_triangle);
+
+            ray.m_tmax = 4.0f;
+            CHECK_FALSE(nbvh::raycast(bvh, ray, hit));
+
+            nply::vertex_t p;
+            p.x = -3.0f;
+            p.y = 4.5f;
+            p.z = 4.0f;
+            nbvh::closest_t closest;
+            CHECK_TRUE(nbvh::closest_point(bvh, p, 10.0f, closest));
+            CHECK_CLOSE(0.0f, closest.m_point.x, 0.0001f);
+            CHECK_CLOSE(4.5f, closest.m_point.y, 0.0001f);
+            CHECK_CLOSE(25.0f, closest.m_distance_sq, 0.001f);
+            CHECK_FALSE(nbvh::closest_point(bvh, p, 4.0f, closest));
+
+            n3d::box_t box;
+            box.m_min[0] = 1.5f;
+            box.m_min[1] = 1.5f;
+            box.m_min[2] = -1.0f;
+            box.m_max[0] = 2.5f;
+            box.m_max[1] = 2.5f;
+            box.m_max[2] = 1.0f;
+            u32       triangles[32];
+            u32 const count = nbvh::overlap(bvh, box, triangles, 32);
+            CHECK_EQUAL(8, count); // 4 quads
+        }
+
+        UNITTEST_TEST(build_serial)
+        {
+            sAllocator->reset();
+            make_grid();
+            nbvh::bvh_t* bvh = nbvh::build(sAllocator, nullptr, sVertices, (c_grid + 1) * (c_grid + 1), sTriangles, sTriCount);
+            CHECK_TRUE(nbvh::get_node_count(bvh) > 0);
+            test_queries(bvh);
+        }
+
+        UNITTEST_TEST(build_parallel)
+        {
+            sAllocator->reset();
+            make_grid();
+            test_scheduler scheduler;
+            nbvh::bvh_t*   bvh = nbvh::build(sAllocator, &scheduler, sVertices, (c_grid + 1) * (c_grid + 1), sTriangles, sTriCount);
+            test_queries(bvh);
+        }
+
+        static bool cast_down(nbvh::bvh_t const* bvh, f32 x, f32 y, nbvh::hit_t& hit)
+        {
+            nbvh::ray_t ray;
+            ray.m_origin.x    = x;
+            ray.m_origin.y    = y;
+            ray.m_origin.z    = 1.0f;
+            ray.m_direction.x = 0.0f;
+            ray.m_direction.y = 0.0f;
+            ray.m_direction.z = -1.0f;
+            ray.m_tmin        = 0.0f;
+            ray.m_tmax        = 2.0f;
+            return nbvh::raycast(bvh, ray, hit);
+        }
+
+        UNITTEST_TEST(skewed_and_non_finite)
+        {
+            sAllocator->reset();
+
+            // geometrically spaced triangles make every SAH split cut off only the last few, the depth
+            // limit turns the rest into a large leaf instead of a deep chain
+            u32 const         count     = 100;
+            nply::vertex_t*   vertices  = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * (count * 3 + 3));
+            nply::triangle_t* triangles = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * (count + 1));
+            f32               x         = 1.0f;
+            for (u32 i = 0; i < count; ++i, x *= 1.5f)
+            {
+                nply::vertex_t* v = vertices + i * 3;
+                v[0].x = x, v[0].y = 0.0f, v[0].z = 0.0f;
+                v[1].x = x * 1.1f, v[1].y = 0.0f, v[1].z = 0.0f;
+                v[2].x = x, v[2].y = 1.0f, v[2].z = 0.0f;
+                triangles[i].v1 = i * 3;
+                triangles[i].v2 = i * 3 + 1;
+                triangles[i].v3 = i * 3 + 2;
+            }
+
+            test_scheduler scheduler;
+            for (s32 pass = 0; pass < 2; ++pass)
+            {
+                nbvh::config_t config;
+                config.m_max_leaf_size = 1;
+                nbvh::bvh_t* bvh       = nbvh::build(sAllocator, pass == 0 ? nullptr : &scheduler, vertices, count * 3, triangles, count, config);
+                f32          tx        = 1.0f;
+                u32          wrong     = 0;
+                for (u32 i = 0; i < count; ++i, tx *= 1.5f)
+                {
+                    nbvh::hit_t hit;
+                    if (!cast_down(bvh, tx * 1.02f, 0.1f, hit) || hit.m_triangle != i)
+                        wrong++;
+                }
+                CHECK_EQUAL(0, wrong);
+            }
+
+            // a triangle with a NaN and one with an Inf vertex next to the grid
+            make_grid();
+            u32 const         grid_vertices = (c_grid + 1) * (c_grid + 1);
+            nply::vertex_t*   mixed         = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * (grid_vertices + 2));
+            nply::triangle_t* mixed_tris    = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * (sTriCount + 2));
+            for (u32 i = 0; i < grid_vertices; ++i)
+                mixed[i] = sVertices[i];
+            for (u32 i = 0; i < sTriCount; ++i)
+                mixed_tris[i] = sTriangles[i];
+            f32 const inf                  = 1e30f * 1e30f;
+            mixed[grid_vertices].x         = inf - inf;
+            mixed[grid_vertices].y         = 0.0f;
+            mixed[grid_vertices].z         = 0.0f;
+            mixed[grid_vertices + 1].x     = inf;
+            mixed[grid_vertices + 1].y     = 0.0f;
+            mixed[grid_vertices + 1].z     = 0.0f;
+            nply::triangle_t const nan_tri = {0, 1, grid_vertices};
+            nply::triangle_t const inf_tri = {0, 1, grid_vertices + 1};
+            mixed_tris[sTriCount]          = nan_tri;
+            mixed_tris[sTriCount + 1]      = inf_tri;
+
+            for (s32 pass = 0; pass < 2; ++pass)
+            {
+                nbvh::bvh_t* bvh = nbvh::build(sAllocator, pass == 0 ? nullptr : &scheduler, mixed, grid_vertices + 2, mixed_tris, sTriCount + 2);
+                nbvh::hit_t  hit;
+                CHECK_TRUE(cast_down(bvh, 5.25f, 7.5f, hit));
+                CHECK_TRUE(hit.m_triangle < sTriCount);
+                CHECK_CLOSE(1.0f, hit.m_t, 0.0001f);
+            }
+        }
+
+        UNITTEST_TEST(release_and_out_of_memory)
+        {
+            sAllocator->reset();
+            make_grid();
+            test_scheduler scheduler;
+
+            // only the tree is left after the build, release gives it back
+            for (s32 pass = 0; pass < 2; ++pass)
+            {
+                counting_allocator allocator(sAllocator, 1000);
+                nbvh::bvh_t*       bvh = nbvh::build(&allocator, pass == 0 ? nullptr : &scheduler, sVertices, (c_grid + 1) * (c_grid + 1), sTriangles, sTriCount);
+                CHECK_TRUE(bvh != nullptr);
+                CHECK_EQUAL(3, allocator.m_live);
+                test_queries(bvh);
+                nbvh::release(&allocator, bvh);
+                CHECK_EQUAL(0, allocator.m_live);
+            }
+
+            // every allocation failing in turn
+            for (s64 limit = 0; limit < 8; ++limit)
+            {
+                counting_allocator allocator(sAllocator, limit);
+                nbvh::bvh_t*       bvh = nbvh::build(&allocator, &scheduler, sVertices, (c_grid + 1) * (c_grid + 1), sTriangles, sTriCount);
+                CHECK_TRUE(bvh == nullptr);
+                CHECK_EQUAL(0, allocator.m_live);
+            }
+        }
+
+        UNITTEST_TEST(build_empty)
+        {
+            sAllocator->reset();
+            nbvh::bvh_t* bvh = nbvh::build(sAllocator, nullptr, nullptr, 0, nullptr, 0);
+            nbvh::ray_t  ray;
+            ray.m_origin.x = ray.m_origin.y = ray.m_origin.z = 0.0f;
+            ray.m_direction.x = ray.m_direction.y = 0.0f;
+            ray.m_direction.z = 1.0f;
+            ray.m_tmin        = 0.0f;
+            ray.m_tmax        = 1.0f;
+            nbvh::hit_t hit;
+            CHECK_FALSE(nbvh::raycast(bvh, ray, hit));
+        }
+    }
+}
+UNITTEST_SUITE_END
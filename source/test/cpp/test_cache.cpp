@@ -0,0 +1,277 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_cache.h"
+#include "c3dff/c_synthetic.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+// Counts the allocations that are alive
+class cache_allocator : public nply::allocator_t
+{
+public:
+    nply::allocator_t* m_backing;
+    s64                m_live;
+
+protected:
+    virtual void* v_alloc(u64 size, u32 alignment)
+    {
+        m_live++;
+        return m_backing->alloc(size, alignment);
+    }
+    virtual void v_dealloc(void* ptr)
+    {
+        if (ptr != nullptr)
+            m_live--;
+    }
+};
+
+// Decodes the same ply file for every key, key.m_id is stored in mesh.m_user. Fails for id 13.
+class cache_loader : public ncache::loader_t
+{
+public:
+    const u8*         m_file;
+    u64               m_file_size;
+    u64               m_loads;
+    u64               m_waits;
+    bool              m_patient;
+    ncache::cache_t*  m_cache;  // for a nested request from inside of load
+    ncache::loader_t* m_nested; // loader of the nested request
+    ncache::key_t     m_nested_key;
+    bool              m_nested_ok;
+
+    virtual bool load(ncache::key_t const& key, nply::allocator_t* allocator, ncache::mesh_t& mesh)
+    {
+        m_loads++;
+        if (m_nested != nullptr)
+        {
+            ncache::mesh_t const* nested = m_cache->acquire(m_nested_key, m_nested);
+            m_nested_ok                  = nested != nullptr;
+            m_cache->release(nested);
+        }
+        if (key.m_id == 13)
+        {
+            allocator->alloc(100); // released with the failed entry
+            return false;
+        }
+
+        nply::memory_reader_t reader(m_file, m_file_size);
+        nply::ply_t*          ply = nply::create(allocator);
+        if (!nply::read_header(ply, &reader))
+            return false;
+        u64 const         vertex_count   = nply::get_element_count(ply, "vertex");
+        u64 const         triangle_count = nply::get_element_count(ply, "face");
+        nply::vertex_t*   vertices       = (nply::vertex_t*)allocator->alloc(sizeof(nply::vertex_t) * vertex_count);
+        nply::triangle_t* triangles      = (nply::triangle_t*)allocator->alloc(sizeof(nply::triangle_t) * triangle_count);
+        nply::vertices_handler_t  vh(vertices, vertex_count);
+        nply::triangles_handler_t th(triangles, triangle_count);
+        if (!nply::read_data(ply, &reader, &vh, &th))
+            return false;
+
+        u64* id               = (u64*)allocator->alloc(sizeof(u64));
+        *id                   = key.m_id;
+        mesh.m_vertices       = vertices;
+        mesh.m_vertex_count   = vh.m_vertex_count;
+        mesh.m_triangles      = triangles;
+        mesh.m_triangle_count = th.m_triangle_count;
+        mesh.m_user           = id;
+        return true;
+    }
+
+    virtual bool wait()
+    {
+        m_waits++;
+        return m_patient;
+    }
+};
+
+UNITTEST_SUITE_BEGIN(cache)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_cache_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_cache_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        static void make_loader(cache_loader& loader)
+        {
+            nsynthetic::config_t config;
+            config.m_format       = nply::FORMAT_BLE;
+            config.m_vertex_count = 500;
+            config.m_face_count   = 300;
+            config.m_seed         = 9;
+            u8*         buffer    = (u8*)sAllocator->alloc(64 * 1024);
+            test_writer writer(buffer, 64 * 1024);
+            nsynthetic::generate(config, &writer);
+
+            loader.m_file       = buffer;
+            loader.m_file_size  = writer.m_used;
+            loader.m_loads      = 0;
+            loader.m_waits      = 0;
+            loader.m_patient    = false;
+            loader.m_cache      = nullptr;
+            loader.m_nested     = nullptr;
+            loader.m_nested_key = ncache::key_t();
+            loader.m_nested_ok  = false;
+        }
+
+        static ncache::key_t key(u64 id, u64 stamp)
+        {
+            ncache::key_t k;
+            k.m_id    = id;
+            k.m_stamp = stamp;
+            return k;
+        }
+
+        static u64 id_of(ncache::mesh_t const* mesh) { return *(u64 const*)mesh->m_user; }
+
+        UNITTEST_TEST(hits_and_stamps)
+        {
+            sAllocator->reset();
+            cache_loader loader;
+            make_loader(loader);
+            cache_allocator allocator;
+            allocator.m_backing = sAllocator;
+            allocator.m_live    = 0;
+
+            ncache::cache_t cache;
+            cache.init(&allocator, 1024 * 1024, 4);
+
+            ncache::mesh_t const* a = cache.acquire(key(1, 100), &loader);
+            ncache::mesh_t const* b = cache.acquire(key(1, 100), &loader);
+            CHECK_TRUE(a != nullptr);
+            CHECK_TRUE(a == b);
+            CHECK_EQUAL(500, a->m_vertex_count);
+            CHECK_EQUAL(300, a->m_triangle_count);
+            CHECK_TRUE(a->m_size > sizeof(nply::vertex_t) * 500);
+            CHECK_EQUAL(1, loader.m_loads);
+
+            ncache::stats_t stats = cache.get_stats();
+            CHECK_EQUAL(1, stats.m_hits);
+            CHECK_EQUAL(1, stats.m_count);
+            CHECK_EQUAL(a->m_size, stats.m_size);
+
+            // a new stamp replaces the mesh, the old one stays valid until it is released
+            s64 const             live = allocator.m_live;
+            ncache::mesh_t const* c    = cache.acquire(key(1, 101), &loader);
+            CHECK_TRUE(c != nullptr && c != a);
+            CHECK_EQUAL(2, loader.m_loads);
+            CHECK_EQUAL(2, cache.get_stats().m_count);
+            CHECK_EQUAL(1, id_of(a));
+            cache.release(a);
+            cache.release(b);
+            CHECK_EQUAL(1, cache.get_stats().m_count);
+            CHECK_TRUE(allocator.m_live < live + 1);
+
+            ncache::mesh_t const* d = cache.acquire(key(1, 101), &loader);
+            CHECK_TRUE(d == c);
+            CHECK_EQUAL(2, loader.m_loads);
+            cache.release(c);
+            cache.release(d);
+
+            // failures are not cached
+            CHECK_TRUE(cache.acquire(key(13, 1), &loader) == nullptr);
+            CHECK_TRUE(cache.acquire(key(13, 1), &loader) == nullptr);
+            CHECK_EQUAL(4, loader.m_loads);
+            CHECK_EQUAL(2, cache.get_stats().m_failed);
+
+            cache.exit();
+            CHECK_EQUAL(0, allocator.m_live);
+        }
+
+        UNITTEST_TEST(lru_budget)
+        {
+            sAllocator->reset();
+            cache_loader loader;
+            make_loader(loader);
+            cache_allocator allocator;
+            allocator.m_backing = sAllocator;
+            allocator.m_live    = 0;
+
+            ncache::cache_t cache;
+            cache.init(&allocator, 1024 * 1024);
+
+            ncache::mesh_t const* m    = cache.acquire(key(1, 1), &loader);
+            u64 const             size = m->m_size;
+            cache.release(m);
+            cache.set_budget(size * 2 + size / 2); // two meshes fit
+
+            cache.release(cache.acquire(key(2, 1), &loader));
+            cache.release(cache.acquire(key(1, 1), &loader)); // 2 is now the least recently used
+            CHECK_EQUAL(2, loader.m_loads);
+            cache.release(cache.acquire(key(3, 1), &loader));
+            CHECK_EQUAL(3, loader.m_loads);
+            CHECK_EQUAL(1, cache.get_stats().m_evictions);
+
+            cache.release(cache.acquire(key(1, 1), &loader));
+            cache.release(cache.acquire(key(3, 1), &loader));
+            CHECK_EQUAL(3, loader.m_loads);
+            cache.release(cache.acquire(key(2, 1), &loader));
+            CHECK_EQUAL(4, loader.m_loads);
+
+            // meshes in use are not evicted, the cache goes over the budget until they are released
+            ncache::mesh_t const* held[3];
+            for (u64 i = 0; i < 3; ++i)
+                held[i] = cache.acquire(key(10 + i, 1), &loader);
+            CHECK_EQUAL(3, cache.get_stats().m_count);
+            for (u64 i = 0; i < 3; ++i)
+                CHECK_EQUAL(10 + i, id_of(held[i]));
+            for (u64 i = 0; i < 3; ++i)
+                cache.release(held[i]);
+            CHECK_EQUAL(2, cache.get_stats().m_count);
+            CHECK_TRUE(cache.get_stats().m_size <= size * 2 + size / 2);
+
+            cache.set_budget(0);
+            CHECK_EQUAL(0, cache.get_stats().m_count);
+            cache.exit();
+            CHECK_EQUAL(0, allocator.m_live);
+        }
+
+        UNITTEST_TEST(single_flight)
+        {
+            sAllocator->reset();
+            cache_loader loader;
+            make_loader(loader);
+            cache_loader waiter;
+            make_loader(waiter);
+            cache_allocator allocator;
+            allocator.m_backing = sAllocator;
+            allocator.m_live    = 0;
+
+            ncache::cache_t cache;
+            cache.init(&allocator, 1024 * 1024);
+
+            // a request for a file that is being loaded waits instead of loading it a second time
+            loader.m_cache      = &cache;
+            loader.m_nested     = &waiter;
+            loader.m_nested_key = key(5, 1);
+            cache.release(cache.acquire(key(5, 1), &loader));
+            CHECK_FALSE(loader.m_nested_ok);
+            CHECK_EQUAL(1, waiter.m_waits);
+            CHECK_EQUAL(0, waiter.m_loads);
+            CHECK_EQUAL(1, loader.m_loads);
+
+            // other files are loaded while one is
+            loader.m_nested_key = key(6, 1);
+            cache.release(cache.acquire(key(7, 1), &loader));
+            CHECK_TRUE(loader.m_nested_ok);
+            CHECK_EQUAL(1, waiter.m_loads);
+            CHECK_EQUAL(3, cache.get_stats().m_count);
+
+            cache.exit();
+            CHECK_EQUAL(0, allocator.m_live);
+        }
+    }
+}
+UNITTEST_SUITE_END
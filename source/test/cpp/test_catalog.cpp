@@ -0,0 +1,231 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_catalog.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+// A 'file system' of strings, file i is at path "dir/i.ply"
+class source_test : public ncatalog::source_t
+{
+public:
+    const char** m_paths;
+    const char** m_files;
+    u64*         m_stamps;
+    s32          m_count;
+    s32          m_reads;
+
+    static u64 length(const char* str)
+    {
+        u64 len = 0;
+        while (str[len] != 0)
+            len++;
+        return len;
+    }
+
+    static bool equal(const char* a, const char* b)
+    {
+        while (*a != 0 && *a == *b)
+        {
+            a++;
+            b++;
+        }
+        return *a == *b;
+    }
+
+    s32 find(const char* path)
+    {
+        for (s32 i = 0; i < m_count; ++i)
+            if (equal(m_paths[i], path))
+                return i;
+        return -1;
+    }
+
+    virtual u64 read(const char* path, u8* buffer, u64 size)
+    {
+        s32 const i = find(path);
+        if (i < 0)
+            return 0;
+        m_reads++;
+        u64 const len = length(m_files[i]);
+        u64 const n   = len < size ? len : size;
+        for (u64 b = 0; b < n; ++b)
+            buffer[b] = (u8)m_files[i][b];
+        return n;
+    }
+
+    virtual u64 stamp(const char* path)
+    {
+        s32 const i = find(path);
+        return i < 0 ? 0 : m_stamps[i];
+    }
+};
+
+UNITTEST_SUITE_BEGIN(catalog)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_catalog_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_catalog_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        static char* copy_text(char* dst, const char* src)
+        {
+            s32 i = 0;
+            for (; src[i] != 0; ++i)
+                dst[i] = src[i];
+            dst[i] = 0;
+            return dst;
+        }
+
+        UNITTEST_TEST(index_files)
+        {
+            sAllocator->reset();
+
+            s32 const count = 200;
+            char*     names = (char*)sAllocator->alloc(count * 16);
+            char*     texts = (char*)sAllocator->alloc(count * 128);
+
+            const char** paths  = (const char**)sAllocator->alloc(sizeof(const char*) * count);
+            const char** files  = (const char**)sAllocator->alloc(sizeof(const char*) * count);
+            u64*         stamps = (u64*)sAllocator->alloc(sizeof(u64) * count);
+            for (s32 i = 0; i < count; ++i)
+            {
+                // "dir/NNN.ply", in reverse order so that the catalog has to sort them
+                s32 const n    = count - 1 - i;
+                char*     name = copy_text(names + i * 16, "dir/000.ply");
+                name[4]        = (char)('0' + n / 100);
+                name[5]        = (char)('0' + (n / 10) % 10);
+                name[6]        = (char)('0' + n % 10);
+                paths[i]       = name;
+                stamps[i]      = 1000 + i;
+
+                // every 10th file is not a ply file, the others have 1 to 9 vertices
+                if ((n % 10) == 9)
+                {
+                    files[i] = copy_text(texts + i * 128, "solid cube\n");
+                }
+                else
+                {
+                    char* text = copy_text(texts + i * 128, "ply\nformat ascii 1.0\nelement vertex 1\nproperty float x\nend_header\n0.5\n");
+                    text[36]   = (char)('1' + (n % 9));
+                    files[i]   = text;
+                }
+            }
+
+            source_test source;
+            source.m_paths  = paths;
+            source.m_files  = files;
+            source.m_stamps = stamps;
+            source.m_count  = count;
+            source.m_reads  = 0;
+
+            nply::scratch_t scratch;
+            scratch.init(Allocator, 8, 64 * 1024);
+            test_scheduler scheduler;
+
+            ncatalog::catalog_t catalog;
+            CHECK_TRUE(ncatalog::build(sAllocator, &scheduler, &scratch, &source, paths, count, nullptr, catalog));
+            CHECK_EQUAL(count, source.m_reads);
+
+            ncatalog::catalog_t opened;
+            CHECK_TRUE(ncatalog::open(catalog.m_data, catalog.m_size, opened));
+            CHECK_EQUAL((u64)count, ncatalog::get_count(opened));
+            CHECK_TRUE(source_test::equal("dir/000.ply", ncatalog::get_path(opened, 0)));
+            CHECK_TRUE(source_test::equal("dir/199.ply", ncatalog::get_path(opened, count - 1)));
+
+            for (s32 n = 0; n < count; ++n)
+            {
+                s64 const index = ncatalog::find(opened, paths[count - 1 - n]);
+                CHECK_EQUAL((s64)n, index);
+                CHECK_EQUAL(stamps[count - 1 - n], ncatalog::get_stamp(opened, (u64)index));
+
+                nply::info_t info;
+                if ((n % 10) == 9)
+                {
+                    CHECK_FALSE(ncatalog::get_info(opened, (u64)index, info));
+                    continue;
+                }
+                CHECK_TRUE(ncatalog::get_info(opened, (u64)index, info));
+                CHECK_EQUAL(nply::FORMAT_ASCII, nply::get_format(info));
+                CHECK_EQUAL((u64)(1 + (n % 9)), nply::get_element_count(info, "vertex"));
+            }
+            CHECK_EQUAL(-1, ncatalog::find(opened, "dir/200.ply"));
+
+            // Rebuild with one changed file, only that file is read again
+            stamps[5]      = 1;
+            source.m_reads = 0;
+            ncatalog::catalog_t updated;
+            CHECK_TRUE(ncatalog::build(sAllocator, &scheduler, &scratch, &source, paths, count, &opened, updated));
+            CHECK_EQUAL(1, source.m_reads);
+            CHECK_EQUAL(opened.m_size, updated.m_size);
+
+            scratch.exit();
+        }
+
+        UNITTEST_TEST(open_checks)
+        {
+            sAllocator->reset();
+
+            const char* paths[]  = {"a.ply", "b.ply"};
+            const char* files[]  = {"ply\nformat ascii 1.0\nelement vertex 1\nproperty float x\nend_header\n1\n", "solid cube\n"};
+            u64         stamps[] = {1, 2};
+
+            source_test source;
+            source.m_paths  = paths;
+            source.m_files  = files;
+            source.m_stamps = stamps;
+            source.m_count  = 2;
+            source.m_reads  = 0;
+
+            nply::scratch_t scratch;
+            scratch.init(Allocator, 2, 64 * 1024);
+            test_scheduler scheduler;
+
+            ncatalog::catalog_t catalog;
+            CHECK_TRUE(ncatalog::build(sAllocator, &scheduler, &scratch, &source, paths, 2, nullptr, catalog));
+            scratch.exit();
+
+            // header: magic and version, size, count, entries offset; entry: path offset, info offset, info size, stamp
+            u64* image = (u64*)sAllocator->alloc(catalog.m_size, 8);
+            for (u64 i = 0; i < catalog.m_size / 8; ++i)
+                image[i] = ((u64 const*)catalog.m_data)[i];
+            u64 const  size  = image[1];
+            u64* const entry = image + image[3] / 8 + 4;
+
+            ncatalog::catalog_t opened;
+            CHECK_TRUE(ncatalog::open((u8 const*)image, size, opened));
+
+            // the last path runs up to the end of the image without a terminator
+            u8* bytes = (u8*)image;
+            for (u64 i = size - 3; i < size; ++i)
+                bytes[i] = 'x';
+            entry[0] = size - 3;
+            CHECK_FALSE(ncatalog::open((u8 const*)image, size, opened));
+            entry[0] = size;
+            CHECK_FALSE(ncatalog::open((u8 const*)image, size, opened));
+
+            // entries and info that do not fit, also when the sums wrap around
+            entry[0] = image[3];
+            entry[1] = 8;
+            entry[2] = ~(u64)0;
+            CHECK_FALSE(ncatalog::open((u8 const*)image, size, opened));
+            entry[2] = 0;
+            CHECK_TRUE(ncatalog::open((u8 const*)image, size, opened));
+            image[2] = ~(u64)0 / 8;
+            CHECK_FALSE(ncatalog::open((u8 const*)image, size, opened));
+        }
+    }
+}
+UNITTEST_SUITE_END
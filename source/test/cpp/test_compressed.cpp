@@ -0,0 +1,221 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_compressed.h"
+#include "c3dff/c_synthetic.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+class compressed_input : public ncompressed::input_t
+{
+public:
+    const u8* m_data;
+    u64       m_size;
+
+    virtual u64 read_at(u64 offset, u8* buffer, u64 size)
+    {
+        if (offset >= m_size)
+            return 0;
+        u64 const n = (m_size - offset) < size ? (m_size - offset) : size;
+        for (u64 i = 0; i < n; ++i)
+            buffer[i] = m_data[offset + i];
+        return n;
+    }
+};
+
+// A stand-in for a real codec: the 'compressed' bytes are the data xor 0x5A, the stream hands out
+// at most 7 bytes per call and ends after 'm_stream_size' bytes, frames of 'm_bad_size' are corrupt.
+class xor_codec : public ncompressed::codec_t
+{
+public:
+    u64 m_stream_size;
+    u64 m_streamed;
+    u64 m_bad_size;
+
+    static void transform(const u8* src, u8* dst, u64 size)
+    {
+        for (u64 i = 0; i < size; ++i)
+            dst[i] = src[i] ^ 0x5A;
+    }
+
+    virtual bool stream(const u8* src, u64 src_size, u64& consumed, u8* dst, u64 dst_size, u64& produced, bool& end)
+    {
+        u64 n = src_size < dst_size ? src_size : dst_size;
+        n     = n < 7 ? n : 7;
+        if (n > m_stream_size - m_streamed)
+            n = m_stream_size - m_streamed;
+        transform(src, dst, n);
+        consumed    = n;
+        produced    = n;
+        m_streamed += n;
+        end         = m_streamed == m_stream_size;
+        return true;
+    }
+
+    virtual bool frame(const u8* src, u64 src_size, u8* dst, u64 dst_size)
+    {
+        if (src_size != dst_size || src_size == m_bad_size)
+            return false;
+        transform(src, dst, src_size);
+        return true;
+    }
+};
+
+UNITTEST_SUITE_BEGIN(compressed)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_compressed_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_compressed_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        struct mesh_t
+        {
+            nply::vertex_t   m_vertices[600];
+            nply::triangle_t m_triangles[400];
+            u64              m_vertex_count;
+            u64              m_triangle_count;
+        };
+
+        static bool decode(nply::reader_t* reader, mesh_t& mesh)
+        {
+            nply::ply_t* ply = nply::create(sAllocator);
+            if (!nply::read_header(ply, reader))
+                return false;
+            nply::vertices_handler_t  vertices(mesh.m_vertices, 600);
+            nply::triangles_handler_t triangles(mesh.m_triangles, 400);
+            bool const                ok = nply::read_data(ply, reader, &vertices, &triangles);
+            mesh.m_vertex_count          = vertices.m_vertex_count;
+            mesh.m_triangle_count        = triangles.m_triangle_count;
+            return ok;
+        }
+
+        static bool same(mesh_t const& a, mesh_t const& b)
+        {
+            if (a.m_vertex_count != b.m_vertex_count || a.m_triangle_count != b.m_triangle_count)
+                return false;
+            for (u64 i = 0; i < a.m_vertex_count; ++i)
+            {
+                if (a.m_vertices[i].x != b.m_vertices[i].x || a.m_vertices[i].y != b.m_vertices[i].y || a.m_vertices[i].z != b.m_vertices[i].z)
+                    return false;
+            }
+            for (u64 i = 0; i < a.m_triangle_count; ++i)
+            {
+                if (a.m_triangles[i].v1 != b.m_triangles[i].v1 || a.m_triangles[i].v2 != b.m_triangles[i].v2 || a.m_triangles[i].v3 != b.m_triangles[i].v3)
+                    return false;
+            }
+            return true;
+        }
+
+        static void check_format(nply::eformat format)
+        {
+            nsynthetic::config_t config;
+            config.m_format          = format;
+            config.m_vertex_count    = 600;
+            config.m_face_count      = 400;
+            config.m_attribute_count = 2;
+            config.m_seed            = 5;
+            u8*         plain        = (u8*)sAllocator->alloc(256 * 1024);
+            test_writer writer(plain, 256 * 1024);
+            CHECK_TRUE(nsynthetic::generate(config, &writer));
+            u64 const size = writer.m_used;
+
+            mesh_t*               expected = (mesh_t*)sAllocator->alloc(sizeof(mesh_t));
+            nply::memory_reader_t plain_reader(plain, size);
+            CHECK_TRUE(decode(&plain_reader, *expected));
+
+            u8* packed = (u8*)sAllocator->alloc(size);
+            xor_codec::transform(plain, packed, size);
+            compressed_input input;
+            input.m_data = packed;
+            input.m_size = size;
+            xor_codec codec;
+            codec.m_stream_size = size;
+            codec.m_streamed    = 0;
+            codec.m_bad_size    = 0;
+
+            // one stream, small chunks so that lines and records cross them
+            {
+                mesh_t*                      mesh = (mesh_t*)sAllocator->alloc(sizeof(mesh_t));
+                ncompressed::stream_reader_t reader;
+                reader.init(sAllocator, &input, &codec, 1000);
+                CHECK_TRUE(decode(&reader, *mesh));
+                CHECK_FALSE(reader.failed());
+                CHECK_EQUAL(size, reader.get_decompressed());
+                CHECK_TRUE(same(*expected, *mesh));
+                reader.exit();
+            }
+
+            // frames of uneven sizes, decompressed in batches
+            {
+                ncompressed::frame_t frames[64];
+                u64                  count  = 0;
+                u64                  offset = 0;
+                while (offset < size)
+                {
+                    u64 n = 700 + (count * 379) % 1500;
+                    if (n > size - offset)
+                        n = size - offset;
+                    frames[count].m_offset            = offset;
+                    frames[count].m_size              = n;
+                    frames[count].m_decompressed_size = n;
+                    offset += n;
+                    count++;
+                }
+                CHECK_TRUE(count < 64);
+
+                test_scheduler               scheduler;
+                mesh_t*                      mesh = (mesh_t*)sAllocator->alloc(sizeof(mesh_t));
+                ncompressed::frames_reader_t reader;
+                reader.init(sAllocator, &scheduler, &input, &codec, frames, count);
+                CHECK_TRUE(decode(&reader, *mesh));
+                CHECK_FALSE(reader.failed());
+                CHECK_TRUE(same(*expected, *mesh));
+                reader.exit();
+
+                // a corrupt frame near the end fails the read
+                codec.m_bad_size = frames[count - 2].m_size;
+                reader.init(sAllocator, &scheduler, &input, &codec, frames, count, 3);
+                CHECK_FALSE(decode(&reader, *mesh));
+                CHECK_TRUE(reader.failed());
+                reader.exit();
+            }
+
+            // a stream that is cut short
+            {
+                codec.m_streamed = 0;
+                input.m_size     = size - 100;
+                mesh_t*                      mesh = (mesh_t*)sAllocator->alloc(sizeof(mesh_t));
+                ncompressed::stream_reader_t reader;
+                reader.init(sAllocator, &input, &codec, 1000);
+                CHECK_FALSE(decode(&reader, *mesh));
+                CHECK_TRUE(reader.failed());
+                reader.exit();
+            }
+        }
+
+        UNITTEST_TEST(ascii)
+        {
+            sAllocator->reset();
+            check_format(nply::FORMAT_ASCII);
+        }
+
+        UNITTEST_TEST(binary)
+        {
+            sAllocator->reset();
+            check_format(nply::FORMAT_BLE);
+        }
+    }
+}
+UNITTEST_SUITE_END
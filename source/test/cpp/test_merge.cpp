@@ -0,0 +1,226 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_merge.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(merge)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_merge_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_merge_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        // A tetrahedron with counter-clockwise winding
+        static nply::vertex_t   s_vertices[4]  = {{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
+        static nply::triangle_t s_triangles[4] = {{0, 2, 1}, {0, 1, 3}, {0, 3, 2}, {1, 2, 3}};
+
+        static nmerge::mesh_t make_mesh(nmesh::matrix_t const* transform)
+        {
+            nmerge::mesh_t mesh;
+            mesh.m_vertices       = s_vertices;
+            mesh.m_vertex_count   = 4;
+            mesh.m_triangles      = s_triangles;
+            mesh.m_triangle_count = 4;
+            mesh.m_transform      = transform;
+            return mesh;
+        }
+
+        static nply::vertex_t vertex(f32 x, f32 y, f32 z)
+        {
+            nply::vertex_t v;
+            v.x = x;
+            v.y = y;
+            v.z = z;
+            return v;
+        }
+
+        static f64 signed_volume(nply::vertex_t const* vertices, nply::triangle_t const* triangles, u64 count)
+        {
+            f64 volume = 0.0;
+            for (u64 i = 0; i < count; ++i)
+            {
+                nply::vertex_t const& a = vertices[triangles[i].v1];
+                nply::vertex_t const& b = vertices[triangles[i].v2];
+                nply::vertex_t const& c = vertices[triangles[i].v3];
+                volume += (f64)a.x * ((f64)b.y * c.z - (f64)b.z * c.y) - (f64)a.y * ((f64)b.x * c.z - (f64)b.z * c.x) + (f64)a.z * ((f64)b.x * c.y - (f64)b.y * c.x);
+            }
+            return volume / 6.0;
+        }
+
+        UNITTEST_TEST(ranges_and_transforms)
+        {
+            sAllocator->reset();
+            nmesh::matrix_t const move   = nmesh::translate(vertex(10.0f, 0.0f, 0.0f));
+            nmesh::matrix_t const mirror = nmesh::scale(vertex(-1.0f, 1.0f, 1.0f));
+
+            nmerge::mesh_t meshes[4];
+            meshes[0]                  = make_mesh(nullptr);
+            meshes[1]                  = make_mesh(nullptr);
+            meshes[1].m_vertex_count   = 0;
+            meshes[1].m_triangle_count = 0;
+            meshes[2]                  = make_mesh(&move);
+            meshes[3]                  = make_mesh(&mirror);
+
+            nmerge::merged_t merged;
+            CHECK_TRUE(nmerge::merge(sAllocator, nullptr, meshes, 4, merged));
+            CHECK_EQUAL(12, merged.m_vertex_count);
+            CHECK_EQUAL(12, merged.m_triangle_count);
+            CHECK_EQUAL(4, merged.m_range_count);
+
+            u64 const offsets[4] = {0, 4, 4, 8};
+            for (u32 i = 0; i < 4; ++i)
+            {
+                CHECK_EQUAL(offsets[i], merged.m_ranges[i].m_vertex_offset);
+                CHECK_EQUAL(offsets[i], merged.m_ranges[i].m_triangle_offset);
+                CHECK_EQUAL(meshes[i].m_vertex_count, merged.m_ranges[i].m_vertex_count);
+                CHECK_EQUAL(meshes[i].m_triangle_count, merged.m_ranges[i].m_triangle_count);
+            }
+
+            for (u32 v = 0; v < 4; ++v)
+            {
+                CHECK_EQUAL(s_vertices[v].x, merged.m_vertices[v].x);
+                CHECK_EQUAL(s_vertices[v].x + 10.0f, merged.m_vertices[4 + v].x);
+                CHECK_EQUAL(s_vertices[v].y, merged.m_vertices[4 + v].y);
+                CHECK_EQUAL(-s_vertices[v].x, merged.m_vertices[8 + v].x);
+                CHECK_EQUAL(s_vertices[v].z, merged.m_vertices[8 + v].z);
+            }
+
+            // indices are rebased, the mirrored copy has its winding swapped
+            for (u32 t = 0; t < 4; ++t)
+            {
+                CHECK_EQUAL(s_triangles[t].v2, merged.m_triangles[t].v2);
+                CHECK_EQUAL(s_triangles[t].v1 + 4, merged.m_triangles[4 + t].v1);
+                CHECK_EQUAL(s_triangles[t].v3 + 4, merged.m_triangles[4 + t].v3);
+                CHECK_EQUAL(s_triangles[t].v1 + 8, merged.m_triangles[8 + t].v1);
+                CHECK_EQUAL(s_triangles[t].v3 + 8, merged.m_triangles[8 + t].v2);
+                CHECK_EQUAL(s_triangles[t].v2 + 8, merged.m_triangles[8 + t].v3);
+            }
+            for (u32 i = 0; i < 4; ++i)
+            {
+                nmerge::range_t const& r = merged.m_ranges[i];
+                if (r.m_triangle_count == 0)
+                    continue;
+                f64 const volume = signed_volume(merged.m_vertices, merged.m_triangles + r.m_triangle_offset, r.m_triangle_count);
+                CHECK_TRUE(volume > 0.1666 && volume < 0.1667);
+            }
+            nmerge::release(sAllocator, merged);
+            CHECK_TRUE(merged.m_vertices == nullptr);
+
+            CHECK_TRUE(nmerge::merge(sAllocator, nullptr, meshes, 0, merged));
+            CHECK_EQUAL(0, merged.m_vertex_count);
+            CHECK_EQUAL(0, merged.m_range_count);
+        }
+
+        UNITTEST_TEST(many_meshes)
+        {
+            sAllocator->reset();
+
+            // a large grid between thousands of small meshes, parts start and end in the middle of meshes
+            u32 const         side          = 120;
+            nply::vertex_t*   grid_vertices = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * side * side);
+            nply::triangle_t* grid_faces    = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * (side - 1) * (side - 1) * 2);
+            u32               faces         = 0;
+            for (u32 y = 0; y < side; ++y)
+            {
+                for (u32 x = 0; x < side; ++x)
+                {
+                    grid_vertices[y * side + x] = vertex((f32)x, (f32)y, 0.0f);
+                    if (x + 1 < side && y + 1 < side)
+                    {
+                        u32 const i          = y * side + x;
+                        grid_faces[faces].v1 = i;
+                        grid_faces[faces].v2 = i + 1;
+                        grid_faces[faces].v3 = i + side;
+                        faces++;
+                        grid_faces[faces].v1 = i + 1;
+                        grid_faces[faces].v2 = i + side + 1;
+                        grid_faces[faces].v3 = i + side;
+                        faces++;
+                    }
+                }
+            }
+
+            u32 const        count      = 3001;
+            nmerge::mesh_t*  meshes     = (nmerge::mesh_t*)sAllocator->alloc(sizeof(nmerge::mesh_t) * count);
+            nmesh::matrix_t* transforms = (nmesh::matrix_t*)sAllocator->alloc(sizeof(nmesh::matrix_t) * count);
+            for (u32 i = 0; i < count; ++i)
+            {
+                transforms[i] = nmesh::translate(vertex((f32)i, 0.0f, 0.0f));
+                meshes[i]     = make_mesh((i % 3) != 0 ? &transforms[i] : nullptr);
+            }
+            meshes[1500].m_vertices       = grid_vertices;
+            meshes[1500].m_vertex_count   = side * side;
+            meshes[1500].m_triangles      = grid_faces;
+            meshes[1500].m_triangle_count = faces;
+
+            test_scheduler   scheduler;
+            nmerge::merged_t serial, parallel;
+            CHECK_TRUE(nmerge::merge(sAllocator, nullptr, meshes, count, serial));
+            CHECK_TRUE(nmerge::merge(sAllocator, &scheduler, meshes, count, parallel));
+            CHECK_EQUAL(3000 * 4 + side * side, parallel.m_vertex_count);
+            CHECK_EQUAL(3000 * 4 + faces, parallel.m_triangle_count);
+
+            u64 differences = 0;
+            for (u64 i = 0; i < serial.m_vertex_count; ++i)
+            {
+                if (serial.m_vertices[i].x != parallel.m_vertices[i].x || serial.m_vertices[i].y != parallel.m_vertices[i].y || serial.m_vertices[i].z != parallel.m_vertices[i].z)
+                    differences++;
+            }
+            for (u64 i = 0; i < serial.m_triangle_count; ++i)
+            {
+                if (serial.m_triangles[i].v1 != parallel.m_triangles[i].v1 || serial.m_triangles[i].v2 != parallel.m_triangles[i].v2 || serial.m_triangles[i].v3 != parallel.m_triangles[i].v3)
+                    differences++;
+            }
+            CHECK_EQUAL(0, differences);
+
+            // every triangle indexes the vertices of its own mesh
+            u64 outside = 0;
+            for (u32 m = 0; m < count; ++m)
+            {
+                nmerge::range_t const& r = parallel.m_ranges[m];
+                for (u64 t = r.m_triangle_offset; t < r.m_triangle_offset + r.m_triangle_count; ++t)
+                {
+                    u32 const v[3] = {parallel.m_triangles[t].v1, parallel.m_triangles[t].v2, parallel.m_triangles[t].v3};
+                    for (u32 k = 0; k < 3; ++k)
+                        if (v[k] < r.m_vertex_offset || v[k] >= r.m_vertex_offset + r.m_vertex_count)
+                            outside++;
+                }
+            }
+            CHECK_EQUAL(0, outside);
+            CHECK_EQUAL(3000.0f, parallel.m_vertices[parallel.m_ranges[2999].m_vertex_offset + 1].x);
+            CHECK_EQUAL((f32)(side - 1), parallel.m_vertices[parallel.m_ranges[1500].m_vertex_offset + side * side - 1].x);
+        }
+
+        UNITTEST_TEST(index_limit)
+        {
+            // plan only looks at the sizes
+            nmerge::mesh_t meshes[2];
+            meshes[0]                  = make_mesh(nullptr);
+            meshes[0].m_vertex_count   = (u64)1 << 31;
+            meshes[1]                  = meshes[0];
+            nmerge::range_t ranges[2];
+            u64             vertex_count, triangle_count;
+            CHECK_TRUE(nmerge::plan(meshes, 2, ranges, vertex_count, triangle_count));
+            CHECK_EQUAL((u64)1 << 32, vertex_count);
+            CHECK_EQUAL((u64)1 << 31, ranges[1].m_vertex_offset);
+
+            meshes[1].m_vertex_count = ((u64)1 << 31) + 1;
+            CHECK_FALSE(nmerge::plan(meshes, 2, ranges, vertex_count, triangle_count));
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,101 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_mesh.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(mesh)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_mesh_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_mesh_allocator;
+            sAllocator->init(Allocator, 4 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        // A cube from (1,2,3) to (3,4,5) with outward facing, counter-clockwise triangles
+        static const nply::vertex_t   sCubeVertices[8]   = {{1, 2, 3}, {3, 2, 3}, {3, 4, 3}, {1, 4, 3}, {1, 2, 5}, {3, 2, 5}, {3, 4, 5}, {1, 4, 5}};
+        static const nply::triangle_t sCubeTriangles[12] = {{0, 2, 1}, {0, 3, 2}, {4, 5, 6}, {4, 6, 7}, {0, 1, 5}, {0, 5, 4}, {1, 2, 6}, {1, 6, 5}, {2, 3, 7}, {2, 7, 6}, {3, 0, 4}, {3, 4, 7}};
+
+        static nmesh::positions_t make_cube()
+        {
+            nmesh::positions_t p;
+            p.m_count = 8;
+            p.m_x     = (f32*)sAllocator->alloc(sizeof(f32) * 8);
+            p.m_y     = (f32*)sAllocator->alloc(sizeof(f32) * 8);
+            p.m_z     = (f32*)sAllocator->alloc(sizeof(f32) * 8);
+            nmesh::to_soa(nullptr, sCubeVertices, p);
+            return p;
+        }
+
+        UNITTEST_TEST(bounds_and_statistics)
+        {
+            sAllocator->reset();
+            nmesh::positions_t p = make_cube();
+
+            n3d::box_t const box = nmesh::bounds(nullptr, p);
+            CHECK_EQUAL(1.0f, box.m_min[0]);
+            CHECK_EQUAL(2.0f, box.m_min[1]);
+            CHECK_EQUAL(3.0f, box.m_min[2]);
+            CHECK_EQUAL(3.0f, box.m_max[0]);
+            CHECK_EQUAL(4.0f, box.m_max[1]);
+            CHECK_EQUAL(5.0f, box.m_max[2]);
+
+            CHECK_CLOSE(8.0, nmesh::signed_volume(nullptr, p, sCubeTriangles, 12), 0.0001);
+            CHECK_CLOSE(24.0, nmesh::surface_area(nullptr, p, sCubeTriangles, 12), 0.0001);
+        }
+
+        UNITTEST_TEST(bounds_large)
+        {
+            sAllocator->reset();
+            nmesh::positions_t p;
+            p.m_count = 100003;
+            p.m_x     = (f32*)sAllocator->alloc(sizeof(f32) * (u32)p.m_count);
+            p.m_y     = (f32*)sAllocator->alloc(sizeof(f32) * (u32)p.m_count);
+            p.m_z     = (f32*)sAllocator->alloc(sizeof(f32) * (u32)p.m_count);
+            for (u32 i = 0; i < p.m_count; ++i)
+            {
+                p.m_x[i] = (f32)i;
+                p.m_y[i] = -(f32)i;
+                p.m_z[i] = (f32)(i % 7);
+            }
+            n3d::box_t const box = nmesh::bounds(nullptr, p);
+            CHECK_EQUAL(0.0f, box.m_min[0]);
+            CHECK_EQUAL(100002.0f, box.m_max[0]);
+            CHECK_EQUAL(-100002.0f, box.m_min[1]);
+            CHECK_EQUAL(6.0f, box.m_max[2]);
+        }
+
+        UNITTEST_TEST(transform_and_fit)
+        {
+            sAllocator->reset();
+            nmesh::positions_t p = make_cube();
+
+            nply::vertex_t offset = {1.0f, -2.0f, 0.5f};
+            nmesh::transform(nullptr, nmesh::translate(offset), p);
+            CHECK_EQUAL(2.0f, p.m_x[0]);
+            CHECK_EQUAL(0.0f, p.m_y[0]);
+            CHECK_EQUAL(3.5f, p.m_z[0]);
+
+            nmesh::unit_cube(nullptr, p);
+            n3d::box_t const box = nmesh::bounds(nullptr, p);
+            for (s32 i = 0; i < 3; ++i)
+            {
+                CHECK_CLOSE(-0.5f, box.m_min[i], 0.0001f);
+                CHECK_CLOSE(0.5f, box.m_max[i], 0.0001f);
+            }
+            CHECK_CLOSE(1.0, nmesh::signed_volume(nullptr, p, sCubeTriangles, 12), 0.0001);
+        }
+    }
+}
+UNITTEST_SUITE_END
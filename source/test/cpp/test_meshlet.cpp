@@ -0,0 +1,213 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_meshlet.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(meshlet)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_meshlet_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_meshlet_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        // A flat grid of n x n quads in the z = 0 plane, facing +z
+        static nmeshlet::mesh_t make_grid(u32 n)
+        {
+            nmeshlet::mesh_t  mesh;
+            nply::vertex_t*   vertices  = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * (n + 1) * (n + 1));
+            nply::triangle_t* triangles = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * n * n * 2);
+            for (u32 y = 0; y <= n; ++y)
+            {
+                for (u32 x = 0; x <= n; ++x)
+                {
+                    nply::vertex_t& v = vertices[y * (n + 1) + x];
+                    v.x               = (f32)x;
+                    v.y               = (f32)y;
+                    v.z               = 0.0f;
+                }
+            }
+            for (u32 y = 0; y < n; ++y)
+            {
+                for (u32 x = 0; x < n; ++x)
+                {
+                    u32 const         i = y * (n + 1) + x;
+                    nply::triangle_t* t = triangles + (y * n + x) * 2;
+                    t[0].v1             = i;
+                    t[0].v2             = i + 1;
+                    t[0].v3             = i + n + 2;
+                    t[1].v1             = i;
+                    t[1].v2             = i + n + 2;
+                    t[1].v3             = i + n + 1;
+                }
+            }
+            mesh.m_vertices       = vertices;
+            mesh.m_vertex_count   = (n + 1) * (n + 1);
+            mesh.m_triangles      = triangles;
+            mesh.m_triangle_count = n * n * 2;
+            return mesh;
+        }
+
+        // Every triangle of the mesh is in exactly one meshlet and the limits and bounds hold
+        static void check_meshlets(nmeshlet::mesh_t const& mesh, nmeshlet::meshlets_t const& meshlets, u32 max_vertices, u32 max_triangles)
+        {
+            u8* seen = (u8*)sAllocator->alloc(mesh.m_triangle_count + 1);
+            for (u32 t = 0; t < mesh.m_triangle_count; ++t)
+                seen[t] = 0;
+
+            u32 vertex_offset   = 0;
+            u32 triangle_offset = 0;
+            for (u32 m = 0; m < meshlets.m_meshlet_count; ++m)
+            {
+                nmeshlet::meshlet_t const& meshlet = meshlets.m_meshlets[m];
+                CHECK_EQUAL(vertex_offset, meshlet.m_vertex_offset);
+                CHECK_EQUAL(triangle_offset, meshlet.m_triangle_offset);
+                CHECK_TRUE(meshlet.m_vertex_count <= max_vertices);
+                CHECK_TRUE(meshlet.m_triangle_count >= 1 && meshlet.m_triangle_count <= max_triangles);
+                vertex_offset   += meshlet.m_vertex_count;
+                triangle_offset += meshlet.m_triangle_count;
+
+                u32 const* vertices = meshlets.m_vertices + meshlet.m_vertex_offset;
+                for (u32 i = 0; i < meshlet.m_vertex_count; ++i)
+                {
+                    nply::vertex_t const& v  = mesh.m_vertices[vertices[i]];
+                    f32 const             dx = v.x - meshlet.m_center[0];
+                    f32 const             dy = v.y - meshlet.m_center[1];
+                    f32 const             dz = v.z - meshlet.m_center[2];
+                    CHECK_TRUE(dx * dx + dy * dy + dz * dz <= (meshlet.m_radius * 1.001f + 0.0001f) * (meshlet.m_radius * 1.001f + 0.0001f));
+                }
+
+                u8 const* local = meshlets.m_triangles + meshlet.m_triangle_offset * 3;
+                for (u32 i = 0; i < meshlet.m_triangle_count; ++i)
+                {
+                    CHECK_TRUE(local[i * 3 + 0] < meshlet.m_vertex_count && local[i * 3 + 1] < meshlet.m_vertex_count && local[i * 3 + 2] < meshlet.m_vertex_count);
+                    u32 const v1    = vertices[local[i * 3 + 0]];
+                    u32 const v2    = vertices[local[i * 3 + 1]];
+                    u32 const v3    = vertices[local[i * 3 + 2]];
+                    u32       found = 0;
+                    for (u32 t = 0; t < mesh.m_triangle_count; ++t)
+                    {
+                        nply::triangle_t const& tri = mesh.m_triangles[t];
+                        if (!seen[t] && tri.v1 == v1 && tri.v2 == v2 && tri.v3 == v3)
+                        {
+                            seen[t] = 1;
+                            found++;
+                            break;
+                        }
+                    }
+                    CHECK_EQUAL(1, found);
+                }
+            }
+            CHECK_EQUAL(meshlets.m_vertex_count, vertex_offset);
+            CHECK_EQUAL(mesh.m_triangle_count, triangle_offset);
+            CHECK_EQUAL(mesh.m_triangle_count, meshlets.m_triangle_count);
+            for (u32 t = 0; t < mesh.m_triangle_count; ++t)
+                CHECK_EQUAL(1, seen[t]);
+        }
+
+        UNITTEST_TEST(grid)
+        {
+            sAllocator->reset();
+            nmeshlet::mesh_t const mesh = make_grid(24);
+            nmeshlet::config_t     config;
+            nmeshlet::meshlets_t   meshlets;
+            CHECK_TRUE(nmeshlet::build(sAllocator, mesh, config, meshlets));
+            check_meshlets(mesh, meshlets, nmeshlet::MAX_VERTICES, nmeshlet::MAX_TRIANGLES);
+
+            // connected triangles are kept together, a 64 vertex patch of the grid holds about 80 triangles
+            CHECK_TRUE(meshlets.m_meshlet_count <= mesh.m_triangle_count / 60 + 1);
+
+            f32 const below[3] = {12.0f, 12.0f, -10.0f};
+            f32 const above[3] = {12.0f, 12.0f, 10.0f};
+            for (u32 m = 0; m < meshlets.m_meshlet_count; ++m)
+            {
+                nmeshlet::meshlet_t const& meshlet = meshlets.m_meshlets[m];
+                CHECK_TRUE(meshlet.m_cone_axis[2] > 0.999f);
+                CHECK_TRUE(nmeshlet::is_backfacing(meshlet, below));
+                CHECK_FALSE(nmeshlet::is_backfacing(meshlet, above));
+            }
+        }
+
+        UNITTEST_TEST(limits)
+        {
+            sAllocator->reset();
+            nmeshlet::mesh_t mesh = make_grid(6);
+
+            // degenerate triangles are kept, they count once per distinct vertex
+            nply::triangle_t* triangles = (nply::triangle_t*)mesh.m_triangles;
+            triangles[5].v2             = triangles[5].v1;
+            triangles[9].v3             = triangles[9].v1;
+            triangles[9].v2             = triangles[9].v1;
+
+            nmeshlet::config_t config;
+            config.m_max_vertices  = 5;
+            config.m_max_triangles = 3;
+            nmeshlet::meshlets_t meshlets;
+            CHECK_TRUE(nmeshlet::build(sAllocator, mesh, config, meshlets));
+            check_meshlets(mesh, meshlets, 5, 3);
+
+            // limits beyond what u8 indices and the output were sized for are clamped
+            config.m_max_vertices  = 1000;
+            config.m_max_triangles = 1000;
+            CHECK_TRUE(nmeshlet::build(sAllocator, mesh, config, meshlets));
+            check_meshlets(mesh, meshlets, nmeshlet::MAX_VERTICES, nmeshlet::MAX_TRIANGLES);
+            CHECK_EQUAL(1, meshlets.m_meshlet_count);
+
+            triangles[7].v3 = mesh.m_vertex_count;
+            CHECK_FALSE(nmeshlet::build(sAllocator, mesh, config, meshlets));
+        }
+
+        UNITTEST_TEST(many_meshes)
+        {
+            sAllocator->reset();
+            nmeshlet::mesh_t meshes[7];
+            for (u32 i = 0; i < 7; ++i)
+                meshes[i] = make_grid(3 + i * 5);
+            meshes[4].m_triangle_count = 0;
+            ((nply::triangle_t*)meshes[5].m_triangles)[11].v1 = meshes[5].m_vertex_count + 3;
+
+            nply::scratch_t scratch;
+            scratch.init(Allocator, 3, 64 * 1024);
+            test_scheduler       scheduler;
+            nmeshlet::config_t   config;
+            nmeshlet::meshlets_t meshlets[7];
+            CHECK_FALSE(nmeshlet::build(sAllocator, &scheduler, &scratch, meshes, 7, config, meshlets));
+            scratch.exit();
+
+            for (u32 i = 0; i < 7; ++i)
+            {
+                if (i == 5)
+                {
+                    CHECK_EQUAL(0, meshlets[i].m_meshlet_count);
+                    continue;
+                }
+                check_meshlets(meshes[i], meshlets[i], nmeshlet::MAX_VERTICES, nmeshlet::MAX_TRIANGLES);
+
+                // the same as building the mesh on its own
+                nmeshlet::meshlets_t single;
+                CHECK_TRUE(nmeshlet::build(sAllocator, meshes[i], config, single));
+                CHECK_EQUAL(single.m_meshlet_count, meshlets[i].m_meshlet_count);
+                CHECK_EQUAL(single.m_vertex_count, meshlets[i].m_vertex_count);
+                for (u32 v = 0; v < single.m_vertex_count; ++v)
+                    CHECK_EQUAL(single.m_vertices[v], meshlets[i].m_vertices[v]);
+                for (u32 t = 0; t < single.m_triangle_count * 3; ++t)
+                    CHECK_EQUAL(single.m_triangles[t], meshlets[i].m_triangles[t]);
+            }
+            CHECK_EQUAL(0, meshlets[4].m_meshlet_count);
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -17,6 +17,7 @@ public:
         : m_str(str)
         , m_cursor(str)
         , m_end(str + len)
+        , m_line_end(0)
     {
     }
 
@@ -25,13 +26,16 @@ public:
         const char* cursor = ncore::nply::g_ReadLine(m_cursor, m_end, str, end);
         if (cursor > m_cursor)
         {
-            m_cursor = cursor;
+            m_cursor   = cursor;
+            m_line_end = (u32)(cursor - end);
             return true;
         }
         return false;
     }
 
-    virtual bool read_data(u32 size, const u8*& begin, const u8*& end)
+    virtual u32 line_end_size() const { return m_line_end; }
+
+    virtual bool read_data(u64 size, const u8*& begin, const u8*& end)
     {
         if ((m_cursor + size) <= m_end)
         {
@@ -46,35 +50,15 @@ public:
     const char* m_str;
     const char* m_cursor;
     const char* m_end;
+    u32         m_line_end;
 };
 
-class ply_allocator : public ncore::nply::allocator_t
+// Accepts the faces without looking at them
+class faces_test : public ncore::nply::handler_t
 {
-    alloc_t* m_allocator;
-    u8*      m_memory;
-    u8*      m_ptr;
-    u32      m_size;
-
 public:
-    void init(alloc_t* allocator)
-    {
-        m_allocator = allocator;
-        m_size      = 128 * 1024 * 1024;
-        m_memory    = (u8*)m_allocator->allocate(m_size, 8);
-        m_ptr       = m_memory;
-    }
-
-    void exit() { m_allocator->deallocate(m_memory); }
-
-    virtual void* alloc(u32 size)
-    {
-        ASSERT(size < ((m_memory + m_size) - m_ptr));
-        u8* ptr = m_ptr;
-        m_ptr += (size + (16 - 1)) & ~(16 - 1);
-        return ptr;
-    }
-
-    void reset() { m_ptr = m_memory; }
+    virtual bool setup(s32 element_index, u64 num_items, ncore::nply::etype* property_type_array, s32* property_index_array, s32 property_count) { return element_index == ncore::nply::INDEX_FACE; }
+    virtual void read(s32 element_index, ncore::nply::etype* property_type, s32 property_count, void* property_data) {}
 };
 
 UNITTEST_SUITE_BEGIN(ply)
@@ -102,17 +86,659 @@ UNITTEST_SUITE_BEGIN(ply)
             reader_test reader((const char*)skull_ply, skull_ply_len);
             CHECK_TRUE(nply::read_header(ply, &reader));
             {
-                u32 const                vertex_count = get_element_count(ply, "vertex");
+                u64 const                vertex_count = get_element_count(ply, "vertex");
                 nply::vertex_t*          vertex_array = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * vertex_count);
                 nply::vertices_handler_t vertices_handler(vertex_array, vertex_count);
 
-                u32 const                 triangle_count = get_element_count(ply, "face");
+                u64 const                 triangle_count = get_element_count(ply, "face");
                 nply::triangle_t*         triangle_array = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * triangle_count);
                 nply::triangles_handler_t triangles_handler(triangle_array, triangle_count);
 
-                nply::read_data(ply, &reader, &vertices_handler, &triangles_handler);
+                CHECK_TRUE(nply::read_data(ply, &reader, &vertices_handler, &triangles_handler));
+                CHECK_EQUAL(vertex_count, vertices_handler.m_vertex_count);
+                CHECK_EQUAL(triangle_count, triangles_handler.m_triangle_count);
+            }
+        }
+
+        static u32 text_length(const char* str)
+        {
+            u32 len = 0;
+            while (str[len] != 0)
+                len++;
+            return len;
+        }
+
+        static s32 text_compare(const char* a, const char* b)
+        {
+            while (*a != 0 && *a == *b)
+            {
+                a++;
+                b++;
+            }
+            return (s32)*a - (s32)*b;
+        }
+
+        static u8* append(u8* dst, const char* str)
+        {
+            while (*str != 0)
+                *dst++ = (u8)*str++;
+            return dst;
+        }
+
+        template <typename T> static u8* append(u8* dst, T value, bool big_endian)
+        {
+            u8 const* src = (u8 const*)&value;
+            for (u32 i = 0; i < sizeof(T); ++i)
+                *dst++ = big_endian ? src[sizeof(T) - 1 - i] : src[i];
+            return dst;
+        }
+
+        UNITTEST_TEST(ascii_selected_properties)
+        {
+            sAllocator->reset();
+
+            const char* text = "ply\r\nformat ascii 1.0\r\n"
+                               "element vertex 3\r\nproperty uchar red\r\nproperty double z\r\nproperty float nx\r\nproperty float x\r\nproperty int y\r\n"
+                               "element face 2\r\nproperty uchar flags\r\nproperty list uchar uint vertex_indices\r\nend_header\r\n"
+                               "255 1.5e2 0.25 -1.25 7\r\n\r\n"
+                               "0 -0.001 1 3.0 -8\r\n"
+                               "12 2 1 .5 0\r\n"
+                               "1 3 0 1 2\r\n"
+                               "0 3 2 1 0\r\n";
+
+            const char* xyz[3] = {"x", "y", "z"};
+            {
+                nply::ply_t* ply = nply::create(sAllocator);
+                reader_test  reader(text, text_length(text));
+                CHECK_TRUE(nply::read_header(ply, &reader));
+                CHECK_EQUAL(3, nply::get_element_count(ply, "vertex"));
+                CHECK_EQUAL(2, nply::get_element_count(ply, "face"));
+                CHECK_TRUE(nply::select_properties(ply, "vertex", xyz, 3));
+                CHECK_FALSE(nply::set_property_index(ply, "vertex", "w", 0));
+
+                nply::vertex_t           vertices[3];
+                nply::vertices_handler_t vertices_handler(vertices, 3);
+                CHECK_TRUE(nply::read_data(ply, &reader, &vertices_handler, nullptr));
+                CHECK_EQUAL(3, vertices_handler.m_vertex_count);
+                CHECK_CLOSE(-1.25f, vertices[0].x, 0.00001f);
+                CHECK_CLOSE(7.0f, vertices[0].y, 0.00001f);
+                CHECK_CLOSE(150.0f, vertices[0].z, 0.00001f);
+                CHECK_CLOSE(3.0f, vertices[1].x, 0.00001f);
+                CHECK_CLOSE(-8.0f, vertices[1].y, 0.00001f);
+                CHECK_CLOSE(-0.001f, vertices[1].z, 0.00001f);
+                CHECK_CLOSE(0.5f, vertices[2].x, 0.00001f);
+                CHECK_CLOSE(2.0f, vertices[2].z, 0.00001f);
+            }
+            {
+                nply::ply_t* ply = nply::create(sAllocator);
+                reader_test  reader(text, text_length(text));
+                CHECK_TRUE(nply::read_header(ply, &reader));
+                nply::set_element_index(ply, "vertex", nply::INDEX_NONE);
+
+                nply::triangle_t          triangles[2];
+                nply::triangles_handler_t triangles_handler(triangles, 2);
+                CHECK_TRUE(nply::read_data(ply, &reader, &triangles_handler, nullptr));
+                CHECK_EQUAL(2, triangles_handler.m_triangle_count);
+                CHECK_EQUAL(0, triangles[0].v1);
+                CHECK_EQUAL(2, triangles[0].v3);
+                CHECK_EQUAL(2, triangles[1].v1);
+                CHECK_EQUAL(0, triangles[1].v3);
+            }
+        }
+
+        static void check_binary(bool big_endian)
+        {
+            // A scan with 40 properties of which only x, y and z are wanted
+            s32 const vertex_count   = 1000;
+            s32 const property_count = 40;
+            s32 const x = 5, y = 17, z = 33;
+
+            u8* data = (u8*)sAllocator->alloc(1024 * 1024);
+            u8* dst  = data;
+            dst      = append(dst, big_endian ? "ply\nformat binary_big_endian 1.0\n" : "ply\nformat binary_little_endian 1.0\n");
+            dst      = append(dst, "comment generated\nelement vertex 1000\n");
+            for (s32 p = 0; p < property_count; ++p)
+            {
+                char line[64] = "property float p00\n";
+                line[16]      = (char)('0' + p / 10);
+                line[17]      = (char)('0' + p % 10);
+                dst           = append(dst, line);
+            }
+            dst = append(dst, "element face 999\nproperty list uchar int vertex_indices\nproperty ushort material\nend_header\n");
+            for (s32 v = 0; v < vertex_count; ++v)
+            {
+                for (s32 p = 0; p < property_count; ++p)
+                    dst = append<f32>(dst, (f32)(v * 100 + p), big_endian);
+            }
+            for (s32 f = 0; f < vertex_count - 1; ++f)
+            {
+                dst = append<u8>(dst, 3, big_endian);
+                dst = append<s32>(dst, f, big_endian);
+                dst = append<s32>(dst, f + 1, big_endian);
+                dst = append<s32>(dst, 0, big_endian);
+                dst = append<u16>(dst, (u16)f, big_endian);
+            }
+
+            nply::ply_t* ply = nply::create(sAllocator);
+            reader_test  reader((const char*)data, (u32)(dst - data));
+            CHECK_TRUE(nply::read_header(ply, &reader));
+            CHECK_TRUE(nply::set_property_index(ply, "vertex", "p05", nply::INDEX_PROP_X));
+            CHECK_TRUE(nply::set_property_index(ply, "vertex", "p17", nply::INDEX_PROP_Y));
+            CHECK_TRUE(nply::set_property_index(ply, "vertex", "p33", nply::INDEX_PROP_Z));
+            for (s32 p = 0; p < property_count; ++p)
+            {
+                if (p == x || p == y || p == z)
+                    continue;
+                char name[4] = "p00";
+                name[1]      = (char)('0' + p / 10);
+                name[2]      = (char)('0' + p % 10);
+                CHECK_TRUE(nply::set_property_index(ply, "vertex", name, nply::INDEX_NONE));
+            }
+
+            nply::vertex_t*          vertices = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * vertex_count);
+            nply::vertices_handler_t vertices_handler(vertices, vertex_count);
+            nply::triangle_t*         triangles = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * (vertex_count - 1));
+            nply::triangles_handler_t triangles_handler(triangles, vertex_count - 1);
+            CHECK_TRUE(nply::read_data(ply, &reader, &vertices_handler, &triangles_handler));
+            CHECK_EQUAL(vertex_count, vertices_handler.m_vertex_count);
+            CHECK_EQUAL(vertex_count - 1, triangles_handler.m_triangle_count);
+            for (s32 v = 0; v < vertex_count; ++v)
+            {
+                CHECK_EQUAL((f32)(v * 100 + x), vertices[v].x);
+                CHECK_EQUAL((f32)(v * 100 + y), vertices[v].y);
+                CHECK_EQUAL((f32)(v * 100 + z), vertices[v].z);
+            }
+            for (s32 f = 0; f < vertex_count - 1; ++f)
+            {
+                CHECK_EQUAL((u32)f, triangles[f].v1);
+                CHECK_EQUAL((u32)(f + 1), triangles[f].v2);
+                CHECK_EQUAL(0, triangles[f].v3);
+            }
+            CHECK_EQUAL(reader.m_end, reader.m_cursor);
+
+            // Skipping the vertices (fixed size) and the faces (lists) consumes the whole body
+            nply::ply_t* skipped = nply::create(sAllocator);
+            reader_test  skip_reader((const char*)data, (u32)(dst - data));
+            CHECK_TRUE(nply::read_header(skipped, &skip_reader));
+            nply::vertex_t           one;
+            nply::vertices_handler_t no_vertices(&one, 1);
+            nply::set_element_index(skipped, "vertex", nply::INDEX_NONE);
+            CHECK_TRUE(nply::read_data(skipped, &skip_reader, &no_vertices, nullptr));
+            CHECK_EQUAL(0, no_vertices.m_vertex_count);
+            CHECK_EQUAL(skip_reader.m_end, skip_reader.m_cursor);
+        }
+
+        UNITTEST_TEST(probe_header)
+        {
+            sAllocator->reset();
+
+            const char* text = "ply\nformat binary_little_endian 1.0\ncomment scanned 2024\nobj_info num_cols 640\n"
+                               "element vertex 5000000000\nproperty float x\nproperty float y\nproperty float z\n"
+                               "element face 12\nproperty list uchar int vertex_indices\nend_header\n\x0a\x0d";
+            u32 const   size = text_length(text);
+
+            nply::info_t info;
+            CHECK_FALSE(nply::probe(sAllocator, (const u8*)text, 40, info)); // header is incomplete
+            CHECK_FALSE(nply::probe(sAllocator, (const u8*)"solid ascii\n", 12, info));
+            CHECK_TRUE(nply::probe(sAllocator, (const u8*)text, size, info));
+
+            nply::info_t opened;
+            CHECK_TRUE(nply::open_info(info.m_data, info.m_size, opened));
+            CHECK_EQUAL(nply::FORMAT_BLE, nply::get_format(opened));
+            CHECK_EQUAL(size - 2, nply::get_body_offset(opened));
+            CHECK_EQUAL(2, nply::get_num_elements(opened));
+            CHECK_EQUAL(5000000000ull, nply::get_element_count(opened, "vertex"));
+            CHECK_EQUAL(12, nply::get_element_count(opened, "face"));
+            CHECK_EQUAL(12, nply::get_element_items(opened, 1));
+            CHECK_EQUAL(3, nply::get_num_properties(opened, 0));
+            CHECK_EQUAL(0, text_compare("y", nply::get_property_name(opened, 0, 1)));
+            CHECK_EQUAL(nply::TYPE_FLOAT32, nply::get_property_type(opened, 0, 2));
+            CHECK_EQUAL(0, text_compare("face", nply::get_element_name(opened, 1)));
+            CHECK_TRUE(nply::type_is_list(nply::get_property_type(opened, 1, 0)));
+            CHECK_EQUAL(nply::TYPE_UINT8, nply::get_property_count_type(opened, 1, 0));
+            CHECK_EQUAL(1, nply::get_num_comments(opened));
+            CHECK_EQUAL(0, text_compare("scanned 2024", nply::get_comment(opened, 0)));
+            CHECK_EQUAL(1, nply::get_num_obj_info(opened));
+            CHECK_EQUAL(0, text_compare("num_cols 640", nply::get_obj_info(opened, 0)));
+        }
+
+        // Every call advances the clock by one tick
+        class ticker_test : public nply::ticker_t
+        {
+        public:
+            ticker_test()
+                : m_ticks(0)
+            {
+            }
+            virtual u64 ticks() { return ++m_ticks; }
+            virtual u64 frequency() { return 1000; }
+            u64         m_ticks;
+        };
+
+        UNITTEST_TEST(decode_statistics)
+        {
+            sAllocator->reset();
+            s32 const vertex_count = 100;
+
+            u8* data = (u8*)sAllocator->alloc(64 * 1024);
+            u8* dst  = append(data, "ply\nformat binary_little_endian 1.0\nelement vertex 100\nproperty float x\nproperty float y\nproperty float z\n"
+                                    "element face 99\nproperty list uchar int vertex_indices\nend_header\n");
+            u32 const header_size = (u32)(dst - data);
+            for (s32 v = 0; v < vertex_count * 3; ++v)
+                dst = append<f32>(dst, (f32)v, false);
+            for (s32 f = 0; f < vertex_count - 1; ++f)
+            {
+                dst = append<u8>(dst, 3, false);
+                dst = append<s32>(dst, f, false);
+                dst = append<s32>(dst, f + 1, false);
+                dst = append<s32>(dst, 0, false);
             }
+
+            nply::ply_t* ply = nply::create(sAllocator);
+            CHECK_NULL(nply::get_stats(ply));
+
+            ticker_test ticker;
+            nply::enable_stats(ply, &ticker);
+            reader_test reader((const char*)data, (u32)(dst - data));
+            CHECK_TRUE(nply::read_header(ply, &reader));
+
+            nply::vertex_t*          vertices = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * vertex_count);
+            nply::vertices_handler_t vertices_handler(vertices, vertex_count);
+            CHECK_TRUE(nply::read_data(ply, &reader, &vertices_handler, nullptr));
+            CHECK_EQUAL(vertex_count, vertices_handler.m_vertex_count);
+
+            nply::stats_t const* stats = nply::get_stats(ply);
+            CHECK_NOT_NULL(stats);
+            CHECK_EQUAL(1000, stats->m_frequency);
+            CHECK_EQUAL(vertex_count, stats->m_items_decoded);
+            CHECK_EQUAL(vertex_count - 1, stats->m_items_skipped);
+            CHECK_EQUAL((u64)(vertex_count * 12), stats->m_bytes_read - (u64)(vertex_count - 1)); // one count byte per face
+            CHECK_EQUAL((u64)(vertex_count - 1) * 12, stats->m_bytes_skipped);
+            CHECK_EQUAL((u64)(dst - data) - header_size, stats->m_bytes_read + stats->m_bytes_skipped);
+            CHECK_TRUE(stats->m_ticks[nply::stats_t::PHASE_HEADER] > 0);
+            CHECK_TRUE(stats->m_ticks[nply::stats_t::PHASE_IO] > 0);
+            CHECK_TRUE(stats->m_ticks[nply::stats_t::PHASE_CONVERT] > 0);
+            CHECK_TRUE(stats->m_ticks[nply::stats_t::PHASE_HANDLER] > 0);
+
+            nply::stats_t total = *stats;
+            nply::add_stats(total, *stats);
+            CHECK_EQUAL(2 * stats->m_items_decoded, total.m_items_decoded);
+            CHECK_EQUAL(2 * stats->m_ticks[nply::stats_t::PHASE_IO], total.m_ticks[nply::stats_t::PHASE_IO]);
+
+            nply::reset_stats(ply);
+            CHECK_EQUAL(0, stats->m_bytes_read);
+            nply::enable_stats(ply, nullptr);
+            CHECK_NULL(nply::get_stats(ply));
         }
+
+        static bool read_text(const char* text, nply::error_t& error)
+        {
+            nply::ply_t* ply = nply::create(sAllocator);
+            reader_test  reader(text, text_length(text));
+            bool         ok = nply::read_header(ply, &reader);
+            if (ok)
+            {
+                nply::vertex_t           vertices[4];
+                nply::vertices_handler_t handler(vertices, 4);
+                ok = nply::read_data(ply, &reader, &handler, nullptr);
+            }
+            error = nply::get_error(ply);
+            return ok;
+        }
+
+        UNITTEST_TEST(header_errors)
+        {
+            sAllocator->reset();
+            nply::error_t error;
+
+            CHECK_TRUE(read_text("ply\nformat ascii 1.0\nelement vertex 1\nproperty float x\nend_header\n1\n", error));
+            CHECK_EQUAL(nply::ERROR_NONE, error.m_kind);
+
+            CHECK_FALSE(read_text("solid cube\n", error));
+            CHECK_EQUAL(nply::ERROR_NOT_PLY, error.m_kind);
+            CHECK_FALSE(read_text("ply\nformat binary_middle_endian 1.0\n", error));
+            CHECK_EQUAL(nply::ERROR_FORMAT, error.m_kind);
+            CHECK_EQUAL(4, error.m_offset);
+            CHECK_FALSE(read_text("ply\nformat ascii 1.0\nelement vertex 1\nproperty quad x\nend_header\n", error));
+            CHECK_EQUAL(nply::ERROR_TYPE, error.m_kind);
+            CHECK_EQUAL(38, error.m_offset);
+            CHECK_EQUAL(-1, error.m_element);
+            CHECK_FALSE(read_text("ply\nformat ascii 1.0\nproperty float x\nend_header\n", error));
+            CHECK_EQUAL(nply::ERROR_HEADER, error.m_kind);
+            CHECK_FALSE(read_text("ply\nformat ascii 1.0\nelement vertex 1\nproperty float x\n", error));
+            CHECK_EQUAL(nply::ERROR_TRUNCATED, error.m_kind);
+            CHECK_EQUAL(0, text_compare("truncated file", nply::get_error_name(error.m_kind)));
+        }
+
+        UNITTEST_TEST(data_errors)
+        {
+            sAllocator->reset();
+            nply::error_t error;
+
+            // the second vertex is missing 'y', the third vertex is missing
+            CHECK_FALSE(read_text("ply\nformat ascii 1.0\nelement vertex 3\nproperty float x\nproperty float y\nend_header\n1 2\n3\n", error));
+            CHECK_EQUAL(nply::ERROR_VALUE, error.m_kind);
+            CHECK_EQUAL(0, error.m_element);
+            CHECK_EQUAL(1, error.m_record);
+            CHECK_FALSE(read_text("ply\nformat ascii 1.0\nelement vertex 3\nproperty float x\nproperty float y\nend_header\n1 2\n3 x\n", error));
+            CHECK_EQUAL(nply::ERROR_VALUE, error.m_kind);
+            CHECK_FALSE(read_text("ply\nformat ascii 1.0\nelement vertex 3\nproperty float x\nproperty float y\nend_header\n1 2\n3 4\n", error));
+            CHECK_EQUAL(nply::ERROR_TRUNCATED, error.m_kind);
+            CHECK_EQUAL(2, error.m_record);
+
+            // a binary file that ends in the middle of the faces
+            u8* data = (u8*)sAllocator->alloc(4096);
+            u8* dst  = append(data, "ply\nformat binary_little_endian 1.0\nelement vertex 4\nproperty float x\nproperty float y\nproperty float z\n"
+                                    "element face 2\nproperty list uchar int vertex_indices\nend_header\n");
+            u64 const body = (u64)(dst - data);
+            for (s32 v = 0; v < 12; ++v)
+                dst = append<f32>(dst, (f32)v, false);
+            dst = append<u8>(dst, 3, false);
+            for (s32 i = 0; i < 3; ++i)
+                dst = append<s32>(dst, i, false);
+            dst = append<u8>(dst, 3, false);
+            dst = append<s32>(dst, 1, false);
+
+            nply::ply_t* ply = nply::create(sAllocator);
+            reader_test  reader((const char*)data, (u32)(dst - data));
+            CHECK_TRUE(nply::read_header(ply, &reader));
+            nply::vertex_t            vertices[4];
+            nply::vertices_handler_t  vertices_handler(vertices, 4);
+            nply::triangle_t          triangles[2];
+            nply::triangles_handler_t triangles_handler(triangles, 2);
+            CHECK_FALSE(nply::read_data(ply, &reader, &vertices_handler, &triangles_handler));
+            nply::error_t const& e = nply::get_error(ply);
+            CHECK_EQUAL(nply::ERROR_TRUNCATED, e.m_kind);
+            CHECK_EQUAL(1, e.m_element);
+            CHECK_EQUAL(1, e.m_record);
+            CHECK_EQUAL(body + 12 * 4 + 13 + 1, e.m_offset);
+        }
+
+        UNITTEST_TEST(crlf_offsets)
+        {
+            sAllocator->reset();
+            nply::error_t error;
+
+            // every "\r\n" counts as two bytes, in the header and in an ASCII body
+            CHECK_FALSE(read_text("ply\r\nformat binary_middle_endian 1.0\r\n", error));
+            CHECK_EQUAL(nply::ERROR_FORMAT, error.m_kind);
+            CHECK_EQUAL(5, error.m_offset);
+            CHECK_FALSE(read_text("ply\r\nformat ascii 1.0\r\nelement vertex 2\r\nproperty float x\r\nend_header\r\n1\r\nx\r\n", error));
+            CHECK_EQUAL(nply::ERROR_VALUE, error.m_kind);
+            CHECK_EQUAL(1, error.m_record);
+            CHECK_EQUAL(77, error.m_offset);
+
+            // a binary body behind a CRLF header, the records are read in blocks so the error is at the body
+            u8* data = (u8*)sAllocator->alloc(4096);
+            u8* dst  = append(data, "ply\r\nformat binary_little_endian 1.0\r\nelement vertex 2\r\nproperty float x\r\nproperty float y\r\nproperty float z\r\nend_header\r\n");
+            u64 const body = (u64)(dst - data);
+            for (s32 v = 0; v < 4; ++v)
+                dst = append<f32>(dst, (f32)v, false);
+
+            nply::ply_t* ply = nply::create(sAllocator);
+            reader_test  reader((const char*)data, (u32)(dst - data));
+            CHECK_TRUE(nply::read_header(ply, &reader));
+            nply::vertex_t           vertices[2];
+            nply::vertices_handler_t vertices_handler(vertices, 2);
+            CHECK_FALSE(nply::read_data(ply, &reader, &vertices_handler, nullptr));
+            nply::error_t const& e = nply::get_error(ply);
+            CHECK_EQUAL(nply::ERROR_TRUNCATED, e.m_kind);
+            CHECK_EQUAL(0, e.m_record);
+            CHECK_EQUAL(body, e.m_offset);
+
+            nply::info_t info;
+            CHECK_TRUE(nply::probe(sAllocator, data, (u64)(dst - data), info));
+            CHECK_EQUAL(body, nply::get_body_offset(info));
+        }
+
+        UNITTEST_TEST(ascii_tokens)
+        {
+            sAllocator->reset();
+
+            // lines and tokens longer than a 16 byte block, on both sides of the block boundaries
+            const char* lines = "a line of text that is longer than 32 bytes\r\nshort\n\nlast line without end";
+            const char* end   = lines + text_length(lines);
+            const char* str;
+            const char* str_end;
+            const char* cursor = nply::g_ReadLine(lines, end, str, str_end);
+            CHECK_EQUAL(43, (s32)(str_end - str));
+            CHECK_EQUAL(45, (s32)(cursor - lines));
+            cursor = nply::g_ReadLine(cursor, end, str, str_end);
+            CHECK_EQUAL(5, (s32)(str_end - str));
+            cursor = nply::g_ReadLine(cursor, end, str, str_end);
+            CHECK_EQUAL(0, (s32)(str_end - str));
+            cursor = nply::g_ReadLine(cursor, end, str, str_end);
+            CHECK_EQUAL(21, (s32)(str_end - str));
+            CHECK_TRUE(cursor == end);
+
+            const char* text = "ply\nformat ascii 1.0\nelement   vertex\t2\nproperty float x\nproperty float y\nproperty list uchar float extra\nproperty float z\nend_header\r\n"
+                               "   1.25\t\t  -2.5       3 0.1 0.2 0.3          1000.0625   \r\n"
+                               "\t7 8 0 9\n";
+            nply::ply_t* ply = nply::create(sAllocator);
+            reader_test  reader(text, text_length(text));
+            CHECK_TRUE(nply::read_header(ply, &reader));
+            CHECK_EQUAL(2, nply::get_element_count(ply, "vertex"));
+            const char* xyz[3] = {"x", "y", "z"};
+            CHECK_TRUE(nply::select_properties(ply, "vertex", xyz, 3));
+
+            nply::vertex_t           vertices[2];
+            nply::vertices_handler_t handler(vertices, 2);
+            CHECK_TRUE(nply::read_data(ply, &reader, &handler, nullptr));
+            CHECK_EQUAL(2, handler.m_vertex_count);
+            CHECK_EQUAL(1.25f, vertices[0].x);
+            CHECK_EQUAL(-2.5f, vertices[0].y);
+            CHECK_EQUAL(1000.0625f, vertices[0].z);
+            CHECK_EQUAL(7.0f, vertices[1].x);
+            CHECK_EQUAL(8.0f, vertices[1].y);
+            CHECK_EQUAL(9.0f, vertices[1].z);
+
+            // a list that claims more items than the line has
+            nply::error_t error;
+            CHECK_FALSE(read_text("ply\nformat ascii 1.0\nelement vertex 1\nproperty float x\nproperty list uchar float extra\nend_header\n1 4 1 2 3\n", error));
+            CHECK_EQUAL(nply::ERROR_VALUE, error.m_kind);
+        }
+
+        UNITTEST_TEST(polygon_faces)
+        {
+            sAllocator->reset();
+
+            // a quad is split into two triangles, a face with two indices is skipped
+            const char* text = "ply\nformat ascii 1.0\nelement vertex 5\nproperty float x\nproperty float y\nproperty float z\n"
+                               "element face 3\nproperty list uchar int vertex_indices\nend_header\n"
+                               "0 0 0\n1 0 0\n1 1 0\n0 1 0\n2 2 0\n"
+                               "4 0 1 2 3\n2 3 4\n3 2 4 3\n";
+            nply::ply_t* ply = nply::create(sAllocator);
+            reader_test  reader(text, text_length(text));
+            CHECK_TRUE(nply::read_header(ply, &reader));
+
+            nply::vertex_t            vertices[5];
+            nply::vertices_handler_t  vertices_handler(vertices, 5);
+            nply::triangle_t          triangles[4];
+            nply::triangles_handler_t triangles_handler(triangles, 4);
+            CHECK_TRUE(nply::read_data(ply, &reader, &vertices_handler, &triangles_handler));
+            CHECK_EQUAL(3, triangles_handler.m_triangle_count);
+            u32 const expected[3][3] = {{0, 1, 2}, {0, 2, 3}, {2, 4, 3}};
+            for (s32 i = 0; i < 3; ++i)
+            {
+                CHECK_EQUAL(expected[i][0], triangles[i].v1);
+                CHECK_EQUAL(expected[i][1], triangles[i].v2);
+                CHECK_EQUAL(expected[i][2], triangles[i].v3);
+            }
+        }
+
+        UNITTEST_TEST(ascii_non_finite)
+        {
+            sAllocator->reset();
+
+            const char* text = "ply\nformat ascii 1.0\nelement vertex 2\nproperty float x\nproperty float y\nproperty float z\nend_header\n"
+                               "nan Inf -infinity\n1 2 3\n";
+            for (s32 pass = 0; pass < 2; ++pass)
+            {
+                nply::ply_t* ply = nply::create(sAllocator);
+                reader_test  reader(text, text_length(text));
+                CHECK_TRUE(nply::read_header(ply, &reader));
+                nply::set_validation(ply, pass == 0 ? nply::VALIDATE_NONE : nply::VALIDATE_FINITE);
+                nply::vertex_t           vertices[2];
+                nply::vertices_handler_t handler(vertices, 2);
+                bool const               ok = nply::read_data(ply, &reader, &handler, nullptr);
+                if (pass == 0)
+                {
+                    CHECK_TRUE(ok);
+                    CHECK_TRUE(vertices[0].x != vertices[0].x);
+                    CHECK_TRUE(vertices[0].y > 1e38f);
+                    CHECK_TRUE(vertices[0].z < -1e38f);
+                    CHECK_EQUAL(3.0f, vertices[1].z);
+                }
+                else
+                {
+                    CHECK_FALSE(ok);
+                    CHECK_EQUAL(nply::ERROR_NOT_FINITE, nply::get_error(ply).m_kind);
+                    CHECK_EQUAL(0, nply::get_error(ply).m_record);
+                }
+            }
+
+            // only float properties take the words
+            nply::error_t error;
+            CHECK_FALSE(read_text("ply\nformat ascii 1.0\nelement vertex 1\nproperty float x\nproperty int i\nend_header\n1 nan\n", error));
+            CHECK_EQUAL(nply::ERROR_VALUE, error.m_kind);
+            CHECK_FALSE(read_text("ply\nformat ascii 1.0\nelement vertex 1\nproperty float x\nend_header\nnano\n", error));
+            CHECK_EQUAL(nply::ERROR_VALUE, error.m_kind);
+        }
+
+        static u8* append_body(u8* dst, f32 nan_at, s32 index_at, s32 bad_index)
+        {
+            for (s32 v = 0; v < 100; ++v)
+            {
+                for (s32 p = 0; p < 3; ++p)
+                    dst = append<f32>(dst, v == 37 && p == 1 ? nan_at : (f32)v, false);
+            }
+            for (s32 f = 0; f < 50; ++f)
+            {
+                dst = append<u8>(dst, 6, false);
+                for (s32 i = 0; i < 6; ++i)
+                    dst = append<s32>(dst, f == index_at && i == 4 ? bad_index : f + i, false);
+            }
+            return dst;
+        }
+
+        static bool validate(u8* data, u8* end, u32 flags, nply::error_t& error)
+        {
+            nply::ply_t* ply = nply::create(sAllocator);
+            reader_test  reader((const char*)data, (u32)(end - data));
+            CHECK_TRUE(nply::read_header(ply, &reader));
+            nply::set_validation(ply, flags);
+            nply::vertex_t           vertices[100];
+            nply::vertices_handler_t vertices_handler(vertices, 100);
+            faces_test               faces;
+            bool const               ok = nply::read_data(ply, &reader, &vertices_handler, &faces);
+            error                       = nply::get_error(ply);
+            return ok;
+        }
+
+        UNITTEST_TEST(validation)
+        {
+            sAllocator->reset();
+
+            const char* header = "ply\nformat binary_little_endian 1.0\nelement vertex 100\nproperty float x\nproperty float y\nproperty float z\n"
+                                 "element face 50\nproperty list uchar int vertex_indices\nend_header\n";
+            u8*         data   = (u8*)sAllocator->alloc(8192);
+            u8*         body   = append(data, header);
+
+            f32 const     inf = 1e30f * 1e30f;
+            nply::error_t error;
+
+            u8* end = append_body(body, 1.0f, -1, 0);
+            CHECK_TRUE(validate(data, end, nply::VALIDATE_INDICES | nply::VALIDATE_FINITE, error));
+
+            end = append_body(body, inf, -1, 0);
+            CHECK_TRUE(validate(data, end, nply::VALIDATE_NONE, error));
+            CHECK_FALSE(validate(data, end, nply::VALIDATE_FINITE, error));
+            CHECK_EQUAL(nply::ERROR_NOT_FINITE, error.m_kind);
+            CHECK_EQUAL(0, error.m_element);
+            CHECK_EQUAL(37, error.m_record);
+
+            end = append_body(body, 1.0f, 21, 100);
+            CHECK_TRUE(validate(data, end, nply::VALIDATE_FINITE, error));
+            CHECK_FALSE(validate(data, end, nply::VALIDATE_INDICES, error));
+            CHECK_EQUAL(nply::ERROR_INDEX, error.m_kind);
+            CHECK_EQUAL(1, error.m_element);
+            CHECK_EQUAL(21, error.m_record);
+
+            end = append_body(body, 1.0f, 3, -1);
+            CHECK_FALSE(validate(data, end, nply::VALIDATE_INDICES, error));
+            CHECK_EQUAL(3, error.m_record);
+
+            // no vertices, every index of the face is out of range (4 of them, a full SIMD group)
+            end = append(data, "ply\nformat binary_little_endian 1.0\nelement vertex 0\nproperty float x\nproperty float y\nproperty float z\n"
+                               "element face 1\nproperty list uchar int vertex_indices\nend_header\n");
+            end = append<u8>(end, 4, false);
+            for (s32 i = 0; i < 4; ++i)
+                end = append<s32>(end, 0, false);
+            CHECK_TRUE(validate(data, end, nply::VALIDATE_NONE, error));
+            CHECK_FALSE(validate(data, end, nply::VALIDATE_INDICES, error));
+            CHECK_EQUAL(nply::ERROR_INDEX, error.m_kind);
+            CHECK_EQUAL(1, error.m_element);
+            CHECK_EQUAL(0, error.m_record);
+        }
+
+        UNITTEST_TEST(validation_delivery)
+        {
+            sAllocator->reset();
+
+            // the handlers receive the records before the failing one and nothing after it
+            u8* data = (u8*)sAllocator->alloc(8192);
+            u8* end  = append(data, "ply\nformat binary_little_endian 1.0\nelement vertex 100\nproperty float x\nproperty float y\nproperty float z\n"
+                                    "element face 50\nproperty list uchar int vertex_indices\nend_header\n");
+            end      = append_body(end, 1e30f * 1e30f, -1, 0);
+
+            nply::ply_t* ply = nply::create(sAllocator);
+            reader_test  reader((const char*)data, (u32)(end - data));
+            CHECK_TRUE(nply::read_header(ply, &reader));
+            nply::set_validation(ply, nply::VALIDATE_FINITE);
+            nply::vertex_t           vertices[100];
+            nply::vertices_handler_t vertices_handler(vertices, 100);
+            CHECK_FALSE(nply::read_data(ply, &reader, &vertices_handler, nullptr));
+            CHECK_EQUAL(37, nply::get_error(ply).m_record);
+            CHECK_EQUAL(37, vertices_handler.m_vertex_count);
+            CHECK_EQUAL(36.0f, vertices[36].x);
+        }
+
+        UNITTEST_TEST(read_records_offsets)
+        {
+            sAllocator->reset();
+
+            // the vertices follow the faces (variable-size records) in the first file and not in the second
+            for (s32 pass = 0; pass < 2; ++pass)
+            {
+                u8* data = (u8*)sAllocator->alloc(4096);
+                u8* end  = append(data, pass == 0 ? "ply\nformat binary_little_endian 1.0\nelement face 1\nproperty list uchar int vertex_indices\n"
+                                                    "element vertex 4\nproperty float x\nproperty float y\nproperty float z\nend_header\n"
+                                                  : "ply\nformat binary_little_endian 1.0\nelement vertex 4\nproperty float x\nproperty float y\nproperty float z\n"
+                                                    "element face 1\nproperty list uchar int vertex_indices\nend_header\n");
+                u64 const body = (u64)(end - data);
+
+                nply::ply_t* ply = nply::create(sAllocator);
+                reader_test  header((const char*)data, (u32)body);
+                CHECK_TRUE(nply::read_header(ply, &header));
+
+                // records 2 and 3, the reader only holds one and a half of them
+                f32 const                records[6] = {6.0f, 7.0f, 8.0f, 9.0f, 10.0f, 11.0f};
+                reader_test              reader((const char*)records, 18);
+                nply::vertex_t           vertices[4];
+                nply::vertices_handler_t vertices_handler(vertices, 4);
+                CHECK_FALSE(nply::read_records(ply, "vertex", 2, 2, &reader, &vertices_handler));
+                nply::error_t const& e = nply::get_error(ply);
+                CHECK_EQUAL(nply::ERROR_TRUNCATED, e.m_kind);
+                if (pass == 0)
+                    CHECK_EQUAL(nply::c_offset_unknown, e.m_offset);
+                else
+                    CHECK_EQUAL(body + 2 * 12, e.m_offset);
+            }
+        }
+
+        UNITTEST_TEST(binary_little_endian_selected_properties) { sAllocator->reset(); check_binary(false); }
+
+        UNITTEST_TEST(binary_big_endian_selected_properties) { sAllocator->reset(); check_binary(true); }
     }
 }
 UNITTEST_SUITE_END
@@ -0,0 +1,162 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_ply_layout.h"
+#include "c3dff/c_synthetic.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+#include <stddef.h>
+
+using namespace ncore;
+
+struct point_t
+{
+    f32 x, y, z;
+    u8  r, g, b;
+};
+
+typedef nply::layout_t<point_t, nply::field_t<f32, offsetof(point_t, x)>, nply::field_t<f32, offsetof(point_t, y)>, nply::field_t<f32, offsetof(point_t, z)>, nply::field_t<u8, offsetof(point_t, r)>, nply::field_t<u8, offsetof(point_t, g)>,
+                       nply::field_t<u8, offsetof(point_t, b)> >
+  point_layout_t;
+
+UNITTEST_SUITE_BEGIN(ply_layout)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_layout_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_layout_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        // Returns true when the specialized loop was used
+        static bool load(nsynthetic::config_t const& config, point_t* points)
+        {
+            u64 const   size = 1024 * 1024;
+            u8*         data = (u8*)sAllocator->alloc(size);
+            test_writer writer(data, size);
+            CHECK_TRUE(nsynthetic::generate(config, &writer));
+
+            nply::memory_reader_t reader(data, writer.m_used);
+            nply::ply_t*          ply = nply::create(sAllocator);
+            CHECK_TRUE(nply::read_header(ply, &reader));
+
+            nply::records_handler_t<point_layout_t> handler(nply::INDEX_VERTEX, points, config.m_vertex_count);
+            CHECK_TRUE(nply::read_data(ply, &reader, &handler, nullptr));
+            CHECK_EQUAL(config.m_vertex_count, handler.m_record_count);
+            CHECK_EQUAL(reader.m_end, reader.m_cursor);
+            return handler.m_specialized;
+        }
+
+        UNITTEST_TEST(layout)
+        {
+            CHECK_EQUAL(6, point_layout_t::COUNT);
+            CHECK_EQUAL(15, point_layout_t::STRIDE);
+            CHECK_EQUAL(nply::TYPE_UINT8, point_layout_t::field_type(4));
+
+            nply::etype types[6]   = {nply::TYPE_FLOAT32, nply::TYPE_FLOAT32, nply::TYPE_FLOAT32, nply::TYPE_UINT8, nply::TYPE_UINT8, nply::TYPE_UINT8};
+            s32         indices[6] = {0, 1, 2, 3, 4, 5};
+            CHECK_TRUE(point_layout_t::match(types, indices, 6));
+            CHECK_FALSE(point_layout_t::match(types, indices, 5));
+            indices[4] = 5;
+            indices[5] = 4;
+            CHECK_FALSE(point_layout_t::match(types, indices, 6));
+            indices[4] = 4;
+            indices[5] = 5;
+            types[0]   = nply::TYPE_FLOAT64;
+            CHECK_FALSE(point_layout_t::match(types, indices, 6));
+        }
+
+        UNITTEST_TEST(specialized_and_generic_decode_the_same)
+        {
+            sAllocator->reset();
+
+            nsynthetic::config_t config;
+            config.m_vertex_count    = 3000;
+            config.m_face_count      = 1000;
+            config.m_attribute_count = 3;
+            config.m_attribute_type  = nply::TYPE_UINT8;
+            config.m_seed            = 11;
+
+            point_t* points[4];
+            for (s32 i = 0; i < 4; ++i)
+                points[i] = (point_t*)sAllocator->alloc(sizeof(point_t) * config.m_vertex_count);
+
+            config.m_format = nply::FORMAT_BLE;
+            CHECK_TRUE(load(config, points[0]));
+            config.m_format = nply::FORMAT_BBE;
+            CHECK_TRUE(load(config, points[1]));
+
+            // doubles do not match the layout, they take the generic path
+            config.m_format        = nply::FORMAT_BLE;
+            config.m_position_type = nply::TYPE_FLOAT64;
+            CHECK_FALSE(load(config, points[2]));
+
+            config.m_format        = nply::FORMAT_ASCII;
+            config.m_position_type = nply::TYPE_FLOAT32;
+            CHECK_FALSE(load(config, points[3]));
+
+            for (u64 v = 0; v < config.m_vertex_count; ++v)
+            {
+                for (s32 i = 1; i < 3; ++i)
+                {
+                    CHECK_EQUAL(points[0][v].x, points[i][v].x);
+                    CHECK_EQUAL(points[0][v].y, points[i][v].y);
+                    CHECK_EQUAL(points[0][v].z, points[i][v].z);
+                    CHECK_EQUAL(points[0][v].r, points[i][v].r);
+                    CHECK_EQUAL(points[0][v].g, points[i][v].g);
+                    CHECK_EQUAL(points[0][v].b, points[i][v].b);
+                }
+                CHECK_TRUE(points[3][v].x - points[0][v].x < 0.001f && points[0][v].x - points[3][v].x < 0.001f);
+                CHECK_EQUAL(points[0][v].b, points[3][v].b);
+            }
+        }
+
+        UNITTEST_TEST(generic_values_out_of_range)
+        {
+            sAllocator->reset();
+
+            // values that do not fit the field are clamped, NaN is 0 for integer fields
+            const char* text = "ply\nformat ascii 1.0\nelement vertex 2\nproperty double x\nproperty double y\nproperty float z\n"
+                               "property int red\nproperty double green\nproperty short blue\nend_header\n"
+                               "1e300 -1e300 inf 300 nan 200\n-2.5 5 -inf -5 1e20 -1\n";
+            u64 size = 0;
+            while (text[size] != 0)
+                size++;
+
+            nply::memory_reader_t reader((const u8*)text, size);
+            nply::ply_t*          ply = nply::create(sAllocator);
+            CHECK_TRUE(nply::read_header(ply, &reader));
+
+            point_t                                 points[2];
+            nply::records_handler_t<point_layout_t> handler(nply::INDEX_VERTEX, points, 2);
+            CHECK_TRUE(nply::read_data(ply, &reader, &handler, nullptr));
+            CHECK_FALSE(handler.m_specialized);
+            CHECK_EQUAL(2, handler.m_record_count);
+
+            f32 const max = 3.40282346638528859812e+38f;
+            f32 const inf = 1e30f * 1e30f;
+            CHECK_EQUAL(max, points[0].x);
+            CHECK_EQUAL(-max, points[0].y);
+            CHECK_EQUAL(inf, points[0].z);
+            CHECK_EQUAL(255, points[0].r);
+            CHECK_EQUAL(0, points[0].g);
+            CHECK_EQUAL(200, points[0].b);
+            CHECK_EQUAL(-2.5f, points[1].x);
+            CHECK_EQUAL(5.0f, points[1].y);
+            CHECK_EQUAL(-inf, points[1].z);
+            CHECK_EQUAL(0, points[1].r);
+            CHECK_EQUAL(255, points[1].g);
+            CHECK_EQUAL(0, points[1].b);
+        }
+    }
+}
+UNITTEST_SUITE_END
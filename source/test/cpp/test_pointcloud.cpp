@@ -0,0 +1,208 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_pointcloud.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(pointcloud)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_pc_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_pc_allocator;
+            sAllocator->init(Allocator, 8 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        UNITTEST_TEST(downsample_through_handler)
+        {
+            sAllocator->reset();
+
+            // vertex layout: float x, float y, float z, uchar red
+            nply::etype property_types[4]   = {nply::TYPE_FLOAT32, nply::TYPE_FLOAT32, nply::TYPE_FLOAT32, nply::TYPE_UINT8};
+            s32         property_indices[4] = {0, 1, 2, 3};
+
+            npointcloud::voxel_grid_handler_t handler(sAllocator, 1.0f, 1, 16);
+            CHECK_TRUE(handler.setup(nply::INDEX_VERTEX, 400, property_types, property_indices, 4));
+            CHECK_FALSE(handler.setup(nply::INDEX_FACE, 0, property_types, property_indices, 4));
+
+            // 100 points in each of 4 voxels
+            u8 record[13];
+            for (s32 i = 0; i < 400; ++i)
+            {
+                f32 const p[3] = {(f32)(i % 4) * 2.0f + 0.25f + (f32)(i % 10) * 0.05f, 0.5f, 0.5f};
+                u8 const* src  = (u8 const*)p;
+                for (s32 b = 0; b < 12; ++b)
+                    record[b] = src[b];
+                record[12] = ((i / 4) & 1) ? 100 : 200;
+                handler.read(nply::INDEX_VERTEX, property_types, 4, record);
+            }
+
+            CHECK_EQUAL(400, handler.get_input_count());
+            CHECK_EQUAL(4, handler.get_point_count());
+
+            nply::vertex_t positions[4];
+            f32            colors[4];
+            CHECK_EQUAL(4, handler.get_points(positions, colors, 4));
+            for (s32 i = 0; i < 4; ++i)
+            {
+                CHECK_CLOSE(0.5f, positions[i].y, 0.0001f);
+                CHECK_CLOSE(150.0f, colors[i], 0.01f);
+            }
+        }
+
+        UNITTEST_TEST(unaligned_and_non_finite)
+        {
+            sAllocator->reset();
+
+            // vertex layout: uchar red, float x, float y, float z, the floats are not aligned
+            nply::etype property_types[4]   = {nply::TYPE_UINT8, nply::TYPE_FLOAT32, nply::TYPE_FLOAT32, nply::TYPE_FLOAT32};
+            s32         property_indices[4] = {3, 0, 1, 2};
+
+            npointcloud::voxel_grid_handler_t handler(sAllocator, 1.0f, 1, 16);
+            CHECK_TRUE(handler.setup(nply::INDEX_VERTEX, 4, property_types, property_indices, 4));
+
+            // a point far outside of the grid is clamped to its border, NaN and Inf are skipped
+            f32 const inf          = 1e30f * 1e30f;
+            f32 const points[4][3] = {{0.5f, 1.5f, 2.5f}, {0.5f, -2e30f, 2e30f}, {inf - inf, 1.5f, 2.5f}, {0.5f, 1.5f, inf}};
+
+            u8 record[13];
+            for (s32 i = 0; i < 4; ++i)
+            {
+                u8 const* src = (u8 const*)points[i];
+                record[0]     = 10;
+                for (s32 b = 0; b < 12; ++b)
+                    record[1 + b] = src[b];
+                handler.read(nply::INDEX_VERTEX, property_types, 4, record);
+            }
+
+            CHECK_EQUAL(4, handler.get_input_count());
+            CHECK_EQUAL(2, handler.get_point_count());
+            nply::vertex_t positions[2];
+            f32            colors[2];
+            CHECK_EQUAL(2, handler.get_points(positions, colors, 2));
+            s32 found = 0;
+            for (s32 i = 0; i < 2; ++i)
+            {
+                CHECK_EQUAL(10.0f, colors[i]);
+                if (positions[i].y == 1.5f && positions[i].z == 2.5f)
+                    found++;
+            }
+            CHECK_EQUAL(1, found);
+        }
+
+        UNITTEST_TEST(remove_outliers)
+        {
+            sAllocator->reset();
+
+            npointcloud::voxel_grid_handler_t handler(sAllocator, 0.1f);
+
+            // a dense 10x10 sheet of voxels and one point far away
+            for (s32 y = 0; y < 10; ++y)
+                for (s32 x = 0; x < 10; ++x)
+                    handler.insert((f32)x * 0.1f + 0.05f, (f32)y * 0.1f + 0.05f, 0.05f, nullptr);
+            handler.insert(0.55f, 0.55f, 0.35f, nullptr);
+            CHECK_EQUAL(101, handler.get_point_count());
+
+            CHECK_EQUAL(1, handler.remove_outliers(4, 5.0f, 2));
+            CHECK_EQUAL(100, handler.get_point_count());
+
+            nply::vertex_t positions[100];
+            CHECK_EQUAL(100, handler.get_points(positions, nullptr, 100));
+            for (s32 i = 0; i < 100; ++i)
+                CHECK_CLOSE(0.05f, positions[i].z, 0.0001f);
+
+            // a point without neighbours is only removed when the threshold is below the search radius
+            handler.insert(0.55f, 0.55f, 0.35f, nullptr);
+            CHECK_EQUAL(0, handler.remove_outliers(4, 20.0f, 2));
+            CHECK_EQUAL(101, handler.get_point_count());
+            CHECK_EQUAL(1, handler.remove_outliers(4, 5.0f, 2));
+
+            // nothing to compare with when no point has neighbours
+            npointcloud::voxel_grid_handler_t sparse(sAllocator, 0.1f);
+            sparse.insert(0.05f, 0.05f, 0.05f, nullptr);
+            sparse.insert(5.05f, 0.05f, 0.05f, nullptr);
+            CHECK_EQUAL(0, sparse.remove_outliers(4, 1.0f, 2));
+        }
+
+        UNITTEST_TEST(release_and_reinsert)
+        {
+            sAllocator->reset();
+            counting_allocator allocator(sAllocator, 1000);
+
+            npointcloud::voxel_grid_handler_t handler(&allocator, 0.1f, 1, 16);
+            f32 const                         red = 1.0f;
+            for (s32 y = 0; y < 10; ++y)
+                for (s32 x = 0; x < 10; ++x)
+                    handler.insert((f32)x * 0.1f + 0.05f, (f32)y * 0.1f + 0.05f, 0.05f, &red);
+            handler.insert(0.51f, 0.51f, 0.31f, &red);
+            s64 const live = allocator.m_live;
+            CHECK_EQUAL(1, handler.remove_outliers(4, 5.0f, 2));
+            CHECK_EQUAL(live, allocator.m_live);
+
+            // the removed voxel starts over instead of averaging with its old points
+            f32 const blue = 3.0f;
+            CHECK_TRUE(handler.insert(0.59f, 0.59f, 0.39f, &blue));
+            CHECK_EQUAL(101, handler.get_point_count());
+            nply::vertex_t positions[101];
+            f32            colors[101];
+            CHECK_EQUAL(101, handler.get_points(positions, colors, 101));
+            s32 found = 0;
+            for (s32 i = 0; i < 101; ++i)
+            {
+                if (positions[i].z > 0.2f)
+                {
+                    CHECK_CLOSE(0.39f, positions[i].z, 0.0001f);
+                    CHECK_CLOSE(0.59f, positions[i].x, 0.0001f);
+                    CHECK_EQUAL(3.0f, colors[i]);
+                    found++;
+                }
+            }
+            CHECK_EQUAL(1, found);
+
+            handler.release();
+            CHECK_EQUAL(0, allocator.m_live);
+            CHECK_EQUAL(0, handler.get_point_count());
+        }
+
+        UNITTEST_TEST(out_of_memory)
+        {
+            sAllocator->reset();
+
+            // no table at all
+            counting_allocator                none(sAllocator, 0);
+            npointcloud::voxel_grid_handler_t empty(&none, 1.0f, 2, 16);
+            CHECK_FALSE(empty.insert(1.0f, 2.0f, 3.0f, nullptr));
+            CHECK_TRUE(empty.out_of_memory());
+            CHECK_EQUAL(0, empty.get_point_count());
+            CHECK_EQUAL(0, empty.remove_outliers(4, 1.0f));
+            nply::vertex_t positions[16];
+            CHECK_EQUAL(0, empty.get_points(positions, nullptr, 16));
+
+            // the first table (3 allocations) holds 8 voxels, growing it fails
+            counting_allocator                three(sAllocator, 3);
+            npointcloud::voxel_grid_handler_t handler(&three, 1.0f, 0, 16);
+            for (s32 i = 0; i < 8; ++i)
+                CHECK_TRUE(handler.insert((f32)i, 0.0f, 0.0f, nullptr));
+            CHECK_FALSE(handler.out_of_memory());
+            CHECK_FALSE(handler.insert(8.0f, 0.0f, 0.0f, nullptr));
+            CHECK_TRUE(handler.out_of_memory());
+            CHECK_EQUAL(8, handler.get_point_count());
+            CHECK_EQUAL(0, handler.remove_outliers(2, 1.0f));
+            CHECK_EQUAL(8, handler.get_points(positions, nullptr, 16));
+            handler.release();
+            CHECK_EQUAL(0, three.m_live);
+        }
+    }
+}
+UNITTEST_SUITE_END
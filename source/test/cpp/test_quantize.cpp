@@ -0,0 +1,232 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_quantize.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(quantize)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_q_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_q_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        static void make_strip(u32 vertex_count, nply::vertex_t*& vertices, nply::triangle_t*& triangles, u32& triangle_count)
+        {
+            vertices       = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * vertex_count);
+            triangle_count = vertex_count - 2;
+            triangles      = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * triangle_count);
+            for (u32 i = 0; i < vertex_count; ++i)
+            {
+                vertices[i].x = (f32)(i / 2) * 0.37f - 100.0f;
+                vertices[i].y = (f32)(i & 1) * 2.5f;
+                vertices[i].z = (f32)((i * 7919) % 1000) * 0.01f;
+            }
+            for (u32 i = 0; i < triangle_count; ++i)
+            {
+                triangles[i].v1 = i;
+                triangles[i].v2 = i + 1;
+                triangles[i].v3 = i + 2;
+            }
+        }
+
+        static void check_roundtrip(u32 vertex_count, nquantize::eindex_format expected_format)
+        {
+            nply::vertex_t*   vertices;
+            nply::triangle_t* triangles;
+            u32               triangle_count;
+            make_strip(vertex_count, vertices, triangles, triangle_count);
+
+            nquantize::compact_mesh_t mesh;
+            CHECK_TRUE(nquantize::encode(sAllocator, vertices, nullptr, vertex_count, triangles, triangle_count, mesh));
+            CHECK_EQUAL(vertex_count, nquantize::get_vertex_count(mesh));
+            CHECK_EQUAL(triangle_count, nquantize::get_triangle_count(mesh));
+            CHECK_EQUAL(expected_format, nquantize::get_index_format(mesh));
+            CHECK_FALSE(nquantize::has_normals(mesh));
+            CHECK_TRUE(mesh.m_size < (sizeof(nply::vertex_t) * vertex_count + sizeof(nply::triangle_t) * triangle_count) / 2);
+
+            nquantize::compact_mesh_t opened;
+            CHECK_TRUE(nquantize::open(mesh.m_data, mesh.m_size, opened));
+
+            n3d::box_t const box    = nquantize::get_bounds(opened);
+            f32 const        max_dx = (box.m_max[0] - box.m_min[0]) / 65535.0f;
+
+            nply::vertex_t* decoded = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * vertex_count);
+            nquantize::decode_positions(opened, decoded);
+            for (u32 i = 0; i < vertex_count; ++i)
+            {
+                CHECK_CLOSE(vertices[i].x, decoded[i].x, max_dx);
+                CHECK_CLOSE(vertices[i].y, decoded[i].y, 2.5f / 65535.0f);
+                CHECK_CLOSE(vertices[i].z, decoded[i].z, 10.0f / 65535.0f);
+            }
+            nply::vertex_t const p = nquantize::get_position(opened, vertex_count / 2);
+            CHECK_EQUAL(decoded[vertex_count / 2].x, p.x);
+
+            nply::triangle_t* decoded_triangles = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * triangle_count);
+            CHECK_TRUE(nquantize::decode_indices(opened, decoded_triangles));
+            for (u32 i = 0; i < triangle_count; ++i)
+            {
+                CHECK_EQUAL(triangles[i].v1, decoded_triangles[i].v1);
+                CHECK_EQUAL(triangles[i].v2, decoded_triangles[i].v2);
+                CHECK_EQUAL(triangles[i].v3, decoded_triangles[i].v3);
+            }
+        }
+
+        UNITTEST_TEST(small_mesh)
+        {
+            sAllocator->reset();
+            check_roundtrip(1001, nquantize::INDEX_FORMAT_VARINT); // strips delta-code to 1 byte per index
+        }
+
+        UNITTEST_TEST(large_mesh)
+        {
+            sAllocator->reset();
+            check_roundtrip(100003, nquantize::INDEX_FORMAT_VARINT);
+        }
+
+        UNITTEST_TEST(u16_indices)
+        {
+            sAllocator->reset();
+
+            // Large jumps between indices do not delta-code well
+            u32 const       vertex_count = 60000;
+            nply::vertex_t* vertices     = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * vertex_count);
+            for (u32 i = 0; i < vertex_count; ++i)
+            {
+                vertices[i].x = (f32)i;
+                vertices[i].y = 0.0f;
+                vertices[i].z = 0.0f;
+            }
+            nply::triangle_t          triangles[2] = {{0, 50000, 10}, {40000, 5, 59999}};
+            nquantize::compact_mesh_t mesh;
+            CHECK_TRUE(nquantize::encode(sAllocator, vertices, nullptr, vertex_count, triangles, 2, mesh));
+            CHECK_EQUAL(nquantize::INDEX_FORMAT_U16, nquantize::get_index_format(mesh));
+            nply::triangle_t decoded[2];
+            CHECK_TRUE(nquantize::decode_indices(mesh, decoded));
+            CHECK_EQUAL(50000, decoded[0].v2);
+            CHECK_EQUAL(40000, decoded[1].v1);
+            CHECK_EQUAL(59999, decoded[1].v3);
+
+            nply::triangle_t bad = {0, 1, vertex_count};
+            CHECK_FALSE(nquantize::encode(sAllocator, vertices, nullptr, vertex_count, &bad, 1, mesh));
+        }
+
+        // Header fields that the corruption test patches (see the layout in c_quantize.cpp)
+        static const u32 c_indices_offset = 64;
+        static const u32 c_indices_size   = 72;
+
+        static void patch_u64(u8* image, u32 offset, u64 value)
+        {
+            u8 const* src = (u8 const*)&value;
+            for (u32 i = 0; i < 8; ++i)
+                image[offset + i] = src[i];
+        }
+
+        static void patch_u16(u8* image, u64 offset, u16 value)
+        {
+            image[offset + 0] = (u8)value;
+            image[offset + 1] = (u8)(value >> 8);
+        }
+
+        static u64 read_u64(u8 const* image, u32 offset)
+        {
+            u64 value = 0;
+            for (u32 i = 0; i < 8; ++i)
+                value |= (u64)image[offset + i] << (i * 8);
+            return value;
+        }
+
+        UNITTEST_TEST(corrupt_images)
+        {
+            sAllocator->reset();
+
+            // large jumps between the indices make u16 the smaller format
+            nply::vertex_t*   vertices;
+            nply::triangle_t* triangles;
+            u32               triangle_count;
+            u32 const         vertex_count = 60000;
+            make_strip(vertex_count, vertices, triangles, triangle_count);
+            triangle_count = 10;
+            for (u32 i = 0; i < triangle_count; ++i)
+            {
+                triangles[i].v1 = (i * 3 + 0) * 20011 % vertex_count;
+                triangles[i].v2 = (i * 3 + 1) * 20011 % vertex_count;
+                triangles[i].v3 = (i * 3 + 2) * 20011 % vertex_count;
+            }
+            nquantize::compact_mesh_t mesh;
+            CHECK_TRUE(nquantize::encode(sAllocator, vertices, nullptr, vertex_count, triangles, triangle_count, mesh));
+            CHECK_EQUAL(nquantize::INDEX_FORMAT_U16, nquantize::get_index_format(mesh));
+
+            u8* image = (u8*)sAllocator->alloc(mesh.m_size, 8);
+            for (u64 i = 0; i < mesh.m_size; ++i)
+                image[i] = mesh.m_data[i];
+            u64 const indices_offset = read_u64(image, c_indices_offset);
+            u64 const indices_size   = read_u64(image, c_indices_size);
+
+            nquantize::compact_mesh_t opened;
+            CHECK_TRUE(nquantize::open(image, mesh.m_size, opened));
+
+            // fewer index bytes than the triangles need
+            patch_u64(image, c_indices_size, indices_size - 2);
+            CHECK_FALSE(nquantize::open(image, mesh.m_size, opened));
+            patch_u64(image, c_indices_size, indices_size);
+
+            // an index block that does not start on a u16, or that wraps around
+            patch_u64(image, c_indices_offset, indices_offset + 1);
+            CHECK_FALSE(nquantize::open(image, mesh.m_size, opened));
+            patch_u64(image, c_indices_offset, ~(u64)1);
+            CHECK_FALSE(nquantize::open(image, mesh.m_size, opened));
+            patch_u64(image, c_indices_offset, indices_offset);
+
+            // an index past the vertices, in the SIMD part and in the tail
+            nply::triangle_t* decoded = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * triangle_count);
+            CHECK_TRUE(nquantize::open(image, mesh.m_size, opened));
+            CHECK_TRUE(nquantize::decode_indices(opened, decoded));
+            patch_u16(image, indices_offset + 2 * 2, (u16)vertex_count);
+            CHECK_FALSE(nquantize::decode_indices(opened, decoded));
+            patch_u16(image, indices_offset + 2 * 2, (u16)triangles[0].v3);
+            patch_u16(image, indices_offset + (triangle_count * 3 - 1) * 2, 0xFFFF); // past the SIMD groups
+            CHECK_FALSE(nquantize::decode_indices(opened, decoded));
+        }
+
+        UNITTEST_TEST(normals)
+        {
+            sAllocator->reset();
+
+            f32 const normals[4 * 3] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.57735f, -0.57735f, 0.57735f, -0.6f, 0.0f, -0.8f};
+            for (s32 i = 0; i < 4; ++i)
+            {
+                u16 u, v;
+                f32 x, y, z;
+                nquantize::oct_encode(normals[i * 3 + 0], normals[i * 3 + 1], normals[i * 3 + 2], u, v);
+                nquantize::oct_decode(u, v, x, y, z);
+                CHECK_CLOSE(normals[i * 3 + 0], x, 0.001f);
+                CHECK_CLOSE(normals[i * 3 + 1], y, 0.001f);
+                CHECK_CLOSE(normals[i * 3 + 2], z, 0.001f);
+            }
+
+            nply::vertex_t            vertices[4] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+            nply::triangle_t          triangle    = {0, 1, 2};
+            nquantize::compact_mesh_t mesh;
+            CHECK_TRUE(nquantize::encode(sAllocator, vertices, normals, 4, &triangle, 1, mesh));
+            CHECK_TRUE(nquantize::has_normals(mesh));
+            f32 decoded[4 * 3];
+            nquantize::decode_normals(mesh, decoded);
+            for (s32 i = 0; i < 12; ++i)
+                CHECK_CLOSE(normals[i], decoded[i], 0.001f);
+        }
+    }
+}
+UNITTEST_SUITE_END
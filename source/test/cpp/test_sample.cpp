@@ -0,0 +1,187 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_sample.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(sample)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_sample_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_sample_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        // Three triangles in the z = 0 plane with areas 1, 3 and 0, the attribute is x + 2y
+        static f32 s_x[7]         = {0.0f, 2.0f, 0.0f, 10.0f, 12.0f, 10.0f, 20.0f};
+        static f32 s_y[7]         = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 3.0f, 0.0f};
+        static f32 s_z[7]         = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        static f32 s_attribute[7] = {0.0f, 2.0f, 2.0f, 10.0f, 12.0f, 16.0f, 20.0f};
+
+        static nply::triangle_t s_triangles[3]  = {{0, 1, 2}, {3, 4, 5}, {6, 6, 4}};
+        static f32 const*       s_attributes[1] = {s_attribute};
+
+        static nsample::mesh_t make_mesh()
+        {
+            nsample::mesh_t mesh;
+            mesh.m_positions.m_x     = s_x;
+            mesh.m_positions.m_y     = s_y;
+            mesh.m_positions.m_z     = s_z;
+            mesh.m_positions.m_count = 7;
+            mesh.m_attributes        = s_attributes;
+            mesh.m_attribute_count   = 1;
+            mesh.m_triangles         = s_triangles;
+            mesh.m_triangle_count    = 3;
+            return mesh;
+        }
+
+        UNITTEST_TEST(alias_table)
+        {
+            sAllocator->reset();
+            nsample::mesh_t const mesh = make_mesh();
+            nsample::table_t      table;
+            CHECK_TRUE(nsample::build(sAllocator, nullptr, mesh, table));
+            CHECK_EQUAL(3, table.m_count);
+            CHECK_TRUE(table.m_area > 3.9999 && table.m_area < 4.0001);
+
+            // the probability of every triangle over all slots is its share of the area
+            f64 const expected[3] = {0.25, 0.75, 0.0};
+            for (u32 t = 0; t < 3; ++t)
+            {
+                f64 p = 0.0;
+                for (u32 s = 0; s < table.m_count; ++s)
+                {
+                    if (s == t)
+                        p += table.m_probability[s] / 3.0;
+                    if (table.m_alias[s] == t && table.m_alias[s] != s)
+                        p += (1.0 - table.m_probability[s]) / 3.0;
+                }
+                CHECK_TRUE(p > expected[t] - 0.00001 && p < expected[t] + 0.00001);
+            }
+
+            nsample::mesh_t flat  = mesh;
+            flat.m_triangles      = s_triangles + 2;
+            flat.m_triangle_count = 1;
+            CHECK_FALSE(nsample::build(sAllocator, nullptr, flat, table));
+        }
+
+        UNITTEST_TEST(points)
+        {
+            sAllocator->reset();
+            nsample::mesh_t const mesh = make_mesh();
+            nsample::table_t      table;
+            CHECK_TRUE(nsample::build(sAllocator, nullptr, mesh, table));
+
+            nsample::config_t config;
+            config.m_seed       = 7;
+            config.m_attributes = true;
+            nsample::points_t points;
+            CHECK_TRUE(nsample::sample(sAllocator, nullptr, mesh, table, 40000, config, points));
+            CHECK_EQUAL(40000, points.m_count);
+            CHECK_EQUAL(1, points.m_attribute_count);
+
+            u64 counts[3] = {0, 0, 0};
+            u64 left      = 0; // of the second triangle, x < 11
+            for (u64 i = 0; i < points.m_count; ++i)
+            {
+                f32 const x = points.m_positions.m_x[i];
+                f32 const y = points.m_positions.m_y[i];
+                u32 const t = points.m_triangles[i];
+                counts[t]++;
+                CHECK_EQUAL(0.0f, points.m_positions.m_z[i]);
+                f32 const d = points.m_attributes[0][i] - (x + 2.0f * y);
+                CHECK_TRUE(d > -0.0001f && d < 0.0001f);
+
+                // inside of its triangle
+                if (t == 0)
+                    CHECK_TRUE(x >= 0.0f && y >= 0.0f && x * 0.5f + y <= 1.0001f);
+                else
+                    CHECK_TRUE(x >= 10.0f && y >= 0.0f && (x - 10.0f) * 1.5f + y <= 3.0001f);
+                if (t == 1 && x < 11.0f)
+                    left++;
+            }
+            CHECK_EQUAL(0, counts[2]);
+            CHECK_TRUE(counts[0] > 9500 && counts[0] < 10500);
+            // the part of the second triangle left of x = 11 has 3/4 of its area
+            CHECK_TRUE(left > counts[1] * 73 / 100 && left < counts[1] * 77 / 100);
+        }
+
+        UNITTEST_TEST(deterministic)
+        {
+            sAllocator->reset();
+            nsample::mesh_t const mesh = make_mesh();
+            nsample::table_t      table;
+            CHECK_TRUE(nsample::build(sAllocator, nullptr, mesh, table));
+
+            nsample::config_t config;
+            config.m_seed = 3;
+            nsample::points_t serial, parallel, other;
+            test_scheduler  scheduler;
+            CHECK_TRUE(nsample::sample(sAllocator, nullptr, mesh, table, 50000, config, serial));
+            CHECK_TRUE(nsample::sample(sAllocator, &scheduler, mesh, table, 50000, config, parallel));
+            config.m_seed = 4;
+            CHECK_TRUE(nsample::sample(sAllocator, &scheduler, mesh, table, 50000, config, other));
+            CHECK_EQUAL(0, parallel.m_attribute_count);
+
+            u64 differences = 0;
+            u64 same_other  = 0;
+            for (u64 i = 0; i < serial.m_count; ++i)
+            {
+                if (serial.m_positions.m_x[i] != parallel.m_positions.m_x[i] || serial.m_positions.m_y[i] != parallel.m_positions.m_y[i] || serial.m_triangles[i] != parallel.m_triangles[i])
+                    differences++;
+                if (serial.m_positions.m_x[i] == other.m_positions.m_x[i])
+                    same_other++;
+            }
+            CHECK_EQUAL(0, differences);
+            CHECK_TRUE(same_other < 100);
+        }
+
+        UNITTEST_TEST(poisson_disk)
+        {
+            sAllocator->reset();
+            nsample::mesh_t const mesh = make_mesh();
+            nsample::table_t      table;
+            CHECK_TRUE(nsample::build(sAllocator, nullptr, mesh, table));
+
+            nsample::config_t config;
+            config.m_attributes   = true;
+            config.m_min_distance = 0.05f;
+            nsample::points_t serial, parallel;
+            test_scheduler  scheduler;
+            CHECK_TRUE(nsample::sample(sAllocator, nullptr, mesh, table, 30000, config, serial));
+            CHECK_TRUE(nsample::sample(sAllocator, &scheduler, mesh, table, 30000, config, parallel));
+
+            // a disk of radius 0.025 around every point, an area of 4 fits at most ~2300 of them
+            CHECK_TRUE(serial.m_count > 800 && serial.m_count < 2400);
+            CHECK_EQUAL(serial.m_count, parallel.m_count);
+            u64 close = 0;
+            for (u64 i = 0; i < serial.m_count; ++i)
+            {
+                for (u64 j = i + 1; j < serial.m_count; ++j)
+                {
+                    f32 const dx = serial.m_positions.m_x[i] - serial.m_positions.m_x[j];
+                    f32 const dy = serial.m_positions.m_y[i] - serial.m_positions.m_y[j];
+                    if (dx * dx + dy * dy < 0.05f * 0.05f)
+                        close++;
+                }
+                f32 const d = serial.m_attributes[0][i] - (serial.m_positions.m_x[i] + 2.0f * serial.m_positions.m_y[i]);
+                CHECK_TRUE(d > -0.0001f && d < 0.0001f);
+                CHECK_EQUAL(serial.m_positions.m_x[i], parallel.m_positions.m_x[i]);
+            }
+            CHECK_EQUAL(0, close);
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,133 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_svo.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(svo)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_svo_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_svo_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        static void make_voxel(nsvo::voxel_t& v, u16 x, u16 y, u16 z, u8 value)
+        {
+            v.x     = x;
+            v.y     = y;
+            v.z     = z;
+            v.value = value;
+            v.pad   = 0;
+        }
+
+        UNITTEST_TEST(build_and_lookup)
+        {
+            sAllocator->reset();
+
+            nsvo::voxel_t voxels[5];
+            make_voxel(voxels[0], 0, 0, 0, 1);
+            make_voxel(voxels[1], 255, 255, 255, 2);
+            make_voxel(voxels[2], 17, 3, 200, 3);
+            make_voxel(voxels[3], 18, 3, 200, 4);
+            make_voxel(voxels[4], 17, 3, 200, 5); // duplicate, last one wins
+
+            nsvo::svo_t svo;
+            CHECK_TRUE(nsvo::build(sAllocator, 8, voxels, 5, svo));
+            CHECK_EQUAL(8, nsvo::get_depth(svo));
+            CHECK_EQUAL(4, nsvo::get_voxel_count(svo));
+            CHECK_EQUAL(1, nsvo::get_voxel(svo, 0, 0, 0));
+            CHECK_EQUAL(2, nsvo::get_voxel(svo, 255, 255, 255));
+            CHECK_EQUAL(5, nsvo::get_voxel(svo, 17, 3, 200));
+            CHECK_EQUAL(4, nsvo::get_voxel(svo, 18, 3, 200));
+            CHECK_EQUAL(0, nsvo::get_voxel(svo, 19, 3, 200));
+            CHECK_EQUAL(0, nsvo::get_voxel(svo, 256, 0, 0));
+
+            nsvo::svo_t opened;
+            CHECK_TRUE(nsvo::open(svo.m_data, svo.m_size, opened));
+            CHECK_EQUAL(5, nsvo::get_voxel(opened, 17, 3, 200));
+            CHECK_FALSE(nsvo::open(svo.m_data, 16, opened));
+        }
+
+        UNITTEST_TEST(merge)
+        {
+            sAllocator->reset();
+
+            // A filled 16^3 block
+            nsvo::voxel_t* voxels = (nsvo::voxel_t*)sAllocator->alloc(sizeof(nsvo::voxel_t) * 4096);
+            u32            n      = 0;
+            for (u16 z = 0; z < 16; ++z)
+                for (u16 y = 0; y < 16; ++y)
+                    for (u16 x = 0; x < 16; ++x)
+                        make_voxel(voxels[n++], x, y, z, 1);
+
+            nsvo::svo_t svo;
+            CHECK_TRUE(nsvo::build(sAllocator, 8, voxels, n, svo));
+            CHECK_EQUAL(4096, nsvo::get_voxel_count(svo));
+
+            nsvo::voxel_t edits[3];
+            make_voxel(edits[0], 100, 100, 100, 7); // add
+            make_voxel(edits[1], 3, 4, 5, 9);       // modify
+            make_voxel(edits[2], 15, 15, 15, 0);    // remove
+
+            nsvo::svo_t merged;
+            CHECK_TRUE(nsvo::merge(sAllocator, svo, edits, 3, merged));
+            CHECK_EQUAL(4096, nsvo::get_voxel_count(merged));
+            CHECK_EQUAL(7, nsvo::get_voxel(merged, 100, 100, 100));
+            CHECK_EQUAL(9, nsvo::get_voxel(merged, 3, 4, 5));
+            CHECK_EQUAL(0, nsvo::get_voxel(merged, 15, 15, 15));
+            CHECK_EQUAL(1, nsvo::get_voxel(merged, 14, 15, 15));
+
+            nsvo::voxel_t* decoded = (nsvo::voxel_t*)sAllocator->alloc(sizeof(nsvo::voxel_t) * 4096);
+            CHECK_EQUAL(4096, nsvo::decode(merged, decoded, 4096));
+            for (u32 i = 0; i < 4096; ++i)
+            {
+                CHECK_EQUAL(decoded[i].value, nsvo::get_voxel(merged, decoded[i].x, decoded[i].y, decoded[i].z));
+            }
+        }
+
+        UNITTEST_TEST(scratch_memory)
+        {
+            sAllocator->reset();
+
+            nsvo::voxel_t voxels[3];
+            make_voxel(voxels[0], 1, 2, 3, 1);
+            make_voxel(voxels[1], 40, 50, 60, 2);
+            make_voxel(voxels[2], 1, 2, 3, 3);
+
+            // only the images are left behind
+            counting_allocator allocator(sAllocator, 100);
+            nsvo::svo_t        svo, merged;
+            CHECK_TRUE(nsvo::build(&allocator, 6, voxels, 3, svo));
+            CHECK_EQUAL(1, allocator.m_live);
+            CHECK_TRUE(nsvo::merge(&allocator, svo, voxels, 2, merged));
+            CHECK_EQUAL(2, allocator.m_live);
+            CHECK_EQUAL(1, nsvo::get_voxel(merged, 1, 2, 3));
+
+            // every allocation failing in turn
+            for (s64 limit = 0; limit < 7; ++limit)
+            {
+                nsvo::svo_t        out;
+                counting_allocator build_allocator(sAllocator, limit);
+                CHECK_EQUAL(limit == 6, nsvo::build(&build_allocator, 6, voxels, 3, out));
+                CHECK_EQUAL(limit == 6 ? 1 : 0, build_allocator.m_live);
+                counting_allocator merge_allocator(sAllocator, limit);
+                CHECK_FALSE(nsvo::merge(&merge_allocator, svo, voxels, 2, out));
+                CHECK_EQUAL(0, merge_allocator.m_live);
+            }
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,115 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_synthetic.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(synthetic)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_synthetic_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_synthetic_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        static void load(nsynthetic::config_t const& config, nply::vertex_t* vertices, nply::triangle_t* triangles)
+        {
+            u64 const   size = 4 * 1024 * 1024;
+            u8*         data = (u8*)sAllocator->alloc(size);
+            test_writer writer(data, size);
+            CHECK_TRUE(nsynthetic::generate(config, &writer));
+
+            nply::memory_reader_t reader(data, writer.m_used);
+            nply::ply_t*          ply = nply::create(sAllocator);
+            CHECK_TRUE(nply::read_header(ply, &reader));
+            CHECK_EQUAL(config.m_vertex_count, nply::get_element_count(ply, "vertex"));
+            CHECK_EQUAL(config.m_face_count, nply::get_element_count(ply, "face"));
+
+            nply::vertices_handler_t  vertices_handler(vertices, config.m_vertex_count);
+            nply::triangles_handler_t triangles_handler(triangles, config.m_face_count);
+            CHECK_TRUE(nply::read_data(ply, &reader, &vertices_handler, &triangles_handler));
+            CHECK_EQUAL(config.m_vertex_count, vertices_handler.m_vertex_count);
+            CHECK_EQUAL(config.m_face_count, triangles_handler.m_triangle_count);
+            CHECK_EQUAL(reader.m_end, reader.m_cursor);
+        }
+
+        UNITTEST_TEST(formats_decode_the_same)
+        {
+            sAllocator->reset();
+
+            nsynthetic::config_t config;
+            config.m_vertex_count    = 2000;
+            config.m_face_count      = 3000;
+            config.m_attribute_count = 5;
+            config.m_seed            = 7;
+
+            nply::vertex_t*   vertices[3];
+            nply::triangle_t* triangles[3];
+            for (s32 f = 0; f < 3; ++f)
+            {
+                vertices[f]     = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * config.m_vertex_count);
+                triangles[f]    = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * config.m_face_count);
+                config.m_format = (nply::eformat)f;
+                load(config, vertices[f], triangles[f]);
+            }
+
+            for (u64 i = 0; i < config.m_vertex_count; ++i)
+            {
+                CHECK_TRUE(vertices[1][i].x >= -100.0f && vertices[1][i].x <= 100.0f);
+                CHECK_EQUAL(vertices[1][i].x, vertices[2][i].x); // little and big endian
+                CHECK_EQUAL(vertices[1][i].z, vertices[2][i].z);
+                CHECK_CLOSE(vertices[1][i].y, vertices[0][i].y, 0.0001f); // ascii has 6 decimals
+            }
+            for (u64 i = 0; i < config.m_face_count; ++i)
+            {
+                CHECK_TRUE(triangles[0][i].v1 < config.m_vertex_count);
+                CHECK_EQUAL(triangles[0][i].v1, triangles[1][i].v1);
+                CHECK_EQUAL(triangles[0][i].v3, triangles[2][i].v3);
+            }
+        }
+
+        UNITTEST_TEST(repeatable)
+        {
+            sAllocator->reset();
+
+            nsynthetic::config_t config;
+            config.m_vertex_count  = 100;
+            config.m_face_count    = 10;
+            config.m_face_arity    = 4;
+            config.m_position_type = nply::TYPE_FLOAT64;
+
+            u8*         a = (u8*)sAllocator->alloc(64 * 1024);
+            u8*         b = (u8*)sAllocator->alloc(64 * 1024);
+            test_writer wa(a, 64 * 1024);
+            test_writer wb(b, 64 * 1024);
+            CHECK_TRUE(nsynthetic::generate(config, &wa));
+            CHECK_TRUE(nsynthetic::generate(config, &wb));
+            CHECK_EQUAL(wa.m_used, wb.m_used);
+            bool same = true;
+            for (u64 i = 0; i < wa.m_used; ++i)
+                same = same && (a[i] == b[i]);
+            CHECK_TRUE(same);
+
+            config.m_seed = 2;
+            test_writer wc(b, 64 * 1024);
+            CHECK_TRUE(nsynthetic::generate(config, &wc));
+            same = true;
+            for (u64 i = 0; i < wa.m_used; ++i)
+                same = same && (a[i] == b[i]);
+            CHECK_FALSE(same);
+        }
+    }
+}
+UNITTEST_SUITE_END
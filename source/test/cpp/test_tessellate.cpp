@@ -0,0 +1,231 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_tessellate.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(tessellate)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_tessellate_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_tessellate_allocator;
+            sAllocator->init(Allocator, 32 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        static f32 linear(f32 x, f32 y, f32 z) { return 2.0f * x + 3.0f * y - z; }
+
+        // Two attributes, a linear function of the position and a constant
+        static void alloc_mesh(u64 vertex_count, u64 triangle_count, ntessellate::mesh_t& mesh)
+        {
+            mesh.m_positions.m_x     = (f32*)sAllocator->alloc(sizeof(f32) * vertex_count);
+            mesh.m_positions.m_y     = (f32*)sAllocator->alloc(sizeof(f32) * vertex_count);
+            mesh.m_positions.m_z     = (f32*)sAllocator->alloc(sizeof(f32) * vertex_count);
+            mesh.m_positions.m_count = vertex_count;
+            mesh.m_attributes        = (f32**)sAllocator->alloc(sizeof(f32*) * 2);
+            mesh.m_attributes[0]     = (f32*)sAllocator->alloc(sizeof(f32) * vertex_count);
+            mesh.m_attributes[1]     = (f32*)sAllocator->alloc(sizeof(f32) * vertex_count);
+            mesh.m_attribute_count   = 2;
+            mesh.m_triangles         = (nply::triangle_t*)sAllocator->alloc(sizeof(nply::triangle_t) * triangle_count);
+            mesh.m_triangle_count    = triangle_count;
+        }
+
+        static void set_vertex(ntessellate::mesh_t& mesh, u32 i, f32 x, f32 y, f32 z)
+        {
+            mesh.m_positions.m_x[i] = x;
+            mesh.m_positions.m_y[i] = y;
+            mesh.m_positions.m_z[i] = z;
+            mesh.m_attributes[0][i] = linear(x, y, z);
+            mesh.m_attributes[1][i] = 1.0f;
+        }
+
+        static void set_triangle(ntessellate::mesh_t& mesh, u64 t, u32 v1, u32 v2, u32 v3)
+        {
+            mesh.m_triangles[t].v1 = v1;
+            mesh.m_triangles[t].v2 = v2;
+            mesh.m_triangles[t].v3 = v3;
+        }
+
+        // The unit cube, counter-clockwise seen from outside
+        static ntessellate::mesh_t make_cube()
+        {
+            ntessellate::mesh_t mesh;
+            alloc_mesh(8, 12, mesh);
+            for (u32 i = 0; i < 8; ++i)
+                set_vertex(mesh, i, (f32)(i & 1), (f32)((i >> 1) & 1), (f32)((i >> 2) & 1));
+            u32 const quads[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+            for (u32 q = 0; q < 6; ++q)
+            {
+                set_triangle(mesh, q * 2 + 0, quads[q][0], quads[q][1], quads[q][2]);
+                set_triangle(mesh, q * 2 + 1, quads[q][0], quads[q][2], quads[q][3]);
+            }
+            return mesh;
+        }
+
+        static ntessellate::mesh_t make_grid(u32 n)
+        {
+            ntessellate::mesh_t mesh;
+            alloc_mesh((n + 1) * (n + 1), n * n * 2, mesh);
+            for (u32 y = 0; y <= n; ++y)
+                for (u32 x = 0; x <= n; ++x)
+                    set_vertex(mesh, y * (n + 1) + x, (f32)x, (f32)y, (f32)((x * 7 + y * 3) % 5) * 0.25f);
+            for (u32 y = 0; y < n; ++y)
+            {
+                for (u32 x = 0; x < n; ++x)
+                {
+                    u32 const i = y * (n + 1) + x;
+                    set_triangle(mesh, (y * n + x) * 2 + 0, i, i + 1, i + n + 2);
+                    set_triangle(mesh, (y * n + x) * 2 + 1, i, i + n + 2, i + n + 1);
+                }
+            }
+            return mesh;
+        }
+
+        static f32 max_edge_sq(ntessellate::mesh_t const& mesh)
+        {
+            f32 max = 0.0f;
+            for (u64 t = 0; t < mesh.m_triangle_count; ++t)
+            {
+                u32 const v[3] = {mesh.m_triangles[t].v1, mesh.m_triangles[t].v2, mesh.m_triangles[t].v3};
+                for (s32 e = 0; e < 3; ++e)
+                {
+                    u32 const a  = v[e];
+                    u32 const b  = v[(e + 1) % 3];
+                    f32 const dx = mesh.m_positions.m_x[a] - mesh.m_positions.m_x[b];
+                    f32 const dy = mesh.m_positions.m_y[a] - mesh.m_positions.m_y[b];
+                    f32 const dz = mesh.m_positions.m_z[a] - mesh.m_positions.m_z[b];
+                    f32 const d  = dx * dx + dy * dy + dz * dz;
+                    max          = d > max ? d : max;
+                }
+            }
+            return max;
+        }
+
+        UNITTEST_TEST(atomic_cas)
+        {
+            u64 volatile value = 5;
+            CHECK_EQUAL(5, nparallel::atomic_cas(&value, 4, 9));
+            CHECK_EQUAL(5, value);
+            CHECK_EQUAL(5, nparallel::atomic_cas(&value, 5, 9));
+            CHECK_EQUAL(9, value);
+        }
+
+        UNITTEST_TEST(cube)
+        {
+            sAllocator->reset();
+            ntessellate::mesh_t const cube = make_cube();
+            ntessellate::config_t     config;
+            config.m_max_edge_length = 0.3f;
+            ntessellate::mesh_t result;
+            CHECK_TRUE(ntessellate::split(sAllocator, nullptr, cube, config, result));
+            CHECK_TRUE(result.m_triangle_count > 12 * 16);
+            CHECK_TRUE(max_edge_sq(result) <= 0.09f);
+            CHECK_EQUAL(2, result.m_attribute_count);
+
+            // watertight: every edge is used once in each direction
+            for (u64 t = 0; t < result.m_triangle_count; ++t)
+            {
+                u32 const v[3] = {result.m_triangles[t].v1, result.m_triangles[t].v2, result.m_triangles[t].v3};
+                for (s32 e = 0; e < 3; ++e)
+                {
+                    u32 opposite = 0;
+                    for (u64 o = 0; o < result.m_triangle_count; ++o)
+                    {
+                        u32 const w[3] = {result.m_triangles[o].v1, result.m_triangles[o].v2, result.m_triangles[o].v3};
+                        for (s32 f = 0; f < 3; ++f)
+                            if (w[f] == v[(e + 1) % 3] && w[(f + 1) % 3] == v[e])
+                                opposite++;
+                    }
+                    CHECK_EQUAL(1, opposite);
+                }
+            }
+
+            f64 const volume = nmesh::signed_volume(nullptr, result.m_positions, result.m_triangles, result.m_triangle_count);
+            CHECK_TRUE(volume > 0.9999 && volume < 1.0001);
+
+            for (u64 i = 0; i < result.m_positions.m_count; ++i)
+            {
+                f32 const expected = linear(result.m_positions.m_x[i], result.m_positions.m_y[i], result.m_positions.m_z[i]);
+                f32 const d        = result.m_attributes[0][i] - expected;
+                CHECK_TRUE(d > -0.0001f && d < 0.0001f);
+                CHECK_EQUAL(1.0f, result.m_attributes[1][i]);
+            }
+            ntessellate::release(sAllocator, result);
+        }
+
+        UNITTEST_TEST(rounds)
+        {
+            sAllocator->reset();
+            ntessellate::mesh_t const cube = make_cube();
+            ntessellate::config_t     config;
+            ntessellate::mesh_t       result;
+
+            config.m_max_edge_length = 0.0f;
+            CHECK_FALSE(ntessellate::split(sAllocator, nullptr, cube, config, result));
+
+            // no rounds is a copy
+            config.m_max_edge_length = 0.3f;
+            config.m_max_rounds      = 0;
+            CHECK_TRUE(ntessellate::split(sAllocator, nullptr, cube, config, result));
+            CHECK_EQUAL(8, result.m_positions.m_count);
+            CHECK_EQUAL(12, result.m_triangle_count);
+            CHECK_TRUE(result.m_triangles != cube.m_triangles);
+            for (u64 t = 0; t < 12; ++t)
+                CHECK_EQUAL(cube.m_triangles[t].v3, result.m_triangles[t].v3);
+
+            // one round splits every edge of the cube once
+            config.m_max_rounds = 1;
+            CHECK_TRUE(ntessellate::split(sAllocator, nullptr, cube, config, result));
+            CHECK_EQUAL(8 + 18, result.m_positions.m_count);
+            CHECK_EQUAL(12 * 4, result.m_triangle_count);
+            CHECK_TRUE(max_edge_sq(result) > 0.09f);
+        }
+
+        UNITTEST_TEST(parallel)
+        {
+            sAllocator->reset();
+            ntessellate::mesh_t const grid = make_grid(100);
+            ntessellate::config_t     config;
+            config.m_max_edge_length = 0.7f;
+
+            ntessellate::mesh_t serial;
+            CHECK_TRUE(ntessellate::split(sAllocator, nullptr, grid, config, serial));
+            CHECK_TRUE(max_edge_sq(serial) <= 0.49f);
+
+            test_scheduler      scheduler;
+            ntessellate::mesh_t parallel;
+            CHECK_TRUE(ntessellate::split(sAllocator, &scheduler, grid, config, parallel));
+
+            CHECK_EQUAL(serial.m_positions.m_count, parallel.m_positions.m_count);
+            CHECK_EQUAL(serial.m_triangle_count, parallel.m_triangle_count);
+            u64 differences = 0;
+            for (u64 i = 0; i < serial.m_positions.m_count; ++i)
+            {
+                if (serial.m_positions.m_x[i] != parallel.m_positions.m_x[i] || serial.m_positions.m_y[i] != parallel.m_positions.m_y[i] || serial.m_positions.m_z[i] != parallel.m_positions.m_z[i])
+                    differences++;
+                if (serial.m_attributes[0][i] != parallel.m_attributes[0][i])
+                    differences++;
+            }
+            for (u64 t = 0; t < serial.m_triangle_count; ++t)
+            {
+                nply::triangle_t const& a = serial.m_triangles[t];
+                nply::triangle_t const& b = parallel.m_triangles[t];
+                if (a.v1 != b.v1 || a.v2 != b.v2 || a.v3 != b.v3)
+                    differences++;
+            }
+            CHECK_EQUAL(0, differences);
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,212 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "c3dff/c_tiles.h"
+
+#include "cunittest/cunittest.h"
+#include "c3dff/test_allocator.h"
+#include "c3dff/test_helpers.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(tiles)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_ALLOCATOR;
+
+        static ply_allocator  s_tiles_allocator;
+        static ply_allocator* sAllocator = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sAllocator = &s_tiles_allocator;
+            sAllocator->init(Allocator, 16 * 1024 * 1024);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { sAllocator->exit(); }
+
+        static inline s32 abs_diff(f32 a, f32 b) { return (s32)(a > b ? a - b : b - a); }
+
+        // The cells of an 8x8x8 grid in a shuffled order
+        static nply::vertex_t* make_grid(u32 seed)
+        {
+            nply::vertex_t* points = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * 512);
+            for (u32 i = 0; i < 512; ++i)
+            {
+                points[i].x = (f32)(i & 7);
+                points[i].y = (f32)((i >> 3) & 7);
+                points[i].z = (f32)(i >> 6);
+            }
+            for (u32 i = 511; i > 0; --i)
+            {
+                seed                   = seed * 1664525 + 1013904223;
+                u32 const            j = (seed >> 8) % (i + 1);
+                nply::vertex_t const t = points[i];
+                points[i]              = points[j];
+                points[j]              = t;
+            }
+            return points;
+        }
+
+        UNITTEST_TEST(curves)
+        {
+            sAllocator->reset();
+            test_scheduler  scheduler;
+            nply::vertex_t* points = make_grid(7);
+            u32*            order  = (u32*)sAllocator->alloc(sizeof(u32) * 512);
+
+            // every step along the hilbert curve moves to a neighbouring cell
+            CHECK_TRUE(ntiles::sort(sAllocator, &scheduler, points, 512, ntiles::CURVE_HILBERT, order));
+            for (u32 i = 1; i < 512; ++i)
+            {
+                nply::vertex_t const& a = points[order[i - 1]];
+                nply::vertex_t const& b = points[order[i]];
+                CHECK_EQUAL(1, abs_diff(a.x, b.x) + abs_diff(a.y, b.y) + abs_diff(a.z, b.z));
+            }
+
+            // the morton curve visits the 2x2x2 blocks one after the other
+            CHECK_TRUE(ntiles::sort(sAllocator, &scheduler, points, 512, ntiles::CURVE_MORTON, order));
+            for (u32 i = 0; i < 512; i += 8)
+            {
+                nply::vertex_t const& first = points[order[i]];
+                for (u32 j = 1; j < 8; ++j)
+                {
+                    nply::vertex_t const& p = points[order[i + j]];
+                    CHECK_TRUE((s32)p.x / 2 == (s32)first.x / 2 && (s32)p.y / 2 == (s32)first.y / 2 && (s32)p.z / 2 == (s32)first.z / 2);
+                }
+            }
+            CHECK_EQUAL(0.0f, points[order[0]].x + points[order[0]].y + points[order[0]].z);
+            CHECK_EQUAL(21.0f, points[order[511]].x + points[order[511]].y + points[order[511]].z);
+        }
+
+        static inline bool is_non_finite(u32 point) { return point == 10 || point == 20 || point == 30; }
+
+        UNITTEST_TEST(non_finite)
+        {
+            sAllocator->reset();
+            test_scheduler  scheduler;
+            nply::vertex_t* points = make_grid(5);
+            u32*            order  = (u32*)sAllocator->alloc(sizeof(u32) * 512);
+
+            // one Inf coordinate does not flatten the curve, NaN and Inf points are out of the bounds
+            f32 const inf = 1e30f * 1e30f;
+            points[10].x  = inf;
+            points[20].y  = inf - inf;
+            points[30].z  = -inf;
+            CHECK_TRUE(ntiles::sort(sAllocator, &scheduler, points, 512, ntiles::CURVE_HILBERT, order));
+            u32 steps = 0;
+            for (u32 i = 1; i < 512; ++i)
+            {
+                if (is_non_finite(order[i - 1]) || is_non_finite(order[i]))
+                    continue;
+                nply::vertex_t const& a = points[order[i - 1]];
+                nply::vertex_t const& b = points[order[i]];
+                if (abs_diff(a.x, b.x) + abs_diff(a.y, b.y) + abs_diff(a.z, b.z) == 1)
+                    steps++;
+            }
+            CHECK_TRUE(steps > 490);
+
+            ntiles::config_t config;
+            config.m_tile_size = 64;
+            ntiles::tiled_t tiled;
+            CHECK_TRUE(ntiles::build(sAllocator, &scheduler, points, nullptr, 0, 512, config, tiled));
+            n3d::box_t const bounds = ntiles::get_bounds(tiled);
+            for (s32 i = 0; i < 3; ++i)
+            {
+                CHECK_EQUAL(0.0f, bounds.m_min[i]);
+                CHECK_EQUAL(7.0f, bounds.m_max[i]);
+            }
+        }
+
+        UNITTEST_TEST(build_and_query)
+        {
+            sAllocator->reset();
+            test_scheduler scheduler;
+
+            u32 const       count      = 50000; // a few parts for the radix sort
+            nply::vertex_t* points     = (nply::vertex_t*)sAllocator->alloc(sizeof(nply::vertex_t) * count);
+            f32*            attributes = (f32*)sAllocator->alloc(sizeof(f32) * 2 * count);
+            u32             seed       = 3;
+            for (u32 i = 0; i < count; ++i)
+            {
+                f32* v = &points[i].x;
+                for (s32 k = 0; k < 3; ++k)
+                {
+                    seed = seed * 1664525 + 1013904223;
+                    v[k] = (f32)(seed >> 8) / (f32)(1 << 24) * (k == 2 ? 10.0f : 100.0f);
+                }
+                attributes[i * 2 + 0] = points[i].x + points[i].y;
+                attributes[i * 2 + 1] = (f32)i;
+            }
+
+            ntiles::config_t config;
+            config.m_tile_size = 1000;
+            ntiles::tiled_t tiled;
+            CHECK_TRUE(ntiles::build(sAllocator, &scheduler, points, attributes, 2, count, config, tiled));
+            CHECK_EQUAL(count, ntiles::get_point_count(tiled));
+            CHECK_EQUAL(50, ntiles::get_tile_count(tiled));
+            CHECK_EQUAL(2, ntiles::get_attribute_count(tiled));
+            CHECK_EQUAL(20, ntiles::get_stride(tiled));
+
+            // every point is in one tile, with its attributes, inside of the tile box
+            u8* seen = (u8*)sAllocator->alloc(count);
+            for (u32 i = 0; i < count; ++i)
+                seen[i] = 0;
+            f32 volume = 0.0f;
+            for (u32 t = 0; t < ntiles::get_tile_count(tiled); ++t)
+            {
+                ntiles::tile_t const& tile = ntiles::get_tile(tiled, t);
+                CHECK_EQUAL(0, tile.m_offset & 4095);
+                CHECK_EQUAL(1000, tile.m_count);
+                f32 const* records = ntiles::get_points(tiled, t);
+                for (u32 i = 0; i < tile.m_count; ++i, records += 5)
+                {
+                    u32 const p = (u32)records[4];
+                    CHECK_EQUAL(0, seen[p]);
+                    seen[p] = 1;
+                    CHECK_EQUAL(points[p].x, records[0]);
+                    CHECK_EQUAL(points[p].z, records[2]);
+                    CHECK_EQUAL(attributes[p * 2], records[3]);
+                    CHECK_TRUE(n3d::box_contains(tile.m_box, points[p]));
+                }
+                volume += (tile.m_box.m_max[0] - tile.m_box.m_min[0]) * (tile.m_box.m_max[1] - tile.m_box.m_min[1]) * (tile.m_box.m_max[2] - tile.m_box.m_min[2]);
+            }
+            // spatially compact tiles, in file order every tile would span (almost) the whole volume
+            CHECK_TRUE(volume < 100.0f * 100.0f * 10.0f * 4.0f);
+
+            // a reader that only has the index finds the tiles of a range
+            u64 const index_size = ntiles::get_index_size(tiled.m_data, ntiles::HEADER_SIZE);
+            CHECK_TRUE(index_size > ntiles::HEADER_SIZE && index_size < 4096);
+            ntiles::tiled_t index;
+            CHECK_FALSE(ntiles::open(tiled.m_data, index_size - 1, index));
+            CHECK_TRUE(ntiles::open(tiled.m_data, index_size, index));
+            CHECK_TRUE(ntiles::get_points(index, 0) == nullptr);
+
+            n3d::box_t range;
+            range.m_min[0] = 20.0f;
+            range.m_min[1] = 30.0f;
+            range.m_min[2] = 2.0f;
+            range.m_max[0] = 35.0f;
+            range.m_max[1] = 40.0f;
+            range.m_max[2] = 6.0f;
+            u32       tiles[50];
+            u32 const n = ntiles::query(index, range, tiles, 50);
+            CHECK_TRUE(n > 0 && n < 25);
+
+            u32 inside = 0;
+            for (u32 i = 0; i < count; ++i)
+                inside += n3d::box_contains(range, points[i]) ? 1 : 0;
+            u32 found = 0;
+            for (u32 k = 0; k < n; ++k)
+            {
+                ntiles::tile_t const& tile    = ntiles::get_tile(index, tiles[k]);
+                f32 const*            records = (f32 const*)(tiled.m_data + tile.m_offset); // 'mapped' by the reader
+                for (u32 i = 0; i < tile.m_count; ++i, records += 5)
+                    found += n3d::box_contains(range, points[(u32)records[4]]) ? 1 : 0;
+            }
+            CHECK_EQUAL(inside, found);
+
+            CHECK_EQUAL(0, ntiles::get_index_size(tiled.m_data + 8, ntiles::HEADER_SIZE));
+        }
+    }
+}
+UNITTEST_SUITE_END
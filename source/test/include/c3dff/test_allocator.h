@@ -7,6 +7,7 @@
 
 #include "cbase/c_allocator.h"
 #include "cunittest/private/ut_Config.h"
+#include "c3dff/c_ply.h"
 
 class test_alloc_t : public ncore::alloc_t
 {
@@ -22,6 +23,36 @@ public:
     virtual void  v_release() {}
 };
 
+class ply_allocator : public ncore::nply::allocator_t
+{
+    ncore::alloc_t* m_allocator;
+    ncore::u8*      m_memory;
+    ncore::u8*      m_ptr;
+    ncore::u32      m_size;
+
+public:
+    void init(ncore::alloc_t* allocator, ncore::u32 size = 128 * 1024 * 1024)
+    {
+        m_allocator = allocator;
+        m_size      = size;
+        m_memory    = (ncore::u8*)m_allocator->allocate(m_size, 8);
+        m_ptr       = m_memory;
+    }
+
+    void exit() { m_allocator->deallocate(m_memory); }
+
+    void reset() { m_ptr = m_memory; }
+
+protected:
+    virtual void* v_alloc(ncore::u64 size, ncore::u32 alignment)
+    {
+        ncore::u8* ptr = (ncore::u8*)(((ncore::uint_t)m_ptr + (alignment - 1)) & ~(ncore::uint_t)(alignment - 1));
+        ASSERT(size <= (ncore::u64)((m_memory + m_size) - ptr));
+        m_ptr = ptr + ((size + (16 - 1)) & ~(ncore::u64)(16 - 1));
+        return ptr;
+    }
+};
+
 #define UNITTEST_ALLOCATOR                            \
     static test_alloc_t TestAlloc(&FixtureAllocator); \
     static alloc_t*     Allocator = &TestAlloc
@@ -0,0 +1,80 @@
+#ifndef __TEST_HELPERS_H__
+#define __TEST_HELPERS_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "c3dff/c_ply.h"
+#include "c3dff/c_parallel.h"
+#include "c3dff/c_synthetic.h"
+
+// Runs the parts on the calling thread in reverse order, so that nothing depends on the parts
+// being executed in order
+class test_scheduler : public ncore::nparallel::scheduler_t
+{
+public:
+    virtual ncore::s32 concurrency() { return 4; }
+    virtual void       run(ncore::nparallel::task_t* task, ncore::s32 count)
+    {
+        for (ncore::s32 i = count - 1; i >= 0; --i)
+            task->execute(i);
+    }
+};
+
+// Writes into a fixed buffer, fails when it is full
+class test_writer : public ncore::nsynthetic::writer_t
+{
+public:
+    test_writer(ncore::u8* buffer, ncore::u64 size)
+        : m_buffer(buffer)
+        , m_size(size)
+        , m_used(0)
+    {
+    }
+    virtual bool write(const ncore::u8* data, ncore::u64 size)
+    {
+        if (m_used + size > m_size)
+            return false;
+        for (ncore::u64 i = 0; i < size; ++i)
+            m_buffer[m_used + i] = data[i];
+        m_used += size;
+        return true;
+    }
+    ncore::u8* m_buffer;
+    ncore::u64 m_size;
+    ncore::u64 m_used;
+};
+
+// Counts the live allocations, allocations after 'm_limit' of them fail
+class counting_allocator : public ncore::nply::allocator_t
+{
+public:
+    counting_allocator(ncore::nply::allocator_t* backing, ncore::s64 limit)
+        : m_backing(backing)
+        , m_live(0)
+        , m_allocs(0)
+        , m_limit(limit)
+    {
+    }
+    ncore::nply::allocator_t* m_backing;
+    ncore::s64                m_live;
+    ncore::s64                m_allocs;
+    ncore::s64                m_limit;
+
+protected:
+    virtual void* v_alloc(ncore::u64 size, ncore::u32 alignment)
+    {
+        if (m_allocs++ >= m_limit)
+            return nullptr;
+        m_live++;
+        return m_backing->alloc(size, alignment);
+    }
+    virtual void v_dealloc(void* ptr)
+    {
+        if (ptr != nullptr)
+            m_live--;
+    }
+};
+
+#endif // __TEST_HELPERS_H__